@@ -0,0 +1,454 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  pidip_bench : runs PiDiP modules without pd and measures them
+ *
+ *  usage : pidip_bench [-n frames] [-s WIDTHxHEIGHT] [-y file.y4m] [-v] [module ...]
+ *
+ *  each module processes synthetic frames, and the frames of a
+ *  YUV4MPEG2 file ( 4:2:0 ) if one is given, at 320x240, 1280x720
+ *  and 1920x1080 or at the sizes given with -s.
+ *  a line of comma separated values is printed for each run :
+ *
+ *  module,source,width,height,frames,ns_per_pixel,frames_per_s,allocs_per_frame
+ *
+ *  only the register and process messages sent to the module are timed,
+ *  allocations are getbytes calls and packets that could not be reused.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pdp.h"
+#include "pidip_bench.h"
+
+#define BENCH_MAXSIZES 8
+#define BENCH_NBSYNTH 8         // synthetic frames, cycled
+#define BENCH_MAXRECORDED 32    // frames read from a recording
+#define BENCH_WARMUP 3          // frames processed before measuring
+
+void pdp_aging_setup(void);
+void pdp_baltan_setup(void);
+void pdp_bgmodel_setup(void);
+void pdp_binary_setup(void);
+void pdp_cycle_setup(void);
+void pdp_dice_setup(void);
+void pdp_dilate_setup(void);
+void pdp_disintegration_setup(void);
+void pdp_distance_setup(void);
+void pdp_dot_setup(void);
+void pdp_edge_setup(void);
+void pdp_erode_setup(void);
+void pdp_fdiff_setup(void);
+void pdp_hitandmiss_setup(void);
+void pdp_intrusion_setup(void);
+void pdp_lens_setup(void);
+void pdp_lumafilt_setup(void);
+void pdp_mosaic_setup(void);
+void pdp_nervous_setup(void);
+void pdp_noquark_setup(void);
+void pdp_puzzle_setup(void);
+void pdp_quark_setup(void);
+void pdp_radioactiv_setup(void);
+void pdp_rev_setup(void);
+void pdp_ripple_setup(void);
+void pdp_shagadelic_setup(void);
+void pdp_simura_setup(void);
+void pdp_smuck_setup(void);
+void pdp_spiral_setup(void);
+void pdp_spotlight_setup(void);
+void pdp_transform_setup(void);
+void pdp_underwatch_setup(void);
+void pdp_vertigo_setup(void);
+void pdp_warhol_setup(void);
+void pdp_warp_setup(void);
+
+typedef struct _bench_module
+{
+  char *m_name;
+  void (*m_setup)(void);
+} t_bench_module;
+
+static t_bench_module bench_modules[] =
+{
+  { "pdp_aging", pdp_aging_setup },
+  { "pdp_baltan", pdp_baltan_setup },
+  { "pdp_bgmodel", pdp_bgmodel_setup },
+  { "pdp_binary", pdp_binary_setup },
+  { "pdp_cycle", pdp_cycle_setup },
+  { "pdp_dice", pdp_dice_setup },
+  { "pdp_dilate", pdp_dilate_setup },
+  { "pdp_disintegration", pdp_disintegration_setup },
+  { "pdp_distance", pdp_distance_setup },
+  { "pdp_dot", pdp_dot_setup },
+  { "pdp_edge", pdp_edge_setup },
+  { "pdp_erode", pdp_erode_setup },
+  { "pdp_fdiff", pdp_fdiff_setup },
+  { "pdp_hitandmiss", pdp_hitandmiss_setup },
+  { "pdp_intrusion", pdp_intrusion_setup },
+  { "pdp_lens", pdp_lens_setup },
+  { "pdp_lumafilt", pdp_lumafilt_setup },
+  { "pdp_mosaic", pdp_mosaic_setup },
+  { "pdp_nervous", pdp_nervous_setup },
+  { "pdp_noquark", pdp_noquark_setup },
+  { "pdp_puzzle", pdp_puzzle_setup },
+  { "pdp_quark", pdp_quark_setup },
+  { "pdp_radioactiv", pdp_radioactiv_setup },
+  { "pdp_rev", pdp_rev_setup },
+  { "pdp_ripple", pdp_ripple_setup },
+  { "pdp_shagadelic", pdp_shagadelic_setup },
+  { "pdp_simura", pdp_simura_setup },
+  { "pdp_smuck", pdp_smuck_setup },
+  { "pdp_spiral", pdp_spiral_setup },
+  { "pdp_spotlight", pdp_spotlight_setup },
+  { "pdp_transform", pdp_transform_setup },
+  { "pdp_underwatch", pdp_underwatch_setup },
+  { "pdp_vertigo", pdp_vertigo_setup },
+  { "pdp_warhol", pdp_warhol_setup },
+  { "pdp_warp", pdp_warp_setup },
+};
+
+#define BENCH_NBMODULES (int)(sizeof(bench_modules)/sizeof(t_bench_module))
+
+/* frames of a source at one size, YV12 S16 */
+typedef struct _bench_frames
+{
+  char *f_source;
+  int f_width;
+  int f_height;
+  int f_nbframes;
+  short int **f_data;
+} t_bench_frames;
+
+/* a recording, YV12 U8 at its own size */
+typedef struct _bench_recording
+{
+  int r_width;
+  int r_height;
+  int r_nbframes;
+  unsigned char *r_data[BENCH_MAXRECORDED];
+} t_bench_recording;
+
+static double bench_now( void )
+{
+  struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static void bench_allocframes( t_bench_frames *f, char *source, int width, int height, int nbframes )
+{
+  int i;
+
+    f->f_source = source;
+    f->f_width = width;
+    f->f_height = height;
+    f->f_nbframes = nbframes;
+    f->f_data = (short int **) malloc( nbframes*sizeof(short int *) );
+    for ( i=0; i<nbframes; i++ )
+    {
+       f->f_data[i] = (short int *) malloc( (width*height+((width*height)>>1))<<1 );
+    }
+}
+
+static void bench_freeframes( t_bench_frames *f )
+{
+  int i;
+
+    for ( i=0; i<f->f_nbframes; i++ ) free( f->f_data[i] );
+    free( f->f_data );
+}
+
+/* a gradient with some noise and a bright square moving across it */
+static void bench_synthetic( t_bench_frames *f, int width, int height )
+{
+  int i, px, py, vsize = width*height;
+  int sx, sy, ssize = height/4;
+  unsigned int seed = 1;
+  short int *pY, *pV, *pU;
+
+    bench_allocframes( f, "synthetic", width, height, BENCH_NBSYNTH );
+    for ( i=0; i<BENCH_NBSYNTH; i++ )
+    {
+       pY = f->f_data[i];
+       pV = pY+vsize;
+       pU = pV+(vsize>>2);
+       sx = ( i*(width-ssize) )/BENCH_NBSYNTH;
+       sy = ( height-ssize )/2;
+       for ( py=0; py<height; py++ )
+       {
+          for ( px=0; px<width; px++ )
+          {
+             seed = seed*1103515245+12345;
+             if ( ( px>=sx ) && ( px<sx+ssize ) && ( py>=sy ) && ( py<sy+ssize ) )
+                *pY++ = 235<<7;
+             else
+                *pY++ = ( ( ( px+py+4*i )*192/( width+height ) ) + ( ( seed>>16 )&15 ) ) << 7;
+          }
+       }
+       for ( py=0; py<(height>>1); py++ )
+       {
+          for ( px=0; px<(width>>1); px++ )
+          {
+             *pV++ = ( ( px*64 )/( width>>1 ) - 32 ) << 8;
+             *pU++ = ( ( py*64 )/( height>>1 ) - 32 ) << 8;
+          }
+       }
+    }
+}
+
+/* reads the 4:2:0 frames of a YUV4MPEG2 file */
+static int bench_readrecording( t_bench_recording *r, char *filename )
+{
+  FILE *fd;
+  char line[1024], *tag;
+  int framesize;
+
+    r->r_nbframes = 0;
+    if ( !( fd = fopen( filename, "rb" ) ) )
+    {
+       fprintf( stderr, "pidip_bench : cannot open %s\n", filename );
+       return 0;
+    }
+    if ( !fgets( line, sizeof(line), fd ) || strncmp( line, "YUV4MPEG2 ", 10 ) )
+    {
+       fprintf( stderr, "pidip_bench : %s is not a YUV4MPEG2 file\n", filename );
+       fclose( fd );
+       return 0;
+    }
+    r->r_width = r->r_height = 0;
+    for ( tag=strtok( line+10, " \n" ); tag; tag=strtok( NULL, " \n" ) )
+    {
+       if ( tag[0] == 'W' ) r->r_width = atoi( tag+1 );
+       if ( tag[0] == 'H' ) r->r_height = atoi( tag+1 );
+       if ( ( tag[0] == 'C' ) && strncmp( tag+1, "420", 3 ) )
+       {
+          fprintf( stderr, "pidip_bench : %s is not 4:2:0\n", filename );
+          fclose( fd );
+          return 0;
+       }
+    }
+    if ( ( r->r_width <= 0 ) || ( r->r_height <= 0 ) )
+    {
+       fclose( fd );
+       return 0;
+    }
+    framesize = r->r_width*r->r_height + 2*( (r->r_width>>1)*(r->r_height>>1) );
+    while ( ( r->r_nbframes < BENCH_MAXRECORDED ) && fgets( line, sizeof(line), fd ) &&
+            !strncmp( line, "FRAME", 5 ) )
+    {
+       r->r_data[r->r_nbframes] = (unsigned char *) malloc( framesize );
+       if ( fread( r->r_data[r->r_nbframes], 1, framesize, fd ) != (size_t)framesize )
+       {
+          free( r->r_data[r->r_nbframes] );
+          break;
+       }
+       r->r_nbframes++;
+    }
+    fclose( fd );
+    return ( r->r_nbframes > 0 );
+}
+
+/* the recording scaled to a size ( nearest sample ), to S16 and V before U */
+static void bench_recorded( t_bench_frames *f, t_bench_recording *r, int width, int height )
+{
+  int i, px, py, sx, sy;
+  int rvsize = r->r_width*r->r_height, vsize = width*height;
+  int rcw = r->r_width>>1, cw = width>>1, ch = height>>1;
+  unsigned char *sY, *sU, *sV;
+  short int *pY, *pV, *pU;
+
+    bench_allocframes( f, "recorded", width, height, r->r_nbframes );
+    for ( i=0; i<r->r_nbframes; i++ )
+    {
+       sY = r->r_data[i];
+       sU = sY+rvsize;
+       sV = sU+(rvsize>>2);
+       pY = f->f_data[i];
+       pV = pY+vsize;
+       pU = pV+(vsize>>2);
+       for ( py=0; py<height; py++ )
+       {
+          sy = ( py*r->r_height )/height;
+          for ( px=0; px<width; px++ )
+          {
+             sx = ( px*r->r_width )/width;
+             *pY++ = sY[sy*r->r_width+sx]<<7;
+          }
+       }
+       for ( py=0; py<ch; py++ )
+       {
+          sy = ( py*(r->r_height>>1) )/ch;
+          for ( px=0; px<cw; px++ )
+          {
+             sx = ( px*rcw )/cw;
+             *pV++ = ( sV[sy*rcw+sx]-128 )<<8;
+             *pU++ = ( sU[sy*rcw+sx]-128 )<<8;
+          }
+       }
+    }
+}
+
+/* sends frames to a new object of the module and prints the measures */
+static void bench_run( t_bench_module *m, t_bench_frames *f, int nbframes )
+{
+  t_class *c = pidip_bench_class( m->m_name );
+  t_pidip_bench_input input;
+  void *x;
+  int i, packet, vsize = f->f_width*f->f_height;
+  double start, elapsed = 0.;
+  unsigned long allocs, nballocs = 0, outputs;
+
+    if ( !c || !( input = (t_pidip_bench_input) pidip_bench_method( c, "pdp" ) ) )
+    {
+       fprintf( stderr, "pidip_bench : %s has no pdp inlet\n", m->m_name );
+       return;
+    }
+    if ( !( x = pidip_bench_new( c ) ) )
+    {
+       fprintf( stderr, "pidip_bench : could not create %s\n", m->m_name );
+       return;
+    }
+
+    outputs = pidip_bench_outputs;
+    for ( i=-BENCH_WARMUP; i<nbframes; i++ )
+    {
+       // the frame is sent like pdp_packet_pass_if_valid does,
+       // released between the register and the process messages
+       packet = pdp_packet_new_image_YCrCb( f->f_width, f->f_height );
+       memcpy( pdp_packet_data( packet ), f->f_data[(i+BENCH_WARMUP)%f->f_nbframes],
+               (vsize+(vsize>>1))<<1 );
+
+       allocs = pidip_bench_allocs;
+       start = bench_now();
+       input( x, gensym( "register_rw" ), (t_floatarg)packet );
+       pdp_packet_mark_unused( packet );
+       input( x, gensym( "process" ), 0 );
+       if ( i >= 0 )
+       {
+          elapsed += bench_now() - start;
+          nballocs += pidip_bench_allocs - allocs;
+       }
+    }
+    pidip_bench_free( x );
+
+    if ( pidip_bench_outputs == outputs )
+    {
+       fprintf( stderr, "pidip_bench : %s sent no packet\n", m->m_name );
+    }
+    printf( "%s,%s,%d,%d,%d,%.3f,%.2f,%.2f\n", m->m_name, f->f_source, f->f_width, f->f_height,
+            nbframes, elapsed/((double)nbframes*vsize), nbframes/(elapsed/1e9),
+            (double)nballocs/nbframes );
+    fflush( stdout );
+}
+
+static void bench_usage( void )
+{
+  int i;
+
+    fprintf( stderr, "usage : pidip_bench [-n frames] [-s WIDTHxHEIGHT] [-y file.y4m] [-v] [module ...]\n" );
+    fprintf( stderr, "modules :" );
+    for ( i=0; i<BENCH_NBMODULES; i++ ) fprintf( stderr, " %s", bench_modules[i].m_name );
+    fprintf( stderr, "\n" );
+    exit( 1 );
+}
+
+int main( int argc, char **argv )
+{
+  int widths[BENCH_MAXSIZES] = { 320, 1280, 1920 };
+  int heights[BENCH_MAXSIZES] = { 240, 720, 1080 };
+  int nbsizes = 3, usersizes = 0;
+  int nbframes = 50;
+  char *recording = NULL;
+  int *selected;
+  int i, j, s, nbselected = 0;
+  t_bench_recording rec;
+  t_bench_frames frames;
+
+    selected = (int *) calloc( BENCH_NBMODULES, sizeof(int) );
+    memset( &rec, 0x0, sizeof(rec) );
+    for ( i=1; i<argc; i++ )
+    {
+       if ( !strcmp( argv[i], "-n" ) && ( i+1 < argc ) )
+       {
+          nbframes = atoi( argv[++i] );
+          if ( nbframes <= 0 ) bench_usage();
+       }
+       else if ( !strcmp( argv[i], "-s" ) && ( i+1 < argc ) )
+       {
+          if ( !usersizes ) nbsizes = 0;
+          usersizes = 1;
+          if ( ( nbsizes >= BENCH_MAXSIZES ) ||
+               ( sscanf( argv[++i], "%dx%d", &widths[nbsizes], &heights[nbsizes] ) != 2 ) ||
+               ( widths[nbsizes] < 16 ) || ( heights[nbsizes] < 16 ) )
+             bench_usage();
+          // pdp images have sizes multiple of 8
+          widths[nbsizes] &= ~7;
+          heights[nbsizes] &= ~7;
+          nbsizes++;
+       }
+       else if ( !strcmp( argv[i], "-y" ) && ( i+1 < argc ) )
+       {
+          recording = argv[++i];
+       }
+       else if ( !strcmp( argv[i], "-v" ) )
+       {
+          pidip_bench_verbose = 1;
+       }
+       else
+       {
+          for ( j=0; j<BENCH_NBMODULES; j++ )
+          {
+             if ( !strcmp( argv[i], bench_modules[j].m_name ) ) break;
+          }
+          if ( j == BENCH_NBMODULES ) bench_usage();
+          selected[j] = 1;
+          nbselected++;
+       }
+    }
+
+    if ( recording && !bench_readrecording( &rec, recording ) ) exit( 1 );
+
+    for ( j=0; j<BENCH_NBMODULES; j++ ) bench_modules[j].m_setup();
+
+    printf( "module,source,width,height,frames,ns_per_pixel,frames_per_s,allocs_per_frame\n" );
+    for ( s=0; s<nbsizes; s++ )
+    {
+       bench_synthetic( &frames, widths[s], heights[s] );
+       for ( j=0; j<BENCH_NBMODULES; j++ )
+       {
+          if ( !nbselected || selected[j] ) bench_run( &bench_modules[j], &frames, nbframes );
+       }
+       bench_freeframes( &frames );
+
+       if ( !recording ) continue;
+       bench_recorded( &frames, &rec, widths[s], heights[s] );
+       for ( j=0; j<BENCH_NBMODULES; j++ )
+       {
+          if ( !nbselected || selected[j] ) bench_run( &bench_modules[j], &frames, nbframes );
+       }
+       bench_freeframes( &frames );
+    }
+
+    free( selected );
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  pidip_bench.h : pd and pdp stand ins for the benchmark of PiDiP modules
+ *
+ * the benchmark links the modules against a minimal implementation
+ * of the pd and pdp calls they make, so they run without pd.
+ * classes are recorded when the modules are set up and objects
+ * are created with their default arguments.
+ * packets come from a pool like in pdp, the process queue runs
+ * the processing and the callback at once in the calling thread,
+ * and the packets sent by the modules are released at once.
+ * allocations ( getbytes and new packets ) are counted.
+ */
+
+#ifndef PIDIP_BENCH_H
+#define PIDIP_BENCH_H
+
+#include "pdp.h"
+
+typedef void (*t_pidip_bench_input)( void *x, t_symbol *s, t_floatarg f );
+
+/* the class set up with 'name', NULL if it was not */
+t_class *pidip_bench_class( char *name );
+/* an object created with its default arguments */
+void *pidip_bench_new( t_class *c );
+void pidip_bench_free( void *x );
+/* the method of the left inlet for 'selector' */
+t_method pidip_bench_method( t_class *c, char *selector );
+
+extern unsigned long pidip_bench_allocs;   // getbytes calls and new packets
+extern unsigned long pidip_bench_outputs;  // packets sent by the modules
+extern int pidip_bench_verbose;            // prints the posts of the modules
+
+#endif
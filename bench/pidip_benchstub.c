@@ -0,0 +1,619 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  pd and pdp stand ins for the benchmark
+ *  ( see pidip_bench.h )
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "pdp.h"
+#include "pidip_bench.h"
+
+#define BENCH_MAXARGS 6
+#define BENCH_MAXMETHODS 128
+#define BENCH_MAXPACKETS 256
+
+unsigned long pidip_bench_allocs = 0;
+unsigned long pidip_bench_outputs = 0;
+int pidip_bench_verbose = 0;
+
+/* ------------------------ symbols ------------------------ */
+
+t_symbol s_pointer = { "pointer", 0, 0 };
+t_symbol s_float = { "float", 0, 0 };
+t_symbol s_symbol = { "symbol", 0, 0 };
+t_symbol s_bang = { "bang", 0, 0 };
+t_symbol s_list = { "list", 0, 0 };
+t_symbol s_anything = { "anything", 0, 0 };
+t_symbol s_signal = { "signal", 0, 0 };
+t_symbol s_ = { "", 0, 0 };
+
+static t_symbol *bench_builtins[] = { &s_pointer, &s_float, &s_symbol, &s_bang,
+                                      &s_list, &s_anything, &s_signal, &s_ };
+static t_symbol *bench_symbols = NULL;
+
+t_symbol *gensym(const char *s)
+{
+  t_symbol *sym;
+  unsigned int i;
+
+    for ( i=0; i<sizeof(bench_builtins)/sizeof(t_symbol*); i++ )
+    {
+       if ( !strcmp( bench_builtins[i]->s_name, s ) ) return bench_builtins[i];
+    }
+    for ( sym=bench_symbols; sym; sym=sym->s_next )
+    {
+       if ( !strcmp( sym->s_name, s ) ) return sym;
+    }
+    sym = (t_symbol *) calloc( 1, sizeof(t_symbol) );
+    sym->s_name = strdup( s );
+    sym->s_next = bench_symbols;
+    bench_symbols = sym;
+    return sym;
+}
+
+/* ------------------------ memory and posts ------------------------ */
+
+void *getbytes(size_t nbytes)
+{
+    pidip_bench_allocs++;
+    return calloc( 1, nbytes ? nbytes : 1 );
+}
+
+void *resizebytes(void *x, size_t oldsize, size_t newsize)
+{
+  char *y;
+
+    pidip_bench_allocs++;
+    y = (char *) realloc( x, newsize ? newsize : 1 );
+    if ( y && ( newsize > oldsize ) ) memset( y+oldsize, 0x0, newsize-oldsize );
+    return y;
+}
+
+void freebytes(void *x, size_t nbytes)
+{
+    free( x );
+}
+
+static void bench_vpost( const char *fmt, va_list ap )
+{
+    if ( !pidip_bench_verbose ) return;
+    vfprintf( stderr, fmt, ap );
+    fprintf( stderr, "\n" );
+}
+
+void post(const char *fmt, ...)
+{
+  va_list ap;
+
+    va_start( ap, fmt );
+    bench_vpost( fmt, ap );
+    va_end( ap );
+}
+
+void error(const char *fmt, ...)
+{
+  va_list ap;
+
+    va_start( ap, fmt );
+    bench_vpost( fmt, ap );
+    va_end( ap );
+}
+
+void pd_error(void *object, const char *fmt, ...)
+{
+  va_list ap;
+
+    va_start( ap, fmt );
+    bench_vpost( fmt, ap );
+    va_end( ap );
+}
+
+void startpost(const char *fmt, ...)
+{
+}
+
+void endpost(void)
+{
+}
+
+/* ------------------------ classes and objects ------------------------ */
+
+typedef struct _bench_method
+{
+  t_symbol *m_sel;
+  t_method m_fn;
+} t_bench_method;
+
+struct _class
+{
+  t_symbol *c_name;
+  t_newmethod c_new;
+  t_method c_free;
+  size_t c_size;
+  t_atomtype c_args[BENCH_MAXARGS];
+  int c_nargs;
+  t_bench_method c_methods[BENCH_MAXMETHODS];
+  int c_nmethods;
+  struct _class *c_next;
+};
+
+struct _outlet
+{
+  int o_unused;
+};
+
+struct _inlet
+{
+  int i_unused;
+};
+
+struct _clock
+{
+  int c_unused;
+};
+
+static t_class *bench_classes = NULL;
+static struct _outlet bench_outlet;
+static struct _inlet bench_inlet;
+
+t_class *class_new(t_symbol *name, t_newmethod newmethod, t_method freemethod,
+                   size_t size, int flags, t_atomtype arg1, ...)
+{
+  t_class *c = (t_class *) calloc( 1, sizeof(t_class) );
+  va_list ap;
+  t_atomtype type = arg1;
+
+    c->c_name = name;
+    c->c_new = newmethod;
+    c->c_free = freemethod;
+    c->c_size = size;
+    va_start( ap, arg1 );
+    while ( type != A_NULL && c->c_nargs < BENCH_MAXARGS )
+    {
+       c->c_args[c->c_nargs++] = type;
+       type = (t_atomtype) va_arg( ap, int );
+    }
+    va_end( ap );
+    c->c_next = bench_classes;
+    bench_classes = c;
+    return c;
+}
+
+void class_addmethod(t_class *c, t_method fn, t_symbol *sel, t_atomtype arg1, ...)
+{
+    if ( c->c_nmethods >= BENCH_MAXMETHODS ) return;
+    c->c_methods[c->c_nmethods].m_sel = sel;
+    c->c_methods[c->c_nmethods].m_fn = fn;
+    c->c_nmethods++;
+}
+
+void class_addbang(t_class *c, t_method fn)
+{
+    class_addmethod( c, fn, &s_bang, A_NULL );
+}
+
+void class_doaddfloat(t_class *c, t_method fn)
+{
+    class_addmethod( c, fn, &s_float, A_FLOAT, A_NULL );
+}
+
+void class_addsymbol(t_class *c, t_method fn)
+{
+    class_addmethod( c, fn, &s_symbol, A_SYMBOL, A_NULL );
+}
+
+void class_addlist(t_class *c, t_method fn)
+{
+    class_addmethod( c, fn, &s_list, A_GIMME, A_NULL );
+}
+
+void class_addanything(t_class *c, t_method fn)
+{
+    class_addmethod( c, fn, &s_anything, A_GIMME, A_NULL );
+}
+
+void class_addcreator(t_newmethod newmethod, t_symbol *s, t_atomtype type1, ...)
+{
+}
+
+void class_sethelpsymbol(t_class *c, t_symbol *s)
+{
+}
+
+const char *class_getname(const t_class *c)
+{
+    return c->c_name->s_name;
+}
+
+t_class *pidip_bench_class( char *name )
+{
+  t_class *c;
+  t_symbol *s = gensym( name );
+
+    for ( c=bench_classes; c; c=c->c_next )
+    {
+       if ( c->c_name == s ) return c;
+    }
+    return NULL;
+}
+
+t_method pidip_bench_method( t_class *c, char *selector )
+{
+  t_symbol *s = gensym( selector );
+  int i;
+
+    for ( i=0; i<c->c_nmethods; i++ )
+    {
+       if ( c->c_methods[i].m_sel == s ) return c->c_methods[i].m_fn;
+    }
+    return NULL;
+}
+
+t_pd *pd_new(t_class *c)
+{
+  t_pd *x = (t_pd *) calloc( 1, c->c_size );
+
+    *x = c;
+    return x;
+}
+
+void pd_free(t_pd *x)
+{
+  t_class *c = *x;
+
+    if ( c->c_free ) ((void (*)(void *))c->c_free)( x );
+    free( x );
+}
+
+/* like pd, symbols are passed as integers and floats after them */
+typedef void *(*t_bench_newgimme)( t_symbol *s, int argc, t_atom *argv );
+typedef void *(*t_bench_newargs)( t_int i1, t_int i2, t_int i3, t_int i4, t_int i5, t_int i6,
+                                  t_floatarg f1, t_floatarg f2, t_floatarg f3,
+                                  t_floatarg f4, t_floatarg f5, t_floatarg f6 );
+
+void *pidip_bench_new( t_class *c )
+{
+  t_int ai[BENCH_MAXARGS];
+  t_floatarg af[BENCH_MAXARGS];
+  int i, ni = 0, nf = 0;
+
+    if ( ( c->c_nargs == 1 ) && ( c->c_args[0] == A_GIMME ) )
+    {
+       return ((t_bench_newgimme)c->c_new)( c->c_name, 0, NULL );
+    }
+    memset( ai, 0x0, sizeof(ai) );
+    memset( af, 0x0, sizeof(af) );
+    for ( i=0; i<c->c_nargs; i++ )
+    {
+       if ( ( c->c_args[i] == A_SYMBOL ) || ( c->c_args[i] == A_DEFSYM ) )
+          ai[ni++] = (t_int)&s_;
+       else
+          af[nf++] = 0.;
+    }
+    return ((t_bench_newargs)c->c_new)( ai[0], ai[1], ai[2], ai[3], ai[4], ai[5],
+                                        af[0], af[1], af[2], af[3], af[4], af[5] );
+}
+
+void pidip_bench_free( void *x )
+{
+    pd_free( (t_pd *)x );
+}
+
+t_inlet *inlet_new(t_object *owner, t_pd *dest, t_symbol *s1, t_symbol *s2)
+{
+    return &bench_inlet;
+}
+
+t_inlet *floatinlet_new(t_object *owner, t_float *fp)
+{
+    return &bench_inlet;
+}
+
+t_inlet *symbolinlet_new(t_object *owner, t_symbol **sp)
+{
+    return &bench_inlet;
+}
+
+t_outlet *outlet_new(t_object *owner, t_symbol *s)
+{
+    return &bench_outlet;
+}
+
+void outlet_bang(t_outlet *x)
+{
+}
+
+void outlet_float(t_outlet *x, t_float f)
+{
+}
+
+void outlet_symbol(t_outlet *x, t_symbol *s)
+{
+}
+
+void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
+{
+}
+
+t_float atom_getfloat(t_atom *a)
+{
+    return ( a->a_type == A_FLOAT ) ? a->a_w.w_float : 0.;
+}
+
+t_float atom_getfloatarg(int which, int argc, t_atom *argv)
+{
+    return ( which < argc ) ? atom_getfloat( argv+which ) : 0.;
+}
+
+t_symbol *atom_getsymbol(t_atom *a)
+{
+    return ( a->a_type == A_SYMBOL ) ? a->a_w.w_symbol : &s_;
+}
+
+/* clocks never fire, the benchmark has no scheduler */
+t_clock *clock_new(void *owner, t_method fn)
+{
+    return (t_clock *) calloc( 1, sizeof(t_clock) );
+}
+
+void clock_set(t_clock *x, double systime)
+{
+}
+
+void clock_delay(t_clock *x, double delaytime)
+{
+}
+
+void clock_unset(t_clock *x)
+{
+}
+
+void clock_free(t_clock *x)
+{
+    free( x );
+}
+
+double clock_getlogicaltime(void)
+{
+  struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec*1000. + ts.tv_nsec/1000000.;
+}
+
+double clock_gettimesince(double prevsystime)
+{
+    return clock_getlogicaltime() - prevsystime;
+}
+
+/* ------------------------ packets ------------------------ */
+
+typedef struct _bench_packet
+{
+  t_pdp *p_header;
+  void *p_data;
+  unsigned int p_size;     // bytes of data
+} t_bench_packet;
+
+static t_bench_packet bench_packets[BENCH_MAXPACKETS];
+
+t_pdp *pdp_packet_header(int packet)
+{
+    if ( ( packet < 0 ) || ( packet >= BENCH_MAXPACKETS ) ) return NULL;
+    if ( !bench_packets[packet].p_header || !bench_packets[packet].p_header->users ) return NULL;
+    return bench_packets[packet].p_header;
+}
+
+void *pdp_packet_data(int packet)
+{
+    if ( !pdp_packet_header( packet ) ) return NULL;
+    return bench_packets[packet].p_data;
+}
+
+/* a free packet of the same size is reused, like in pdp */
+static int bench_packet_new( unsigned int type, unsigned int encoding, unsigned int width,
+                             unsigned int height, unsigned int size )
+{
+  int i, packet = -1;
+  t_pdp *header;
+
+    for ( i=0; i<BENCH_MAXPACKETS; i++ )
+    {
+       if ( bench_packets[i].p_header && !bench_packets[i].p_header->users &&
+            ( bench_packets[i].p_size == size ) )
+       {
+          packet = i;
+          break;
+       }
+    }
+    if ( packet < 0 )
+    {
+       for ( i=0; i<BENCH_MAXPACKETS; i++ )
+       {
+          if ( !bench_packets[i].p_header )
+          {
+             bench_packets[i].p_header = (t_pdp *) calloc( 1, sizeof(t_pdp) );
+             bench_packets[i].p_data = calloc( 1, size );
+             bench_packets[i].p_size = size;
+             pidip_bench_allocs++;
+             packet = i;
+             break;
+          }
+       }
+    }
+    if ( packet < 0 ) return -1;
+
+    header = bench_packets[packet].p_header;
+    header->type = type;
+    header->size = size;
+    header->users = 1;
+    if ( type == PDP_IMAGE )
+    {
+       header->info.image.encoding = encoding;
+       header->info.image.width = width;
+       header->info.image.height = height;
+    }
+    else
+    {
+       header->info.bitmap.encoding = encoding;
+       header->info.bitmap.width = width;
+       header->info.bitmap.height = height;
+    }
+    return packet;
+}
+
+int pdp_packet_new_image_YCrCb(u32 w, u32 h)
+{
+    return bench_packet_new( PDP_IMAGE, PDP_IMAGE_YV12, w, h, (w*h+((w*h)>>1))<<1 );
+}
+
+int pdp_packet_new_image_grey(u32 w, u32 h)
+{
+    return bench_packet_new( PDP_IMAGE, PDP_IMAGE_GREY, w, h, (w*h)<<1 );
+}
+
+int pdp_packet_new_bitmap_yv12(u32 w, u32 h)
+{
+    return bench_packet_new( PDP_BITMAP, PDP_BITMAP_YV12, w, h, w*h+((w*h)>>1) );
+}
+
+int pdp_packet_new_bitmap_rgb(u32 w, u32 h)
+{
+    return bench_packet_new( PDP_BITMAP, PDP_BITMAP_RGB, w, h, w*h*3 );
+}
+
+int pdp_packet_new_image(t_pdp_symbol *type, u32 w, u32 h)
+{
+    return pdp_packet_new_image_YCrCb( w, h );
+}
+
+int pdp_packet_copy_ro(int packet)
+{
+  t_pdp *header = pdp_packet_header( packet );
+
+    if ( !header ) return -1;
+    header->users++;
+    return packet;
+}
+
+int pdp_packet_clone_rw(int packet)
+{
+  t_pdp *header = pdp_packet_header( packet );
+  int clone;
+
+    if ( !header ) return -1;
+    clone = bench_packet_new( header->type, header->info.image.encoding,
+                              header->info.image.width, header->info.image.height, header->size );
+    if ( clone >= 0 ) memcpy( &bench_packets[clone].p_header->info, &header->info, sizeof(header->info) );
+    return clone;
+}
+
+int pdp_packet_copy_rw(int packet)
+{
+  int copy = pdp_packet_clone_rw( packet );
+
+    if ( copy >= 0 ) memcpy( bench_packets[copy].p_data, bench_packets[packet].p_data, bench_packets[packet].p_size );
+    return copy;
+}
+
+void pdp_packet_mark_unused(int packet)
+{
+  t_pdp *header = pdp_packet_header( packet );
+
+    if ( header ) header->users--;
+}
+
+void pdp_packet_delete(int packet)
+{
+    pdp_packet_mark_unused( packet );
+}
+
+/* all the packets of the benchmark are YV12 images already */
+int pdp_packet_convert_ro(int packet, t_pdp_symbol *type)
+{
+    return pdp_packet_copy_ro( packet );
+}
+
+int pdp_packet_convert_rw(int packet, t_pdp_symbol *type)
+{
+    return pdp_packet_copy_rw( packet );
+}
+
+int pdp_packet_convert_ro_or_drop(int *dst, int src, t_pdp_symbol *type)
+{
+    if ( *dst != -1 ) return 1;
+    *dst = pdp_packet_convert_ro( src, type );
+    return 0;
+}
+
+int pdp_packet_convert_rw_or_drop(int *dst, int src, t_pdp_symbol *type)
+{
+    if ( *dst != -1 ) return 1;
+    *dst = pdp_packet_convert_rw( src, type );
+    return 0;
+}
+
+/* nobody is downstream, sent packets are released at once */
+void pdp_packet_pass_if_valid(t_outlet *outlet, int *packet)
+{
+    if ( !pdp_packet_header( *packet ) ) return;
+    pidip_bench_outputs++;
+    pdp_packet_mark_unused( *packet );
+    *packet = -1;
+}
+
+t_pdp_symbol *pdp_gensym(char *s)
+{
+    return (t_pdp_symbol *) gensym( s );
+}
+
+/* ------------------------ process queue ------------------------ */
+
+void pdp_queue_add(void *owner, void *process, void *callback, int *queue_id)
+{
+    ((void (*)(void *))process)( owner );
+    ((void (*)(void *))callback)( owner );
+    *queue_id = -1;
+}
+
+void pdp_queue_finish(int queue_id)
+{
+}
+
+/* ------------------------ image processing ------------------------ */
+
+int pdp_imageproc_legalwidth(int i)
+{
+    return i & ~7;
+}
+
+int pdp_imageproc_legalheight(int i)
+{
+    return i & ~7;
+}
@@ -0,0 +1,127 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_bgmodel.h : shared adaptive background model for motion effects
+ *
+ * a background model learns the luminance of a scene at a decimated
+ * resolution, with a running average or a mixture of gaussians per pixel,
+ * so that slow lighting changes become background.
+ * each frame gives a difference ( background - frame ) and a foreground
+ * mask at the model resolution.
+ *
+ * several effects can attach to the same named model ( like pidip_history ),
+ * the first one pushing a frame has it learnt, the others find it done,
+ * so the model is only updated once per frame of a camera.
+ * frames are pushed from the pd thread and learnt in the process thread,
+ * rows can be shared between worker threads.
+ */
+
+#ifndef PIDIP_BGMODEL_H
+#define PIDIP_BGMODEL_H
+
+#include <pthread.h>
+
+#define PIDIP_BGMODEL_RUNNING 0       // running average
+#define PIDIP_BGMODEL_MOG     1       // mixture of gaussians
+
+#define PIDIP_BGMODEL_GAUSSIANS 3
+#define PIDIP_BGMODEL_MAXSHIFT 3      // decimation up to 8x8 pixels
+#define PIDIP_BGMODEL_MAXTHREADS 8
+
+/* flags of pidip_bgmodel_expand */
+#define PIDIP_BGMODEL_ABS     1       // absolute differences
+#define PIDIP_BGMODEL_MASKED  2       // 0 out of the foreground
+
+typedef struct _pidip_bgmodel_gaussian
+{
+  float g_weight;
+  float g_mean;
+  float g_var;
+} t_pidip_bgmodel_gaussian;
+
+typedef struct _pidip_bgmodel
+{
+  t_symbol *m_name;               // NULL for a private model
+  int m_nbusers;
+
+  /* settings, applied with the next frame */
+  int m_mode;
+  float m_rate;                   // learning rate, 0..1
+  int m_threshold;                // foreground threshold on 0..255
+  int m_wantshift;
+  int m_wantthreads;
+  int m_reset;
+
+  /* model */
+  int m_shift;                    // decimation is 1<<m_shift
+  int m_width;                    // model resolution
+  int m_height;
+  int m_fwidth;                   // frame resolution
+  int m_fheight;
+  int m_frames;                   // frames learnt since the last reset
+  int *m_average;                 // running average, 8.8 fixed point
+  t_pidip_bgmodel_gaussian *m_gaussians;
+  unsigned char *m_luma;          // decimated frame
+  short int *m_diff;              // background - frame, on -255..255
+  unsigned char *m_mask;          // 255 in the foreground
+  float m_foreground;             // part of the frame in the foreground
+
+  /* frame to learn */
+  int m_packet;                   // retained by the last push
+  int m_learnt;
+
+  /* workers */
+  int m_nthreads;
+  pthread_t m_threads[PIDIP_BGMODEL_MAXTHREADS];
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_start;
+  pthread_cond_t m_done;
+  int m_generation;
+  int m_finished;
+  int m_running;
+  int m_counts[PIDIP_BGMODEL_MAXTHREADS]; // foreground pixels of each band
+
+  struct _pidip_bgmodel *m_next;
+} t_pidip_bgmodel;
+
+/* attach a user, name can be NULL */
+t_pidip_bgmodel *pidip_bgmodel_attach( t_symbol *name );
+/* detach a user, the model is freed with its last user */
+void pidip_bgmodel_detach( t_pidip_bgmodel *m );
+
+/* settings, from the pd thread */
+void pidip_bgmodel_mode( t_pidip_bgmodel *m, int mode );
+void pidip_bgmodel_rate( t_pidip_bgmodel *m, float rate );
+void pidip_bgmodel_threshold( t_pidip_bgmodel *m, int threshold );
+void pidip_bgmodel_decimation( t_pidip_bgmodel *m, int shift );
+void pidip_bgmodel_threads( t_pidip_bgmodel *m, int threads );
+void pidip_bgmodel_reset( t_pidip_bgmodel *m );
+
+/* from the pd thread : retain the frame to learn unless it's already there */
+void pidip_bgmodel_push( t_pidip_bgmodel *m, int packet );
+/* from the process thread : learn the pushed frame if it's not done yet,
+   returns 0 if there is no model for this frame */
+int pidip_bgmodel_update( t_pidip_bgmodel *m );
+
+/* write the difference at the frame resolution, in S16 luma units */
+void pidip_bgmodel_expand( t_pidip_bgmodel *m, short int *dst, int width, int height, int flags );
+
+#endif
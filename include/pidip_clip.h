@@ -0,0 +1,92 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_clip.h : raw clips for instant playback
+ *
+ * a raw clip is a header of one page followed by uncompressed frames
+ * in YV12 8 bits ( Y, then V, then U planes, like pdp images ).
+ * each frame starts on a page boundary, so a player maps the file
+ * and asks the kernel to read ahead the pages of the next frames
+ * in the play direction : opening a clip costs nothing
+ * and frames only live in the page cache.
+ *
+ * the header is written in the byte order of the machine.
+ */
+
+#ifndef PIDIP_CLIP_H
+#define PIDIP_CLIP_H
+
+#include <stddef.h>
+
+#define PIDIP_CLIP_MAGIC "PDPCLIP"
+#define PIDIP_CLIP_VERSION 1
+#define PIDIP_CLIP_HEADERSIZE 4096
+#define PIDIP_CLIP_EXTENSION ".clip"
+
+typedef struct _pidip_clipheader
+{
+  char h_magic[8];
+  int h_version;
+  int h_width;
+  int h_height;
+  int h_nbframes;
+  int h_ratenum;              // frame rate is h_ratenum/h_rateden
+  int h_rateden;
+  int h_framesize;            // bytes of a frame
+  int h_framestride;          // bytes between two frames, page aligned
+  int h_offset;               // offset of the first frame
+} t_pidip_clipheader;
+
+typedef struct _pidip_clip
+{
+  int c_fd;
+  unsigned char *c_map;
+  size_t c_maplen;
+  t_pidip_clipheader c_header;
+} t_pidip_clip;
+
+typedef struct _pidip_clipwriter
+{
+  int w_fd;
+  t_pidip_clipheader w_header;
+  unsigned char *w_frame;     // one frame with its padding
+} t_pidip_clipwriter;
+
+/* reading, returns 0 if the file is not a valid clip */
+void pidip_clip_init( t_pidip_clip *clip );
+int pidip_clip_open( t_pidip_clip *clip, char *filename );
+void pidip_clip_close( t_pidip_clip *clip );
+/* converts a frame into a YV12 S16 buffer */
+int pidip_clip_frame( t_pidip_clip *clip, int frame, short int *data );
+/* asks the kernel to read 'count' frames after 'frame' ( before if 'count' < 0 ) */
+void pidip_clip_readahead( t_pidip_clip *clip, int frame, int count, int loop );
+
+/* writing, the number of frames is set by pidip_clip_finish,
+   sizes must be even and the rate positive, as pidip_clip_open requires */
+int pidip_clip_create( t_pidip_clipwriter *writer, char *filename, int width, int height,
+                       int ratenum, int rateden );
+int pidip_clip_write( t_pidip_clipwriter *writer, short int *data );
+int pidip_clip_finish( t_pidip_clipwriter *writer );
+
+/* rational frame rate of a rate in frames per second ( 29.97 gives 30000/1001 ) */
+void pidip_clip_rate( double framerate, int *ratenum, int *rateden );
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_history.h : shared frame history for temporal effects
+ *
+ * a frame history is a ring of PDP packets retained by reference
+ * ( pdp_packet_copy_ro ), newest first.
+ * several effects can attach to the same named history,
+ * the first one pushing a frame stores it, the others find it
+ * already there, so the same source is only kept once.
+ * the ring is as deep as its deepest reader and a frame
+ * is released as soon as no reader wants it anymore.
+ *
+ * all calls are made from the pd thread ( input or callback methods ),
+ * frames needed in the process thread are pinned before queueing
+ * and unpinned in the callback.
+ */
+
+#ifndef PIDIP_HISTORY_H
+#define PIDIP_HISTORY_H
+
+#define PIDIP_HISTORY_MAXDEPTH 256
+
+typedef struct _pidip_history
+{
+  t_symbol *h_name;                 // NULL for a private history
+  int *h_packets;                   // ring of retained packets
+  int h_size;                       // allocated slots
+  int h_head;                       // slot of the newest frame
+  int h_count;                      // number of valid frames
+  int h_width;
+  int h_height;
+  int h_nbreaders;
+  int h_readers[PIDIP_HISTORY_MAXDEPTH+1]; // number of readers for each depth
+  struct _pidip_history *h_next;
+} t_pidip_history;
+
+/* attach a reader wanting 'depth' frames, name can be NULL */
+t_pidip_history *pidip_history_attach( t_symbol *name, int depth );
+/* detach a reader, the history is freed with its last reader */
+void pidip_history_detach( t_pidip_history *h, int depth );
+/* change the depth wanted by one reader */
+void pidip_history_depth( t_pidip_history *h, int olddepth, int newdepth );
+/* store a frame unless it's already the newest one */
+void pidip_history_push( t_pidip_history *h, int packet );
+/* number of frames available */
+int pidip_history_count( t_pidip_history *h );
+/* packet of age 'age' ( 0 is the newest ) or -1, not retained */
+int pidip_history_get( t_pidip_history *h, int age );
+/* retain the 'nb' newest frames in 'packets', returns the number retained */
+int pidip_history_pin( t_pidip_history *h, int *packets, int nb );
+/* release pinned frames */
+void pidip_history_unpin( int *packets, int nb );
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_inplace.h : in place processing of packets owned by one effect
+ *
+ * a packet is passed downstream by releasing it between the register
+ * and the process messages, so when an effect processes it and holds
+ * its only reference, nobody else can see the frame anymore.
+ * the effect can then write its result in the incoming packet
+ * instead of cloning it and copying the whole frame again.
+ *
+ * the output packet is asked in the pd thread, where reference counts
+ * change, before the processing is queued. when it is the input,
+ * a second reference is taken, so that the effect releases its
+ * input and passes its output exactly like with a clone.
+ *
+ * only effects writing each sample after reading it at the same place,
+ * or reading from their own copy of the frame, can work in place.
+ */
+
+#ifndef PIDIP_INPLACE_H
+#define PIDIP_INPLACE_H
+
+/* the packet to write the processing of 'packet' in : 'packet' itself
+   if it has no other user, or a new packet like pdp_packet_clone_rw */
+int pidip_inplace_rw( int packet );
+
+/* starts an output with the content of the input, nothing to do in place */
+void pidip_inplace_copy( short int *newdata, short int *data, int size );
+
+#endif
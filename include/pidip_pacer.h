@@ -0,0 +1,83 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_pacer.h : shared frame clocks for video sources
+ *
+ * a pacer is a named frame clock at an exact rational rate
+ * ( 30000/1001 for ntsc ). a driver ( pdp_pacer~ ) computes the frame
+ * due from its own time base, the dsp sample count or a monotonic timer,
+ * and sources subscribed to the same name get a tick for each new frame.
+ * frames are never computed by accumulating periods, so there is no drift,
+ * frames that are due together are delivered as one tick
+ * telling how many were skipped, so that a player can drop them.
+ *
+ * all calls are made from the pd thread.
+ */
+
+#ifndef PIDIP_PACER_H
+#define PIDIP_PACER_H
+
+/* 'skipped' frames were due before 'frame' and were not ticked */
+typedef void (*t_pidip_pacer_tick)( void *owner, int frame, int skipped );
+
+typedef struct _pidip_pacerclient
+{
+  void *c_owner;
+  t_pidip_pacer_tick c_tick;
+  struct _pidip_pacerclient *c_next;
+} t_pidip_pacerclient;
+
+typedef struct _pidip_pacer
+{
+  t_symbol *p_name;
+  int p_ratenum;                    // frame rate is p_ratenum/p_rateden
+  int p_rateden;
+  int p_frame;                      // last ticked frame, -1 before the first one
+  unsigned int p_late;              // ticks delivered more than half a period late
+  unsigned int p_skipped;           // frames never ticked
+  int p_nbusers;                    // drivers and clients attached
+  t_pidip_pacerclient *p_clients;
+  struct _pidip_pacer *p_next;
+} t_pidip_pacer;
+
+/* the pacer is created by its first user and freed with its last one */
+t_pidip_pacer *pidip_pacer_attach( t_symbol *name );
+void pidip_pacer_detach( t_pidip_pacer *p );
+void pidip_pacer_subscribe( t_pidip_pacer *p, void *owner, t_pidip_pacer_tick tick );
+void pidip_pacer_unsubscribe( t_pidip_pacer *p, void *owner );
+/* leaves 'current' and follows the pacer 'name', &s_ only leaves, returns the pacer followed */
+t_pidip_pacer *pidip_pacer_follow( t_pidip_pacer *current, t_symbol *name, void *owner, t_pidip_pacer_tick tick );
+
+/* returns 0 for a wrong rate */
+int pidip_pacer_rate( t_pidip_pacer *p, int ratenum, int rateden );
+void pidip_pacer_reset( t_pidip_pacer *p );
+
+/* frame due 'elapsed' units after the start, with 'units' per second */
+int pidip_pacer_frameat( t_pidip_pacer *p, long long elapsed, long long units );
+/* start of a frame in units after the start */
+long long pidip_pacer_timeof( t_pidip_pacer *p, int frame, long long units );
+/* ticks the clients if 'frame' is new, returns the number of skipped frames */
+int pidip_pacer_advance( t_pidip_pacer *p, int frame, int late );
+
+/* monotonic time in microseconds */
+long long pidip_pacer_now( void );
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_pipe.h : fused chains of point and neighbourhood operators
+ *
+ * a chain of effects like lumafilt -> binary -> erode makes each
+ * object allocate a packet, queue its processing and stream the whole
+ * frame through memory. a pipe runs the same operators one after the
+ * other on bands of rows instead : a band is loaded in a strip,
+ * goes through all the operators while it stays in the cache, and only
+ * the result is written to the output frame.
+ *
+ * an operator with a neighbourhood needs rows above and below the band,
+ * so each band is loaded with a halo of the rows reached by the
+ * following operators, which are computed twice at band boundaries.
+ * strips are apron planes ( see pidip_plane.h ), replicated at the
+ * borders of the frame, so the operators never check their bounds.
+ *
+ * operators read rows from one strip and write them to the other one,
+ * chrominance rows go with the even luminance rows.
+ */
+
+#ifndef PIDIP_PIPE_H
+#define PIDIP_PIPE_H
+
+#include "pidip_plane.h"
+
+#define PIDIP_PIPE_MAXSTAGES 16
+#define PIDIP_PIPE_MAXREACH 8     // largest half size of a neighbourhood
+#define PIDIP_PIPE_BAND 32        // default number of rows of a band
+
+typedef struct _pidip_strip
+{
+  t_pidip_plane s_y;
+  t_pidip_plane s_v;
+  t_pidip_plane s_u;
+  t_pidip_plane *s_work;      // rows for the intermediate results of an operator, shared
+  int s_base;                 // frame row of the first row of the strip, even
+} t_pidip_strip;
+
+/* rows of a strip, in frame rows, chrominance rows for even luminance rows */
+#define PIDIP_STRIP_Y(strip, y) PIDIP_PLANE_ROW(&(strip)->s_y, (y)-(strip)->s_base)
+#define PIDIP_STRIP_V(strip, y) PIDIP_PLANE_ROW(&(strip)->s_v, ((y)-(strip)->s_base)>>1)
+#define PIDIP_STRIP_U(strip, y) PIDIP_PLANE_ROW(&(strip)->s_u, ((y)-(strip)->s_base)>>1)
+#define PIDIP_STRIP_W(strip, y) PIDIP_PLANE_ROW((strip)->s_work, (y)-(strip)->s_base)
+
+typedef struct _pidip_pipeop
+{
+  char *o_name;
+  int o_size;                 // size of the state of an instance
+  void (*o_init)( void *state );
+  /* sets a parameter, returns 0 if the operator has no such parameter */
+  int (*o_param)( void *state, char *param, int argc, t_float *argv );
+  /* half size of the neighbourhood, 0 for point operators */
+  void (*o_reach)( void *state, int *rx, int *ry );
+  /* luminance rows y0 <= y < y1 of 'width' samples, and their chrominance,
+     from 'in' to 'out' */
+  void (*o_run)( void *state, t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 );
+} t_pidip_pipeop;
+
+typedef struct _pidip_pipe
+{
+  int p_nbstages;
+  t_pidip_pipeop *p_ops[PIDIP_PIPE_MAXSTAGES];
+  void *p_states[PIDIP_PIPE_MAXSTAGES];
+  int p_halo[PIDIP_PIPE_MAXSTAGES+1];   // rows reached from the input of each stage, even
+  int p_band;
+  int p_width;                // size the strips are allocated for
+  int p_height;
+  int p_dirty;                // the reach of a stage changed
+  t_pidip_strip p_strips[2];
+  t_pidip_plane p_work;
+} t_pidip_pipe;
+
+void pidip_pipe_init( t_pidip_pipe *pipe );
+void pidip_pipe_free( t_pidip_pipe *pipe );
+/* the operator called 'name', NULL if none */
+t_pidip_pipeop *pidip_pipe_op( char *name );
+/* appends a stage, returns 0 if there is no such operator or no room */
+int pidip_pipe_add( t_pidip_pipe *pipe, char *name );
+/* sets a parameter of all the stages of operator 'name', returns how many took it */
+int pidip_pipe_param( t_pidip_pipe *pipe, char *name, char *param, int argc, t_float *argv );
+void pidip_pipe_band( t_pidip_pipe *pipe, int band );
+
+/* runs all the stages on a YV12 frame, src and dst must differ */
+void pidip_pipe_yv12( t_pidip_pipe *pipe, short int *src, short int *dst, int width, int height );
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_plane.h : planes with aligned rows and a border apron
+ *
+ * pdp packets keep their planes packed, one row after the other,
+ * so a neighbourhood filter has to check its bounds at each sample.
+ * an effect can import a plane of a packet in a plane of its own,
+ * with rows starting on PIDIP_PLANE_ALIGN bytes and an apron of
+ * 'p_apron' samples all around, filled with copies of the border
+ * samples or with a constant. a kernel not larger than the apron
+ * then reads outside of the frame without any test.
+ *
+ * with a replicated apron, the samples read outside of the frame
+ * are copies of samples inside of the kernel window, so filters
+ * looking for a value in the window ( erosion, dilation, min, max )
+ * give the same result as when skipping the outside of the frame.
+ *
+ * the buffer of a plane comes from pidip_pool and is only taken again when it grows.
+ */
+
+#ifndef PIDIP_PLANE_H
+#define PIDIP_PLANE_H
+
+#define PIDIP_PLANE_ALIGN 32      // alignment of the rows, in bytes
+
+typedef struct _pidip_plane
+{
+  int p_width;
+  int p_height;
+  int p_apron;                // samples around the plane
+  int p_stride;               // samples from a row to the next one
+  short int *p_data;          // sample ( 0, 0 ), aligned
+  void *p_buffer;             // allocated buffer
+  int p_allocated;            // size of the buffer, in bytes
+} t_pidip_plane;
+
+/* samples of a plane, ( x, y ) can be up to p_apron samples out of the frame */
+#define PIDIP_PLANE_ROW(plane, y) ((plane)->p_data+(y)*(plane)->p_stride)
+#define PIDIP_PLANE_AT(plane, x, y) ((plane)->p_data[(y)*(plane)->p_stride+(x)])
+
+/* planes of a packed YV12 packet of width w and height h */
+#define PIDIP_YV12_Y(data, w, h) (data)
+#define PIDIP_YV12_V(data, w, h) ((data)+(w)*(h))
+#define PIDIP_YV12_U(data, w, h) ((data)+(w)*(h)+((w)>>1)*((h)>>1))
+
+void pidip_plane_init( t_pidip_plane *plane );
+void pidip_plane_free( t_pidip_plane *plane );
+/* sets the size of a plane, returns 0 if it cannot be allocated */
+int pidip_plane_alloc( t_pidip_plane *plane, int width, int height, int apron );
+
+/* copies a packed plane in, rows of 'stride' samples, and replicates the border */
+void pidip_plane_import( t_pidip_plane *plane, short int *src, int stride );
+/* copies the plane out, without the apron */
+void pidip_plane_export( t_pidip_plane *plane, short int *dst, int stride );
+
+/* fills the apron with copies of the border samples */
+void pidip_plane_replicate( t_pidip_plane *plane );
+/* fills the apron with a constant */
+void pidip_plane_border( t_pidip_plane *plane, short int value );
+
+#endif
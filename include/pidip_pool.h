@@ -0,0 +1,71 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_pool.h : pool of scratch buffers with size classes
+ *
+ * effects reallocate their frame sized buffers each time the size
+ * of the frames changes, so switching resolutions back and forth
+ * goes through the allocator again and again, and a buffer freed with
+ * the wrong size or never freed makes the memory creep over days.
+ *
+ * buffers are taken from the pool and given back to it instead :
+ * the size is rounded up to a class ( powers of two and the halves
+ * between them ) and kept in a header before the buffer, so that
+ * giving back only needs the buffer. buffers given back stay resident
+ * in the list of their class, up to a limit of bytes, and are taken
+ * again by the next request of the class. like getbytes, the buffers
+ * are cleared, and they are aligned on PIDIP_POOL_ALIGN bytes.
+ *
+ * the lists are shared by all the effects and locked, buffers can be
+ * taken in the pd thread and given back in the process thread.
+ */
+
+#ifndef PIDIP_POOL_H
+#define PIDIP_POOL_H
+
+#define PIDIP_POOL_ALIGN 32
+#define PIDIP_POOL_LIMIT (64*1024*1024)   // default of the resident bytes
+
+typedef struct _pidip_pool_stats
+{
+  unsigned long s_hits;           // requests served by a resident buffer
+  unsigned long s_misses;         // requests allocating a buffer
+  unsigned long s_released;       // buffers given back beyond the limit and freed
+  unsigned long s_resident;       // bytes waiting in the lists
+  unsigned long s_used;           // bytes held by the effects
+  unsigned long s_peak;           // most bytes held by the effects
+  unsigned long s_limit;
+} t_pidip_pool_stats;
+
+/* a cleared buffer of at least 'size' bytes, NULL if it cannot be allocated */
+void *pidip_pool_get( int size );
+/* gives a buffer back, NULL is ignored */
+void pidip_pool_put( void *buffer );
+/* 'buffer' if it holds 'size' bytes, cleared, or another buffer, the content is not kept */
+void *pidip_pool_resize( void *buffer, int size );
+
+/* frees the resident buffers */
+void pidip_pool_trim( void );
+/* sets the most resident bytes, freeing the ones beyond */
+void pidip_pool_limit( unsigned long bytes );
+void pidip_pool_stats( t_pidip_pool_stats *stats );
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_profile.h : processing time and drops of each object
+ *
+ * effects queue their processing with pidip_queue_add instead of
+ * pdp_queue_add, the processing and the callback are then wrapped
+ * to measure the time spent in the process thread ( wall and cpu ),
+ * the time waited in the queue and the number of frames.
+ * drops are counted by pidip_convert_ro_or_drop.
+ * objects that output messages while processing stay in the pd thread,
+ * they are measured with pidip_process_inline and never wait.
+ *
+ * there is a record per object, created from the pd thread
+ * and released when the object is freed.
+ * each queued processing has its own job in the record, with its routines
+ * and the time it was queued, as some objects queue one per inlet.
+ * no lock is taken : each counter is only written by one thread,
+ * the process thread or the pd thread, the other one only reads it,
+ * so a reading can be one frame late. a reset is asked to the process
+ * thread, which clears its own counters before the next measure.
+ */
+
+#ifndef PIDIP_PROFILE_H
+#define PIDIP_PROFILE_H
+
+#define PIDIP_PROFILE_JOBS 8      // processings of an object in the queue at once
+
+struct _pidip_profile;
+
+typedef struct _pidip_profile_job
+{
+  struct _pidip_profile *j_profile;
+  void (*j_process)(void *owner);
+  void (*j_callback)(void *owner);
+  double j_queued;                // time of the queueing, in us
+} t_pidip_profile_job;
+
+typedef struct _pidip_profile
+{
+  void *p_owner;
+  int p_instance;                 // creation order, tells objects of a class apart
+  t_pidip_profile_job p_jobs[PIDIP_PROFILE_JOBS];
+  unsigned int p_nextjob;
+
+  /* written by the process thread */
+  unsigned int p_reseen;          // last reset done
+  unsigned int p_nbprocessed;
+  double p_wall;                  // total times, in us
+  double p_wallmax;
+  double p_cpu;
+  double p_wait;
+  double p_waitmax;
+
+  /* written by the pd thread */
+  unsigned int p_reset;           // resets asked
+  unsigned int p_nbqueued;
+  unsigned int p_nbdropped;
+
+  struct _pidip_profile *p_next;
+} t_pidip_profile;
+
+/* pdp_queue_add, measuring the processing of 'owner' */
+void pidip_queue_add( void *owner, void *process, void *callback, int *queue_id );
+/* runs the processing of 'owner' now, in the pd thread, measuring it */
+void pidip_process_inline( void *owner, void *process );
+/* pdp_packet_convert_ro_or_drop, counting the drops of 'owner' */
+int pidip_convert_ro_or_drop( void *owner, int *dst, int src, t_pdp_symbol *type );
+/* finishes the processing of an object being freed and forgets it,
+   'queue_id' is -1 for an object processing inline */
+void pidip_queue_release( void *owner, int queue_id );
+
+/* for the pd thread : the records, the class name of one, a reset of all of them */
+t_pidip_profile *pidip_profile_first( void );
+char *pidip_profile_name( t_pidip_profile *p );
+void pidip_profile_reset( void );
+/* time since the last reset, in us */
+double pidip_profile_elapsed( void );
+
+#endif
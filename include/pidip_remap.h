@@ -0,0 +1,125 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_remap.h : precomputed coordinate maps for geometric effects
+ *
+ * a remap gives, for each pixel of the output frame, the position
+ * of its source in the input frame, in 1/16 of pixels.
+ * positions are clamped to the frame when the map is built,
+ * so applying a map is a branchless gather of the luminance
+ * and both chrominance planes in the same pass.
+ * a map only covers a region of the frame, the rest is copied.
+ *
+ * maps are kept in a small cache per effect, keyed by the
+ * parameters they were built from, so an effect with unchanged
+ * parameters never rebuilds its map.
+ * an effect whose parameters move on every frame would build a map
+ * for a single use, it remaps its pixels directly instead.
+ */
+
+#ifndef PIDIP_REMAP_H
+#define PIDIP_REMAP_H
+
+#define PIDIP_REMAP_ONE 16        // one pixel in map coordinates
+#define PIDIP_REMAP_KEYSIZE 8     // maximum number of parameters in a key
+
+#define PIDIP_REMAP_NEAREST 0
+#define PIDIP_REMAP_BILINEAR 1
+
+typedef struct _pidip_remap
+{
+  int m_width;
+  int m_height;
+  int m_interpolate;          // PIDIP_REMAP_NEAREST or PIDIP_REMAP_BILINEAR
+  int m_x0;                   // remapped region, even bounds, x1 and y1 excluded
+  int m_y0;
+  int m_x1;
+  int m_y1;
+  int m_allocated;            // allocated luminance cells
+  int *m_offset;              // source of each luminance cell
+  unsigned short *m_frac;     // subpixel position of the source, x | y<<8, 0..16
+  int *m_coffset;             // source of each chrominance cell
+  unsigned short *m_cfrac;
+  int m_nbkeys;
+  int m_key[PIDIP_REMAP_KEYSIZE];
+  unsigned int m_used;        // last use, for the cache
+} t_pidip_remap;
+
+typedef struct _pidip_remapcache
+{
+  int c_nbmaps;
+  t_pidip_remap *c_maps;
+  unsigned int c_clock;
+  int c_nblast;               // parameters of the last frame
+  int c_lastkey[PIDIP_REMAP_KEYSIZE];
+} t_pidip_remapcache;
+
+void pidip_remap_init( t_pidip_remap *map );
+void pidip_remap_free( t_pidip_remap *map );
+/* restrict the map to a region, the caller then sets every point in it */
+void pidip_remap_region( t_pidip_remap *map, int x0, int y0, int x1, int y1 );
+/* output pixel ( px, py ) comes from ( sx, sy ), in 1/16 of pixels */
+void pidip_remap_point( t_pidip_remap *map, int px, int py, int sx, int sy );
+/* remap a YV12 frame of the map size, src and dst must differ */
+void pidip_remap_apply( t_pidip_remap *map, short int *src, short int *dst );
+
+void pidip_remapcache_init( t_pidip_remapcache *cache, int nbmaps );
+void pidip_remapcache_free( t_pidip_remapcache *cache );
+/* map for these parameters, '*build' is set if the caller has to set its points */
+t_pidip_remap *pidip_remapcache_get( t_pidip_remapcache *cache, int width, int height,
+                                     int interpolate, int *key, int nbkeys, int *build );
+/* same, but NULL if the key changed since the last frame and no map has it,
+   the caller then remaps the frame with pidip_remap_pixel */
+t_pidip_remap *pidip_remapcache_steady( t_pidip_remapcache *cache, int width, int height,
+                                        int interpolate, int *key, int nbkeys, int *build );
+
+void pidip_remap_pixel_bilinear( short int *src, short int *dst, int width, int height,
+                                 int px, int py, int sx, int sy );
+
+/* remap one pixel without a map, same result as pidip_remap_point and pidip_remap_apply,
+   inlined as it is called for every pixel of an animated effect */
+static inline void pidip_remap_pixel( short int *src, short int *dst, int width, int height, int interpolate,
+                                      int px, int py, int sx, int sy )
+{
+  int vsize, o;
+
+    if ( interpolate == PIDIP_REMAP_BILINEAR )
+    {
+       pidip_remap_pixel_bilinear( src, dst, width, height, px, py, sx, sy );
+       return;
+    }
+    if ( sx < 0 ) sx = 0;
+    if ( sy < 0 ) sy = 0;
+    if ( sx > (width-1)*PIDIP_REMAP_ONE ) sx = (width-1)*PIDIP_REMAP_ONE;
+    if ( sy > (height-1)*PIDIP_REMAP_ONE ) sy = (height-1)*PIDIP_REMAP_ONE;
+    // positions are now positive, in 1/16 of pixels
+    dst[py*width+px] = src[(sy>>4)*width+(sx>>4)];
+
+    // chrominance of the top left pixel of each 2x2 block,
+    // the clamped position is inside the chrominance plane of an even frame
+    if ( (px|py)&1 ) return;
+    vsize = width*height;
+    o = (sy>>5)*(width>>1)+(sx>>5);
+    dst[vsize+(py>>1)*(width>>1)+(px>>1)] = src[vsize+o];
+    dst[vsize+(vsize>>2)+(py>>1)*(width>>1)+(px>>1)] = src[vsize+(vsize>>2)+o];
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_roi.h : regions of interest passed along with packets
+ *
+ * a region restricts the work of the effects knowing about it
+ * to a rectangle of the frame, the rest of the frame goes through
+ * untouched. pdp_cropper in view mode or pdp_ctrack attach a region
+ * to a packet instead of copying the rectangle into a new packet.
+ *
+ * pdp packet headers have no room for a region, so it is attached
+ * while the packet is being passed to an outlet : an effect asks for
+ * it with the number of the packet in its register_rw message, keeps
+ * its own copy for the processing and attaches it again to its output.
+ * everything happens in the pd thread, so no lock is taken.
+ *
+ * regions are in frame coordinates with even bounds, so that they
+ * cover whole chrominance cells. rows of a plane are 'r_stride'
+ * samples long for the luminance, half of it for the chrominance.
+ */
+
+#ifndef PIDIP_ROI_H
+#define PIDIP_ROI_H
+
+#define PIDIP_ROI_MAXPASSES 16    // passes of packets with a region nested in each other
+
+typedef struct _pidip_roi
+{
+  int r_x;                    // offset of the region
+  int r_y;
+  int r_width;                // size of the region, 0 for the whole frame
+  int r_height;
+  int r_stride;               // width of the frame
+} t_pidip_roi;
+
+/* the region x0 <= x < x1, y0 <= y < y1, clipped to the frame and aligned */
+void pidip_roi_set( t_pidip_roi *roi, int x0, int y0, int x1, int y1, int width, int height );
+/* the whole frame, and the test of it */
+void pidip_roi_clear( t_pidip_roi *roi );
+int pidip_roi_whole( t_pidip_roi *roi );
+
+/* passes a packet with a region attached, a NULL or whole frame region is a plain pass */
+void pidip_roi_pass( t_outlet *outlet, int *packet, t_pidip_roi *roi );
+/* the region attached to a packet being passed, returns 0 and the whole frame if none */
+int pidip_roi_get( int packet, t_pidip_roi *roi );
+
+/* clips the rectangle x0 <= x < x1, y0 <= y < y1 to the region of a frame,
+   returns 0 if nothing is left */
+int pidip_roi_clip( t_pidip_roi *roi, int width, int height, int *x0, int *y0, int *x1, int *y1 );
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_source.h : frame sources with background decoding for file players
+ *
+ * a source gives random access to the frames of a file through
+ * a backend ( open, decode a frame, close ). frames are decoded
+ * in YV12 S16 format into a cache of the last used frames,
+ * and a thread decodes the frames coming next in the play direction,
+ * so that a player only copies a cached frame into its packet.
+ *
+ * the decoder of a backend is only used by one thread at a time,
+ * the player asks for a frame index, so seeking is frame accurate
+ * and looping is prefetched like any other frame.
+ */
+
+#ifndef PIDIP_SOURCE_H
+#define PIDIP_SOURCE_H
+
+#include <pthread.h>
+
+#define PIDIP_SOURCE_MAXBACKENDS 8
+#define PIDIP_SOURCE_CACHE 16       // default number of cached frames
+#define PIDIP_SOURCE_PREFETCH 8     // default number of frames decoded ahead
+
+typedef struct _pidip_source_info
+{
+  int i_width;
+  int i_height;
+  int i_nbframes;
+  double i_framerate;
+} t_pidip_source_info;
+
+typedef struct _pidip_source_backend
+{
+  char *b_name;
+  /* returns a handle or NULL if the file is not for this backend */
+  void *(*b_open)( char *filename, t_pidip_source_info *info );
+  /* decodes a frame into a YV12 S16 buffer, returns 0 on errors */
+  int (*b_decode)( void *handle, int frame, short int *data );
+  void (*b_close)( void *handle );
+} t_pidip_source_backend;
+
+typedef struct _pidip_sourceframe
+{
+  int f_frame;                // -1 if empty
+  int f_busy;                 // being decoded
+  unsigned int f_used;        // clock of the last use
+  short int *f_data;
+} t_pidip_sourceframe;
+
+typedef struct _pidip_source
+{
+  t_pidip_source_backend *s_backend;
+  void *s_handle;
+  t_pidip_source_info s_info;
+  int s_framesize;            // bytes of a decoded frame
+
+  t_pidip_sourceframe *s_cache;
+  int s_cachesize;
+  unsigned int s_clock;
+
+  int s_prefetch;             // frames decoded ahead
+  int s_loop;                 // the prefetch wraps at the end
+  int s_current;              // last requested frame
+  int s_direction;            // 1 or -1
+
+  int s_running;
+  pthread_t s_thread;
+  pthread_mutex_t s_mutex;    // cache and requests
+  pthread_mutex_t s_decoder;  // backend decoder
+  pthread_cond_t s_cond;      // new request or decoded frame
+} t_pidip_source;
+
+/* backends are tried in the order they were registered */
+void pidip_source_register( t_pidip_source_backend *backend );
+
+void pidip_source_init( t_pidip_source *src );
+void pidip_source_free( t_pidip_source *src );
+/* 'cachesize' <= 0 caches all the frames, returns 0 if no backend can open the file */
+int pidip_source_open( t_pidip_source *src, char *filename, int cachesize, int prefetch );
+void pidip_source_close( t_pidip_source *src );
+int pidip_source_opened( t_pidip_source *src );
+void pidip_source_loop( t_pidip_source *src, int loop );
+
+/* copies a frame into a caller owned YV12 S16 buffer, returns 0 on errors */
+int pidip_source_frame( t_pidip_source *src, int frame, short int *data );
+
+/* time of a frame and duration of the file, in ms */
+double pidip_source_time( t_pidip_source *src, int frame );
+double pidip_source_duration( t_pidip_source *src );
+
+/* the backends of raw clips ( see pidip_clip.h ) and quicktime files */
+extern t_pidip_source_backend pidip_source_clip;
+extern t_pidip_source_backend pidip_source_quicktime;
+
+#endif
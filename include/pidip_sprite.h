@@ -0,0 +1,89 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_sprite.h : cached YUV+alpha sprites for overlays
+ *
+ * a sprite is a small YUV image with a coverage mask,
+ * converted once from an RGBA drawing and blended into
+ * YV12 frames only within its bounding box.
+ *
+ * the text cache keeps one sprite per text rendering
+ * ( string, font, color, angle ), a sprite not asked for
+ * during a frame is released by pidip_textcache_collect.
+ */
+
+#ifndef PIDIP_SPRITE_H
+#define PIDIP_SPRITE_H
+
+typedef struct _pidip_sprite
+{
+  int s_width;
+  int s_height;
+  int s_xoff;                 // position relative to the drawing origin
+  int s_yoff;
+  int s_allocated;            // allocated pixels
+  unsigned char *s_alpha;     // coverage, 0..255
+  short int *s_data;          // Y, V and U planes at full resolution, PDP scale
+} t_pidip_sprite;
+
+typedef struct _pidip_textsprite
+{
+  char *t_text;
+  void *t_font;
+  int t_r;
+  int t_g;
+  int t_b;
+  t_float t_angle;
+  int t_width;                // text size as given by imlib_get_text_size
+  int t_height;
+  int t_used;
+  t_pidip_sprite t_sprite;
+  struct _pidip_textsprite *t_next;
+} t_pidip_textsprite;
+
+typedef struct _pidip_textcache
+{
+  t_pidip_textsprite *c_sprites;
+} t_pidip_textcache;
+
+void pidip_sprite_init( t_pidip_sprite *sprite );
+void pidip_sprite_free( t_pidip_sprite *sprite );
+/* a width x height sprite of uniform color at ( x, y ),
+   with a cleared coverage the caller rasterizes into */
+int pidip_sprite_solid( t_pidip_sprite *sprite, int x, int y, int width, int height, int r, int g, int b );
+/* convert a 32 bits ARGB drawing, cropped to its non transparent pixels,
+   ( xorigin, yorigin ) is the drawing origin inside the ARGB buffer */
+void pidip_sprite_from_argb( t_pidip_sprite *sprite, unsigned int *argb, int width, int height,
+                             int xorigin, int yorigin );
+/* blend into a YV12 frame with the drawing origin at ( x, y ), alpha is 0..256 */
+void pidip_sprite_blend( t_pidip_sprite *sprite, short int *frame, int fwidth, int fheight,
+                         int x, int y, int alpha );
+
+void pidip_textcache_init( t_pidip_textcache *cache );
+/* sprite of a text, rendered with imlib only if it's not in the cache yet */
+t_pidip_textsprite *pidip_textcache_get( t_pidip_textcache *cache, char *text, void *font,
+                                         int r, int g, int b, t_float angle );
+/* release the sprites which were not asked for since the last collect */
+void pidip_textcache_collect( t_pidip_textcache *cache );
+/* release all sprites ( rendering settings changed ) */
+void pidip_textcache_flush( t_pidip_textcache *cache );
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * pidip_stats.h : frame statistics for analysis objects
+ *
+ * one pass over a YV12 or RGB frame fills a histogram per channel,
+ * mean, variance, extrema and percentiles are read from the histograms
+ * with integer sums, so the cost per sample is one increment.
+ * with a grid, each cell also sums its samples for per cell
+ * mean, variance and extrema.
+ *
+ * channels are Y, U, V for YV12 frames and R, G, B for RGB ones,
+ * all values are on 0..255.
+ */
+
+#ifndef PIDIP_STATS_H
+#define PIDIP_STATS_H
+
+#define PIDIP_STATS_CHANNELS 3
+#define PIDIP_STATS_MAXCELLS 4096
+
+typedef struct _pidip_cellstats
+{
+  unsigned int c_count;
+  unsigned int c_sum;
+  unsigned long long c_sum2;
+  int c_min;
+  int c_max;
+} t_pidip_cellstats;
+
+typedef struct _pidip_stats
+{
+  int s_cols;                     // grid, 0 for none
+  int s_rows;
+  unsigned int s_histo[PIDIP_STATS_CHANNELS][256];
+  unsigned int s_count[PIDIP_STATS_CHANNELS];
+  int s_allocated;                // allocated cells
+  t_pidip_cellstats *s_cells;     // cells of each channel, row by row
+  int *s_colcell;                 // cell column of each pixel column
+  int s_colwidth;                 // allocated columns
+} t_pidip_stats;
+
+void pidip_stats_init( t_pidip_stats *st );
+void pidip_stats_free( t_pidip_stats *st );
+/* set the grid, 0 columns for no grid, returns 0 if it's not possible */
+int pidip_stats_grid( t_pidip_stats *st, int cols, int rows );
+
+/* analyze a frame */
+void pidip_stats_yv12( t_pidip_stats *st, short int *data, int width, int height );
+void pidip_stats_rgb( t_pidip_stats *st, unsigned char *data, int width, int height );
+
+/* results, for a channel of the last frame */
+int pidip_stats_min( t_pidip_stats *st, int channel );
+int pidip_stats_max( t_pidip_stats *st, int channel );
+t_float pidip_stats_mean( t_pidip_stats *st, int channel );
+t_float pidip_stats_variance( t_pidip_stats *st, int channel );
+/* value under which 'percent' % of the samples are */
+int pidip_stats_percentile( t_pidip_stats *st, int channel, t_float percent );
+t_pidip_cellstats *pidip_stats_cell( t_pidip_stats *st, int channel, int cell );
+
+#endif
@@ -30,4 +30,5 @@ int yuv_YUVtoRGB(unsigned char y, unsigned char u, unsigned char v);
 int yuv_YUVtoBGR(unsigned char y, unsigned char u, unsigned char v);
 void yuv_Y122RGB( short int* packet, unsigned int *rgb, int width, int height );
 void yuv_Y122BGR( short int* packet, unsigned int *rgb, int width, int height );
+void yuv_YV12toRGB( short int* packet, unsigned int *rgb, int width, int height );
 void yuv_RGB2Y12( unsigned int *rgb, short int* packet, int width, int height );
@@ -25,6 +25,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
 #include <math.h>
 #include <aalib.h>
@@ -194,7 +196,7 @@ static void pdp_aa_process_yv12(t_pdp_aa *x)
 
     // post( "pdp_aa : ascii text : %s", x->x_context->textbuffer );
 
-    memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
+    pidip_inplace_copy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
 
     return;
 }
@@ -223,8 +225,8 @@ static void pdp_aa_process(t_pdp_aa *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_aa_process_yv12, pdp_aa_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_aa_process_yv12, pdp_aa_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -248,7 +250,7 @@ static void pdp_aa_input_0(t_pdp_aa *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))  
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -263,7 +265,7 @@ static void pdp_aa_free(t_pdp_aa *x)
 {
   int i;
 
-   pdp_queue_finish(x->x_queue_id);
+   pidip_queue_release(x, x->x_queue_id);
    pdp_packet_mark_unused(x->x_packet0);
    pdp_aa_free_ressources(x);
    for (i=0; i<MAX_OPTIONS; i++)
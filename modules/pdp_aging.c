@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 static char   *pdp_aging_version = "pdp_aging: version 0.1, port of aging from effectv( Fukuchi Kentaro ) adapted by Yves Degoyon (ydegoyon@free.fr)";
@@ -294,7 +295,7 @@ static void pdp_aging_process(t_pdp_aging *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_aging_process_yv12, pdp_aging_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_aging_process_yv12, pdp_aging_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -313,7 +314,7 @@ static void pdp_aging_process(t_pdp_aging *x)
 static void pdp_aging_input_0(t_pdp_aging *x, t_symbol *s, t_floatarg f)
 {
     if (s== gensym("register_rw"))  
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -329,7 +330,7 @@ static void pdp_aging_free(t_pdp_aging *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 
 }
@@ -24,6 +24,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "yuv.h"
 #include "default.map"
 #include <math.h>
@@ -192,7 +193,7 @@ static void pdp_ascii_process(t_pdp_ascii *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_ascii_process_yv12, pdp_ascii_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_ascii_process_yv12, pdp_ascii_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -216,7 +217,7 @@ static void pdp_ascii_input_0(t_pdp_ascii *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))  
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -232,7 +233,7 @@ static void pdp_ascii_free(t_pdp_ascii *x)
   int i;
 
    if ( x->x_charmaps ) free( x->x_charmaps );
-   pdp_queue_finish(x->x_queue_id);
+   pidip_queue_release(x, x->x_queue_id);
    pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -27,6 +27,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include <math.h>
 
 #define PLANES 32
@@ -76,10 +78,10 @@ static void pdp_baltan_process_yv12(t_pdp_baltan *x)
     /* allocate buffers if necessary  */
     if ( ( x->x_planebuf == NULL ) || ( (int)size != x->x_pixels ) ) 
     {
-       if ( x->x_planebuf ) freebytes( x->x_planebuf, x->x_pixels*PLANES*sizeof(int) );
+       if ( x->x_planebuf ) pidip_pool_put( x->x_planebuf );
        
        x->x_pixels = size;
-       x->x_planebuf = (int*)getbytes(x->x_pixels*PLANES*sizeof(int));
+       x->x_planebuf = (int*)pidip_pool_get(x->x_pixels*PLANES*sizeof(int));
        post("pdp_baltan : allocated plane buffer (size=%d)", x->x_pixels*PLANES*sizeof(int) );
        bzero(x->x_planebuf, x->x_pixels*PLANES*sizeof(int));
        x->x_plane = 0;
@@ -142,7 +144,7 @@ static void pdp_baltan_process(t_pdp_baltan *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_baltan_process_yv12, pdp_baltan_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_baltan_process_yv12, pdp_baltan_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -162,7 +164,7 @@ static void pdp_baltan_input_0(t_pdp_baltan *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))  
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -180,8 +182,8 @@ static void pdp_baltan_dfts(t_pdp_baltan *x, t_floatarg fdfts )
 
 static void pdp_baltan_free(t_pdp_baltan *x)
 {
-    if ( x->x_planebuf ) freebytes( x->x_planebuf, x->x_pixels*PLANES*sizeof(int) );
-    pdp_queue_finish(x->x_queue_id);
+    if ( x->x_planebuf ) pidip_pool_put( x->x_planebuf );
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -0,0 +1,218 @@
+/*
+ *   Pure Data Packet module.
+ *   Copyright (c) by Yves Degoyon <ydegoyon@free.fr>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object learns the background of a scene ( see pidip_bgmodel.h )
+ *  and outputs the mask of the moving objects
+ *  Effects attached to the same model ( 'bgmodel <name>' ) share its work
+ */
+
+#include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_bgmodel.h"
+
+typedef struct pdp_bgmodel_struct
+{
+    t_object x_obj;
+    t_float x_f;
+
+    t_outlet *x_outlet0;
+    t_outlet *x_outlet1; // part of the frame in the foreground
+
+    int x_packet0;
+    int x_packet1;
+    int x_dropped;
+    int x_queue_id;
+
+    t_pidip_bgmodel *x_model;
+
+} t_pdp_bgmodel;
+
+static void pdp_bgmodel_process_yv12(t_pdp_bgmodel *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    t_pdp     *newheader = pdp_packet_header(x->x_packet1);
+    short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
+    int       vsize;
+
+    newheader->info.image.encoding = header->info.image.encoding;
+    newheader->info.image.width = header->info.image.width;
+    newheader->info.image.height = header->info.image.height;
+    vsize = header->info.image.width*header->info.image.height;
+
+    // the mask is in the luminance, without colors
+    memset( newdata+vsize, 0x0, (vsize>>1)*sizeof(short int) );
+    if ( !pidip_bgmodel_update( x->x_model ) )
+    {
+       memset( newdata, 0x0, vsize*sizeof(short int) );
+       return;
+    }
+    pidip_bgmodel_expand( x->x_model, newdata, header->info.image.width, header->info.image.height,
+                          PIDIP_BGMODEL_ABS|PIDIP_BGMODEL_MASKED );
+}
+
+static void pdp_bgmodel_sendpacket(t_pdp_bgmodel *x)
+{
+    /* release the packet */
+    pdp_packet_mark_unused(x->x_packet0);
+    x->x_packet0 = -1;
+
+    outlet_float(x->x_outlet1, x->x_model->m_foreground);
+
+    /* unregister and propagate if valid dest packet */
+    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+}
+
+static void pdp_bgmodel_process(t_pdp_bgmodel *x)
+{
+   t_pdp *header = 0;
+
+   /* check if image data packets are compatible */
+   if ( (header = pdp_packet_header(x->x_packet0))
+	&& (PDP_IMAGE == header->type)){
+    
+	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
+
+	case PDP_IMAGE_YV12:
+            x->x_packet1 = pdp_packet_new_image_YCrCb( header->info.image.width, header->info.image.height );
+            pidip_queue_add(x, pdp_bgmodel_process_yv12, pdp_bgmodel_sendpacket, &x->x_queue_id);
+	    break;
+
+	default:
+	    break;
+	    
+	}
+    }
+}
+
+static void pdp_bgmodel_input_0(t_pdp_bgmodel *x, t_symbol *s, t_floatarg f)
+{
+    if (s== gensym("register_rw"))
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_bgmodel_push(x->x_model, x->x_packet0);
+    }
+
+    if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
+
+        /* add the process method and callback to the process queue */
+        pdp_bgmodel_process(x);
+
+    }
+}
+
+static void pdp_bgmodel_name(t_pdp_bgmodel *x, t_symbol *s)
+{
+    pdp_queue_finish(x->x_queue_id);
+    pidip_bgmodel_detach(x->x_model);
+    x->x_model = pidip_bgmodel_attach( (s==&s_)?NULL:s );
+}
+
+static void pdp_bgmodel_running(t_pdp_bgmodel *x)
+{
+    pidip_bgmodel_mode(x->x_model, PIDIP_BGMODEL_RUNNING);
+}
+
+static void pdp_bgmodel_mog(t_pdp_bgmodel *x)
+{
+    pidip_bgmodel_mode(x->x_model, PIDIP_BGMODEL_MOG);
+}
+
+static void pdp_bgmodel_rate(t_pdp_bgmodel *x, t_floatarg frate)
+{
+    pidip_bgmodel_rate(x->x_model, frate);
+}
+
+static void pdp_bgmodel_threshold(t_pdp_bgmodel *x, t_floatarg fthreshold)
+{
+    pidip_bgmodel_threshold(x->x_model, (int)fthreshold);
+}
+
+/* the decimation is given as a block size : 1, 2, 4 or 8 pixels */
+static void pdp_bgmodel_decimation(t_pdp_bgmodel *x, t_floatarg fblock)
+{
+  int shift = 0;
+
+    while ( ( (2<<shift) <= (int)fblock ) && ( shift < PIDIP_BGMODEL_MAXSHIFT ) ) shift++;
+    pidip_bgmodel_decimation(x->x_model, shift);
+}
+
+static void pdp_bgmodel_threads(t_pdp_bgmodel *x, t_floatarg fthreads)
+{
+    pidip_bgmodel_threads(x->x_model, (int)fthreads);
+}
+
+static void pdp_bgmodel_reset(t_pdp_bgmodel *x)
+{
+    pidip_bgmodel_reset(x->x_model);
+}
+
+static void pdp_bgmodel_free(t_pdp_bgmodel *x)
+{
+    pidip_queue_release(x, x->x_queue_id);
+    pdp_packet_mark_unused(x->x_packet0);
+    pidip_bgmodel_detach(x->x_model);
+}
+
+t_class *pdp_bgmodel_class;
+
+void *pdp_bgmodel_new(t_symbol *s)
+{
+    t_pdp_bgmodel *x = (t_pdp_bgmodel *)pd_new(pdp_bgmodel_class);
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_anything); 
+    x->x_outlet1 = outlet_new(&x->x_obj, &s_float); 
+
+    x->x_packet0 = -1;
+    x->x_packet1 = -1;
+    x->x_queue_id = -1;
+    x->x_dropped = 0;
+
+    x->x_model = pidip_bgmodel_attach( (s==&s_)?NULL:s );
+
+    return (void *)x;
+}
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_bgmodel_setup(void)
+{
+    pdp_bgmodel_class = class_new(gensym("pdp_bgmodel"), (t_newmethod)pdp_bgmodel_new,
+    	(t_method)pdp_bgmodel_free, sizeof(t_pdp_bgmodel), 0, A_DEFSYMBOL, A_NULL);
+
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_name, gensym("bgmodel"),  A_DEFSYMBOL, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_running, gensym("running"),  A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_mog, gensym("mog"),  A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_rate, gensym("rate"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_threshold, gensym("threshold"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_decimation, gensym("decimation"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_threads, gensym("threads"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_bgmodel_class, (t_method)pdp_bgmodel_reset, gensym("reset"),  A_NULL);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
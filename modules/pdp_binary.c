@@ -22,6 +22,8 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
@@ -135,7 +137,7 @@ static void pdp_binary_pick(t_pdp_binary *x)
 
 static void pdp_binary_allocate(t_pdp_binary *x)
 {
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    x->x_frame = (short int *) pidip_pool_get ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
 
     if ( !x->x_frame )
     {
@@ -146,7 +148,7 @@ static void pdp_binary_allocate(t_pdp_binary *x)
 
 static void pdp_binary_free_ressources(t_pdp_binary *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    if ( x->x_frame ) pidip_pool_put ( x->x_frame );
 }
 
 static void pdp_binary_process_yv12(t_pdp_binary *x)
@@ -256,7 +258,7 @@ static void pdp_binary_process(t_pdp_binary *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_binary_process_yv12, pdp_binary_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_binary_process_yv12, pdp_binary_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -279,7 +281,7 @@ static void pdp_binary_input_0(t_pdp_binary *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -292,6 +294,7 @@ static void pdp_binary_free(t_pdp_binary *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_binary_free_ressources( x );
 }
@@ -23,6 +23,7 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "yuv.h"
 #include <math.h>
 #include <ctype.h>
@@ -512,7 +513,7 @@ static void pdp_cache_process(t_pdp_cache *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_cache_process_yv12, pdp_cache_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_cache_process_yv12, pdp_cache_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -535,7 +536,7 @@ static void pdp_cache_input_0(t_pdp_cache *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -551,7 +552,7 @@ static void pdp_cache_free(t_pdp_cache *x)
   int i;
 
     pdp_cache_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
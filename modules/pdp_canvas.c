@@ -20,16 +20,58 @@
 
 /*  This object is an object allowing juxtaposition of frames from two inlets
  *  Written by Yves Degoyon                                 
+ *
+ *  layers are composed in z order, with an opacity, an optional alpha mask
+ *  ( the luminance of another layer ) and an optional clipping rectangle.
+ *  the canvas is kept between frames and only the region
+ *  changed since the last frame is cleared and recomposed.
+ *  the composition draws a copy of the layers, with their packets pinned,
+ *  so that new frames are taken by the inlets while it runs.
  */
 
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 static char   *pdp_canvas_version = "pdp_canvas: version 0.1, display for several video sources, written by Yves Degoyon (ydegoyon@free.fr)";
 
 #define MAX_CANVAS_INPUT 10
+#define MAX_CANVAS_LAYERS 64
+
+typedef struct _canvas_rect
+{
+    int r_x0, r_y0;          // first pixel
+    int r_x1, r_y1;          // past the last pixel
+} t_canvas_rect;
+
+struct pdp_canvas_struct;
+
+/* receives packets for a layer through a send name */
+typedef struct pdp_canvas_proxy_struct
+{
+    t_pd p_pd;
+    struct pdp_canvas_struct *p_owner;
+    int p_layer;
+} t_pdp_canvas_proxy;
+
+typedef struct _canvas_layer
+{
+    int l_packet;
+    int l_width;
+    int l_height;
+    int l_size;
+    t_float l_xoffset;
+    t_float l_yoffset;
+    int l_zorder;            // layers are drawn from the lowest to the highest
+    int l_opacity;           // 0..256
+    int l_mask;              // layer whose luminance is the alpha of this one, or -1
+    int l_clip;              // is the clipping rectangle active
+    t_canvas_rect l_cliprect;
+    t_symbol *l_receive;
+    t_pdp_canvas_proxy *l_proxy;
+} t_canvas_layer;
 
 typedef struct pdp_canvas_struct
 {
@@ -47,12 +89,17 @@ typedef struct pdp_canvas_struct
     t_float x_xmouse;
     t_float x_ymouse;
 
-    int *x_packets;
-    int *x_widths;
-    int *x_heights;
-    t_float *x_xoffsets;
-    t_float *x_yoffsets;
-    int *x_sizes;
+    t_canvas_layer *x_layers;
+    int *x_order;            // layers sorted by z order
+    int x_nblayers;
+
+    t_canvas_layer x_drawn[MAX_CANVAS_LAYERS];  // layers used by the running composition
+    int x_draworder[MAX_CANVAS_LAYERS];
+    int x_nbdrawn;
+
+    short int *x_frame;      // the composed canvas, kept between frames
+    t_canvas_rect x_dirty;   // region changed since the last composition
+    t_canvas_rect x_compose; // region recomposed by the process thread
 
     int x_owidth;
     int x_oheight;
@@ -61,94 +108,247 @@ typedef struct pdp_canvas_struct
 
 } t_pdp_canvas;
 
+static t_class *pdp_canvas_proxy_class;
+
+static int pdp_canvas_intersect(t_canvas_rect *r, t_canvas_rect *clip)
+{
+    if ( r->r_x0 < clip->r_x0 ) r->r_x0 = clip->r_x0;
+    if ( r->r_y0 < clip->r_y0 ) r->r_y0 = clip->r_y0;
+    if ( r->r_x1 > clip->r_x1 ) r->r_x1 = clip->r_x1;
+    if ( r->r_y1 > clip->r_y1 ) r->r_y1 = clip->r_y1;
+    return ( ( r->r_x0 < r->r_x1 ) && ( r->r_y0 < r->r_y1 ) );
+}
+
+/* visible area of a layer on the canvas, returns 0 if it's empty */
+static int pdp_canvas_layer_rect(t_pdp_canvas *x, t_canvas_layer *layers, int ni, t_canvas_rect *r)
+{
+  t_canvas_layer *l = &layers[ni];
+  t_canvas_rect canvas;
+
+    if ( l->l_packet == -1 ) return 0;
+    r->r_x0 = (int)l->l_xoffset;
+    r->r_y0 = (int)l->l_yoffset;
+    r->r_x1 = r->r_x0+l->l_width;
+    r->r_y1 = r->r_y0+l->l_height;
+    canvas.r_x0 = 0;
+    canvas.r_y0 = 0;
+    canvas.r_x1 = x->x_owidth;
+    canvas.r_y1 = x->x_oheight;
+    if ( !pdp_canvas_intersect( r, &canvas ) ) return 0;
+    if ( l->l_clip && !pdp_canvas_intersect( r, &l->l_cliprect ) ) return 0;
+    return 1;
+}
+
+static void pdp_canvas_damage(t_pdp_canvas *x, t_canvas_rect *r)
+{
+    if ( x->x_dirty.r_x0 >= x->x_dirty.r_x1 )
+    {
+       x->x_dirty = *r;
+       return;
+    }
+    if ( r->r_x0 < x->x_dirty.r_x0 ) x->x_dirty.r_x0 = r->r_x0;
+    if ( r->r_y0 < x->x_dirty.r_y0 ) x->x_dirty.r_y0 = r->r_y0;
+    if ( r->r_x1 > x->x_dirty.r_x1 ) x->x_dirty.r_x1 = r->r_x1;
+    if ( r->r_y1 > x->x_dirty.r_y1 ) x->x_dirty.r_y1 = r->r_y1;
+}
+
+/* mark the area of a layer, and of the layers it masks, as changed */
+static void pdp_canvas_damage_layer(t_pdp_canvas *x, int ni)
+{
+  t_canvas_rect r;
+  int ii;
+
+    if ( pdp_canvas_layer_rect( x, x->x_layers, ni, &r ) ) pdp_canvas_damage( x, &r );
+    for ( ii=0; ii<x->x_nblayers; ii++ )
+    {
+       if ( ( x->x_layers[ii].l_mask == ni ) && pdp_canvas_layer_rect( x, x->x_layers, ii, &r ) )
+       {
+          pdp_canvas_damage( x, &r );
+       }
+    }
+}
+
+static void pdp_canvas_sort(t_pdp_canvas *x)
+{
+  int ii, jj, nl;
+
+    for ( ii=0; ii<x->x_nblayers; ii++ )
+    {
+       nl = ii;
+       for ( jj=ii-1; ( jj>=0 ) && ( x->x_layers[x->x_order[jj]].l_zorder > x->x_layers[nl].l_zorder ); jj-- )
+       {
+          x->x_order[jj+1] = x->x_order[jj];
+       }
+       x->x_order[jj+1] = nl;
+    }
+}
+
+/* alpha of a layer at a canvas position, 0..256 */
+static inline int pdp_canvas_alpha(t_canvas_layer *layers, t_canvas_layer *l, int px, int py)
+{
+  t_canvas_layer *m;
+  short int *mdata;
+  int mx, my;
+
+    if ( l->l_mask < 0 ) return l->l_opacity;
+    m = &layers[l->l_mask];
+    if ( m->l_packet == -1 ) return 0;
+    mx = px-(int)m->l_xoffset;
+    my = py-(int)m->l_yoffset;
+    if ( ( mx < 0 ) || ( mx >= m->l_width ) || ( my < 0 ) || ( my >= m->l_height ) ) return 0;
+    mdata = (short int *)pdp_packet_data(m->l_packet);
+    if ( mdata[my*m->l_width+mx] <= 0 ) return 0;
+    return ( l->l_opacity*( (mdata[my*m->l_width+mx]>>7)+1 ) )>>8;
+}
+
+static void pdp_canvas_draw_layer(t_pdp_canvas *x, int ni, t_canvas_rect *r)
+{
+  t_canvas_layer *l = &x->x_drawn[ni];
+  short int *pY, *pU, *pV, *ppY, *ppU, *ppV, *pdata, *src, *dst;
+  int px, py, cx, cy, sx, sy, a, xo, yo, cw, ch;
+
+    pdata = (short int *)pdp_packet_data(l->l_packet);
+    if ( !pdata ) return;
+    pY = x->x_frame;
+    pV = x->x_frame+x->x_osize;
+    pU = x->x_frame+x->x_osize+(x->x_osize>>2);
+    ppY = pdata;
+    ppV = pdata+l->l_size;
+    ppU = pdata+l->l_size+(l->l_size>>2);
+    xo = (int)l->l_xoffset;
+    yo = (int)l->l_yoffset;
+    cw = l->l_width>>1;
+    ch = l->l_height>>1;
+
+    if ( ( l->l_opacity >= 256 ) && ( l->l_mask < 0 ) )
+    {
+       // opaque layer : plain copies
+       for ( py=r->r_y0; py<r->r_y1; py++ )
+       {
+          memcpy( pY+py*x->x_owidth+r->r_x0, ppY+(py-yo)*l->l_width+(r->r_x0-xo),
+                  (r->r_x1-r->r_x0)*sizeof(short int) );
+       }
+       for ( cy=r->r_y0>>1; cy<=(r->r_y1-1)>>1; cy++ )
+       {
+          sy = ((cy<<1)-yo)>>1;
+          if ( sy < 0 ) sy = 0;
+          if ( sy >= ch ) sy = ch-1;
+          for ( cx=r->r_x0>>1; cx<=(r->r_x1-1)>>1; cx++ )
+          {
+             sx = ((cx<<1)-xo)>>1;
+             if ( sx < 0 ) sx = 0;
+             if ( sx >= cw ) sx = cw-1;
+             pV[cy*(x->x_owidth>>1)+cx] = ppV[sy*cw+sx];
+             pU[cy*(x->x_owidth>>1)+cx] = ppU[sy*cw+sx];
+          }
+       }
+       return;
+    }
+
+    for ( py=r->r_y0; py<r->r_y1; py++ )
+    {
+       dst = pY+py*x->x_owidth;
+       src = ppY+(py-yo)*l->l_width-xo;
+       for ( px=r->r_x0; px<r->r_x1; px++ )
+       {
+          a = pdp_canvas_alpha( x->x_drawn, l, px, py );
+          dst[px] += ( ( src[px]-dst[px] )*a )>>8;
+       }
+    }
+    for ( cy=r->r_y0>>1; cy<=(r->r_y1-1)>>1; cy++ )
+    {
+       sy = ((cy<<1)-yo)>>1;
+       if ( sy < 0 ) sy = 0;
+       if ( sy >= ch ) sy = ch-1;
+       for ( cx=r->r_x0>>1; cx<=(r->r_x1-1)>>1; cx++ )
+       {
+          sx = ((cx<<1)-xo)>>1;
+          if ( sx < 0 ) sx = 0;
+          if ( sx >= cw ) sx = cw-1;
+          a = pdp_canvas_alpha( x->x_drawn, l, cx<<1, cy<<1 );
+          pV[cy*(x->x_owidth>>1)+cx] += ( ( ppV[sy*cw+sx]-pV[cy*(x->x_owidth>>1)+cx] )*a )>>8;
+          pU[cy*(x->x_owidth>>1)+cx] += ( ( ppU[sy*cw+sx]-pU[cy*(x->x_owidth>>1)+cx] )*a )>>8;
+       }
+    }
+}
+
 static void pdp_canvas_process_yv12(t_pdp_canvas *x)
 {
-  int     px, py, ppx, ppy, ii, nbs;
-  short int *pY, *pU, *pV;
-  short int *ppY, *ppU, *ppV;
+  int     py, ii, ni;
   t_pdp     *oheader;
-  short int *odata, *pdata;
-  t_pdp     *iheader;
-  short int *idata;
-  int     mx, dx, my, dy;
+  short int *odata;
+  t_canvas_rect *d = &x->x_compose;
+  t_canvas_rect r;
+
+  // only the changed region is cleared and recomposed
+  if ( d->r_x0 < d->r_x1 )
+  {
+    for ( py=d->r_y0; py<d->r_y1; py++ )
+    {
+       memset( x->x_frame+py*x->x_owidth+d->r_x0, 0x00, (d->r_x1-d->r_x0)*sizeof(short int) );
+    }
+    for ( py=d->r_y0>>1; py<d->r_y1>>1; py++ )
+    {
+       memset( x->x_frame+x->x_osize+py*(x->x_owidth>>1)+(d->r_x0>>1), 0x00,
+               ((d->r_x1-d->r_x0)>>1)*sizeof(short int) );
+       memset( x->x_frame+x->x_osize+(x->x_osize>>2)+py*(x->x_owidth>>1)+(d->r_x0>>1), 0x00,
+               ((d->r_x1-d->r_x0)>>1)*sizeof(short int) );
+    }
+
+    for ( ii=0; ii<x->x_nbdrawn; ii++)
+    {
+      ni = x->x_draworder[ii];
+      if ( x->x_drawn[ni].l_opacity <= 0 ) continue;
+      if ( !pdp_canvas_layer_rect( x, x->x_drawn, ni, &r ) ) continue;
+      if ( !pdp_canvas_intersect( &r, d ) ) continue;
+      pdp_canvas_draw_layer( x, ni, &r );
+    }
+  }
 
   x->x_opacket = pdp_packet_new_image_YCrCb( x->x_owidth, x->x_oheight );
   oheader = pdp_packet_header(x->x_opacket);
   odata   = (short int *)pdp_packet_data(x->x_opacket);
+  if ( !odata ) return;
 
   oheader->info.image.encoding = PDP_IMAGE_YV12;
   oheader->info.image.width = x->x_owidth;
   oheader->info.image.height = x->x_oheight;
 
-  memset( odata, 0x00, (x->x_osize + (x->x_osize>>1))<<1 );
+  memcpy( odata, x->x_frame, (x->x_osize + (x->x_osize>>1))<<1 );
 
-  pY = odata;
-  pV = odata+x->x_osize;
-  pU = odata+x->x_osize+(x->x_osize>>2);
-  for ( ii=0; ii<x->x_nbinputs; ii++)
-  {
-    if ( x->x_packets[ii] != -1 )
-    {
-      if ( x->x_xoffsets[ii] < -x->x_widths[ii] ) continue; 
-      if ( x->x_xoffsets[ii] > x->x_owidth ) continue; 
-      if ( x->x_yoffsets[ii] < -x->x_heights[ii] ) continue; 
-      if ( x->x_yoffsets[ii] > x->x_oheight ) continue; 
-
-      pdata   = (short int *)pdp_packet_data(x->x_packets[ii]);
-      ppY = pdata;
-      ppV = pdata+x->x_sizes[ii];
-      ppU = pdata+x->x_sizes[ii]+(x->x_sizes[ii]>>2);
+  return;
+}
 
-      if ( x->x_xoffsets[ii] < 0 ) 
-      {
-        mx = -x->x_xoffsets[ii];
-        dx = x->x_widths[ii]+x->x_xoffsets[ii];
-      }
-      else if ( x->x_xoffsets[ii] > x->x_owidth - x->x_widths[ii] ) 
-      {
-        mx = 0;
-        dx = x->x_owidth-x->x_xoffsets[ii];
-      }
-      else
-      {
-        mx = 0;
-        dx = x->x_widths[ii];
-      }
+/* copy the layers for the composition, their packets are kept until it's done */
+static void pdp_canvas_pin(t_pdp_canvas *x)
+{
+  int ii;
 
-      if ( x->x_yoffsets[ii] < 0 ) 
-      {
-        my = -x->x_yoffsets[ii];
-        dy = x->x_heights[ii]+x->x_yoffsets[ii];
-      }
-      else if ( x->x_yoffsets[ii] > x->x_oheight - x->x_heights[ii] ) 
-      {
-        my = 0;
-        dy = x->x_oheight-x->x_yoffsets[ii];
-      }
-      else
-      {
-        my = 0;
-        dy = x->x_heights[ii];
-      }
+  for ( ii=0; ii<x->x_nblayers; ii++ )
+  {
+    x->x_drawn[ii] = x->x_layers[ii];
+    if ( x->x_layers[ii].l_packet != -1 ) x->x_drawn[ii].l_packet = pdp_packet_copy_ro( x->x_layers[ii].l_packet );
+    x->x_draworder[ii] = x->x_order[ii];
+  }
+  x->x_nbdrawn = x->x_nblayers;
+}
 
-      for ( py=x->x_yoffsets[ii]+my; py<x->x_yoffsets[ii]+dy; py++)
-      {
-         memcpy( pY+(py*x->x_owidth)+(int)x->x_xoffsets[ii]+mx, 
-                     ppY+(py-(int)x->x_yoffsets[ii])*x->x_widths[ii]+mx, dx*sizeof(short int) );
-         memcpy( pU+((py>>1)*(x->x_owidth>>1))+((int)(x->x_xoffsets[ii]+mx)>>1), 
-                     ppU+((py-(int)x->x_yoffsets[ii])>>1)*(x->x_widths[ii]>>1)+(mx>>1), dx );
-         memcpy( pV+((py>>1)*(x->x_owidth>>1))+((int)(x->x_xoffsets[ii]+mx)>>1), 
-                     ppV+((py-(int)x->x_yoffsets[ii])>>1)*(x->x_widths[ii]>>1)+(mx>>1), dx );
-      }
+static void pdp_canvas_unpin(t_pdp_canvas *x)
+{
+  int ii;
 
-    }
+  for ( ii=0; ii<x->x_nbdrawn; ii++ )
+  {
+    pdp_packet_mark_unused( x->x_drawn[ii].l_packet );
+    x->x_drawn[ii].l_packet = -1;
   }
-
-  return;
+  x->x_nbdrawn = 0;
 }
 
 static void pdp_canvas_sendpacket(t_pdp_canvas *x)
 {
+  pdp_canvas_unpin(x);
+
   /* unregister and propagate if valid dest packet */
   pdp_packet_pass_if_valid(x->x_outlet0, &x->x_opacket);
 }
@@ -159,14 +359,26 @@ static void pdp_canvas_process(t_pdp_canvas *x, int ni)
    t_pdp *header = 0;
 
    /* check if image data packets are compatible */
-   if ( (header = pdp_packet_header(x->x_packets[ni]))
+   if ( (header = pdp_packet_header(x->x_layers[ni].l_packet))
    	&& (PDP_IMAGE == header->type)){
     
 	/* pdp_canvas_process inputs and write into active inlet */
-	switch(pdp_packet_header(x->x_packets[ni])->info.image.encoding){
+	switch(pdp_packet_header(x->x_layers[ni].l_packet)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_canvas_process_yv12, pdp_canvas_sendpacket, &x->x_queue_id);
+            pdp_canvas_damage_layer(x, ni);
+            // the previous composition is still running : the changes wait for the next one
+            if ( x->x_queue_id != -1 ) break;
+            // work on whole chroma samples
+            x->x_compose = x->x_dirty;
+            x->x_compose.r_x0 &= ~1;
+            x->x_compose.r_y0 &= ~1;
+            x->x_compose.r_x1 = ( x->x_compose.r_x1+1 ) & ~1;
+            x->x_compose.r_y1 = ( x->x_compose.r_y1+1 ) & ~1;
+            x->x_dirty.r_x0 = x->x_dirty.r_x1 = 0;
+            x->x_dirty.r_y0 = x->x_dirty.r_y1 = 0;
+            pdp_canvas_pin(x);
+            pidip_queue_add(x, pdp_canvas_process_yv12, pdp_canvas_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -180,34 +392,95 @@ static void pdp_canvas_process(t_pdp_canvas *x, int ni)
     }
 }
 
+static int pdp_canvas_checklayer(t_pdp_canvas *x, char *method, t_floatarg ni)
+{
+  if ( ( ni < 1 ) || ( ni > x->x_nblayers ) )
+  {
+     post( "pdp_canvas : %s : wrong source : %d : must be between 1 and %d", method, (int)ni, x->x_nblayers );
+     return 0;
+  }
+  return 1;
+}
+
 static void pdp_canvas_offset(t_pdp_canvas *x, t_floatarg ni, t_floatarg xoffset, t_floatarg yoffset)
 {
-  if ( ( ni < 1 ) || ( ni > x->x_nbinputs ) )
+  if ( !pdp_canvas_checklayer( x, "offset", ni ) ) return;
+  pdp_canvas_damage_layer( x, (int)ni-1 );
+  x->x_layers[(int)ni-1].l_xoffset = xoffset;
+  x->x_layers[(int)ni-1].l_yoffset = yoffset;
+  pdp_canvas_damage_layer( x, (int)ni-1 );
+}
+
+static void pdp_canvas_zorder(t_pdp_canvas *x, t_floatarg ni, t_floatarg zorder)
+{
+  if ( !pdp_canvas_checklayer( x, "zorder", ni ) ) return;
+  x->x_layers[(int)ni-1].l_zorder = (int)zorder;
+  pdp_canvas_damage_layer( x, (int)ni-1 );
+  pdp_canvas_sort( x );
+}
+
+static void pdp_canvas_opacity(t_pdp_canvas *x, t_floatarg ni, t_floatarg opacity)
+{
+  if ( !pdp_canvas_checklayer( x, "opacity", ni ) ) return;
+  if ( opacity < 0. ) opacity = 0.;
+  if ( opacity > 1. ) opacity = 1.;
+  x->x_layers[(int)ni-1].l_opacity = (int)(opacity*256);
+  pdp_canvas_damage_layer( x, (int)ni-1 );
+}
+
+static void pdp_canvas_mask(t_pdp_canvas *x, t_floatarg ni, t_floatarg nm)
+{
+  if ( !pdp_canvas_checklayer( x, "mask", ni ) ) return;
+  if ( ( nm != 0 ) && ( !pdp_canvas_checklayer( x, "mask", nm ) || ( nm == ni ) ) ) return;
+  pdp_canvas_damage_layer( x, (int)ni-1 );
+  x->x_layers[(int)ni-1].l_mask = (int)nm-1;
+}
+
+static void pdp_canvas_clip(t_pdp_canvas *x, t_symbol *s, int argc, t_atom *argv)
+{
+  t_canvas_layer *l;
+  int ni;
+
+  if ( ( argc < 1 ) || ( argv[0].a_type != A_FLOAT ) )
   {
-     post( "pdp_canvas : offset : wrong source : %d : must be between 1 and %d", ni, x->x_nbinputs );
+     post( "pdp_canvas : clip : usage : clip <source> [<x> <y> <width> <height>]" );
      return;
   }
-  x->x_xoffsets[(int)ni-1] = xoffset;
-  x->x_yoffsets[(int)ni-1] = yoffset;
+  if ( !pdp_canvas_checklayer( x, "clip", argv[0].a_w.w_float ) ) return;
+  ni = (int)argv[0].a_w.w_float-1;
+  l = &x->x_layers[ni];
+
+  // the old visible area has to be redrawn too
+  l->l_clip = 0;
+  pdp_canvas_damage_layer( x, ni );
+  if ( ( argc == 5 ) && ( atom_getfloat(&argv[3]) > 0 ) && ( atom_getfloat(&argv[4]) > 0 ) )
+  {
+     l->l_cliprect.r_x0 = (int)atom_getfloat(&argv[1]);
+     l->l_cliprect.r_y0 = (int)atom_getfloat(&argv[2]);
+     l->l_cliprect.r_x1 = l->l_cliprect.r_x0+(int)atom_getfloat(&argv[3]);
+     l->l_cliprect.r_y1 = l->l_cliprect.r_y0+(int)atom_getfloat(&argv[4]);
+     l->l_clip = 1;
+  }
 }
 
 static void pdp_canvas_select(t_pdp_canvas *x, t_floatarg X, t_floatarg Y)
 {
- int ii;
+ int ii, ni;
+ t_canvas_rect r;
 
   x->x_current = -1;
   X = X*x->x_owidth;
   Y = Y*x->x_oheight;
   // post( "pdp_canvas : select %f %f", X, Y );
-  for ( ii=0; ii<x->x_nbinputs; ii++)
+  // the topmost visible layer is picked
+  for ( ii=0; ii<x->x_nblayers; ii++)
   {
-    if ( x->x_packets[ii] != -1 )
+    ni = x->x_order[ii];
+    if ( ( x->x_layers[ni].l_opacity > 0 ) && pdp_canvas_layer_rect( x, x->x_layers, ni, &r ) )
     {
-      if ( (X >= x->x_xoffsets[ii]) && ( X < x->x_xoffsets[ii] + x->x_widths[ii] )
-           && (Y >= x->x_yoffsets[ii]) && ( Y < x->x_yoffsets[ii] + x->x_heights[ii] )
-         ) 
+      if ( (X >= r.r_x0) && ( X < r.r_x1 ) && (Y >= r.r_y0) && ( Y < r.r_y1 ) )
       {
-         x->x_current = ii;
+         x->x_current = ni;
          x->x_xmouse = X;
          x->x_ymouse = Y;
       }
@@ -222,8 +495,10 @@ static void pdp_canvas_drag(t_pdp_canvas *x, t_floatarg X, t_floatarg Y)
   // post( "pdp_canvas : drag %f %f", X, Y );
   if ( x->x_current != -1 )
   {
-     x->x_xoffsets[ x->x_current ] += (X-x->x_xmouse);
-     x->x_yoffsets[ x->x_current ] += (Y-x->x_ymouse);
+     pdp_canvas_damage_layer( x, x->x_current );
+     x->x_layers[ x->x_current ].l_xoffset += (X-x->x_xmouse);
+     x->x_layers[ x->x_current ].l_yoffset += (Y-x->x_ymouse);
+     pdp_canvas_damage_layer( x, x->x_current );
      x->x_xmouse = X;
      x->x_ymouse = Y;
   }
@@ -237,35 +512,131 @@ static void pdp_canvas_unselect(t_pdp_canvas *x)
 static void pdp_canvas_input(t_pdp_canvas *x, t_symbol *s, t_floatarg f, int ni)
 {
   t_pdp     *header;
-  short int *data;
+  t_canvas_layer *l = &x->x_layers[ni];
 
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
     {
-      if ( x->x_packets[ni] != -1 )
+      // the running composition has its own copy of the frame
+      if ( l->l_packet != -1 )
       { 
-        // delete the packet
-        pdp_packet_delete(x->x_packets[ni]);
-        x->x_packets[ni] = -1;
+        // the old area is recomposed if the size changes
+        pdp_canvas_damage_layer(x, ni);
+        pdp_packet_mark_unused(l->l_packet);
+        l->l_packet = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packets[ni], (int)f, pdp_gensym("image/YCrCb/*") );
-      if ( x->x_packets[ni] != -1 )
+      x->x_dropped = pidip_convert_ro_or_drop(x, &l->l_packet, (int)f, pdp_gensym("image/YCrCb/*") );
+      if ( l->l_packet != -1 )
       {
-        header = pdp_packet_header(x->x_packets[ni]);
-        x->x_widths[ni] = header->info.image.width;
-        x->x_heights[ni] = header->info.image.height;
-        x->x_sizes[ni] = x->x_widths[ni]*x->x_heights[ni];
+        header = pdp_packet_header(l->l_packet);
+        l->l_width = header->info.image.width;
+        l->l_height = header->info.image.height;
+        l->l_size = l->l_width*l->l_height;
       }
     }
 
-    if ((s == gensym("process")) && (-1 != x->x_packets[ni]) && (!x->x_dropped))
+    if ((s == gensym("process")) && (-1 != l->l_packet) && (!x->x_dropped))
     {
         /* add the process method and callback to the process queue */
         pdp_canvas_process(x, ni);
     }
 }
 
+static void pdp_canvas_proxy_input(t_pdp_canvas_proxy *p, t_symbol *s, t_floatarg f)
+{
+  pdp_canvas_input(p->p_owner, s, f, p->p_layer);
+}
+
+static void pdp_canvas_receive(t_pdp_canvas *x, t_floatarg ni, t_symbol *s)
+{
+  t_canvas_layer *l;
+
+  if ( !pdp_canvas_checklayer( x, "receive", ni ) ) return;
+  l = &x->x_layers[(int)ni-1];
+  if ( l->l_receive ) pd_unbind( &l->l_proxy->p_pd, l->l_receive );
+  l->l_receive = ( s == &s_ ) ? NULL : s;
+  if ( !l->l_receive ) return;
+  if ( !l->l_proxy )
+  {
+    l->l_proxy = (t_pdp_canvas_proxy *)pd_new(pdp_canvas_proxy_class);
+    l->l_proxy->p_owner = x;
+    l->l_proxy->p_layer = (int)ni-1;
+  }
+  pd_bind( &l->l_proxy->p_pd, l->l_receive );
+}
+
+static void pdp_canvas_init_layer(t_canvas_layer *l)
+{
+  l->l_packet = -1;
+  l->l_width = 0;
+  l->l_height = 0;
+  l->l_size = 0;
+  l->l_xoffset = 0.;
+  l->l_yoffset = 0.;
+  l->l_zorder = 0;
+  l->l_opacity = 256;
+  l->l_mask = -1;
+  l->l_clip = 0;
+  l->l_receive = NULL;
+  l->l_proxy = NULL;
+}
+
+static void pdp_canvas_release_layer(t_canvas_layer *l)
+{
+  pdp_packet_mark_unused(l->l_packet);
+  if ( l->l_receive ) pd_unbind( &l->l_proxy->p_pd, l->l_receive );
+  if ( l->l_proxy ) pd_free( &l->l_proxy->p_pd );
+  pdp_canvas_init_layer(l);
+}
+
+/* change the number of layers, the first ones are fed by the inlets,
+   the others through "receive" */
+static void pdp_canvas_layers(t_pdp_canvas *x, t_floatarg fnb)
+{
+  int nb = (int)fnb;
+  int ii;
+  t_canvas_layer *layers;
+  int *order;
+
+  if ( ( nb < x->x_nbinputs ) || ( nb > MAX_CANVAS_LAYERS ) )
+  {
+     post( "pdp_canvas : layers : wrong number of layers : %d : must be between %d and %d",
+           nb, x->x_nbinputs, MAX_CANVAS_LAYERS );
+     return;
+  }
+  if ( nb == x->x_nblayers ) return;
+
+  pdp_queue_finish(x->x_queue_id);
+
+  layers = ( t_canvas_layer* ) getbytes( nb*sizeof(t_canvas_layer) );
+  order = ( int* ) getbytes( nb*sizeof(int) );
+  for ( ii=0; ii<nb; ii++ )
+  {
+     if ( ii < x->x_nblayers )
+     {
+        layers[ii] = x->x_layers[ii];
+     }
+     else
+     {
+        pdp_canvas_init_layer( &layers[ii] );
+     }
+     if ( layers[ii].l_mask >= nb ) layers[ii].l_mask = -1;
+  }
+  for ( ii=nb; ii<x->x_nblayers; ii++ )
+  {
+     pdp_canvas_damage_layer( x, ii );
+     pdp_canvas_release_layer( &x->x_layers[ii] );
+  }
+  if ( x->x_layers ) freebytes( x->x_layers, x->x_nblayers*sizeof(t_canvas_layer) );
+  if ( x->x_order ) freebytes( x->x_order, x->x_nblayers*sizeof(int) );
+  x->x_layers = layers;
+  x->x_order = order;
+  x->x_nblayers = nb;
+  if ( ( x->x_current >= nb ) ) x->x_current = -1;
+  pdp_canvas_sort( x );
+}
+
 static void pdp_canvas_input0(t_pdp_canvas *x, t_symbol *s, t_floatarg f)
 {
   pdp_canvas_input(x, s, f, 0);
@@ -320,18 +691,16 @@ static void pdp_canvas_free(t_pdp_canvas *x)
 {
  int ii;
 
-  pdp_queue_finish(x->x_queue_id);
-  for ( ii=0; ii<x->x_nbinputs; ii++)
+  pidip_queue_release(x, x->x_queue_id);
+  pdp_canvas_unpin(x);
+  for ( ii=0; ii<x->x_nblayers; ii++)
   {
-    pdp_packet_mark_unused(x->x_packets[ii]);
+    pdp_canvas_release_layer(&x->x_layers[ii]);
   }
   pdp_packet_mark_unused(x->x_opacket);
-  if ( x->x_packets ) freebytes( x->x_packets, x->x_nbinputs*sizeof(int) );
-  if ( x->x_widths ) freebytes( x->x_widths, x->x_nbinputs*sizeof(int) );
-  if ( x->x_heights ) freebytes( x->x_heights, x->x_nbinputs*sizeof(int) );
-  if ( x->x_sizes ) freebytes( x->x_sizes, x->x_nbinputs*sizeof(int) );
-  if ( x->x_xoffsets ) freebytes( x->x_xoffsets, x->x_nbinputs*sizeof(t_float) );
-  if ( x->x_yoffsets ) freebytes( x->x_yoffsets, x->x_nbinputs*sizeof(t_float) );
+  if ( x->x_layers ) freebytes( x->x_layers, x->x_nblayers*sizeof(t_canvas_layer) );
+  if ( x->x_order ) freebytes( x->x_order, x->x_nblayers*sizeof(int) );
+  if ( x->x_frame ) freebytes( x->x_frame, (x->x_osize + (x->x_osize>>1))*sizeof(short int) );
 }
 
 t_class *pdp_canvas_class;
@@ -383,22 +752,23 @@ void *pdp_canvas_new(t_symbol *s, int argc, t_atom *argv)
 
   post ( "pdp_canvas : new %dx%d canvas with %d inputs", x->x_owidth, x->x_oheight, x->x_nbinputs );
 
-  x->x_packets = ( int* ) getbytes( x->x_nbinputs*sizeof(int) );
-  x->x_widths = ( int* ) getbytes( x->x_nbinputs*sizeof(int) );
-  x->x_heights = ( int* ) getbytes( x->x_nbinputs*sizeof(int) );
-  x->x_sizes = ( int* ) getbytes( x->x_nbinputs*sizeof(int) );
-  x->x_xoffsets = ( t_float* ) getbytes( x->x_nbinputs*sizeof(t_float) );
-  x->x_yoffsets = ( t_float* ) getbytes( x->x_nbinputs*sizeof(t_float) );
+  x->x_queue_id = -1;
+  x->x_layers = NULL;
+  x->x_order = NULL;
+  x->x_nbdrawn = 0;
+  x->x_nblayers = 0;
+  pdp_canvas_layers( x, x->x_nbinputs );
 
-  x->x_opacket = pdp_packet_new_image_YCrCb( x->x_owidth, x->x_oheight );
+  x->x_frame = ( short int* ) getbytes( (x->x_osize + (x->x_osize>>1))*sizeof(short int) );
+  memset( x->x_frame, 0x00, (x->x_osize + (x->x_osize>>1))*sizeof(short int) );
+  x->x_dirty.r_x0 = x->x_dirty.r_x1 = 0;
+  x->x_dirty.r_y0 = x->x_dirty.r_y1 = 0;
+  x->x_opacket = -1;
 
   for ( ii=0; ii<x->x_nbinputs; ii++)
   {
     sprintf( (char*)imes, "pdp%d", ii );
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, gensym("pdp"), gensym((char*)imes) );
-    x->x_packets[ii] = -1;
-    x->x_xoffsets[ii] = 0.;
-    x->x_yoffsets[ii] = 0.;
   }
   x->x_current = -1;
   x->x_outlet0 = outlet_new(&x->x_obj, &s_anything); 
@@ -436,6 +806,15 @@ void pdp_canvas_setup(void)
   class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_select, gensym("select"), A_DEFFLOAT, A_DEFFLOAT, A_NULL);
   class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_drag, gensym("drag"), A_DEFFLOAT, A_DEFFLOAT, A_NULL);
   class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_unselect, gensym("unselect"), A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_layers, gensym("layers"), A_FLOAT, A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_zorder, gensym("zorder"), A_FLOAT, A_FLOAT, A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_opacity, gensym("opacity"), A_FLOAT, A_FLOAT, A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_mask, gensym("mask"), A_FLOAT, A_DEFFLOAT, A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_clip, gensym("clip"), A_GIMME, A_NULL);
+  class_addmethod(pdp_canvas_class, (t_method)pdp_canvas_receive, gensym("receive"), A_FLOAT, A_DEFSYMBOL, A_NULL);
+
+  pdp_canvas_proxy_class = class_new(gensym("pdp_canvas_proxy"), 0, 0, sizeof(t_pdp_canvas_proxy), CLASS_PD, A_NULL);
+  class_addmethod(pdp_canvas_proxy_class, (t_method)pdp_canvas_proxy_input, gensym("pdp"), A_SYMBOL, A_DEFFLOAT, A_NULL);
 
 }
 
@@ -19,9 +19,17 @@
  */
 
 /*  This object is a color mapper that lets you change the colors within the image
+ *
+ *  the substitution table is compiled into a quantized YUV cube
+ *  giving the substituted color for each cell, rebuilt only when
+ *  the matched colors or tolerances change, so the frame is mapped
+ *  in one pass whatever the number of colors.
+ *  a 3D LUT ( .cube file ) can be loaded for grading, it is baked
+ *  into a YUV grid interpolated in the same pass.
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "g_canvas.h"
 #include "yuv.h"
 #include <math.h>
@@ -60,6 +68,14 @@ typedef struct _color
 
 #define COLORHEIGHT 5
 #define DEFAULT_CAPACITY 10
+#define MAX_CAPACITY 255       // colors are stored as bytes in the cube
+
+#define CMAP_YBITS 5           // quantization of the color cube
+#define CMAP_CBITS 7
+#define CMAP_CUBESIZE (1<<(CMAP_YBITS+2*CMAP_CBITS))
+#define CMAP_INDEX(y,u,v) ( ( ((y)>>(8-CMAP_YBITS))<<(2*CMAP_CBITS) ) + ( ((u)>>(8-CMAP_CBITS))<<CMAP_CBITS ) + ((v)>>(8-CMAP_CBITS)) )
+
+#define LUT_NODES 33           // nodes of the grading grid on each axis
 
 static char   *pdp_cmap_version = "pdp_cmap: a color mapper version 0.1 written by Yves Degoyon (ydegoyon@free.fr)";
 
@@ -68,7 +84,8 @@ typedef struct pdp_cmap_struct
     t_object x_obj;
     t_float x_f;
 
-    int x_packet0;
+    int x_packet0;      // last input frame, kept for picking colors
+    int x_packet1;
     int x_dropped;
 
     int x_vwidth;
@@ -88,7 +105,11 @@ typedef struct pdp_cmap_struct
 
     int x_cursX;  // X coordinate of cursor
     int x_cursY;  // Y coordinate of cursor
-    short int *x_frame;  // keep a copy of current frame for picking color
+
+    unsigned char *x_cube; // color index + 1 for each cell, 0 if unchanged
+    int x_cubedirty;       // the cube has to be rebuilt
+
+    short int *x_lut;      // grading grid, LUT_NODES^3 Y,U,V nodes, NULL if none
 
     t_outlet *x_pdp_output; // output packets
 
@@ -168,6 +189,7 @@ static void pdp_cmap_tolerance(t_pdp_cmap *x, t_floatarg ftolerance )
    if ( ftolerance >= 0 ) 
    {
       x->x_colors[x->x_current].tolerance = (int)ftolerance;
+      x->x_cubedirty = 1;
    }
 }
 
@@ -176,6 +198,7 @@ static void pdp_cmap_luminosity(t_pdp_cmap *x, t_floatarg fluminosity )
    if ( ( fluminosity == 0 ) || ( fluminosity == 1 ) )
    {
       x->x_luminosity = (int)fluminosity;
+      x->x_cubedirty = 1;
    }
 }
 
@@ -184,6 +207,7 @@ static void pdp_cmap_delete(t_pdp_cmap *x, t_floatarg fcolor )
    if ( ( fcolor >= 0 ) && ( fcolor < x->x_capacity ) )
    {
       x->x_colors[(int)fcolor].on = 0;
+      x->x_cubedirty = 1;
    }
 }
 
@@ -196,6 +220,7 @@ static void pdp_cmap_clear(t_pdp_cmap *x)
       x->x_colors[ci].on = 0;
    }
    x->x_current = 0;
+   x->x_cubedirty = 1;
 }
 
 static void pdp_cmap_resize(t_pdp_cmap *x,  t_floatarg fnewsize  )
@@ -204,6 +229,11 @@ static void pdp_cmap_resize(t_pdp_cmap *x,  t_floatarg fnewsize  )
   int ci, csize;
 
     if ( (int) fnewsize<=0 ) return;
+    if ( (int) fnewsize>MAX_CAPACITY )
+    {
+       post( "pdp_cmap : too many colors : %d : only %d supported", (int)fnewsize, MAX_CAPACITY );
+       return;
+    }
 
     // allocate new structures
     colors = (t_color*) getbytes( fnewsize*sizeof(t_color) );
@@ -237,6 +267,7 @@ static void pdp_cmap_resize(t_pdp_cmap *x,  t_floatarg fnewsize  )
     x->x_colors = colors;
     x->x_capacity = fnewsize;
     x->x_current = 0;
+    x->x_cubedirty = 1;
 }
 
 static void pdp_cmap_setcur(t_pdp_cmap *x,  t_floatarg fpx, t_floatarg fpy  )
@@ -268,13 +299,14 @@ static void pdp_cmap_cursor(t_pdp_cmap *x, t_floatarg fcursor )
 static void pdp_cmap_pick(t_pdp_cmap *x)
 {
  int y,u,v;
+ short int *frame = (short int *)pdp_packet_data(x->x_packet0);
 
-   if ( x->x_frame && ( x->x_cursX > 0 ) && ( x->x_cursX < x->x_vwidth ) 
+   if ( frame && ( x->x_cursX > 0 ) && ( x->x_cursX < x->x_vwidth )
         && ( x->x_cursY > 0 ) && ( x->x_cursY < x->x_vheight ) )
    {
-      x->x_colors[x->x_current].oy = x->x_frame[ x->x_cursY*x->x_vwidth+x->x_cursX ];
-      x->x_colors[x->x_current].ov = x->x_frame[ x->x_vsize+((x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1)) ];
-      x->x_colors[x->x_current].ou = x->x_frame[ x->x_vsize+(x->x_vsize>>2)+((x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1)) ];
+      x->x_colors[x->x_current].oy = frame[ x->x_cursY*x->x_vwidth+x->x_cursX ];
+      x->x_colors[x->x_current].ov = frame[ x->x_vsize+((x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1)) ];
+      x->x_colors[x->x_current].ou = frame[ x->x_vsize+(x->x_vsize>>2)+((x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1)) ];
       y = (x->x_colors[x->x_current].oy)>>7;
       v = (x->x_colors[x->x_current].ov>>8)+128;
       u = (x->x_colors[x->x_current].ou>>8)+128;
@@ -286,99 +318,327 @@ static void pdp_cmap_pick(t_pdp_cmap *x)
       x->x_colors[x->x_current].u = 255;
       x->x_colors[x->x_current].v = 255;
       x->x_colors[x->x_current].on = 1;
+      x->x_cubedirty = 1;
    }
 }
 
-static void pdp_cmap_allocate(t_pdp_cmap *x)
+static inline int pdp_cmap_clip8( int c )
+{
+    if ( c < 0 ) return 0;
+    if ( c > 255 ) return 255;
+    return c;
+}
+
+/* distance from a sample to the nearest sample of a cell */
+static inline int pdp_cmap_celldist( int o, int q, int step )
+{
+    if ( o < q ) return q-o;
+    if ( o > q+step-1 ) return o-(q+step-1);
+    return 0;
+}
+
+/* compile the substitution table into the cube,
+   later colors win as when they were applied one after the other */
+static void pdp_cmap_build_cube(t_pdp_cmap *x)
 {
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+  int ci, yq, uq, vq, oy, ou, ov, tol, diff;
+  int ymin, ymax, umin, umax, vmin, vmax;
+  int ystep = 1<<(8-CMAP_YBITS);
+  int cstep = 1<<(8-CMAP_CBITS);
 
-    if ( !x->x_frame )
+    memset( x->x_cube, 0x0, CMAP_CUBESIZE );
+    for ( ci=0; ci<x->x_capacity; ci++ )
     {
-       post( "pdp_mgrid : severe error : cannot allocate buffer !!! ");
-       return;
+       if ( !x->x_colors[ci].on ) continue;
+       oy = pdp_cmap_clip8( x->x_colors[ci].oy>>7 );
+       ou = pdp_cmap_clip8( (x->x_colors[ci].ou>>8)+128 );
+       ov = pdp_cmap_clip8( (x->x_colors[ci].ov>>8)+128 );
+       tol = x->x_colors[ci].tolerance;
+
+       // only the cells of the tolerance box are tested, at their nearest point,
+       // so that the cell of the picked color always matches
+       ymin = ( x->x_luminosity ) ? pdp_cmap_clip8( oy-tol ) : 0;
+       ymax = ( x->x_luminosity ) ? pdp_cmap_clip8( oy+tol ) : 255;
+       umin = pdp_cmap_clip8( ou-tol ); umax = pdp_cmap_clip8( ou+tol );
+       vmin = pdp_cmap_clip8( ov-tol ); vmax = pdp_cmap_clip8( ov+tol );
+       for ( yq=(ymin&~(ystep-1)); yq<=ymax; yq+=ystep )
+       {
+          for ( uq=(umin&~(cstep-1)); uq<=umax; uq+=cstep )
+          {
+             for ( vq=(vmin&~(cstep-1)); vq<=vmax; vq+=cstep )
+             {
+                diff = pdp_cmap_celldist(ou,uq,cstep)+pdp_cmap_celldist(ov,vq,cstep);
+                if ( x->x_luminosity ) diff += pdp_cmap_celldist(oy,yq,ystep);
+                if ( diff <= tol ) x->x_cube[CMAP_INDEX(yq,uq,vq)] = ci+1;
+             }
+          }
+       }
     }
+    x->x_cubedirty = 0;
 }
 
-static void pdp_cmap_free_ressources(t_pdp_cmap *x)
+/* trilinear interpolation in the grading grid */
+static inline void pdp_cmap_grade(short int *lut, int y, int u, int v, int *gy, int *gu, int *gv)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+  int n = LUT_NODES-1;
+  int iy, iu, iv, fy, fu, fv, ch, c00, c01, c10, c11, c0, c1;
+  int dy = LUT_NODES*LUT_NODES*3, du = LUT_NODES*3, dv = 3;
+  int out[3];
+  short int *c;
+
+    iy = y*n; fy = ( (iy%255)<<8 )/255; iy /= 255;
+    iu = u*n; fu = ( (iu%255)<<8 )/255; iu /= 255;
+    iv = v*n; fv = ( (iv%255)<<8 )/255; iv /= 255;
+    if ( iy == n ) { iy--; fy = 256; }
+    if ( iu == n ) { iu--; fu = 256; }
+    if ( iv == n ) { iv--; fv = 256; }
+    c = lut + ( (iy*LUT_NODES+iu)*LUT_NODES+iv )*3;
+
+    for ( ch=0; ch<3; ch++ )
+    {
+       c00 = c[ch] + ( ( (c[dv+ch]-c[ch])*fv )>>8 );
+       c01 = c[du+ch] + ( ( (c[du+dv+ch]-c[du+ch])*fv )>>8 );
+       c10 = c[dy+ch] + ( ( (c[dy+dv+ch]-c[dy+ch])*fv )>>8 );
+       c11 = c[dy+du+ch] + ( ( (c[dy+du+dv+ch]-c[dy+du+ch])*fv )>>8 );
+       c0 = c00 + ( ( (c01-c00)*fu )>>8 );
+       c1 = c10 + ( ( (c11-c10)*fu )>>8 );
+       out[ch] = c0 + ( ( (c1-c0)*fy )>>8 );
+    }
+    *gy = out[0];
+    *gu = out[1];
+    *gv = out[2];
 }
 
-static void pdp_cmap_process_yv12(t_pdp_cmap *x)
+static void pdp_cmap_free_lut(t_pdp_cmap *x)
 {
-    t_pdp     *header = pdp_packet_header(x->x_packet0);
-    short int *data   = (short int *)pdp_packet_data(x->x_packet0);
-    int     i, ci;
-    int     px=0, py=0, ppx=0, ppy=0; 
-    int     y=0, u=0, v=0;
-    short int *pfY, *pfU, *pfV;
-    short int *poY, *poU, *poV;
-    int     diff;
+    if ( x->x_lut ) freebytes( x->x_lut, LUT_NODES*LUT_NODES*LUT_NODES*3*sizeof(short int) );
+    x->x_lut = NULL;
+}
 
-    /* allocate all ressources */
-    if ( ( (int)header->info.image.width != x->x_vwidth ) ||
-         ( (int)header->info.image.height != x->x_vheight ) )
+        /* load a 3D LUT in the .cube format, no file removes the grading */
+static void pdp_cmap_cube(t_pdp_cmap *x, t_symbol *filename)
+{
+  FILE *f;
+  char line[256];
+  int size=0, count=0, yi, ui, vi, ri, gi, bi, rgb, ch, i;
+  float dmin[3] = { 0., 0., 0. }, dmax[3] = { 1., 1., 1. };
+  float r, g, b, w, p[3], fr[3], o[3], *table = NULL;
+  int i0[3], i1[3];
+  short int *node;
+
+    if ( filename == &s_ )
     {
-        pdp_cmap_free_ressources( x ); 
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        pdp_cmap_allocate( x ); 
-        post( "pdp_cmap : reallocated buffers" );
+       pdp_cmap_free_lut( x );
+       return;
     }
 
-    memcpy(x->x_frame, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
+    if ( ( f = fopen( filename->s_name, "r" ) ) == NULL )
+    {
+       post( "pdp_cmap : could not open LUT : %s", filename->s_name );
+       return;
+    }
 
-    // map colors
-    for ( ci=0; ci<x->x_capacity; ci++ )
+    while ( fgets( line, sizeof(line), f ) )
+    {
+       if ( sscanf( line, "LUT_3D_SIZE %d", &size ) == 1 )
+       {
+          if ( table || ( size < 2 ) || ( size > 256 ) )
+          {
+             post( "pdp_cmap : wrong LUT size : %d", size );
+             break;
+          }
+          table = (float *) getbytes( size*size*size*3*sizeof(float) );
+          continue;
+       }
+       if ( sscanf( line, "DOMAIN_MIN %f %f %f", &dmin[0], &dmin[1], &dmin[2] ) == 3 ) continue;
+       if ( sscanf( line, "DOMAIN_MAX %f %f %f", &dmax[0], &dmax[1], &dmax[2] ) == 3 ) continue;
+       if ( !table || ( count >= size*size*size ) ) continue;
+       if ( ( line[0] != '-' ) && ( line[0] != '.' ) && ( ( line[0] < '0' ) || ( line[0] > '9' ) ) ) continue;
+       if ( sscanf( line, "%f %f %f", &r, &g, &b ) == 3 )
+       {
+          table[count*3] = r;
+          table[count*3+1] = g;
+          table[count*3+2] = b;
+          count++;
+       }
+    }
+    fclose( f );
+
+    if ( !table || ( count != size*size*size ) )
+    {
+       post( "pdp_cmap : %s is not a valid 3D LUT (%d entries)", filename->s_name, count );
+       if ( table ) freebytes( table, size*size*size*3*sizeof(float) );
+       return;
+    }
+
+    for ( ch=0; ch<3; ch++ )
     {
-       if ( x->x_colors[ci].on )
+       if ( dmax[ch] <= dmin[ch] )
        {
-         pfY = data;
-         pfV = data+x->x_vsize;
-         pfU = data+x->x_vsize+(x->x_vsize>>2);
-         poY = x->x_frame;
-         poV = x->x_frame+x->x_vsize;
-         poU = x->x_frame+x->x_vsize+(x->x_vsize>>2);
-         for ( py=0; py<x->x_vheight; py++ )
+          post( "pdp_cmap : %s has an empty domain", filename->s_name );
+          freebytes( table, size*size*size*3*sizeof(float) );
+          return;
+       }
+    }
+
+    if ( !x->x_lut ) x->x_lut = (short int *) getbytes( LUT_NODES*LUT_NODES*LUT_NODES*3*sizeof(short int) );
+
+    // bake the RGB table into a grid of YUV nodes
+    node = x->x_lut;
+    for ( yi=0; yi<LUT_NODES; yi++ )
+    {
+      for ( ui=0; ui<LUT_NODES; ui++ )
+      {
+        for ( vi=0; vi<LUT_NODES; vi++ )
+        {
+          rgb = yuv_YUVtoRGB( (yi*255)/(LUT_NODES-1), (ui*255)/(LUT_NODES-1), (vi*255)/(LUT_NODES-1) );
+          p[0] = (float)((rgb>>16)&0xff)/255.;
+          p[1] = (float)((rgb>>8)&0xff)/255.;
+          p[2] = (float)(rgb&0xff)/255.;
+          for ( ch=0; ch<3; ch++ )
+          {
+             p[ch] = ( p[ch]-dmin[ch] )/( dmax[ch]-dmin[ch] )*(size-1);
+             if ( p[ch] < 0. ) p[ch] = 0.;
+             if ( p[ch] > size-1 ) p[ch] = size-1;
+             i0[ch] = (int)p[ch];
+             i1[ch] = ( i0[ch] < size-1 ) ? i0[ch]+1 : i0[ch];
+             fr[ch] = p[ch]-i0[ch];
+          }
+          // red varies fastest in .cube files
+          o[0] = o[1] = o[2] = 0.;
+          for ( i=0; i<8; i++ )
+          {
+             ri = (i&1) ? i1[0] : i0[0];
+             gi = (i&2) ? i1[1] : i0[1];
+             bi = (i&4) ? i1[2] : i0[2];
+             w = ( (i&1) ? fr[0] : 1.-fr[0] ) * ( (i&2) ? fr[1] : 1.-fr[1] ) * ( (i&4) ? fr[2] : 1.-fr[2] );
+             for ( ch=0; ch<3; ch++ )
+             {
+                o[ch] += w*table[((bi*size+gi)*size+ri)*3+ch];
+             }
+          }
+          rgb = ( pdp_cmap_clip8( (int)(o[0]*255.+0.5) )<<16 ) +
+                ( pdp_cmap_clip8( (int)(o[1]*255.+0.5) )<<8 ) +
+                pdp_cmap_clip8( (int)(o[2]*255.+0.5) );
+          node[0] = yuv_RGBtoY( rgb )<<7;
+          node[1] = ( yuv_RGBtoU( rgb )-128 )<<8;
+          node[2] = ( yuv_RGBtoV( rgb )-128 )<<8;
+          node += 3;
+        }
+      }
+    }
+    freebytes( table, size*size*size*3*sizeof(float) );
+    post( "pdp_cmap : loaded LUT : %s (%dx%dx%d)", filename->s_name, size, size, size );
+}
+
+static void pdp_cmap_process_yv12(t_pdp_cmap *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    short int *data0  = (short int *)pdp_packet_data(x->x_packet0);
+    t_pdp     *newheader;
+    short int *data;
+    int     i, ci, li, k, cw;
+    int     px=0, py=0, dx, dy;
+    int     y=0, u=0, v=0, gy, gu, gv;
+    short int *piY, *piU, *piV;
+    short int *poY, *poU, *poV;
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+
+    if ( x->x_cubedirty ) pdp_cmap_build_cube( x );
+
+    // the input frame is kept for picking, the mapped one is a new packet
+    x->x_packet1 = pdp_packet_clone_rw( x->x_packet0 );
+    newheader = pdp_packet_header(x->x_packet1);
+    data = (short int *)pdp_packet_data(x->x_packet1);
+    if ( !data ) return;
+    newheader->info.image.encoding = header->info.image.encoding;
+    newheader->info.image.width = x->x_vwidth;
+    newheader->info.image.height = x->x_vheight;
+
+    piY = data0;
+    piV = data0+x->x_vsize;
+    piU = data0+x->x_vsize+(x->x_vsize>>2);
+    poY = data;
+    poV = data+x->x_vsize;
+    poU = data+x->x_vsize+(x->x_vsize>>2);
+    cw = x->x_vwidth>>1;
+
+    // substitution doesn't touch the luminance
+    if ( !x->x_lut ) memcpy( poY, piY, x->x_vsize<<1 );
+
+    // one pass over the chroma samples, each with the luminance of its first pixel
+    for ( py=0; py<(x->x_vheight>>1); py++ )
+    {
+      for ( px=0; px<cw; px++ )
+      {
+         ci = py*cw+px;
+         li = (py<<1)*x->x_vwidth+(px<<1);
+         y = pdp_cmap_clip8( piY[li]>>7 );
+         u = pdp_cmap_clip8( (piU[ci]>>8)+128 );
+         v = pdp_cmap_clip8( (piV[ci]>>8)+128 );
+
+         if ( ( k = x->x_cube[CMAP_INDEX(y,u,v)] ) )
+         {
+            poV[ci] = x->x_colors[k-1].v;
+            poU[ci] = x->x_colors[k-1].u;
+         }
+         else
          {
-           for ( px=0; px<x->x_vwidth; px++ )
+            poV[ci] = piV[ci];
+            poU[ci] = piU[ci];
+         }
+
+         if ( x->x_lut )
+         {
+            u = pdp_cmap_clip8( (poU[ci]>>8)+128 );
+            v = pdp_cmap_clip8( (poV[ci]>>8)+128 );
+            for ( dy=0; dy<2; dy++ )
+            {
+               for ( dx=0; dx<2; dx++ )
+               {
+                  i = li+dy*x->x_vwidth+dx;
+                  pdp_cmap_grade( x->x_lut, pdp_cmap_clip8( piY[i]>>7 ), u, v, &gy, &gu, &gv );
+                  poY[i] = gy;
+                  if ( ( dx == 0 ) && ( dy == 0 ) )
+                  {
+                     poU[ci] = gu;
+                     poV[ci] = gv;
+                  }
+               }
+            }
+         }
+      }
+    }
+
+    // last column and last row of odd sizes, with the nearest chroma sample
+    if ( x->x_lut && cw && ( x->x_vheight>>1 ) )
+    {
+      for ( py=0; py<x->x_vheight; py++ )
+      {
+        for ( px=( py < ((x->x_vheight>>1)<<1) ) ? (cw<<1) : 0; px<x->x_vwidth; px++ )
+        {
+           i = py*x->x_vwidth+px;
+           ci = ( ( py>>1 < (x->x_vheight>>1) ) ? py>>1 : (x->x_vheight>>1)-1 )*cw
+                + ( ( px>>1 < cw ) ? px>>1 : cw-1 );
+           y = pdp_cmap_clip8( piY[i]>>7 );
+           u = pdp_cmap_clip8( (piU[ci]>>8)+128 );
+           v = pdp_cmap_clip8( (piV[ci]>>8)+128 );
+           if ( ( k = x->x_cube[CMAP_INDEX(y,u,v)] ) )
            {
-              y = *poY;
-              v = *poV;
-              u = *poU;
-              
-              if ( x->x_luminosity )
-              {
-                 diff = (abs(y-x->x_colors[ci].oy)>>7)+(abs(u-x->x_colors[ci].ou)>>8)+(abs(v-x->x_colors[ci].ov)>>8);
-              }
-              else
-              {
-                 diff = (abs(u-x->x_colors[ci].ou)>>8)+(abs(v-x->x_colors[ci].ov)>>8);
-              }
-  
-              if ( diff <= x->x_colors[ci].tolerance )
-              {
-                 // change color not luminosity
-                 // *pfY = x->x_colors[ci].y;
-                 *pfV = x->x_colors[ci].v;
-                 *pfU = x->x_colors[ci].u;
-              } 
-  
-              pfY++;poY++;
-              if ( (px%2==0) && (py%2==0) )
-              {
-                 pfU++;pfV++;
-                 poU++;poV++;
-              }
+              u = pdp_cmap_clip8( (x->x_colors[k-1].u>>8)+128 );
+              v = pdp_cmap_clip8( (x->x_colors[k-1].v>>8)+128 );
            }
-         }
-       }
+           pdp_cmap_grade( x->x_lut, y, u, v, &gy, &gu, &gv );
+           poY[i] = gy;
+        }
+      }
     }
 
     // draw cursor
-    if ( ( x->x_cursX > 0 ) && ( x->x_cursY > 0 ) && ( x->x_cursor ) )
+    if ( ( x->x_cursX > 0 ) && ( x->x_cursY > 0 ) && ( x->x_cursor ) && ( x->x_cursX < x->x_vwidth ) && ( x->x_cursY < x->x_vheight ) )
     {
        for ( px=(x->x_cursX-5); px<=(x->x_cursX+5); px++ )
        {
@@ -410,7 +670,7 @@ static void pdp_cmap_process_yv12(t_pdp_cmap *x)
        }
     }
 
-    pdp_packet_pass_if_valid(x->x_pdp_output, &x->x_packet0);
+    pdp_packet_pass_if_valid(x->x_pdp_output, &x->x_packet1);
 
     return;
 }
@@ -428,7 +688,7 @@ static void pdp_cmap_process(t_pdp_cmap *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_cmap_process_yv12(x);
+            pidip_process_inline(x, pdp_cmap_process_yv12);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -450,7 +710,15 @@ static void pdp_cmap_input_0(t_pdp_cmap *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))  
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       /* release the previous frame */
+       if ( x->x_packet0 != -1 )
+       {
+          pdp_packet_mark_unused(x->x_packet0);
+          x->x_packet0 = -1;
+       }
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -463,8 +731,11 @@ static void pdp_cmap_free(t_pdp_cmap *x)
 {
   int i;
 
+    pidip_queue_release(x, -1);
     pdp_packet_mark_unused(x->x_packet0);
-    pdp_cmap_free_ressources( x );
+    if ( x->x_cube ) freebytes( x->x_cube, CMAP_CUBESIZE );
+    pdp_cmap_free_lut( x );
+    if ( x->x_colors ) freebytes( x->x_colors, x->x_capacity*sizeof(t_color) );
 }
 
 t_class *pdp_cmap_class;
@@ -485,6 +756,11 @@ void *pdp_cmap_new(void)
     x->x_pdp_output = outlet_new(&x->x_obj, &s_anything); 
 
     x->x_packet0 = -1;
+    x->x_packet1 = -1;
+
+    x->x_cube = (unsigned char *) getbytes( CMAP_CUBESIZE );
+    x->x_cubedirty = 1;
+    x->x_lut = NULL;
 
     x->x_cursX = -1;
     x->x_cursY = -1;
@@ -533,6 +809,7 @@ void pdp_cmap_setup(void)
     class_addmethod(pdp_cmap_class, (t_method)pdp_cmap_delete, gensym("delete"), A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_cmap_class, (t_method)pdp_cmap_resize, gensym("resize"), A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_cmap_class, (t_method)pdp_cmap_setcur, gensym("setcur"), A_DEFFLOAT, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_cmap_class, (t_method)pdp_cmap_cube, gensym("cube"), A_DEFSYMBOL, A_NULL);
 
 }
 
@@ -20,9 +20,15 @@
 
 /*  This object is a video compositor mixing two sources
  *  idea expressed by liz
+ *
+ *  a soft keyer : a matte is looked up from the distance to the key color
+ *  ( luminance, or chroma with luminosity 0 ), blurred and choked,
+ *  and the key color is removed from the foreground edges ( spill )
+ *  before both sources are blended.
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "g_canvas.h"
 #include "yuv.h"
 #include <math.h>
@@ -79,8 +85,23 @@ typedef struct pdp_compose_struct
     int x_cursY;  // Y coordinate of cursor
     int x_cursor; // cursor drawing flag
     int x_luminosity; // flag to indicate if luminosity is used
-    short int *x_frame;  // keep a copy of current frame for picking color
-    short int *x_right_frame;  // 2nd video source
+    int x_softness;   // width of the soft edge of the key
+    int x_spill;      // spill suppression, 0..256
+    int x_choke;      // matte choke, 0..254
+    int x_blur;       // number of blur passes on the matte
+    int x_pickpacket;   // last source frame, for picking color
+    int x_packet_right; // 2nd video source
+    int x_rightpin;     // 2nd video source used by the running process
+
+    int x_keydirty;   // the key tables have to be rebuilt
+    unsigned char x_lumakey[256];         // foreground alpha for each luminance
+    unsigned char x_chromakey[128*128];   // foreground alpha for each chroma
+    int x_spillu;     // key color direction in the chroma plane
+    int x_spillv;
+    unsigned char *x_matte;     // alpha, at the luma resolution for a luminosity key,
+                                // at the chroma resolution for a color key
+    unsigned char *x_mattetmp;
+    int x_msize;
 
     t_outlet *x_pdp_output; // output packets
 
@@ -88,6 +109,20 @@ typedef struct pdp_compose_struct
 
 } t_pdp_compose;
 
+static inline int pdp_compose_clip8( int c )
+{
+    if ( c < 0 ) return 0;
+    if ( c > 255 ) return 255;
+    return c;
+}
+
+static inline unsigned char pdp_compose_ramp( t_pdp_compose *x, int d )
+{
+    if ( d <= x->x_tolerance ) return 0;
+    if ( d >= x->x_tolerance+x->x_softness ) return 255;
+    return ( ( d-x->x_tolerance )*255 )/x->x_softness;
+}
+
 static void pdp_compose_draw_color(t_pdp_compose *x)
 {
  int width, height;
@@ -120,6 +155,7 @@ static void pdp_compose_r(t_pdp_compose *x, t_floatarg fr )
       x->x_colorY = (yuv_RGBtoY( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB ))<<7;
       x->x_colorU = (yuv_RGBtoU( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
       x->x_colorV = (yuv_RGBtoV( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
+      x->x_keydirty = 1;
       if (glist_isvisible(x->x_canvas)) pdp_compose_draw_color( x );
    }
 }
@@ -132,6 +168,7 @@ static void pdp_compose_g(t_pdp_compose *x, t_floatarg fg )
       x->x_colorY = (yuv_RGBtoY( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB ))<<7;
       x->x_colorU = (yuv_RGBtoU( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
       x->x_colorV = (yuv_RGBtoV( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
+      x->x_keydirty = 1;
       if (glist_isvisible(x->x_canvas)) pdp_compose_draw_color( x );
    }
 }
@@ -144,6 +181,7 @@ static void pdp_compose_b(t_pdp_compose *x, t_floatarg fb )
       x->x_colorY = (yuv_RGBtoY( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB ))<<7;
       x->x_colorU = (yuv_RGBtoU( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
       x->x_colorV = (yuv_RGBtoV( (x->x_colorR << 16) + (x->x_colorG << 8) + x->x_colorB )-128)<<8;
+      x->x_keydirty = 1;
       if (glist_isvisible(x->x_canvas)) pdp_compose_draw_color( x );
    }
 }
@@ -161,6 +199,7 @@ static void pdp_compose_tolerance(t_pdp_compose *x, t_floatarg ftolerance )
    if ( ftolerance >= 0 ) 
    {
       x->x_tolerance = (int)ftolerance;
+      x->x_keydirty = 1;
    }
 }
 
@@ -191,39 +230,136 @@ static void pdp_compose_luminosity(t_pdp_compose *x, t_floatarg fluminosity )
 static void pdp_compose_pick(t_pdp_compose *x)
 {
  int y,u,v;
+ short int *frame = (short int *)pdp_packet_data(x->x_pickpacket);
 
-   if ( x->x_frame && ( x->x_cursX > 0 ) && ( x->x_cursX < x->x_vwidth ) 
+   if ( frame && ( x->x_cursX > 0 ) && ( x->x_cursX < x->x_vwidth ) 
         && ( x->x_cursY > 0 ) && ( x->x_cursY < x->x_vheight ) )
    {
-      x->x_colorY = x->x_frame[ x->x_cursY*x->x_vwidth+x->x_cursX ];
-      x->x_colorV = x->x_frame[ x->x_vsize + (x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1) ];
-      x->x_colorU = x->x_frame[ x->x_vsize + (x->x_vsize>>2) + (x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1) ];
+      x->x_colorY = frame[ x->x_cursY*x->x_vwidth+x->x_cursX ];
+      x->x_colorV = frame[ x->x_vsize + (x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1) ];
+      x->x_colorU = frame[ x->x_vsize + (x->x_vsize>>2) + (x->x_cursY>>1)*(x->x_vwidth>>1)+(x->x_cursX>>1) ];
       y = (x->x_colorY)>>7;
       u = (x->x_colorU>>8)+128;
       v = (x->x_colorV>>8)+128;
       x->x_colorR = yuv_YUVtoR( y, u, v );
       x->x_colorG = yuv_YUVtoG( y, u, v );
       x->x_colorB = yuv_YUVtoB( y, u, v );
+      x->x_keydirty = 1;
       if (glist_isvisible(x->x_canvas)) pdp_compose_draw_color( x );
    }
 }
 
+static void pdp_compose_softness(t_pdp_compose *x, t_floatarg fsoftness )
+{
+   if ( fsoftness >= 0 ) 
+   {
+      x->x_softness = (int)fsoftness;
+      x->x_keydirty = 1;
+   }
+}
+
+static void pdp_compose_spill(t_pdp_compose *x, t_floatarg fspill )
+{
+   if ( ( fspill >= 0. ) && ( fspill <= 1. ) )
+   {
+      x->x_spill = (int)(fspill*256);
+   }
+}
+
+static void pdp_compose_choke(t_pdp_compose *x, t_floatarg fchoke )
+{
+   if ( ( fchoke >= 0 ) && ( fchoke < 255 ) )
+   {
+      x->x_choke = (int)fchoke;
+   }
+}
+
+static void pdp_compose_blur(t_pdp_compose *x, t_floatarg fblur )
+{
+   if ( ( fblur >= 0 ) && ( fblur <= 8 ) )
+   {
+      x->x_blur = (int)fblur;
+   }
+}
+
 static void pdp_compose_allocate(t_pdp_compose *x)
 {
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
-    x->x_right_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    x->x_msize = x->x_vsize;
+    x->x_matte = (unsigned char *) getbytes ( x->x_msize );
+    x->x_mattetmp = (unsigned char *) getbytes ( x->x_msize );
 
-    if ( !x->x_frame || !x->x_right_frame )
+    if ( !x->x_matte || !x->x_mattetmp )
     {
-       post( "pdp_mgrid : severe error : cannot allocate buffer !!! ");
+       post( "pdp_compose : severe error : cannot allocate buffer !!! ");
        return;
     }
 }
 
 static void pdp_compose_free_ressources(t_pdp_compose *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
-    if ( x->x_right_frame ) freebytes ( x->x_right_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    if ( x->x_matte ) freebytes ( x->x_matte, x->x_msize );
+    if ( x->x_mattetmp ) freebytes ( x->x_mattetmp, x->x_msize );
+    x->x_matte = x->x_mattetmp = NULL;
+}
+
+/* alpha of the foreground for each luminance or chroma value :
+   0 within the tolerance, ramping up to 255 over the softness */
+static void pdp_compose_build_key(t_pdp_compose *x)
+{
+  int y, u, v, du, dv, d, norm;
+
+    for ( y=0; y<256; y++ )
+    {
+       d = abs( y - (x->x_colorY>>7) );
+       x->x_lumakey[y] = pdp_compose_ramp( x, d );
+    }
+    for ( u=0; u<128; u++ )
+    {
+       for ( v=0; v<128; v++ )
+       {
+          du = (u<<1)+1-( (x->x_colorU>>8)+128 );
+          dv = (v<<1)+1-( (x->x_colorV>>8)+128 );
+          d = (int)sqrt( du*du + dv*dv );
+          x->x_chromakey[(u<<7)+v] = pdp_compose_ramp( x, d );
+       }
+    }
+
+    // direction of the key color in the chroma plane, for spill suppression
+    du = x->x_colorU>>8;
+    dv = x->x_colorV>>8;
+    norm = (int)sqrt( du*du + dv*dv );
+    x->x_spillu = ( norm > 0 ) ? (du<<8)/norm : 0;
+    x->x_spillv = ( norm > 0 ) ? (dv<<8)/norm : 0;
+    x->x_keydirty = 0;
+}
+
+/* separable 3x3 box blur of the matte */
+static void pdp_compose_blur_matte(t_pdp_compose *x, int mw, int mh)
+{
+  int mx, my, i;
+  unsigned char *m = x->x_matte, *t = x->x_mattetmp;
+
+    for ( my=0; my<mh; my++ )
+    {
+       i = my*mw;
+       t[i] = ( 2*m[i]+m[i+1] )/3;
+       for ( mx=1; mx<mw-1; mx++ )
+       {
+          t[i+mx] = ( m[i+mx-1]+m[i+mx]+m[i+mx+1] )/3;
+       }
+       t[i+mw-1] = ( m[i+mw-2]+2*m[i+mw-1] )/3;
+    }
+    for ( mx=0; mx<mw; mx++ )
+    {
+       m[mx] = ( 2*t[mx]+t[mw+mx] )/3;
+       for ( my=1; my<mh-1; my++ )
+       {
+          i = my*mw+mx;
+          m[i] = ( t[i-mw]+t[i]+t[i+mw] )/3;
+       }
+       i = (mh-1)*mw+mx;
+       m[i] = ( t[i-mw]+2*t[i] )/3;
+    }
 }
 
 static void pdp_compose_process_yv12(t_pdp_compose *x)
@@ -232,11 +368,11 @@ static void pdp_compose_process_yv12(t_pdp_compose *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata   = (short int *)pdp_packet_data(x->x_packet1);
-    int     i, cf;
-    int     px=0, py=0, ppx=0, ppy=0, found=0, xcell=0, ycell=0; 
-    int     celldiff=0, cellwidth=0, cellheight=0;
-    int     y=0, u=0, v=0;
-    int     sum;
+    t_pdp     *rightheader = pdp_packet_header(x->x_rightpin);
+    short int *rightdata = NULL;
+    int     i, ci, li, mi, cw, mw, mh, pass;
+    int     px=0, py=0;
+    int     a, p, u, v, bg;
     short int *pfY, *pfV, *pfU, *prY, *prV, *prU, *pdY, *pdV, *pdU;
 
     /* allocate all ressources */
@@ -250,23 +386,143 @@ static void pdp_compose_process_yv12(t_pdp_compose *x)
         pdp_compose_allocate( x ); 
         post( "pdp_compose : reallocated buffers" );
     }
+    if ( !x->x_matte || !newdata ) return;
+
+    newheader->info.image.encoding = header->info.image.encoding;
+    newheader->info.image.width = x->x_vwidth;
+    newheader->info.image.height = x->x_vheight;
+
+    // the second source is the background, black if it doesn't match
+    if ( rightheader && ( (int)rightheader->info.image.width == x->x_vwidth )
+                     && ( (int)rightheader->info.image.height == x->x_vheight ) )
+    {
+       rightdata = (short int *)pdp_packet_data(x->x_rightpin);
+    }
+
+    pfY = data;
+    pfV = data+x->x_vsize;
+    pfU = data+x->x_vsize+(x->x_vsize>>2);
+    pdY = newdata;
+    pdV = newdata+x->x_vsize;
+    pdU = newdata+x->x_vsize+(x->x_vsize>>2);
+    if ( rightdata )
+    {
+       prY = rightdata;
+       prV = rightdata+x->x_vsize;
+       prU = rightdata+x->x_vsize+(x->x_vsize>>2);
+    }
+    cw = x->x_vwidth>>1;
+    if ( x->x_luminosity )
+    {
+       mw = x->x_vwidth;
+       mh = x->x_vheight;
+    }
+    else
+    {
+       mw = cw;
+       mh = x->x_vheight>>1;
+    }
 
-    memcpy(x->x_frame, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
+    // no key color : the first source goes through
+    if ( x->x_colorR == -1 )
+    {
+       memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
+    }
+    else
+    {
+       if ( x->x_keydirty ) pdp_compose_build_key( x );
+
+       // a luminosity matte follows every luma pixel, a color one the chroma cells
+       if ( x->x_luminosity )
+       {
+          for ( li=0; li<x->x_vsize; li++ )
+          {
+             x->x_matte[li] = x->x_lumakey[ pdp_compose_clip8( pfY[li]>>7 ) ];
+          }
+       }
+       else
+       {
+          for ( ci=0; ci<mw*mh; ci++ )
+          {
+             u = pdp_compose_clip8( (pfU[ci]>>8)+128 )>>1;
+             v = pdp_compose_clip8( (pfV[ci]>>8)+128 )>>1;
+             x->x_matte[ci] = x->x_chromakey[(u<<7)+v];
+          }
+       }
+       for ( pass=0; pass<x->x_blur; pass++ ) pdp_compose_blur_matte( x, mw, mh );
+
+       if ( x->x_choke )
+       {
+          for ( mi=0; mi<mw*mh; mi++ )
+          {
+             a = ( ( x->x_matte[mi] - x->x_choke )*255 )/( 255 - x->x_choke );
+             x->x_matte[mi] = ( a < 0 ) ? 0 : a;
+          }
+       }
+
+       // blend the chroma, removing the key color from the foreground
+       for ( ci=0; ci<cw*(x->x_vheight>>1); ci++ )
+       {
+          if ( x->x_luminosity )
+          {
+             // mean of the 2x2 block of the cell
+             mi = (ci/cw)*(x->x_vwidth<<1)+((ci%cw)<<1);
+             a = ( x->x_matte[mi] + x->x_matte[mi+1] + x->x_matte[mi+x->x_vwidth]
+                   + x->x_matte[mi+x->x_vwidth+1] + 2 )>>2;
+          }
+          else
+          {
+             a = x->x_matte[ci];
+          }
+          a += (a>>7);
+          u = pfU[ci];
+          v = pfV[ci];
+          if ( x->x_spill && !x->x_luminosity )
+          {
+             p = ( u*x->x_spillu + v*x->x_spillv )>>8;
+             if ( p > 0 )
+             {
+                p = ( p*x->x_spill )>>8;
+                u -= ( p*x->x_spillu )>>8;
+                v -= ( p*x->x_spillv )>>8;
+             }
+          }
+          bg = ( rightdata ) ? prU[ci] : 0;
+          pdU[ci] = bg + ( ( ( u-bg )*a )>>8 );
+          bg = ( rightdata ) ? prV[ci] : 0;
+          pdV[ci] = bg + ( ( ( v-bg )*a )>>8 );
+       }
+
+       // blend the luminance
+       for ( py=0; py<x->x_vheight; py++ )
+       {
+         li = py*x->x_vwidth;
+         ci = (py>>1)*cw;
+         for ( px=0; px<x->x_vwidth; px++ )
+         {
+            a = ( x->x_luminosity ) ? x->x_matte[li+px] : x->x_matte[ci+(px>>1)];
+            a += (a>>7);
+            bg = ( rightdata ) ? prY[li+px] : 0;
+            pdY[li+px] = bg + ( ( ( pfY[li+px]-bg )*a )>>8 );
+         }
+       }
+    }
 
     // draw cursor
-    if ( ( x->x_cursor ) && ( x->x_cursX > 0 ) && ( x->x_cursY > 0 ) )
+    if ( ( x->x_cursor ) && ( x->x_cursX > 0 ) && ( x->x_cursY > 0 ) 
+         && ( x->x_cursX < x->x_vwidth ) && ( x->x_cursY < x->x_vheight ) )
     {
        for ( px=(x->x_cursX-5); px<=(x->x_cursX+5); px++ )
        {
          if ( ( px > 0 ) && ( px < x->x_vwidth ) )
          {
-           if ( ((*(data+x->x_cursY*x->x_vwidth+px))>>7) < 128 )   
+           if ( ((*(newdata+x->x_cursY*x->x_vwidth+px))>>7) < 128 )   
            {
-              *(data+x->x_cursY*x->x_vwidth+px) = 0xff<<7;  
+              *(newdata+x->x_cursY*x->x_vwidth+px) = 0xff<<7;  
            }
            else
            {
-              *(data+x->x_cursY*x->x_vwidth+px) = 0x00<<7;  
+              *(newdata+x->x_cursY*x->x_vwidth+px) = 0x00<<7;  
            }
          }
        }
@@ -274,69 +530,29 @@ static void pdp_compose_process_yv12(t_pdp_compose *x)
        {
          if ( ( py > 0 ) && ( py < x->x_vheight ) )
          {
-           if ( ((*(data+py*x->x_vwidth+x->x_cursX))>>7) < 128 )
+           if ( ((*(newdata+py*x->x_vwidth+x->x_cursX))>>7) < 128 )
            {
-              *(data+py*x->x_vwidth+x->x_cursX) = 0xff<<7;
+              *(newdata+py*x->x_vwidth+x->x_cursX) = 0xff<<7;
            }
            else
            {
-              *(data+py*x->x_vwidth+x->x_cursX) = 0x00<<7;
+              *(newdata+py*x->x_vwidth+x->x_cursX) = 0x00<<7;
            }
          }
        }
     }
 
-    pfY = x->x_frame;
-    pfV = x->x_frame+x->x_vsize;
-    pfU = x->x_frame+x->x_vsize+(x->x_vsize>>2);
-    pdY = newdata;
-    pdV = newdata+x->x_vsize;
-    pdU = newdata+x->x_vsize+(x->x_vsize>>2);
-    prY = x->x_right_frame;
-    prV = x->x_right_frame+x->x_vsize;
-    prU = x->x_right_frame+x->x_vsize+(x->x_vsize>>2);
-    // track color
-    if ( x->x_colorR != -1 )
-    {
-       for ( py=0; py<x->x_vheight; py++ )
-       {
-         for ( px=0; px<x->x_vwidth; px++ )
-         {
-            y = *pfY;
-            v = *pfV;
-            u = *pfU;
-            if ( x->x_luminosity )
-            {
-               sum = (abs(y-x->x_colorY)>>7);
-            }
-            else
-            {
-               sum = (abs(y-x->x_colorY)>>7)+(abs(u-x->x_colorU)>>8)+(abs(v-x->x_colorV)>>8);
-            }
-            if ( sum <= x->x_tolerance )
-            {
-               *pdY = *prY;
-               *pdV = *prV;
-               *pdU = *prU;
-            }
-            prY++;pdY++;pfY++;
-            if ( (px%2==0) && (py%2==0) )
-            {
-               prU++; prV++;
-               pfU++; pfV++;
-               pdU++; pdV++;
-            }
-         }
-       }
-    }
-
     return;
 }
 
 static void pdp_compose_sendpacket(t_pdp_compose *x)
 {
-    pdp_packet_mark_unused(x->x_packet0);
+    /* the source frame is kept for picking colors */
+    pdp_packet_mark_unused(x->x_pickpacket);
+    x->x_pickpacket = x->x_packet0;
     x->x_packet0=-1;
+    pdp_packet_mark_unused(x->x_rightpin);
+    x->x_rightpin=-1;
 
     /* unregister and propagate if valid dest packet */
     pdp_packet_pass_if_valid(x->x_pdp_output, &x->x_packet1);
@@ -356,7 +572,8 @@ static void pdp_compose_process(t_pdp_compose *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_compose_process_yv12, pdp_compose_sendpacket, &x->x_queue_id);
+            x->x_rightpin = pdp_packet_copy_ro(x->x_packet_right);
+            pidip_queue_add(x, pdp_compose_process_yv12, pdp_compose_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -375,21 +592,23 @@ static void pdp_compose_process(t_pdp_compose *x)
 
 static void pdp_compose_input_1(t_pdp_compose *x, t_symbol *s, t_floatarg f)
 {
-  short int *rightdata   = (short int *)pdp_packet_data((int)f);
-
     if ( s== gensym("register_rw") )  
     {
-      memcpy(x->x_right_frame, rightdata, (x->x_vsize + (x->x_vsize>>1))<<1 );
+      /* keep a reference on the background, the running process has its own */
+      if ( x->x_packet_right != -1 )
+      {
+         pdp_packet_mark_unused(x->x_packet_right);
+         x->x_packet_right = -1;
+      }
+      pidip_convert_ro_or_drop(x, &x->x_packet_right, (int)f, pdp_gensym("image/YCrCb/*") );
     }
-
-    pdp_packet_mark_unused( (int)f );
 }
 
 static void pdp_compose_input_0(t_pdp_compose *x, t_symbol *s, t_floatarg f)
 {
     if ( s== gensym("register_rw") )
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -402,8 +621,12 @@ static void pdp_compose_free(t_pdp_compose *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
+    pdp_packet_mark_unused(x->x_packet0);
     pdp_packet_mark_unused(x->x_packet1);
+    pdp_packet_mark_unused(x->x_pickpacket);
+    pdp_packet_mark_unused(x->x_packet_right);
+    pdp_packet_mark_unused(x->x_rightpin);
     pdp_compose_free_ressources( x );
 }
 
@@ -434,13 +657,23 @@ void *pdp_compose_new(void)
 
     x->x_packet0 = -1;
     x->x_packet1 = -1;
+    x->x_pickpacket = -1;
+    x->x_packet_right = -1;
+    x->x_rightpin = -1;
     x->x_queue_id = -1;
+    x->x_matte = NULL;
+    x->x_mattetmp = NULL;
 
     x->x_cursX = -1;
     x->x_cursY = -1;
     x->x_tolerance = 20;
     x->x_luminosity = 1;
     x->x_cursor = 1;
+    x->x_softness = 0;
+    x->x_spill = 0;
+    x->x_choke = 0;
+    x->x_blur = 0;
+    x->x_keydirty = 1;
 
     x->x_canvas = canvas_getcurrent();
 
@@ -472,6 +705,10 @@ void pdp_compose_setup(void)
     class_addmethod(pdp_compose_class, (t_method)pdp_compose_tolerance, gensym("tolerance"), A_FLOAT, A_NULL);
     class_addmethod(pdp_compose_class, (t_method)pdp_compose_luminosity, gensym("luminosity"), A_FLOAT, A_NULL);
     class_addmethod(pdp_compose_class, (t_method)pdp_compose_setcur, gensym("setcur"), A_FLOAT, A_FLOAT, A_NULL);
+    class_addmethod(pdp_compose_class, (t_method)pdp_compose_softness, gensym("softness"), A_FLOAT, A_NULL);
+    class_addmethod(pdp_compose_class, (t_method)pdp_compose_spill, gensym("spill"), A_FLOAT, A_NULL);
+    class_addmethod(pdp_compose_class, (t_method)pdp_compose_choke, gensym("choke"), A_FLOAT, A_NULL);
+    class_addmethod(pdp_compose_class, (t_method)pdp_compose_blur, gensym("blur"), A_FLOAT, A_NULL);
 
 }
 
@@ -25,6 +25,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_roi.h"
 #include <math.h>
 
 static char   *pdp_cropper_version = "pdp_cropper: a video cropper, version 0.1, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -53,6 +55,9 @@ typedef struct pdp_cropper_struct
     int       x_cropy1;
     int       x_cropy2;
 
+    int       x_view;   // passes the packet with the rectangle as its region instead of a copy
+    t_pidip_roi x_roi;  // region of the incoming packet
+
 } t_pdp_cropper;
 
 static void pdp_cropper_cropx1(t_pdp_cropper *x, t_floatarg fcropx1 )
@@ -87,36 +92,54 @@ static void pdp_cropper_cropy2(t_pdp_cropper *x, t_floatarg fcropy2 )
     }
 }
 
+/* the crop rectangle in a frame, within the region of the incoming packet */
+static int pdp_cropper_region(t_pdp_cropper *x, t_pidip_roi *roi)
+{
+  int x0, y0, x1, y1;
+
+    if ( ( x->x_cropx1 <0 ) || ( x->x_cropx1 >= x->x_vwidth ) ) x->x_cropx1 = 0;
+    if ( ( x->x_cropx2 <0 ) || ( x->x_cropx2 >= x->x_vwidth ) ) x->x_cropx2 = x->x_vwidth-1;
+    if ( ( x->x_cropy1 <0 ) || ( x->x_cropy1 >= x->x_vheight ) ) x->x_cropy1 = 0;
+    if ( ( x->x_cropy2 <0 ) || ( x->x_cropy2 >= x->x_vheight ) ) x->x_cropy2 = x->x_vheight-1;
+
+    pidip_roi_set( roi, x->x_cropx1, x->x_cropy1, x->x_cropx2, x->x_cropy2, x->x_vwidth, x->x_vheight );
+    x0 = roi->r_x; y0 = roi->r_y;
+    x1 = roi->r_x + roi->r_width; y1 = roi->r_y + roi->r_height;
+    if ( !pidip_roi_clip( &x->x_roi, x->x_vwidth, x->x_vheight, &x0, &y0, &x1, &y1 ) )
+    {
+       return 0;
+    }
+    pidip_roi_set( roi, x0, y0, x1, y1, x->x_vwidth, x->x_vheight );
+    return ( ( roi->r_width > 0 ) && ( roi->r_height > 0 ) );
+}
+
 static void pdp_cropper_process_yv12(t_pdp_cropper *x)
 {
     t_pdp     *header = pdp_packet_header(x->x_packet0);
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = NULL;
     short int *newdata = NULL;
-    int       i;
+    t_pidip_roi roi;
 
-    int px, py;
+    int py;
+    int cstride, cx, cy;
     short int *pY, *pU, *pV;
     short int *pnY, *pnU, *pnV;
-    int minx, maxx;
-    int miny, maxy;
 
     /* allocate all ressources */
-    if ( ( (int)header->info.image.width != x->x_vwidth ) ||
-         ( (int)header->info.image.height != x->x_vheight ) ) 
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+
+    if ( !pdp_cropper_region( x, &roi ) )
     {
-       x->x_vwidth = header->info.image.width;
-       x->x_vheight = header->info.image.height;
-       x->x_vsize = x->x_vwidth*x->x_vheight;
-       if ( ( x->x_cropx1 <0 ) || ( x->x_cropx1 >= x->x_vwidth ) ) x->x_cropx1 = 0;
-       if ( ( x->x_cropx2 <0 ) || ( x->x_cropx2 >= x->x_vwidth ) ) x->x_cropx2 = x->x_vwidth-1;
-       if ( ( x->x_cropy1 <0 ) || ( x->x_cropy1 >= x->x_vheight ) ) x->x_cropy1 = 0;
-       if ( ( x->x_cropy2 <0 ) || ( x->x_cropy2 >= x->x_vheight ) ) x->x_cropy2 = x->x_vheight-1;
+       roi.r_x = roi.r_y = 0;
+       roi.r_width = roi.r_height = 0;
     }
 
-    x->x_csizex = abs ( x->x_cropx2 - x->x_cropx1 );
+    x->x_csizex = roi.r_width;
     if ( x->x_csizex%8 != 0 ) x->x_csizex = x->x_csizex + (8-(x->x_csizex%8)); // align on 8
-    x->x_csizey = abs ( x->x_cropy2 - x->x_cropy1 );
+    x->x_csizey = roi.r_height;
     if ( x->x_csizey%8 != 0 ) x->x_csizey = x->x_csizey + (8-(x->x_csizey%8)); // align on 8
     if ( x->x_csizex == 0 ) x->x_csizex = 8;
     if ( x->x_csizey == 0 ) x->x_csizey = 8;
@@ -126,51 +149,35 @@ static void pdp_cropper_process_yv12(t_pdp_cropper *x)
     x->x_packet1 = pdp_packet_new_image_YCrCb( x->x_csizex, x->x_csizey );
     newheader = pdp_packet_header(x->x_packet1);
     newdata = (short int *)pdp_packet_data(x->x_packet1);
+    if ( !newdata ) return;
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_csizex;
     newheader->info.image.height = x->x_csizey;
 
-    pY = data;
-    pU = (data+x->x_vsize);
-    pV = (data+x->x_vsize+(x->x_vsize>>2));
+    // the rectangle is copied row by row, with the stride of the frame
+    cstride = x->x_vwidth>>1;
+    cx = roi.r_x>>1;
+    cy = roi.r_y>>1;
+    pY = data + roi.r_y*x->x_vwidth + roi.r_x;
+    pU = data + x->x_vsize + cy*cstride + cx;
+    pV = data + x->x_vsize + (x->x_vsize>>2) + cy*cstride + cx;
     pnY = newdata;
     pnU = (newdata+x->x_csizev);
     pnV = (newdata+x->x_csizev+(x->x_csizev>>2));
 
-    if ( x->x_cropx1<x->x_cropx2 ) 
+    for(py=0; py<roi.r_height; py++) 
     {
-       minx = x->x_cropx1;
-       maxx = x->x_cropx2;
-    }
-    else
-    {
-       minx = x->x_cropx2;
-       maxx = x->x_cropx1;
-    }
-
-    if ( x->x_cropy1<x->x_cropy2 ) 
-    {
-       miny = x->x_cropy1;
-       maxy = x->x_cropy2;
-    }
-    else
-    {
-       miny = x->x_cropy2;
-       maxy = x->x_cropy1;
-    }
-
-    for(py=miny; py<maxy; py++) 
-    {
-      for(px=minx; px<maxx; px++) 
-      {
-         *(pnY+(py-miny)*x->x_csizex+(px-minx)) = *(pY+py*x->x_vwidth+px);
-         if ( (py%2==0) && (px%2==0) )
-         {
-           *(pnU+((py-miny)>>1)*(x->x_csizex>>1)+((px-minx)>>1)) = *(pU+(py>>1)*(x->x_vwidth>>1)+(px>>1));
-           *(pnV+((py-miny)>>1)*(x->x_csizex>>1)+((px-minx)>>1)) = *(pV+(py>>1)*(x->x_vwidth>>1)+(px>>1));
-         }
-      }
+      memcpy( pnY, pY, roi.r_width*sizeof(short int) );
+      pY += x->x_vwidth;
+      pnY += x->x_csizex;
+      if ( py&1 ) continue;
+      memcpy( pnU, pU, (roi.r_width>>1)*sizeof(short int) );
+      memcpy( pnV, pV, (roi.r_width>>1)*sizeof(short int) );
+      pU += cstride;
+      pV += cstride;
+      pnU += x->x_csizex>>1;
+      pnV += x->x_csizex>>1;
     }
 
     return;
@@ -186,6 +193,25 @@ static void pdp_cropper_sendpacket(t_pdp_cropper *x)
     pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
 }
 
+/* no copy, the incoming packet goes on with the rectangle as its region */
+static void pdp_cropper_view(t_pdp_cropper *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    t_pidip_roi roi;
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+
+    if ( !pdp_cropper_region( x, &roi ) )
+    {
+       pdp_packet_mark_unused(x->x_packet0);
+       x->x_packet0 = -1;
+       return;
+    }
+    pidip_roi_pass(x->x_outlet0, &x->x_packet0, &roi);
+}
+
 static void pdp_cropper_process(t_pdp_cropper *x)
 {
    int encoding;
@@ -199,7 +225,14 @@ static void pdp_cropper_process(t_pdp_cropper *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_cropper_process_yv12, pdp_cropper_sendpacket, &x->x_queue_id);
+            if ( x->x_view )
+            {
+               pdp_cropper_view(x);
+            }
+            else
+            {
+               pidip_queue_add(x, pdp_cropper_process_yv12, pdp_cropper_sendpacket, &x->x_queue_id);
+            }
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -221,7 +254,8 @@ static void pdp_cropper_input_0(t_pdp_cropper *x, t_symbol *s, t_floatarg f)
     if (s== gensym("register_rw"))
     {
        x->x_dropped = 
-          pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+          pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_roi_get( (int)f, &x->x_roi );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -231,11 +265,19 @@ static void pdp_cropper_input_0(t_pdp_cropper *x, t_symbol *s, t_floatarg f)
     }
 }
 
+static void pdp_cropper_viewmode(t_pdp_cropper *x, t_floatarg fview )
+{
+    if ( ( fview == 0 ) || ( fview == 1 ) )
+    {
+       x->x_view = (int)fview;
+    }
+}
+
 static void pdp_cropper_free(t_pdp_cropper *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -262,6 +304,9 @@ void *pdp_cropper_new(void)
     x->x_cropy1=-1;
     x->x_cropy2=-1;
 
+    x->x_view = 0;
+    pidip_roi_clear( &x->x_roi );
+
     return (void *)x;
 }
 
@@ -283,6 +328,7 @@ void pdp_cropper_setup(void)
     class_addmethod(pdp_cropper_class, (t_method)pdp_cropper_cropx2, gensym("x2"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_cropper_class, (t_method)pdp_cropper_cropy1, gensym("y1"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_cropper_class, (t_method)pdp_cropper_cropy2, gensym("y2"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_cropper_class, (t_method)pdp_cropper_viewmode, gensym("view"),  A_FLOAT, A_NULL);
 
 }
 
@@ -22,8 +22,10 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "g_canvas.h"
 #include "yuv.h"
+#include "pidip_roi.h"
 #include <math.h>
 #include <stdio.h>
 
@@ -79,6 +81,8 @@ typedef struct pdp_ctrack_struct
     int x_cursX;  // X coordinate of cursor
     int x_cursY;  // Y coordinate of cursor
     short int *x_frame;  // keep a copy of current frame for picking color
+    t_pidip_roi x_roi;   // the color is only searched in this region
+    int x_setroi;        // the block found becomes the region of the output
 
     t_outlet *x_pdp_output; // output packets
     t_outlet *x_x1; // output x1 coordinate of block which has been detected
@@ -204,6 +208,14 @@ static void pdp_ctrack_frame(t_pdp_ctrack *x, t_floatarg fframe )
    }
 }
 
+static void pdp_ctrack_setroi(t_pdp_ctrack *x, t_floatarg froi )
+{
+   if ( ( froi == 0 ) || ( froi == 1 ) )
+   {
+      x->x_setroi = (int)froi;
+   }
+}
+
 static void pdp_ctrack_steady(t_pdp_ctrack *x, t_floatarg fsteady )
 {
    if ( ( fsteady == 0 ) || ( fsteady == 1 ) )
@@ -263,6 +275,8 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
     int     X1=0, Y1=0, X2=0, Y2=0;
     short int *pfY, *pfU, *pfV;
     int     diff;
+    int     rx0, ry0, rx1, ry1;
+    t_pidip_roi roi;
 
     /* allocate all ressources */
     if ( ( (int)header->info.image.width != x->x_vwidth ) ||
@@ -315,15 +329,17 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
     pfY = x->x_frame;
     pfV = x->x_frame+x->x_vsize;
     pfU = x->x_frame+x->x_vsize+(x->x_vsize>>2);
-    if ( x->x_colorR != -1 )
+    rx0 = 0; ry0 = 0; rx1 = x->x_vwidth; ry1 = x->x_vheight;
+    if ( ( x->x_colorR != -1 ) && 
+         pidip_roi_clip( &x->x_roi, x->x_vwidth, x->x_vheight, &rx0, &ry0, &rx1, &ry1 ) )
     {
-       for ( py=0; py<x->x_vheight; py++ )
+       for ( py=ry0; py<ry1; py++ )
        {
-         for ( px=0; px<x->x_vwidth; px++ )
+         for ( px=rx0; px<rx1; px++ )
          {
-            y = *pfY++;
-            v = *pfV;
-            u = *pfU;
+            y = pfY[ py*x->x_vwidth+px ];
+            v = pfV[ (py>>1)*(x->x_vwidth>>1)+(px>>1) ];
+            u = pfU[ (py>>1)*(x->x_vwidth>>1)+(px>>1) ];
             
             if ( x->x_luminosity )
             {
@@ -340,10 +356,10 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
                y1=y2=py;
                found=0;
 
-               for (ppy=y1; ppy<x->x_vheight; ppy++)
+               for (ppy=y1; ppy<ry1; ppy++)
                {
                  found = 0;
-                 for (ppx=x1; ppx<x->x_vwidth; ppx++)
+                 for (ppx=x1; ppx<rx1; ppx++)
                  {
                    y = x->x_frame[ ppy*x->x_vwidth+ppx ];
                    v = x->x_frame[ x->x_vsize + (((ppy>>1)*(x->x_vwidth>>1))+(ppx>>1)) ];
@@ -375,7 +391,7 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
                // to the bottom
                for (ppx=x1; ppx<x2; ppx++)
                {
-                 for (ppy=y2; ppy<x->x_vheight; ppy++)
+                 for (ppy=y2; ppy<ry1; ppy++)
                  {
                    y = x->x_frame[ ppy*x->x_vwidth+ppx ];
                    v = x->x_frame[ x->x_vsize + (((ppy>>1)*(x->x_vwidth>>1))+(ppx>>1)) ];
@@ -403,7 +419,7 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
                // to the left
                for (ppy=y1; ppy<=y2; ppy++)
                {
-                 for (ppx=x1; ppx>0; ppx--)
+                 for (ppx=x1; ppx>rx0; ppx--)
                  {
                    y = x->x_frame[ ppy*x->x_vwidth+ppx ];
                    v = x->x_frame[ x->x_vsize + (((ppy>>1)*(x->x_vwidth>>1))+(ppx>>1)) ];
@@ -431,7 +447,7 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
                // to the right
                for (ppy=y1; ppy<=y2; ppy++)
                {
-                 for (ppx=x2; ppx<x->x_vwidth; ppx++)
+                 for (ppx=x2; ppx<rx1; ppx++)
                  {
                    y = x->x_frame[ ppy*x->x_vwidth+ppx ];
                    v = x->x_frame[ x->x_vsize + (((ppy>>1)*(x->x_vwidth>>1))+(ppx>>1)) ];
@@ -482,11 +498,6 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
                px=x2+1; py=y2;
                // post( "pdp_ctrack : px=%d py=%d", px, py );
             } 
-
-            if ( (px%2==0) && (py%2==0) )
-            {
-               pfU++;pfV++;
-            }
          }
        }
        if ( X1!=0 || X2!=0 || Y1!=0 || Y2!=0 )
@@ -541,7 +552,12 @@ static void pdp_ctrack_process_yv12(t_pdp_ctrack *x)
        }
     }
 
-    pdp_packet_pass_if_valid(x->x_pdp_output, &x->x_packet0);
+    pidip_roi_clear( &roi );
+    if ( x->x_setroi && ( X1!=0 || X2!=0 || Y1!=0 || Y2!=0 ) )
+    {
+       pidip_roi_set( &roi, X1, Y1, X2+1, Y2+1, x->x_vwidth, x->x_vheight );
+    }
+    pidip_roi_pass(x->x_pdp_output, &x->x_packet0, &roi);
 
     return;
 }
@@ -559,7 +575,7 @@ static void pdp_ctrack_process(t_pdp_ctrack *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_ctrack_process_yv12(x);
+            pidip_process_inline(x, pdp_ctrack_process_yv12);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -581,7 +597,10 @@ static void pdp_ctrack_input_0(t_pdp_ctrack *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_roi_get( (int)f, &x->x_roi );
+    }
 
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -595,6 +614,7 @@ static void pdp_ctrack_free(t_pdp_ctrack *x)
 {
   int i;
 
+    pidip_queue_release(x, -1);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_ctrack_free_ressources( x );
 }
@@ -639,6 +659,8 @@ void *pdp_ctrack_new(void)
     x->x_steady = 0;
     x->x_cursor = 1;
     x->x_showframe = 1;
+    x->x_setroi = 0;
+    pidip_roi_clear( &x->x_roi );
 
     x->x_canvas = canvas_getcurrent();
 
@@ -670,6 +692,7 @@ void pdp_ctrack_setup(void)
     class_addmethod(pdp_ctrack_class, (t_method)pdp_ctrack_steady, gensym("steady"), A_FLOAT, A_NULL);
     class_addmethod(pdp_ctrack_class, (t_method)pdp_ctrack_cursor, gensym("cursor"), A_FLOAT, A_NULL);
     class_addmethod(pdp_ctrack_class, (t_method)pdp_ctrack_frame, gensym("frame"), A_FLOAT, A_NULL);
+    class_addmethod(pdp_ctrack_class, (t_method)pdp_ctrack_setroi, gensym("roi"), A_FLOAT, A_NULL);
     class_addmethod(pdp_ctrack_class, (t_method)pdp_ctrack_setcur, gensym("setcur"), A_DEFFLOAT, A_DEFFLOAT, A_NULL);
 
 }
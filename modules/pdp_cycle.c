@@ -25,6 +25,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 #define NEWCOLOR(c,o) ((c+o)%230)
@@ -151,7 +152,7 @@ static void pdp_cycle_process(t_pdp_cycle *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_cycle_process_yv12, pdp_cycle_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_cycle_process_yv12, pdp_cycle_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -174,7 +175,7 @@ static void pdp_cycle_input_0(t_pdp_cycle *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -190,7 +191,7 @@ static void pdp_cycle_free(t_pdp_cycle *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -25,6 +25,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include <math.h>
 
 #define DEFAULT_CUBE_BITS   4
@@ -105,12 +107,12 @@ static void pdp_dice_cubebits(t_pdp_dice *x, t_floatarg fcubebits )
 
 static void pdp_dice_free_ressources(t_pdp_dice *x)
 {
-    if ( x->x_dicemap ) freebytes( x->x_dicemap, x->x_vsize );
+    if ( x->x_dicemap ) pidip_pool_put( x->x_dicemap );
 }
 
 static void pdp_dice_allocate(t_pdp_dice *x)
 {
-    x->x_dicemap = (char *) getbytes( x->x_vsize );
+    x->x_dicemap = (char *) pidip_pool_get( x->x_vsize );
 }
 
 static void pdp_dice_process_yv12(t_pdp_dice *x)
@@ -158,10 +160,13 @@ static void pdp_dice_process_yv12(t_pdp_dice *x)
                 for (dx = 0; dx < x->x_cube_size; dx++)
                 {
                   newdata[i] = data[i];
-                  newdata[x->x_vsize+iuv] = data[x->x_vsize+iuv];
-                  newdata[x->x_vsize+(x->x_vsize>>2)+iuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                  if ( dy%2==0 )
+                  {
+                     newdata[x->x_vsize+iuv] = data[x->x_vsize+iuv];
+                     newdata[x->x_vsize+(x->x_vsize>>2)+iuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                  }
                   i++;
-                  if ( (dx%2==0) && (dy%2==0) ) iuv++;
+                  if ( (dx%2==1) && (dy%2==0) ) iuv++;
                 }
             }
             break;
@@ -176,10 +181,13 @@ static void pdp_dice_process_yv12(t_pdp_dice *x)
                   di = base + (dx * x->x_vwidth) + (x->x_cube_size - dy - 1);
                   diuv = baseuv + ((dx>>1) * (x->x_vwidth>>1)) + ((x->x_cube_size - dy - 1)>>1);
                   newdata[di] = data[i];
-                  newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
-                  newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                  if ( dy%2==0 )
+                  {
+                     newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
+                     newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                  }
                   i++;
-                  if ( (dx%2==0) && (dy%2==0) ) iuv++;
+                  if ( (dx%2==1) && (dy%2==0) ) iuv++;
                 }
             }
             break;
@@ -196,10 +204,13 @@ static void pdp_dice_process_yv12(t_pdp_dice *x)
                 i--;
                 if ( dx%2==0) iuv--;
                 newdata[di] = data[i];
-                newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
-                newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                if ( dy%2==0 )
+                {
+                   newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
+                   newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                }
                 di++;
-                if ( (dx%2==0) && (dy%2==0) ) iuv++;
+                if ( (dx%2==1) && (dy%2==0) ) diuv++;
               }
             }
             break;
@@ -214,10 +225,13 @@ static void pdp_dice_process_yv12(t_pdp_dice *x)
                 di = base + dy + (x->x_cube_size - dx - 1) * x->x_vwidth;
                 diuv = baseuv + (dy>>1) + (((x->x_cube_size - dx - 1)>>1) * (x->x_vwidth>>1));
                 newdata[di] = data[i];
-                newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
-                newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                if ( dy%2==0 )
+                {
+                   newdata[x->x_vsize+diuv] = data[x->x_vsize+iuv];
+                   newdata[x->x_vsize+(x->x_vsize>>2)+diuv] = data[x->x_vsize+(x->x_vsize>>2)+iuv];
+                }
                 i++;
-                if ( (dx%2==0) && (dy%2==0) ) iuv++;
+                if ( (dx%2==1) && (dy%2==0) ) iuv++;
               }
             }
             break;
@@ -257,7 +271,7 @@ static void pdp_dice_process(t_pdp_dice *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_dice_process_yv12, pdp_dice_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_dice_process_yv12, pdp_dice_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -280,7 +294,7 @@ static void pdp_dice_input_0(t_pdp_dice *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -296,7 +310,7 @@ static void pdp_dice_free(t_pdp_dice *x)
   int i;
 
     pdp_dice_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -22,6 +22,9 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
+#include "pidip_plane.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
@@ -43,7 +46,7 @@ typedef struct pdp_dilate_struct
     int x_kernelw; // width of the (square) kernel
     int x_kernelh; // height of the square kernel
     int x_nbpasses; // number of passes
-    short int *x_frame;  // keep a copy of current frame for transformations
+    t_pidip_plane x_frame;  // copy of the luminance with an apron of half the kernel
 
     t_outlet *x_pdp_output; // output packets
 
@@ -73,20 +76,9 @@ static void pdp_dilate_kernelh(t_pdp_dilate *x,  t_floatarg fkernelh )
    }
 }
 
-static void pdp_dilate_allocate(t_pdp_dilate *x)
-{
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
-
-    if ( !x->x_frame )
-    {
-       post( "pdp_dilate : severe error : cannot allocate buffer !!! ");
-       return;
-    }
-}
-
 static void pdp_dilate_free_ressources(t_pdp_dilate *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    pidip_plane_free( &x->x_frame );
 }
 
 static void pdp_dilate_process_yv12(t_pdp_dilate *x)
@@ -97,19 +89,19 @@ static void pdp_dilate_process_yv12(t_pdp_dilate *x)
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int     i;
     int     px=0, py=0; 
-    short int *pfY, *pfU, *pfV;
-    int     ppx, ppy, ix, iy, pn, kx, ky;
+    short int *pfY;
+    int     ix, iy, pn, kx, ky;
 
     // allocate all ressources
-    if ( ( (int)header->info.image.width != x->x_vwidth ) ||
-         ( (int)header->info.image.height != x->x_vheight ) )
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+    kx = (x->x_kernelw/2);
+    ky = (x->x_kernelh/2);
+    if ( !pidip_plane_alloc( &x->x_frame, x->x_vwidth, x->x_vheight, (kx>ky)?kx:ky ) )
     {
-        pdp_dilate_free_ressources( x );
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        pdp_dilate_allocate( x );
-        post( "pdp_dilate : reallocated buffers" );
+        post( "pdp_dilate : severe error : cannot allocate buffer !!! ");
+        return;
     }
 
     // post( "pdp_dilate : newheader:%x", newheader );
@@ -118,42 +110,30 @@ static void pdp_dilate_process_yv12(t_pdp_dilate *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
-    memcpy( x->x_frame, data, x->x_vsize+(x->x_vsize>>1)<<1 );
+    pidip_inplace_copy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
 
     // dilate (supposedly) binary image by using a 3x3 square as a structuring element
-    pfY = x->x_frame;
-    pfV = x->x_frame+x->x_vsize;
-    pfU = x->x_frame+x->x_vsize+(x->x_vsize>>2);
-    kx = (x->x_kernelw/2);
-    ky = (x->x_kernelh/2);
+    // the apron replicates the border, so the kernel never leaves the plane
     for ( pn=0; pn<x->x_nbpasses; pn++ )
     {
-      memcpy( x->x_frame, newdata, x->x_vsize+(x->x_vsize>>1)<<1 );
+      pidip_plane_import( &x->x_frame, newdata, x->x_vwidth );
       for ( py=0; py<x->x_vheight; py++ )
       {
         for ( px=0; px<x->x_vwidth; px++ )
         {
-          if ( *(pfY+py*x->x_vwidth+px) == 0 )
+          if ( PIDIP_PLANE_AT( &x->x_frame, px, py ) == 0 )
           {
-            for (ix=-kx; ix<=kx; ix++)
+            for (iy=-ky; iy<=ky; iy++)
             {
-              ppx=px+ix;
-              if ( (ppx>=0) && (ppx<x->x_vwidth) )
+              pfY = PIDIP_PLANE_ROW( &x->x_frame, py+iy ) + px;
+              for (ix=-kx; ix<=kx; ix++)
+              {
+                if ( pfY[ix] == ((255)<<7) ) break;
+              }
+              if ( ix<=kx )
               {
-                for (iy=-ky; iy<=ky; iy++)
-                {
-                  ppy=py+iy;
-                  if ( (ppy>=0) && (ppy<x->x_vheight) )
-                  {
-                     if( *(pfY+ppy*x->x_vwidth+ppx) == ((255)<<7) )
-                     {
-                       *(newdata+py*x->x_vwidth+px) = ((255)<<7);
-                       break;
-                     }
-                  }
-                }
-                if ( *(newdata+py*x->x_vwidth+px) == ((255)<<7) ) break;
+                *(newdata+py*x->x_vwidth+px) = ((255)<<7);
+                break;
               }
             }
           }
@@ -188,8 +168,8 @@ static void pdp_dilate_process(t_pdp_dilate *x)
         {
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_dilate_process_yv12, pdp_dilate_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_dilate_process_yv12, pdp_dilate_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -212,7 +192,7 @@ static void pdp_dilate_input_0(t_pdp_dilate *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -225,6 +205,7 @@ static void pdp_dilate_free(t_pdp_dilate *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_dilate_free_ressources( x );
 }
@@ -247,7 +228,7 @@ void *pdp_dilate_new(void)
     x->x_vwidth = -1;
     x->x_vheight = -1;
     x->x_vsize = -1;
-    x->x_frame = NULL;
+    pidip_plane_init( &x->x_frame );
     x->x_kernelw = 3;
     x->x_kernelh = 3;
 
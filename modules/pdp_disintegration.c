@@ -22,6 +22,9 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
@@ -66,7 +69,7 @@ static void pdp_disintegration_reductor(t_pdp_disintegration *x,  t_floatarg fre
 
 static void pdp_disintegration_allocate(t_pdp_disintegration *x)
 {
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    x->x_frame = (short int *) pidip_pool_get ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
 
     if ( !x->x_frame )
     {
@@ -77,7 +80,7 @@ static void pdp_disintegration_allocate(t_pdp_disintegration *x)
 
 static void pdp_disintegration_free_ressources(t_pdp_disintegration *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    if ( x->x_frame ) pidip_pool_put ( x->x_frame );
 }
 
 static void pdp_disintegration_process_yv12(t_pdp_disintegration *x)
@@ -110,7 +113,7 @@ static void pdp_disintegration_process_yv12(t_pdp_disintegration *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
+    pidip_inplace_copy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
     memcpy( x->x_frame, data, x->x_vsize+(x->x_vsize>>1)<<1 );
 
     pfY = x->x_frame;
@@ -191,8 +194,8 @@ static void pdp_disintegration_process(t_pdp_disintegration *x)
         {
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_disintegration_process_yv12, pdp_disintegration_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_disintegration_process_yv12, pdp_disintegration_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -215,7 +218,7 @@ static void pdp_disintegration_input_0(t_pdp_disintegration *x, t_symbol *s, t_f
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -228,6 +231,7 @@ static void pdp_disintegration_free(t_pdp_disintegration *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_disintegration_free_ressources( x );
 }
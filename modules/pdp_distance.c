@@ -23,6 +23,9 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
+#include "pidip_plane.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
@@ -41,7 +44,7 @@ typedef struct pdp_distance_struct
     int x_vwidth;
     int x_vheight;
     int x_vsize;
-    short int *x_frame;  // keep a copy of current frame for transformations
+    t_pidip_plane x_frame;  // copy of the luminance, its apron is out of reach of the minimum
 
     int x_coeff1;
     int x_coeff2;
@@ -52,17 +55,6 @@ typedef struct pdp_distance_struct
 
 } t_pdp_distance;
 
-static void pdp_distance_allocate(t_pdp_distance *x)
-{
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
-
-    if ( !x->x_frame )
-    {
-       post( "pdp_distance : severe error : cannot allocate buffer !!! ");
-       return;
-    }
-}
-
 static void pdp_distance_coeff1(t_pdp_distance *x, t_floatarg fcoeff1 )
 {
    x->x_coeff1 = (int) fcoeff1;
@@ -85,7 +77,7 @@ static void pdp_distance_coeff4(t_pdp_distance *x, t_floatarg fcoeff4 )
 
 static void pdp_distance_free_ressources(t_pdp_distance *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    pidip_plane_free( &x->x_frame );
 }
 
 static void pdp_distance_process_yv12(t_pdp_distance *x)
@@ -96,18 +88,22 @@ static void pdp_distance_process_yv12(t_pdp_distance *x)
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int     i;
     int     px=0, py=0; 
-    short int *pfY, *pfU, *pfV;
-    int     nvalues, values[5], ival, mval;
+    short int *pfY, *pfP;
+    int     mval, value;
 
     // allocate all ressources
     if ( ( (int)header->info.image.width != x->x_vwidth ) ||
          ( (int)header->info.image.height != x->x_vheight ) )
     {
-        pdp_distance_free_ressources( x );
         x->x_vwidth = header->info.image.width;
         x->x_vheight = header->info.image.height;
         x->x_vsize = x->x_vwidth*x->x_vheight;
-        pdp_distance_allocate( x );
+        if ( !pidip_plane_alloc( &x->x_frame, x->x_vwidth, x->x_vheight, 1 ) )
+        {
+           post( "pdp_distance : severe error : cannot allocate buffer !!! ");
+           x->x_vwidth = -1;
+           return;
+        }
         post( "pdp_distance : reallocated buffers" );
     }
 
@@ -117,102 +113,56 @@ static void pdp_distance_process_yv12(t_pdp_distance *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
-    memcpy( x->x_frame, data, x->x_vsize+(x->x_vsize>>1)<<1 );
+    // the chrominance goes through, only the luminance is transformed
+    pidip_inplace_copy( newdata, data, ( x->x_vsize+(x->x_vsize>>1) )<<1 );
 
-    pfY = x->x_frame;
-    pfV = x->x_frame+x->x_vsize;
-    pfU = x->x_frame+x->x_vsize+(x->x_vsize>>2);
-    
     // thresholding
     for ( py=0; py<x->x_vheight; py++ )
     {
+      pfY = PIDIP_PLANE_ROW( &x->x_frame, py );
+      pfP = data+py*x->x_vwidth;
       for ( px=0; px<x->x_vwidth; px++ )
       {
-         if ( *(pfY+py*x->x_vwidth+px) > ((128)<<7) )
-         {
-            *(pfY+py*x->x_vwidth+px) = ((128)<<7);
-         }
+         pfY[px] = ( pfP[px] > ((128)<<7) ) ? ((128)<<7) : pfP[px];
       }
     }
 
+    // the neighbours out of the frame never give the minimum
+    pidip_plane_border( &x->x_frame, 0x7fff );
+
     // forward pass
     for ( py=0; py<x->x_vheight; py++ )
     {
+      pfY = PIDIP_PLANE_ROW( &x->x_frame, py );
+      pfP = PIDIP_PLANE_ROW( &x->x_frame, py-1 );
       for ( px=0; px<x->x_vwidth; px++ )
       {
-        nvalues = 0;
-        if ( ((px-1)>=0) && ((py-1)>=0) )
-        {
-           values[nvalues] = *(pfY+(py-1)*x->x_vwidth+(px-1)) + (x->x_coeff1<<7);
-           nvalues++;
-        }
-        if ( (py-1)>=0 )
-        {
-           values[nvalues] = *(pfY+(py-1)*x->x_vwidth+px) + (x->x_coeff2<<7);
-           nvalues++;
-        }
-        if ( ((px+1)<x->x_vwidth) && ((py-1)>=0) )
-        {
-           values[nvalues] = *(pfY+(py-1)*x->x_vwidth+(px+1)) + (x->x_coeff3<<7);
-           nvalues++;
-        }
-        if ( (px-1)>=0 )
-        {
-           values[nvalues] = *(pfY+py*x->x_vwidth+(px-1)) + (x->x_coeff4<<7);
-           nvalues++;
-        }
-        values[nvalues] = *(pfY+py*x->x_vwidth+px);
-        nvalues++;
-
-        mval = values[0];
-        for (ival=0; ival<nvalues; ival++)
-        {
-           if (values[ival]<mval) mval=values[ival];
-        }
-        *(x->x_frame+py*x->x_vwidth+px)=mval;
+        mval = pfY[px];
+        if ( (value = pfP[px-1] + (x->x_coeff1<<7)) < mval ) mval = value;
+        if ( (value = pfP[px] + (x->x_coeff2<<7)) < mval ) mval = value;
+        if ( (value = pfP[px+1] + (x->x_coeff3<<7)) < mval ) mval = value;
+        if ( (value = pfY[px-1] + (x->x_coeff4<<7)) < mval ) mval = value;
+        pfY[px] = mval;
       }
     }
 
     // backward pass
     for ( py=x->x_vheight-1; py>=0; py-- )
     {
+      pfY = PIDIP_PLANE_ROW( &x->x_frame, py );
+      pfP = PIDIP_PLANE_ROW( &x->x_frame, py+1 );
       for ( px=x->x_vwidth-1; px>=0; px-- )
       {
-        nvalues = 0;
-        if ( ((px-1)>=0) && ((py+1)<x->x_vheight) )
-        {
-           values[nvalues] = *(pfY+(py+1)*x->x_vwidth+(px-1)) + (x->x_coeff1<<7);
-           nvalues++;
-        }
-        if ( (py+1)<x->x_vheight )
-        {
-           values[nvalues] = *(pfY+(py+1)*x->x_vwidth+px) + (x->x_coeff2<<7);
-           nvalues++;
-        }
-        if ( ((px+1)<x->x_vwidth) && ((py+1)<x->x_vheight) )
-        {
-           values[nvalues] = *(pfY+(py+1)*x->x_vwidth+(px+1)) + (x->x_coeff3<<7);
-           nvalues++;
-        }
-        if ( (px+1)<x->x_vwidth )
-        {
-           values[nvalues] = *(pfY+py*x->x_vwidth+(px+1)) + (x->x_coeff4<<7);
-           nvalues++;
-        }
-        values[nvalues] = *(pfY+py*x->x_vwidth+px);
-        nvalues++;
-
-        mval = values[0];
-        for (ival=0; ival<nvalues; ival++)
-        {
-           if (values[ival]<mval) mval=values[ival];
-        }
-        *(x->x_frame+py*x->x_vwidth+px)=mval;
+        mval = pfY[px];
+        if ( (value = pfP[px-1] + (x->x_coeff1<<7)) < mval ) mval = value;
+        if ( (value = pfP[px] + (x->x_coeff2<<7)) < mval ) mval = value;
+        if ( (value = pfP[px+1] + (x->x_coeff3<<7)) < mval ) mval = value;
+        if ( (value = pfY[px+1] + (x->x_coeff4<<7)) < mval ) mval = value;
+        pfY[px] = mval;
       }
     }
 
-    memcpy( newdata, x->x_frame, x->x_vsize+(x->x_vsize>>1)<<1 );
+    pidip_plane_export( &x->x_frame, newdata, x->x_vwidth );
 
     return;
 }
@@ -241,8 +191,8 @@ static void pdp_distance_process(t_pdp_distance *x)
         {
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_distance_process_yv12, pdp_distance_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_distance_process_yv12, pdp_distance_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -265,7 +215,7 @@ static void pdp_distance_input_0(t_pdp_distance *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -278,6 +228,7 @@ static void pdp_distance_free(t_pdp_distance *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_distance_free_ressources( x );
 }
@@ -301,7 +252,7 @@ void *pdp_distance_new(void)
     x->x_vwidth = -1;
     x->x_vheight = -1;
     x->x_vsize = -1;
-    x->x_frame = NULL;
+    pidip_plane_init( &x->x_frame );
 
     x->x_coeff1 = 4;
     x->x_coeff2 = 3;
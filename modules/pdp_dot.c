@@ -19,13 +19,23 @@
  */
 
 /*  This object is a dot matrix filter
+ *  the frame is cut in nbx x nby cells and each cell is stamped with an
+ *  anti-aliased dot of its mean color. the dots are computed once per size
+ *  of the cells, in NB_LEVELS sizes, so that in halftone mode, white dots
+ *  have an area following the luminosity of their cell.
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
 
+#define NB_LEVELS 32     // sizes of the dots in halftone mode
+#define DOT_ONE 256      // weight of a pixel fully in a dot
+
 static char   *pdp_dot_version = "pdp_dot: dot matrix filter version 0.1 written by Yves Degoyon (ydegoyon@free.fr)";
 
 typedef struct pdp_dot_struct
@@ -43,66 +53,61 @@ typedef struct pdp_dot_struct
 
     int x_nbx;
     int x_nby;
-    char *x_mask;  // pre-calculated mask
+    int x_halftone;
+    int x_dirty;            // the dots have to be computed again
+
+    int x_dotsizex;
+    int x_dotsizey;
+    unsigned short *x_dots; // weights of the dots, NB_LEVELS sizes
+    double *x_sums;         // sums of Y, U and V of a row of cells
 
     t_outlet *x_pdp_output; // output packets
 
 } t_pdp_dot;
 
-static void pdp_dot_update_mask(t_pdp_dot *x)
+static void pdp_dot_update_dots(t_pdp_dot *x)
 {
   int   dotsizeX, dotsizeY;
-  int   ray;
-  int   curX=0, curY=0;
-  char  *pfY;
+  int   ray, level;
   int   px, py;
+  double radius, weight;
+  unsigned short *pdot;
 
+    x->x_dirty = 0;
     dotsizeX = (int) ( x->x_vwidth / x->x_nbx );
     dotsizeY = (int) ( x->x_vheight / x->x_nby );
+    if ( dotsizeX < 1 ) dotsizeX = 1;
+    if ( dotsizeY < 1 ) dotsizeY = 1;
     ray = (dotsizeX>dotsizeY) ? (dotsizeY/2):(dotsizeX/2); 
 
-    // post( "dotsizeX=%d dotsizeY=%d", dotsizeX, dotsizeY );
-
-    pfY = x->x_mask;
-    curY=0;
-
-    while ( curY <= ( x->x_vheight - dotsizeY ) )
-    {
-      curX=0;
-      while ( curX <= ( x->x_vwidth - dotsizeX ) )
-      {
-         for(py=0; py<dotsizeY; py++)
-         {
-           for(px=0; px<dotsizeX; px++)
-           {
-              if ( sqrt( pow( (px-(dotsizeX/2)), 2 ) + pow( (py-(dotsizeY/2)), 2 ) ) < ray )
-              {
-                 *(pfY+(curY+py)*x->x_vwidth+(curX+px))=1;
-              }
-              else
-              {
-                 *(pfY+(curY+py)*x->x_vwidth+(curX+px))=0;
-              }
-           }
-         }
-         curX += dotsizeX;
-         // post ( "curX=%d", curX );
-      }
-      curY += dotsizeY;
-      // post ( "curY=%d", curY );
-    }
-}
-
-static void pdp_dot_allocate(t_pdp_dot *x)
-{
-    x->x_mask = (char *) getbytes ( x->x_vsize*sizeof(char*) );
-
-    if ( !x->x_mask )
+    x->x_dots = (unsigned short *) pidip_pool_resize( x->x_dots, NB_LEVELS*dotsizeX*dotsizeY*sizeof(unsigned short) );
+    x->x_sums = (double *) pidip_pool_resize( x->x_sums, 3*(x->x_vwidth/dotsizeX)*sizeof(double) );
+    if ( !x->x_dots || !x->x_sums )
     {
        post( "pdp_dot : severe error : cannot allocate buffer !!! ");
+       x->x_dotsizex = x->x_dotsizey = 0;
        return;
     }
+    x->x_dotsizex = dotsizeX;
+    x->x_dotsizey = dotsizeY;
 
+    // the radius grows as the square root of the level, the area as the level,
+    // pixels on the border of a dot are weighted by the part they cover
+    pdot = x->x_dots;
+    for(level=0; level<NB_LEVELS; level++)
+    {
+      radius = ray*sqrt( (double)level/(NB_LEVELS-1) );
+      for(py=0; py<dotsizeY; py++)
+      {
+        for(px=0; px<dotsizeX; px++)
+        {
+           weight = radius + 0.5 - sqrt( (double)( (px-(dotsizeX/2))*(px-(dotsizeX/2)) + (py-(dotsizeY/2))*(py-(dotsizeY/2)) ) );
+           if ( ( weight < 0 ) || ( level == 0 ) ) weight = 0;
+           if ( weight > 1 ) weight = 1;
+           *(pdot++) = weight*DOT_ONE;
+        }
+      }
+    }
 }
 
 static void pdp_dot_nbx(t_pdp_dot *x, t_floatarg fnbx )
@@ -110,7 +115,7 @@ static void pdp_dot_nbx(t_pdp_dot *x, t_floatarg fnbx )
    if ( ( (int)fnbx > 5 ) && ( (int)fnbx <= x->x_vwidth ) )
    {
       x->x_nbx = (int) fnbx;
-      pdp_dot_update_mask( x );
+      x->x_dirty = 1;
    }
 }
 
@@ -119,13 +124,24 @@ static void pdp_dot_nby(t_pdp_dot *x, t_floatarg fnby )
    if ( ( (int)fnby > 5 ) && ( (int)fnby <= x->x_vheight ) )
    {
       x->x_nby = (int) fnby;
-      pdp_dot_update_mask( x );
+      x->x_dirty = 1;
+   }
+}
+
+static void pdp_dot_halftone(t_pdp_dot *x, t_floatarg fhalftone )
+{
+   if ( ( fhalftone == 0 ) || ( fhalftone == 1 ) )
+   {
+      x->x_halftone = (int) fhalftone;
    }
 }
 
 static void pdp_dot_free_ressources(t_pdp_dot *x)
 {
-   if ( x->x_mask ) freebytes ( x->x_mask, x->x_vsize*sizeof(char*) );
+   pidip_pool_put ( x->x_dots );
+   pidip_pool_put ( x->x_sums );
+   x->x_dots = NULL;
+   x->x_sums = NULL;
 }
 
 static void pdp_dot_process_yv12(t_pdp_dot *x)
@@ -134,104 +150,127 @@ static void pdp_dot_process_yv12(t_pdp_dot *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int     i;
-    int     px=0, py=0; 
-    short int *pfY, *pfU, *pfV;
-    char    *pmY;
-    double   meanY, meanU, meanV;
-    int   dotsizeX, dotsizeY;
-    int   nbpixs, curX=0, curY=0;
+    int     px=0, py=0, cx, cy, level;
+    short int *pfY, *pfU, *pfV, *pY, *pU, *pV;
+    unsigned short *pdot;
+    double  *psum;
+    int     meanY, meanU, meanV, dotY;
+    int     dotsizeX, dotsizeY, nbcellsX, nbcellsY;
+    int     nbpixs, curX=0, curY=0, cwidth;
 
     // allocate all ressources
     if ( ( (int)header->info.image.width != x->x_vwidth ) ||
          ( (int)header->info.image.height != x->x_vheight ) )
     {
-        pdp_dot_free_ressources( x );
         x->x_vwidth = header->info.image.width;
         x->x_vheight = header->info.image.height;
         x->x_vsize = x->x_vwidth*x->x_vheight;
-        pdp_dot_allocate( x );
-        pdp_dot_update_mask( x );
+        x->x_dirty = 1;
         post( "pdp_dot : reallocated buffers" );
     }
+    if ( x->x_dirty ) pdp_dot_update_dots( x );
 
-    memcpy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
+    pidip_inplace_copy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
 
-    dotsizeX = (int) ( x->x_vwidth / x->x_nbx );
-    dotsizeY = (int) ( x->x_vheight / x->x_nby );
+    newheader->info.image.encoding = header->info.image.encoding;
+    newheader->info.image.width = x->x_vwidth;
+    newheader->info.image.height = x->x_vheight;
+
+    if ( !x->x_dotsizex ) return;
+
+    dotsizeX = x->x_dotsizex;
+    dotsizeY = x->x_dotsizey;
+    nbcellsX = x->x_vwidth/dotsizeX;
+    nbcellsY = x->x_vheight/dotsizeY;
+    nbpixs = dotsizeX*dotsizeY;
+    cwidth = x->x_vwidth>>1;
 
     // post( "dotsizeX=%d dotsizeY=%d", dotsizeX, dotsizeY );
 
-    pmY = x->x_mask;
     pfY = newdata;
     pfV = newdata+x->x_vsize;
     pfU = newdata+x->x_vsize+(x->x_vsize>>2);
-    nbpixs=0;
-    curY=0;
 
-    while ( curY <= ( x->x_vheight - dotsizeY ) )
+    for(cy=0; cy<nbcellsY; cy++)
     {
-      curX=0;
-      while ( curX <= ( x->x_vwidth - dotsizeX ) )
+      curY = cy*dotsizeY;
+
+      // sums of the cells of the row, one line after the other
+      memset( x->x_sums, 0x0, 3*nbcellsX*sizeof(double) );
+      for(py=curY; py<curY+dotsizeY; py++)
       {
-         meanY=0;
-         meanU=0;
-         meanV=0;
-         nbpixs=0;
-         for(py=0; py<dotsizeY; py++)
-         {
-           for(px=0; px<dotsizeX; px++)
+        pY = pfY+py*x->x_vwidth;
+        pU = pfU+(py>>1)*cwidth;
+        pV = pfV+(py>>1)*cwidth;
+        psum = x->x_sums;
+        for(px=0, cx=0; cx<nbcellsX; cx++, psum+=3)
+        {
+           for(curX=px+dotsizeX; px<curX; px++)
            {
-              meanY += (double)*(pfY+(curY+py)*x->x_vwidth+(curX+px));
-              meanU += (double)*(pfU+((curY+py)>>1)*(x->x_vwidth>>1)+((curX+px)>>1));
-              meanV += (double)*(pfV+((curY+py)>>1)*(x->x_vwidth>>1)+((curX+px)>>1));
-              nbpixs++;
+              psum[0] += pY[px];
+              psum[1] += pU[px>>1];
+              psum[2] += pV[px>>1];
            }
+        }
+      }
+
+      // stamp the dots
+      psum = x->x_sums;
+      for(cx=0; cx<nbcellsX; cx++, psum+=3)
+      {
+         curX = cx*dotsizeX;
+         meanY = psum[0]/nbpixs;
+         meanU = psum[1]/nbpixs;
+         meanV = psum[2]/nbpixs;
+         if ( x->x_halftone )
+         {
+            level = (meanY*(NB_LEVELS-1))/(255<<7);
+            if ( level < 0 ) level = 0;
+            if ( level > NB_LEVELS-1 ) level = NB_LEVELS-1;
+            dotY = 255<<7;
+         }
+         else
+         {
+            level = NB_LEVELS-1;
+            dotY = meanY;
          }
+         pdot = x->x_dots+level*nbpixs;
+
          for(py=0; py<dotsizeY; py++)
          {
+           pY = pfY+(curY+py)*x->x_vwidth+curX;
            for(px=0; px<dotsizeX; px++)
            {
-              *(pfY+(curY+py)*x->x_vwidth+(curX+px))=(meanY/nbpixs)*(*(pmY+(curY+py)*x->x_vwidth+(curX+px)));
-              *(pfU+((curY+py)>>1)*(x->x_vwidth>>1)+((curX+px)>>1))=(meanU/nbpixs)*(*(pmY+(curY+py)*x->x_vwidth+(curX+px)));
-              *(pfV+((curY+py)>>1)*(x->x_vwidth>>1)+((curX+px)>>1))=(meanV/nbpixs)*(*(pmY+(curY+py)*x->x_vwidth+(curX+px)));
+              pY[px] = (dotY*pdot[py*dotsizeX+px])>>8;
            }
          }
-         curX += dotsizeX;
-         // post ( "curX=%d", curX );
-      }
-      if ( curX < x->x_vwidth )
-      {
-        curX -= dotsizeX;
-        for(py=0; py<dotsizeY; py++)
-        {
-           for(px=curX; px<x->x_vwidth; px++)
+         // one chroma sample for each pixel with odd coordinates
+         for(py=((curY&1)^1); py<dotsizeY; py+=2)
+         {
+           pU = pfU+((curY+py)>>1)*cwidth;
+           pV = pfV+((curY+py)>>1)*cwidth;
+           for(px=((curX&1)^1); px<dotsizeX; px+=2)
            {
-              if ( (curY+py) < x->x_vheight )
-              {
-                *(pfY+(curY+py)*x->x_vwidth+(px))=0;
-              }
+              pU[(curX+px)>>1] = (meanU*pdot[py*dotsizeX+px])>>8;
+              pV[(curX+px)>>1] = (meanV*pdot[py*dotsizeX+px])>>8;
            }
-        }
+         }
       }
-      curY += dotsizeY;
-      // post ( "curY=%d", curY );
-    }
-    if ( curY < x->x_vheight )
-    {
-      curY -= dotsizeY;
-      for(py=curY; py<x->x_vheight; py++)
+
+      // right of the last cell
+      for(py=curY; py<curY+dotsizeY; py++)
       {
-         for(px=0; px<x->x_vwidth; px++)
+         for(px=nbcellsX*dotsizeX; px<x->x_vwidth; px++)
          {
-            *(pfY+(py)*x->x_vwidth+(px))=0;
+            *(pfY+py*x->x_vwidth+px)=0;
          }
       }
     }
-
-    newheader->info.image.encoding = header->info.image.encoding;
-    newheader->info.image.width = x->x_vwidth;
-    newheader->info.image.height = x->x_vheight;
+    // below the last row of cells
+    for(py=nbcellsY*dotsizeY; py<x->x_vheight; py++)
+    {
+       memset( pfY+py*x->x_vwidth, 0x0, x->x_vwidth*sizeof(short int) );
+    }
 
     return;
 }
@@ -260,8 +299,8 @@ static void pdp_dot_process(t_pdp_dot *x)
         {
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_dot_process_yv12, pdp_dot_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_dot_process_yv12, pdp_dot_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -284,7 +323,7 @@ static void pdp_dot_input_0(t_pdp_dot *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -297,6 +336,7 @@ static void pdp_dot_free(t_pdp_dot *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_dot_free_ressources( x );
 }
@@ -321,6 +361,12 @@ void *pdp_dot_new(void)
 
     x->x_nbx = 100;
     x->x_nby = 100;
+    x->x_halftone = 0;
+    x->x_dirty = 1;
+    x->x_dotsizex = 0;
+    x->x_dotsizey = 0;
+    x->x_dots = NULL;
+    x->x_sums = NULL;
 
     return (void *)x;
 }
@@ -341,6 +387,7 @@ void pdp_dot_setup(void)
     class_addmethod(pdp_dot_class, (t_method)pdp_dot_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_dot_class, (t_method)pdp_dot_nbx, gensym("nbx"),  A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_dot_class, (t_method)pdp_dot_nby, gensym("nby"),  A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_dot_class, (t_method)pdp_dot_halftone, gensym("halftone"),  A_DEFFLOAT, A_NULL);
 }
 
 #ifdef __cplusplus
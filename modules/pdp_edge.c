@@ -26,6 +26,9 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
+#include "pidip_plane.h"
 #include <math.h>
 
 static char   *pdp_edge_version = "pdp_edge: version 0.1, port of edge from effectv( Fukuchi Kentaro ) adapted by Yves Degoyon (ydegoyon@free.fr)";
@@ -46,20 +49,34 @@ typedef struct pdp_edge_struct
     int x_vsize;
     int x_mapw;
     int x_maph;
-    int x_video_width_margin;
-    int *x_map;
+    int *x_map;         // differences of each 4x4 block, with a row and a column of zeros before
+    t_pidip_plane x_y;  // copies of the planes with an apron of one block
+    t_pidip_plane x_u;
+    t_pidip_plane x_v;
 
 } t_pdp_edge;
 
+#define MAPSIZE(x) ( ( (x)->x_mapw + 1 ) * ( (x)->x_maph + 1 ) * 2 * sizeof(int) )
+
+/* saturated addition of the differences of two blocks */
+#define EDGE_ADD(a, b) ( ( ((a)+(b)) | ( (((a)+(b))&0x01010100) - ((((a)+(b))&0x01010100)>>8) ) ) << 8 )
+
 static void pdp_edge_allocate(t_pdp_edge *x)
 {
-  x->x_map = (int*) getbytes ( ( x->x_vwidth * x->x_vheight * sizeof (int) ) << 1 );
-  bzero(x->x_map, ( x->x_vwidth * x->x_vheight * sizeof (int) ) << 1 );
+  x->x_map = (int*) getbytes ( MAPSIZE(x) );
+  if ( x->x_map ) bzero(x->x_map, MAPSIZE(x) );
+  pidip_plane_alloc( &x->x_y, x->x_vwidth, x->x_vheight, 4 );
+  pidip_plane_alloc( &x->x_u, x->x_vwidth>>1, x->x_vheight>>1, 2 );
+  pidip_plane_alloc( &x->x_v, x->x_vwidth>>1, x->x_vheight>>1, 2 );
 }
 
 static void pdp_edge_free_ressources(t_pdp_edge *x)
 {
-  if ( x->x_map ) freebytes ( x->x_map, ( x->x_vwidth * x->x_vheight * sizeof (int) ) << 1 );
+  if ( x->x_map ) freebytes ( x->x_map, MAPSIZE(x) );
+  x->x_map = NULL;
+  pidip_plane_free( &x->x_y );
+  pidip_plane_free( &x->x_u );
+  pidip_plane_free( &x->x_v );
 }
 
 static void pdp_edge_process_yv12(t_pdp_edge *x)
@@ -70,13 +87,14 @@ static void pdp_edge_process_yv12(t_pdp_edge *x)
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int       i;
 
-    int px, py;
-    int y, u, v;
-    int y0, u0, v0;
-    int y1, u1, v1;
+    int bx, by, px, py, cx, cy;
+    int ystride, cstride;
+    int y0, y1;
     int y2, u2, v2;
     int y3, u3, v3;
-    short int *pdata, *pnewdata;
+    int *pmap;
+    short int *pY, *pU, *pV;
+    short int *pnY, *pnU, *pnV;
 
     /* allocate all ressources */
     if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
@@ -87,7 +105,6 @@ static void pdp_edge_process_yv12(t_pdp_edge *x)
        x->x_vsize = x->x_vwidth*x->x_vheight;
        x->x_mapw = x->x_vwidth >> 2;
        x->x_maph = x->x_vheight >> 2;
-       x->x_video_width_margin = x->x_vwidth - ( x->x_mapw << 2 );
        pdp_edge_allocate(x);
     }
 
@@ -95,18 +112,38 @@ static void pdp_edge_process_yv12(t_pdp_edge *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    pdata = data + x->x_vwidth*4+4;
-    pnewdata = newdata + x->x_vwidth*4+4;
-    for(py=1; py<x->x_vheight-4; py+=4) 
+    if ( !x->x_map || !x->x_y.p_data || !x->x_u.p_data || !x->x_v.p_data ) return;
+
+    /* the planes are read from copies with replicated borders, so the
+       blocks of the first row and column have no difference with their
+       neighbours out of the frame */
+    pidip_plane_import( &x->x_y, PIDIP_YV12_Y(data, x->x_vwidth, x->x_vheight), x->x_vwidth );
+    pidip_plane_import( &x->x_v, PIDIP_YV12_V(data, x->x_vwidth, x->x_vheight), x->x_vwidth>>1 );
+    pidip_plane_import( &x->x_u, PIDIP_YV12_U(data, x->x_vwidth, x->x_vheight), x->x_vwidth>>1 );
+    pidip_inplace_copy( newdata, data, ( x->x_vsize + (x->x_vsize>>1) ) << 1 );
+
+    ystride = x->x_y.p_stride;
+    cstride = x->x_u.p_stride;
+    for(by=0; by<x->x_maph; by++) 
     {
-       for(px=1; px<x->x_vwidth-4; px+=4) 
+       py = by<<2;
+       cy = by<<1;
+       pmap = x->x_map + ( (by+1)*(x->x_mapw+1) + 1 )*2;
+       pnY = PIDIP_YV12_Y(newdata, x->x_vwidth, x->x_vheight) + py*x->x_vwidth;
+       pnV = PIDIP_YV12_V(newdata, x->x_vwidth, x->x_vheight) + cy*(x->x_vwidth>>1);
+       pnU = PIDIP_YV12_U(newdata, x->x_vwidth, x->x_vheight) + cy*(x->x_vwidth>>1);
+       for(bx=0; bx<x->x_mapw; bx++, pmap+=2) 
        {
-          /* difference between the current pixel and right neighbor. */
-          y2 = (*(pdata+(py*x->x_vwidth+px))>>8) - (*(pdata+(py*x->x_vwidth+px)-4)>>8);
-          u2 = (*(pdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1))>>8) - 
-              (*(pdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1)-2)>>8);
-          v2 = (*(pdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1))>>8) - 
-              (*(pdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1)-2)>>8);
+          px = bx<<2;
+          cx = bx<<1;
+          pY = PIDIP_PLANE_ROW( &x->x_y, py ) + px;
+          pU = PIDIP_PLANE_ROW( &x->x_u, cy ) + cx;
+          pV = PIDIP_PLANE_ROW( &x->x_v, cy ) + cx;
+
+          /* difference between the current pixel and left neighbor. */
+          y2 = (pY[0]>>8) - (pY[-4]>>8);
+          u2 = (pU[0]>>8) - (pU[-2]>>8);
+          v2 = (pV[0]>>8) - (pV[-2]>>8);
           y2 *= y2;
           u2 *= u2;
           v2 *= v2;
@@ -118,11 +155,9 @@ static void pdp_edge_process_yv12(t_pdp_edge *x)
           if(v2>255) v2 = 255;
 
           /* difference between the current pixel and upper neighbor. */
-          y3 = (*(pdata+(py*x->x_vwidth+px))>>8) - (*(pdata+(py*x->x_vwidth+px)-4*x->x_vwidth)>>8);
-          u3 = (*(pdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1))>>8) - 
-              (*(pdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1)-2*x->x_vwidth)>>8);
-          v3 = (*(pdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1))>>8) - 
-              (*(pdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1)-2*x->x_vwidth)>>8);
+          y3 = (pY[0]>>8) - (pY[-4*ystride]>>8);
+          u3 = (pU[0]>>8) - (pU[-2*cstride]>>8);
+          v3 = (pV[0]>>8) - (pV[-2*cstride]>>8);
           y3 *= y3;
           u3 *= u3;
           v3 *= v3;
@@ -133,65 +168,33 @@ static void pdp_edge_process_yv12(t_pdp_edge *x)
           if(u3>127) u3 = 127;
           if(v3>255) v3 = 255;
 
-          y0 = (x->x_map[(py-1)*x->x_vwidth*2+px*2]>>17);
-          u0 = (x->x_map[(py-1)*x->x_vwidth*2+px*2]>>9)&0xff;
-          v0 = x->x_map[(py-1)*x->x_vwidth*2+px*2]&0xff;
-          y1 = (x->x_map[py*x->x_vwidth*2+(px-1)*2+1]>>17);
-          u1 = (x->x_map[py*x->x_vwidth*2+(px-1)*2+1]>>9)&0xff;
-          v1 = x->x_map[py*x->x_vwidth*2+(px-1)*2+1]&0xff;
-          x->x_map[py*x->x_vwidth*2+px*2] = (y2<<17)|(u2<<9)|v2;
-          x->x_map[py*x->x_vwidth*2+px*2+1] = (y3<<17)|(u3<<9)|v3; 
-          y = y0 + y1;
-          u = y & 0x01010100;
-          *(pnewdata+(py*x->x_vwidth+px)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1)) = (y | (u - (u>>8)))<<8;
-          y = y0 + y3;
-          u = y & 0x01010100;
-          *(pnewdata+(py*x->x_vwidth+px)+1) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(py*x->x_vwidth>>2)+(px>>1+1)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+(px>>1+1)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+(py*x->x_vwidth+px)+2) = y3<<8;
-          *(pnewdata+x->x_vsize+(py*x->x_vwidth>>2)+((px+2)>>1)) = u3<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+((px+2)>>1)) = v3<<8;
-          *(pnewdata+(py*x->x_vwidth+px)+3) = y3<<8;
-          *(pnewdata+x->x_vsize+(py*x->x_vwidth>>2)+((px+3)>>1)) = u3<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+(py*x->x_vwidth>>2)+((px+3)>>1)) = v3<<8;
-          y = y2 + y1;
-          u = y & 0x01010100;
-          *(pnewdata+(py*x->x_vwidth+px)+x->x_vwidth) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+((py+1)*x->x_vwidth>>2)+(px>>1)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+1)*x->x_vwidth>>2)+(px>>1)) = (y | (u - (u>>8)))<<8;
-          y = y2 + y3;
-          u = y & 0x01010100;
-
-          *(pnewdata+(py*x->x_vwidth+px)+x->x_vwidth+1) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+((py+1)*x->x_vwidth>>2)+((px+1)>>1)) = (y | (u - (u>>8)))<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+1)*x->x_vwidth>>2)+((px+1)>>1)) = (y | (u - (u>>8)))<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+x->x_vwidth+2) = y3<<8;
-          *(pnewdata+x->x_vsize+((py+1)*x->x_vwidth>>2)+((px+2)>>1)) = u3<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+1)*x->x_vwidth>>2)+((px+2)>>1)) = v3<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+x->x_vwidth+3) = y3<<8;
-          *(pnewdata+x->x_vsize+((py+1)*x->x_vwidth>>2)+((px+3)>>1)) = u3<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+1)*x->x_vwidth>>2)+((px+3)>>1)) = v3<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+2*x->x_vwidth) = y2<<8;
-          *(pnewdata+x->x_vsize+((py+2)*x->x_vwidth>>2)+((px)>>1)) = u2<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+2)*x->x_vwidth>>2)+((px)>>1)) = v2<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+2*x->x_vwidth+1) = y2<<8;
-          *(pnewdata+x->x_vsize+((py+2)*x->x_vwidth>>2)+((px+1)>>1)) = u2<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+2)*x->x_vwidth>>2)+((px+1)>>1)) = v2<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+3*x->x_vwidth) = y2<<8;
-          *(pnewdata+x->x_vsize+((py+3)*x->x_vwidth>>2)+((px)>>1)) = u2<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+3)*x->x_vwidth>>2)+((px)>>1)) = v2<<8;
-
-          *(pnewdata+(py*x->x_vwidth+px)+3*x->x_vwidth+1) = y2<<8;
-          *(pnewdata+x->x_vsize+((py+3)*x->x_vwidth>>2)+((px+1)>>1)) = u2<<8;
-          *(pnewdata+x->x_vsize+(x->x_vsize>>2)+((py+3)*x->x_vwidth>>2)+((px+1)>>1)) = v2<<8;
+          /* differences kept by the upper and the left blocks */
+          y0 = pmap[-(x->x_mapw+1)*2]>>17;
+          y1 = pmap[-2+1]>>17;
+          pmap[0] = (y2<<17)|(u2<<9)|v2;
+          pmap[1] = (y3<<17)|(u3<<9)|v3; 
+
+          pnY[px] = EDGE_ADD(y0, y1);
+          pnY[px+1] = EDGE_ADD(y0, y3);
+          pnY[px+2] = y3<<8;
+          pnY[px+3] = y3<<8;
+          pnY[px+x->x_vwidth] = EDGE_ADD(y2, y1);
+          pnY[px+x->x_vwidth+1] = EDGE_ADD(y2, y3);
+          pnY[px+x->x_vwidth+2] = y3<<8;
+          pnY[px+x->x_vwidth+3] = y3<<8;
+          pnY[px+2*x->x_vwidth] = y2<<8;
+          pnY[px+2*x->x_vwidth+1] = y2<<8;
+          pnY[px+3*x->x_vwidth] = y2<<8;
+          pnY[px+3*x->x_vwidth+1] = y2<<8;
+
+          pnU[cx] = EDGE_ADD(y0, y1);
+          pnV[cx] = EDGE_ADD(y0, y1);
+          pnU[cx+1] = u3<<8;
+          pnV[cx+1] = v3<<8;
+          pnU[cx+(x->x_vwidth>>1)] = u2<<8;
+          pnV[cx+(x->x_vwidth>>1)] = v2<<8;
+          pnU[cx+(x->x_vwidth>>1)+1] = EDGE_ADD(y2, y3);
+          pnV[cx+(x->x_vwidth>>1)+1] = EDGE_ADD(y2, y3);
        }
     }
 
@@ -221,8 +224,8 @@ static void pdp_edge_process(t_pdp_edge *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_edge_process_yv12, pdp_edge_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_edge_process_yv12, pdp_edge_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -242,7 +245,7 @@ static void pdp_edge_input_0(t_pdp_edge *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -256,7 +259,7 @@ static void pdp_edge_free(t_pdp_edge *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_edge_free_ressources(x);
 }
@@ -275,6 +278,11 @@ void *pdp_edge_new(void)
     x->x_packet1 = -1;
     x->x_queue_id = -1;
 
+    x->x_map = NULL;
+    pidip_plane_init( &x->x_y );
+    pidip_plane_init( &x->x_u );
+    pidip_plane_init( &x->x_v );
+
     return (void *)x;
 }
 
@@ -25,13 +25,7 @@
 #include "pdp_llconv.h"
 #include "time.h"
 #include "sys/time.h"
-#ifdef QUICKTIME_NEWER
-#include <lqt/lqt.h>
-#include <lqt/colormodels.h>
-#else
-#include <quicktime/lqt.h>
-#include <quicktime/colormodels.h>
-#endif
+#include "pidip_source.h"
 #include <bzlib.h> // bz2 compression routines
 
 typedef struct pdp_fcqt_struct
@@ -56,12 +50,6 @@ typedef struct pdp_fcqt_struct
     int x_cursec;
     int x_framescount;
 
-    unsigned char * qt_rows[3];
-
-    unsigned char * qt_frame;
-    quicktime_t *qt;
-    int qt_cmodel;
-
     unsigned int** x_frames;
     unsigned int* x_fsizes;
 
@@ -74,8 +62,6 @@ static void pdp_fcqt_close(t_pdp_fcqt *x)
   int fi;
 
     if (x->initialized){
-	quicktime_close(x->qt);
-	if ( x->qt_frame ) freebytes(x->qt_frame, x->x_vsize*3/2);
         for ( fi=0; fi<x->x_length; fi++ )
         {
           if ( x->x_frames[fi] ) freebytes( x->x_frames[fi], x->x_fsizes[fi] );
@@ -90,49 +76,25 @@ static void pdp_fcqt_open(t_pdp_fcqt *x, t_symbol *name)
 {
   int fi, osize, ret;
   unsigned int *odata, *cdata;
+  t_pidip_source source;
 
     post("pdp_fcqt: opening %s", name->s_name);
 
     pdp_fcqt_close(x);
 
-    x->qt = quicktime_open(name->s_name, 1, 0); // read=yes, write=no 
-
-    if (!(x->qt)){
+    // frames are decoded ahead by the source while the previous one is compressed
+    pidip_source_init(&source);
+    if (!pidip_source_open(&source, name->s_name, PIDIP_SOURCE_CACHE, PIDIP_SOURCE_PREFETCH)){
 	post("pdp_fcqt: error opening qt file");
+	pidip_source_free(&source);
 	x->initialized = false;
 	return;
     }
-
-    if (!quicktime_has_video(x->qt)) {
-	post("pdp_fcqt: no video stream");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-	
-    }
-    else if (!quicktime_supported_video(x->qt,0)) {
-	post("pdp_fcqt: unsupported video codec\n");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-    }
-    else 
-    {
-	x->qt_cmodel = BC_YUV420P;
-	x->x_vwidth  = quicktime_video_width(x->qt,0);
-	x->x_vheight = quicktime_video_height(x->qt,0);
-	x->x_vsize = x->x_vwidth * x->x_vheight;
-	x->qt_frame = (unsigned char*)getbytes(x->x_vsize+(x->x_vsize>>1));
-	x->qt_rows[0] = &x->qt_frame[0];
-	x->qt_rows[2] = &x->qt_frame[x->x_vsize];
-	x->qt_rows[1] = &x->qt_frame[x->x_vsize + (x->x_vsize>>2)];
-    
-	quicktime_set_cmodel(x->qt, x->qt_cmodel);
-	x->initialized = true;
-        x->x_length = quicktime_video_length(x->qt,0);
-	outlet_float(x->x_nbframes, (float)x->x_length);
-
-    }
+    x->x_vwidth  = source.s_info.i_width;
+    x->x_vheight = source.s_info.i_height;
+    x->x_vsize = x->x_vwidth * x->x_vheight;
+    x->x_length = source.s_info.i_nbframes;
+    outlet_float(x->x_nbframes, (float)x->x_length);
 
     // read all frames
     x->x_current_frame = 0;
@@ -142,7 +104,7 @@ static void pdp_fcqt_open(t_pdp_fcqt *x, t_symbol *name)
     if ( !x->x_frames )
     {
       post("pdp_fcqt: couldn't allocate memory for frames(x->x_frames)" );
-      quicktime_close(x->qt);
+      pidip_source_free(&source);
       x->initialized = false;
       return;
     }
@@ -154,52 +116,48 @@ static void pdp_fcqt_open(t_pdp_fcqt *x, t_symbol *name)
     if ( !odata || !cdata )
     {
       post("pdp_fcqt: couldn't allocate memory for frames (odata/cdata)" );
-      quicktime_close(x->qt);
+      pidip_source_free(&source);
+      freebytes( x->x_frames, x->x_length*sizeof(unsigned int*) );
       x->initialized = false;
       return;
     }
 
+    // frames are released by close, so it must know about them from now
+    memset( x->x_frames, 0x0, x->x_length*sizeof(unsigned int*) );
+    x->initialized = true;
+
     for ( fi=0; fi<x->x_length; fi++ )
     {
-       lqt_decode_video(x->qt, x->qt_rows, 0);
-
-       switch(x->qt_cmodel){
-       case BC_YUV420P:
-           pdp_llconv(x->qt_frame, RIF_YVU__P411_U8, odata, RIF_YVU__P411_S16, 
-                            x->x_vwidth, x->x_vheight);
-
-           x->x_fsizes[fi] = osize;
-           if ( ( ret = BZ2_bzBuffToBuffCompress( (char*)cdata,
-                                  &x->x_fsizes[fi],
-                                  (char*)odata,
-                                  osize,
-                                  9, 0, 0 ) ) == BZ_OK )
-           {
-              post( "pdp_fcqt : bz2 compression (%d)->(%d) gain:%d", 
-                         osize, x->x_fsizes[fi], osize/x->x_fsizes[fi]  ); 
-              x->x_fsize += x->x_fsizes[fi];
-              x->x_frames[fi] = (unsigned int*) getbytes( x->x_fsizes[fi] );
-              if ( !x->x_frames[fi] )
-              {
-                post("pdp_fcqt: couldn't allocate memory for frames" );
-                quicktime_close(x->qt);
-                x->initialized = false;
-                return;
-              }
-              memcpy( x->x_frames[fi], cdata, x->x_fsizes[fi] );
-           }
-           else
-           {
-              post( "pdp_fcqt : bz2 compression failed (ret=%d)", ret );
-           }
-           break;
-
-       default:
-           post("pdp_fcqt : error on decode: unkown colour model");
-           break;
+       if ( !pidip_source_frame( &source, fi, (short int*)odata ) )
+       {
+          post("pdp_fcqt : could not decode frame %d", fi );
+          continue;
+       }
+
+       x->x_fsizes[fi] = osize;
+       if ( ( ret = BZ2_bzBuffToBuffCompress( (char*)cdata,
+                              &x->x_fsizes[fi],
+                              (char*)odata,
+                              osize,
+                              9, 0, 0 ) ) == BZ_OK )
+       {
+          post( "pdp_fcqt : bz2 compression (%d)->(%d) gain:%d", 
+                     osize, x->x_fsizes[fi], osize/x->x_fsizes[fi]  ); 
+          x->x_fsize += x->x_fsizes[fi];
+          x->x_frames[fi] = (unsigned int*) getbytes( x->x_fsizes[fi] );
+          if ( !x->x_frames[fi] )
+          {
+            post("pdp_fcqt: couldn't allocate memory for frames" );
+            break;
+          }
+          memcpy( x->x_frames[fi], cdata, x->x_fsizes[fi] );
+       }
+       else
+       {
+          post( "pdp_fcqt : bz2 compression failed (ret=%d)", ret );
        }
-    
     }
+    pidip_source_free(&source);
     
     if ( odata ) freebytes( odata, osize );
     if ( cdata ) freebytes( cdata, osize );
@@ -19,6 +19,9 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_inplace.h"
 #include <math.h>
 
 static char   *pdp_fdiff_version = "pdp_fdiff: version 0.1, frame difference estimator, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -49,10 +52,10 @@ static void pdp_fdiff_allocate(t_pdp_fdiff *x, int newsize)
 {
  int i;
 
-  if ( x->x_pframe != NULL ) freebytes( x->x_pframe, (x->x_vsize + (x->x_vsize>>1))<<1 ); 
+  if ( x->x_pframe != NULL ) pidip_pool_put( x->x_pframe ); 
 
   x->x_vsize = newsize;
-  x->x_pframe = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
+  x->x_pframe = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
 }
 
 static void pdp_fdiff_process_yv12(t_pdp_fdiff *x)
@@ -117,7 +120,7 @@ static void pdp_fdiff_process_yv12(t_pdp_fdiff *x)
 
     /* save previous frame */
     memcpy( x->x_pframe, data, (( x->x_vsize + (x->x_vsize>>1))<<1)); 
-    memcpy( newdata, data, (( x->x_vsize + (x->x_vsize>>1))<<1)); 
+    pidip_inplace_copy( newdata, data, (( x->x_vsize + (x->x_vsize>>1))<<1) ); 
     
     return;
 }
@@ -145,8 +148,8 @@ static void pdp_fdiff_process(t_pdp_fdiff *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_fdiff_process_yv12, pdp_fdiff_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_fdiff_process_yv12, pdp_fdiff_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -166,7 +169,7 @@ static void pdp_fdiff_input_0(t_pdp_fdiff *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -180,10 +183,10 @@ static void pdp_fdiff_free(t_pdp_fdiff *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 
-    if ( x->x_pframe ) freebytes( x->x_pframe, (x->x_vsize + (x->x_vsize>>1))<<1 );
+    if ( x->x_pframe ) pidip_pool_put( x->x_pframe );
 
 }
 
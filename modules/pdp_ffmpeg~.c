@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 #include <time.h>
 #include <sys/time.h>
@@ -938,7 +939,7 @@ static void pdp_ffmpeg_process(t_pdp_ffmpeg *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_ffmpeg_process_yv12, pdp_ffmpeg_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_ffmpeg_process_yv12, pdp_ffmpeg_killpacket, &x->x_queue_id);
             outlet_float( x->x_outlet_nbframes, x->x_nbframes );
             outlet_float( x->x_outlet_nbframes_dropped, x->x_nbframes_dropped );
 	    break;
@@ -963,7 +964,7 @@ static void pdp_ffmpeg_input_0(t_pdp_ffmpeg *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -977,7 +978,7 @@ static void pdp_ffmpeg_free(t_pdp_ffmpeg *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_ffmpeg_free_ressources(x); 
     if (x->x_img_resample_ctx) 
@@ -19,7 +19,7 @@
  */
 
 /*  This object is a geometric forms generator object for PDP
- *  It uses imlib2 for all graphical operations
+ *  Forms are rasterized directly into YUV+alpha sprites
  */
 
 /*  Listening to :
@@ -28,10 +28,12 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
+#include "pidip_sprite.h"
 #include <math.h>
 #include <ctype.h>
-#include <Imlib2.h>  // imlib2 is required
 
 
 /* forms type */
@@ -48,6 +50,8 @@ typedef struct _form
     t_form_type type;
     int n1,n2,n3,n4; // numerical coordinates or rays
     int r,g,b;
+    int dirty;              // the form changed since it was rasterized
+    t_pidip_sprite sprite;  // coverage of the form, over its bounding box
 } t_form;
 
 
@@ -76,9 +80,6 @@ typedef struct pdp_form_struct
     int x_capacity;
     t_float x_alpha;
 
-        /* imlib data */
-    Imlib_Image x_image;
-
 } t_pdp_form;
 
         /* add a line */
@@ -125,6 +126,7 @@ static void pdp_form_line(t_pdp_form *x, t_symbol *s, int argc, t_atom *argv)
                 x->x_forms[x->x_nbforms].n3, x->x_forms[x->x_nbforms].n4, x->x_nbforms,
                 x->x_forms[x->x_nbforms].r, x->x_forms[x->x_nbforms].g, x->x_forms[x->x_nbforms].b );
 
+   x->x_forms[x->x_nbforms].dirty = 1;
    if ( x->x_current == -1 ) x->x_current = x->x_nbforms;
    x->x_nbforms++;
    
@@ -174,6 +176,7 @@ static void pdp_form_rectangle(t_pdp_form *x, t_symbol *s, int argc, t_atom *arg
                 x->x_forms[x->x_nbforms].n3, x->x_forms[x->x_nbforms].n4, x->x_nbforms,
                 x->x_forms[x->x_nbforms].r, x->x_forms[x->x_nbforms].g, x->x_forms[x->x_nbforms].b );
 
+   x->x_forms[x->x_nbforms].dirty = 1;
    if ( x->x_current == -1 ) x->x_current = x->x_nbforms;
    x->x_nbforms++;
    
@@ -223,6 +226,7 @@ static void pdp_form_ellipse(t_pdp_form *x, t_symbol *s, int argc, t_atom *argv)
                 x->x_forms[x->x_nbforms].n3, x->x_forms[x->x_nbforms].n4, x->x_nbforms,
                 x->x_forms[x->x_nbforms].r, x->x_forms[x->x_nbforms].g, x->x_forms[x->x_nbforms].b );
 
+   x->x_forms[x->x_nbforms].dirty = 1;
    if ( x->x_current == -1 ) x->x_current = x->x_nbforms;
    x->x_nbforms++;
    
@@ -242,6 +246,7 @@ static void pdp_form_x1(t_pdp_form *x, t_floatarg fx )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].n1 = fx;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -250,6 +255,7 @@ static void pdp_form_y1(t_pdp_form *x, t_floatarg fy )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].n2 = fy;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -258,6 +264,7 @@ static void pdp_form_x2(t_pdp_form *x, t_floatarg fx )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].n3 = fx;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -266,6 +273,7 @@ static void pdp_form_y2(t_pdp_form *x, t_floatarg fy )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].n4 = fy;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -274,6 +282,7 @@ static void pdp_form_r(t_pdp_form *x, t_floatarg fr )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].r = fr;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -282,6 +291,7 @@ static void pdp_form_g(t_pdp_form *x, t_floatarg fg )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].g = fg;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -290,6 +300,7 @@ static void pdp_form_b(t_pdp_form *x, t_floatarg fb )
     if ( ( x->x_current  >= 0 ) && ( x->x_current  < x->x_nbforms ) )
     {
        x->x_forms[x->x_current].b = fb;
+       x->x_forms[x->x_current].dirty = 1;
     }
 }
 
@@ -301,14 +312,17 @@ static void pdp_form_clear(t_pdp_form *x )
 static void pdp_form_delete(t_pdp_form *x,  t_floatarg fnum  )
 {
   int i;
-  char *lostword;
+  t_form lostform;
 
     if ( ( fnum>0 ) && ( fnum<=x->x_nbforms ) )
     {
+       // the sprite of the lost form is kept for the next one
+       memcpy( &lostform, &x->x_forms[ (int)fnum-1 ], sizeof( t_form ) );
        for ( i=(int)fnum; i<x->x_nbforms; i++ )
        {
           memcpy( &x->x_forms[ i-1 ], &x->x_forms[ i ], sizeof( t_form ) );
        }
+       memcpy( &x->x_forms[ x->x_nbforms-1 ], &lostform, sizeof( t_form ) );
        x->x_nbforms--;
     }
 }
@@ -334,6 +348,8 @@ static void pdp_form_resize(t_pdp_form *x,  t_floatarg fnewsize  )
     for ( i=0; i<fnewsize; i++ )
     {
        forms[i].r = forms[i].g = forms[i].b = 255;
+       forms[i].dirty = 1;
+       pidip_sprite_init( &forms[i].sprite );
     }
 
     if ( fnewsize < x->x_nbforms )
@@ -353,6 +369,10 @@ static void pdp_form_resize(t_pdp_form *x,  t_floatarg fnewsize  )
     }
   
     // free old structures
+    for ( i=csize; i<x->x_capacity; i++ )
+    {
+        pidip_sprite_free( &x->x_forms[i].sprite );
+    }
     if ( x->x_forms ) freebytes( x->x_forms, x->x_capacity*sizeof(t_form) );
 
     // set new structures
@@ -369,19 +389,82 @@ static void pdp_form_resize(t_pdp_form *x,  t_floatarg fnewsize  )
     }
 }
 
-static void pdp_form_allocate(t_pdp_form *x)
+    /* coverage of a one pixel wide line, from the distance to the segment */
+static void pdp_form_rasterize_line(t_form *form)
 {
-   x->x_image = imlib_create_image( x->x_vwidth, x->x_vheight );
-   if ( x->x_image == NULL )
-   {
-      post( "pdp_form : severe error : could not allocate image !!" );
-   }
-   imlib_context_set_image(x->x_image);
+  int x0, y0, x1, y1, px, py;
+  double dx, dy, len2, t, ex, ey, dist;
+  t_pidip_sprite *sprite = &form->sprite;
+
+    x0 = ( ( form->n1 < form->n3 ) ? form->n1 : form->n3 ) - 1;
+    x1 = ( ( form->n1 > form->n3 ) ? form->n1 : form->n3 ) + 1;
+    y0 = ( ( form->n2 < form->n4 ) ? form->n2 : form->n4 ) - 1;
+    y1 = ( ( form->n2 > form->n4 ) ? form->n2 : form->n4 ) + 1;
+    if ( !pidip_sprite_solid( sprite, x0, y0, x1-x0+1, y1-y0+1, form->r, form->g, form->b ) ) return;
+
+    dx = form->n3-form->n1;
+    dy = form->n4-form->n2;
+    len2 = dx*dx+dy*dy;
+    for ( py=y0; py<=y1; py++ )
+    {
+       for ( px=x0; px<=x1; px++ )
+       {
+          t = ( len2 > 0. ) ? ( (px-form->n1)*dx + (py-form->n2)*dy ) / len2 : 0.;
+          if ( t < 0. ) t = 0.;
+          if ( t > 1. ) t = 1.;
+          ex = px - ( form->n1 + t*dx );
+          ey = py - ( form->n2 + t*dy );
+          dist = sqrt( ex*ex+ey*ey );
+          if ( dist < 1. )
+          {
+             sprite->s_alpha[(py-y0)*sprite->s_width+(px-x0)] = (unsigned char)( 255*(1.-dist) );
+          }
+       }
+    }
+}
+
+    /* filled rectangle from ( x1, y1 ) to ( x2, y2 ) */
+static void pdp_form_rasterize_rectangle(t_form *form)
+{
+  int x0, y0, width, height;
+  t_pidip_sprite *sprite = &form->sprite;
+
+    x0 = ( form->n1 < form->n3 ) ? form->n1 : form->n3;
+    y0 = ( form->n2 < form->n4 ) ? form->n2 : form->n4;
+    width = abs( form->n3-form->n1 );
+    height = abs( form->n4-form->n2 );
+    if ( !pidip_sprite_solid( sprite, x0, y0, width, height, form->r, form->g, form->b ) ) return;
+    memset( sprite->s_alpha, 0xff, width*height );
 }
 
-static void pdp_form_free_ressources(t_pdp_form *x)
+    /* filled ellipse centered on ( x1, y1 ) with rays ( x2, y2 ),
+       the border is antialiased over one pixel */
+static void pdp_form_rasterize_ellipse(t_form *form)
 {
-   // if ( x->x_image != NULL ) imlib_free_image();
+  int rx, ry, px, py;
+  double ex, ey, dist, border, coverage;
+  t_pidip_sprite *sprite = &form->sprite;
+
+    rx = abs( form->n3 );
+    ry = abs( form->n4 );
+    if ( !pidip_sprite_solid( sprite, form->n1-rx-1, form->n2-ry-1, 2*rx+3, 2*ry+3,
+                              form->r, form->g, form->b ) ) return;
+    if ( ( rx == 0 ) || ( ry == 0 ) ) return;
+
+    border = ( rx < ry ) ? rx : ry;
+    for ( py=-ry-1; py<=ry+1; py++ )
+    {
+       for ( px=-rx-1; px<=rx+1; px++ )
+       {
+          ex = (double)px/rx;
+          ey = (double)py/ry;
+          dist = sqrt( ex*ex+ey*ey );
+          coverage = ( 1.-dist )*border + 0.5;
+          if ( coverage <= 0. ) continue;
+          if ( coverage > 1. ) coverage = 1.;
+          sprite->s_alpha[(py+ry+1)*sprite->s_width+(px+rx+1)] = (unsigned char)( 255*coverage );
+       }
+    }
 }
 
 static void pdp_form_process_yv12(t_pdp_form *x)
@@ -391,85 +474,41 @@ static void pdp_form_process_yv12(t_pdp_form *x)
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int     ti;
-    int     px, py;
-    unsigned char y, u, v;
-    DATA32    *imdata;
-    DATA32    bgcolor;
-    short int *pY, *pU, *pV;
-
-    if ( ( (int)(header->info.image.width) != x->x_vwidth ) ||
-         ( (int)(header->info.image.height) != x->x_vheight ) )
-    {
-         pdp_form_free_ressources(x);
-         x->x_vwidth = header->info.image.width;
-         x->x_vheight = header->info.image.height;
-         x->x_vsize = x->x_vwidth*x->x_vheight;
-         pdp_form_allocate(x);
-    }
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
-
-    // draw all texts
-    if ( x->x_image != NULL ) imlib_context_set_image(x->x_image); 
-    imlib_image_clear();
-    imlib_context_set_direction(IMLIB_TEXT_TO_ANGLE);
-    imdata = imlib_image_get_data();
-    bgcolor = imdata[0];
+    pidip_inplace_copy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
 
+    // forms are only rasterized when they change,
+    // then blended within their bounding box
     for (ti=0; ti<x->x_nbforms; ti++)
     {
-       imlib_context_set_color( x->x_forms[ti].r, x->x_forms[ti].g, x->x_forms[ti].b, 255 );
-
-       switch ( x->x_forms[ti].type )
-       {
-          case IMLIB_LINE :
-            imlib_image_draw_line( x->x_forms[ti].n1, x->x_forms[ti].n2, x->x_forms[ti].n3, x->x_forms[ti].n4, 1);
-            break;
-
-          case IMLIB_RECTANGLE :
-            imlib_image_draw_rectangle( x->x_forms[ti].n1, x->x_forms[ti].n2, 
-                                        x->x_forms[ti].n3-x->x_forms[ti].n1, x->x_forms[ti].n4-x->x_forms[ti].n2 );
-            imlib_image_fill_rectangle( x->x_forms[ti].n1, x->x_forms[ti].n2, 
-                                        x->x_forms[ti].n3-x->x_forms[ti].n1, x->x_forms[ti].n4-x->x_forms[ti].n2 );
-            break;
-
-          case IMLIB_ELLIPSE :
-            imlib_image_draw_ellipse( x->x_forms[ti].n1, x->x_forms[ti].n2, x->x_forms[ti].n3, x->x_forms[ti].n4 );
-            imlib_image_fill_ellipse( x->x_forms[ti].n1, x->x_forms[ti].n2, x->x_forms[ti].n3, x->x_forms[ti].n4 );
-            break;
-       }
-    }
-
-    pY = newdata;
-    pV = newdata+x->x_vsize;
-    pU = newdata+x->x_vsize+(x->x_vsize>>2);
-    for ( py=0; py<x->x_vheight; py++ )
-    {
-       for ( px=0; px<x->x_vwidth; px++ )
+       if ( x->x_forms[ti].dirty )
        {
-          if ( imdata[py*x->x_vwidth+px] != bgcolor )
-          {
-            y = yuv_RGBtoY(imdata[py*x->x_vwidth+px]);
-            u = yuv_RGBtoU(imdata[py*x->x_vwidth+px]);
-            v = yuv_RGBtoV(imdata[py*x->x_vwidth+px]);
-          
-            *(pY) = (y<<7)*x->x_alpha + (*pY)*(1-x->x_alpha);
-            if ( (px%2==0) && (py%2==0) )
-            {
-              *(pV) = ((v-128)<<8)*x->x_alpha + (*pV)*(1-x->x_alpha);
-              *(pU) = ((u-128)<<8)*x->x_alpha + (*pU)*(1-x->x_alpha);
-            }
-          }
-          pY++;
-          if ( (px%2==0) && (py%2==0) )
+          x->x_forms[ti].dirty = 0;
+          switch ( x->x_forms[ti].type )
           {
-            pV++;pU++;
+             case IMLIB_LINE :
+               pdp_form_rasterize_line( &x->x_forms[ti] );
+               break;
+
+             case IMLIB_RECTANGLE :
+               pdp_form_rasterize_rectangle( &x->x_forms[ti] );
+               break;
+
+             case IMLIB_ELLIPSE :
+               pdp_form_rasterize_ellipse( &x->x_forms[ti] );
+               break;
           }
        }
+       pidip_sprite_blend( &x->x_forms[ti].sprite, newdata, x->x_vwidth, x->x_vheight,
+                           0, 0, (int)(x->x_alpha*256) );
     }
 
     return;
@@ -499,8 +538,8 @@ static void pdp_form_process(t_pdp_form *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_form_process_yv12, pdp_form_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_form_process_yv12, pdp_form_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -523,7 +562,7 @@ static void pdp_form_input_0(t_pdp_form *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -538,9 +577,12 @@ static void pdp_form_free(t_pdp_form *x)
 {
   int i;
 
-    pdp_form_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    for ( i=0; i<x->x_capacity; i++ )
+    {
+       pidip_sprite_free( &x->x_forms[i].sprite );
+    }
 }
 
 t_class *pdp_form_class;
@@ -564,8 +606,6 @@ void *pdp_form_new(void)
     x->x_packet0 = -1;
     x->x_packet1 = -1;
     x->x_queue_id = -1;
-    x->x_image = NULL;
-
     x->x_capacity = DEFAULT_CAPACITY;
 
     x->x_forms = (t_form *) getbytes( x->x_capacity*sizeof(t_form) );
@@ -573,6 +613,8 @@ void *pdp_form_new(void)
     for ( i=0; i<x->x_capacity; i++ )
     {
        x->x_forms[i].r = x->x_forms[i].g = x->x_forms[i].b = 255;
+       x->x_forms[i].dirty = 1;
+       pidip_sprite_init( &x->x_forms[i].sprite );
     }
 
     x->x_nbforms = 0;
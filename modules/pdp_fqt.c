@@ -25,13 +25,8 @@
 #include "pdp_llconv.h"
 #include "time.h"
 #include "sys/time.h"
-#ifdef QUICKTIME_NEWER
-#include <lqt/lqt.h>
-#include <lqt/colormodels.h>
-#else
-#include <quicktime/lqt.h>
-#include <quicktime/colormodels.h>
-#endif
+#include "pidip_source.h"
+#include "pidip_pacer.h"
 
 typedef struct pdp_fqt_struct
 {
@@ -48,21 +43,13 @@ typedef struct pdp_fqt_struct
 
     int x_vwidth;
     int x_vheight;
-    int x_size;
-    int x_fsize; // frames size
     int x_length;
     int x_current_frame;
     int x_cursec;
     int x_framescount;
 
-    unsigned char *qt_rows[3];
-
-    unsigned char *qt_frame;
-    quicktime_t *qt;
-    int qt_cmodel;
-
-    unsigned char **x_frames;
-    int* x_fsizes;
+    t_pidip_source x_source; // all frames, decoded in the background
+    t_pidip_pacer *x_pacer;  // frame clock driving the playback
 
 } t_pdp_fqt;
 
@@ -70,16 +57,8 @@ typedef struct pdp_fqt_struct
 
 static void pdp_fqt_close(t_pdp_fqt *x)
 {
-  int fi;
-
     if (x->initialized){
-	quicktime_close(x->qt);
-	if ( x->qt_frame ) freebytes(x->qt_frame, x->x_size*3/2);
-        for ( fi=0; fi<x->x_length; fi++ )
-        {
-          if ( x->x_frames[fi] ) freebytes( x->x_frames[fi], x->x_fsizes[fi] );
-        }
-        if ( x->x_frames ) freebytes( x->x_frames, x->x_length*sizeof(unsigned char*) );
+	pidip_source_close(&x->x_source);
 	x->initialized = false;
     }
 
@@ -87,93 +66,28 @@ static void pdp_fqt_close(t_pdp_fqt *x)
 
 static void pdp_fqt_open(t_pdp_fqt *x, t_symbol *name)
 {
-  int fi;
-
     post("pdp_fqt: opening %s", name->s_name);
 
     pdp_fqt_close(x);
 
-    x->qt = quicktime_open(name->s_name, 1, 0); // read=yes, write=no 
-
-    if (!(x->qt)){
+    // all frames are kept and decoded ahead of the play position,
+    // so opening does not wait for the whole movie
+    if (!pidip_source_open(&x->x_source, name->s_name, 0, PIDIP_SOURCE_PREFETCH)){
 	post("pdp_fqt: error opening qt file");
 	x->initialized = false;
 	return;
     }
+    pidip_source_loop(&x->x_source, 1);
 
-    if (!quicktime_has_video(x->qt)) {
-	post("pdp_fqt: no video stream");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-	
-    }
-    else if (!quicktime_supported_video(x->qt,0)) {
-	post("pdp_fqt: unsupported video codec\n");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-    }
-    else 
-    {
-	x->qt_cmodel = BC_YUV420P;
-	x->x_vwidth  = quicktime_video_width(x->qt,0);
-	x->x_vheight = quicktime_video_height(x->qt,0);
-	x->x_size = x->x_vwidth * x->x_vheight;
-	x->qt_frame = (unsigned char*)getbytes(x->x_size*3/2);
-	x->qt_rows[0] = &x->qt_frame[0];
-	x->qt_rows[2] = &x->qt_frame[x->x_size];
-	x->qt_rows[1] = &x->qt_frame[x->x_size + (x->x_size>>2)];
-    
-	quicktime_set_cmodel(x->qt, x->qt_cmodel);
-	x->initialized = true;
-        x->x_length = quicktime_video_length(x->qt,0);
-	outlet_float(x->x_nbframes, (float)x->x_length);
-
-    }
-
-    // read all frames
+    x->x_vwidth  = x->x_source.s_info.i_width;
+    x->x_vheight = x->x_source.s_info.i_height;
+    x->x_length = x->x_source.s_info.i_nbframes;
     x->x_current_frame = 0;
-    x->x_frames = (unsigned char**) getbytes( x->x_length*sizeof(unsigned char*) );
-    x->x_fsizes = (int*) getbytes( x->x_length*sizeof(int) );
-    x->x_fsize = 0;
-    if ( !x->x_frames )
-    {
-      post("pdp_fqt: couldn't allocate memory for frames" );
-      quicktime_close(x->qt);
-      x->initialized = false;
-      return;
-    }
-
-    for ( fi=0; fi<x->x_length; fi++ )
-    {
-       x->x_fsizes[fi] = (x->x_size)+((x->x_vwidth>>1)*(x->x_vheight>>1)<<1);
-       x->x_fsize += x->x_fsizes[fi];
-       x->x_frames[fi] = (unsigned char*) getbytes( x->x_fsizes[fi] );
-       if ( !x->x_frames[fi] )
-       {
-         post("pdp_fqt: couldn't allocate memory for frames" );
-         quicktime_close(x->qt);
-         x->initialized = false;
-         return;
-       }
-
-       lqt_decode_video(x->qt, x->qt_rows, 0);
-
-       switch(x->qt_cmodel){
-       case BC_YUV420P:
-           memcpy(x->x_frames[fi], x->qt_frame, x->x_fsizes[fi] );
-           break;
-
-       default:
-           post("pdp_fqt : error on decode: unkown colour model");
-           break;
-       }
-    
-    }
+    x->initialized = true;
+    outlet_float(x->x_nbframes, (float)x->x_length);
 
-    post("pdp_fqt: allocated memory for %d frames (size=%db %dM)", 
-                   x->x_length, x->x_fsize, x->x_fsize/(1024*1024) );
+    post("pdp_fqt: caching %d frames (size=%dM)", 
+                   x->x_length, (x->x_length*x->x_source.s_framesize)/(1024*1024) );
 }
 
 
@@ -189,17 +103,19 @@ static void pdp_fqt_bang(t_pdp_fqt *x)
 	return;
     }
 
-    object = pdp_packet_new_bitmap_yv12( x->x_vwidth, x->x_vheight );
+    object = pdp_packet_new_image_YCrCb( x->x_vwidth, x->x_vheight );
     header = pdp_packet_header(object);
     data = (short int *) pdp_packet_data(object);
 
-    header->info.image.encoding = PDP_BITMAP_YV12;
+    header->info.image.encoding = PDP_IMAGE_YV12;
     header->info.image.width = x->x_vwidth;
     header->info.image.height = x->x_vheight;
 
-    // post( "pdp_fqt : current frame : %d size : %d", 
-    //        x->x_current_frame, x->x_fsizes[x->x_current_frame] );
-    memcpy( data, x->x_frames[x->x_current_frame], x->x_fsizes[x->x_current_frame] );
+    if ( !pidip_source_frame( &x->x_source, x->x_current_frame, data ) )
+    {
+       pdp_packet_mark_unused(object);
+       return;
+    }
 
     if ( gettimeofday(&etime, NULL) == -1)
     {
@@ -239,9 +155,26 @@ static void pdp_fqt_frame(t_pdp_fqt *x, t_floatarg frameindex)
     pdp_fqt_bang(x);
 }
 
+/* a tick of the frame clock, frames skipped by the clock are dropped */
+static void pdp_fqt_tick(void *owner, int frame, int skipped)
+{
+    t_pdp_fqt *x = (t_pdp_fqt *)owner;
+
+    if (!(x->initialized)) return;
+    x->x_current_frame = ( x->x_current_frame + skipped ) % x->x_length;
+    pdp_fqt_bang(x);
+}
+
+static void pdp_fqt_pace(t_pdp_fqt *x, t_symbol *s)
+{
+    x->x_pacer = pidip_pacer_follow(x->x_pacer, s, x, pdp_fqt_tick);
+}
+
 static void pdp_fqt_free(t_pdp_fqt *x)
 {
+    pdp_fqt_pace(x, &s_);
     pdp_fqt_close(x);
+    pidip_source_free(&x->x_source);
 }
 
 t_class *pdp_fqt_class;
@@ -260,6 +193,8 @@ void *pdp_fqt_new(void)
     x->packet0 = -1;
 
     x->initialized = false;
+    x->x_pacer = NULL;
+    pidip_source_init(&x->x_source);
 
     return (void *)x;
 }
@@ -278,6 +213,7 @@ void pdp_fqt_setup(void)
     class_addmethod(pdp_fqt_class, (t_method)pdp_fqt_bang, gensym("bang"), A_NULL);
     class_addmethod(pdp_fqt_class, (t_method)pdp_fqt_close, gensym("close"), A_NULL);
     class_addmethod(pdp_fqt_class, (t_method)pdp_fqt_open, gensym("open"), A_SYMBOL, A_NULL);
+    class_addmethod(pdp_fqt_class, (t_method)pdp_fqt_pace, gensym("pace"), A_DEFSYMBOL, A_NULL);
     class_addfloat (pdp_fqt_class, (t_method)pdp_fqt_frame);
     class_addmethod(pdp_fqt_class, (t_method)pdp_fqt_frame_cold, gensym("frame_cold"), A_FLOAT, A_NULL);
     class_addmethod(pdp_fqt_class, nullfn, gensym("signal"), 0);
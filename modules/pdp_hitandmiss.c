@@ -23,6 +23,9 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
 #include <math.h>
 #include <stdio.h>
@@ -154,7 +157,7 @@ static void pdp_hitandmiss_kdata(t_pdp_hitandmiss *x, t_symbol *s, int argc, t_a
 
 static void pdp_hitandmiss_allocate(t_pdp_hitandmiss *x)
 {
-    x->x_frame = (short int *) getbytes ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    x->x_frame = (short int *) pidip_pool_get ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
 
     if ( !x->x_frame )
     {
@@ -165,7 +168,7 @@ static void pdp_hitandmiss_allocate(t_pdp_hitandmiss *x)
 
 static void pdp_hitandmiss_free_ressources(t_pdp_hitandmiss *x)
 {
-    if ( x->x_frame ) freebytes ( x->x_frame, ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 );
+    if ( x->x_frame ) pidip_pool_put ( x->x_frame );
 }
 
 static void pdp_hitandmiss_process_yv12(t_pdp_hitandmiss *x)
@@ -198,8 +201,7 @@ static void pdp_hitandmiss_process_yv12(t_pdp_hitandmiss *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
-    memcpy( x->x_frame, data, x->x_vsize+(x->x_vsize>>1)<<1 );
+    pidip_inplace_copy( newdata, data, x->x_vsize+(x->x_vsize>>1)<<1 );
 
     // hit and miss (supposedly) binary image by using a 3x3 square as a structuring element
     pfY = x->x_frame;
@@ -278,8 +280,8 @@ static void pdp_hitandmiss_process(t_pdp_hitandmiss *x)
         {
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_hitandmiss_process_yv12, pdp_hitandmiss_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_hitandmiss_process_yv12, pdp_hitandmiss_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -302,7 +304,7 @@ static void pdp_hitandmiss_input_0(t_pdp_hitandmiss *x, t_symbol *s, t_floatarg
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -315,8 +317,10 @@ static void pdp_hitandmiss_free(t_pdp_hitandmiss *x)
 {
   int i;
 
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_hitandmiss_free_ressources( x );
+    if ( x->x_kdata ) free( x->x_kdata );
 }
 
 t_class *pdp_hitandmiss_class;
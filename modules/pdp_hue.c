@@ -19,6 +19,8 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_stats.h"
 #include <math.h>
 
 static char   *pdp_hue_version = "pdp_hue: version 0.1, frame hue estimator, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -40,6 +42,7 @@ typedef struct pdp_hue_struct
     int x_vheight;
     int x_vsize;
     unsigned int x_encoding;
+    t_pidip_stats x_stats;
 
 } t_pdp_hue;
 
@@ -47,12 +50,6 @@ static void pdp_hue_process_rgb(t_pdp_hue *x)
 {
     t_pdp     *header = pdp_packet_header(x->x_packet0);
     unsigned char *data = (unsigned char*)pdp_packet_data(x->x_packet0);
-    int       i;
-
-    int px, py;
-    unsigned char *sr, *sg, *sb;
-    double meanr=0, meang=0, meanb=0;
-    int nbpixs=0;
 
     /* allocate all ressources */
     x->x_vwidth = header->info.image.width;
@@ -60,30 +57,7 @@ static void pdp_hue_process_rgb(t_pdp_hue *x)
     x->x_vsize = x->x_vwidth*x->x_vheight;
     x->x_encoding = header->info.image.encoding;
 
-    sr = data;
-    meanr = 0.; meang = 0.; meanb =0.;
-
-    for(py=0; py<x->x_vheight; py++) 
-    {
-      for(px=0; px<x->x_vwidth; px++) 
-      {
-         meanr += (double)*(sr);
-         meang += (double)*(sr+1);
-         meanb += (double)*(sr+2);
-         sr+=3;
-         nbpixs++;
-      }
-    }
-    if ( nbpixs > 0 )
-    {
-      meanr = meanr / nbpixs;  
-      meang = meang / nbpixs;  
-      meanb = meanb / nbpixs;  
-    }
-
-    outlet_float( x->x_meanr, (t_float)meanr );
-    outlet_float( x->x_meang, (t_float)meang );
-    outlet_float( x->x_meanb, (t_float)meanb );
+    pidip_stats_rgb( &x->x_stats, data, x->x_vwidth, x->x_vheight );
 
     return;
 }
@@ -93,6 +67,11 @@ static void pdp_hue_killpacket(t_pdp_hue *x)
     /* release the packet */
     pdp_packet_mark_unused(x->x_packet0);
     x->x_packet0 = -1;
+
+    /* means are sent from the pd thread */
+    outlet_float( x->x_meanr, pidip_stats_mean( &x->x_stats, 0 ) );
+    outlet_float( x->x_meang, pidip_stats_mean( &x->x_stats, 1 ) );
+    outlet_float( x->x_meanb, pidip_stats_mean( &x->x_stats, 2 ) );
 }
 
 static void pdp_hue_process(t_pdp_hue *x)
@@ -109,7 +88,7 @@ static void pdp_hue_process(t_pdp_hue *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_BITMAP_RGB:
-            pdp_queue_add(x, pdp_hue_process_rgb, pdp_hue_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_hue_process_rgb, pdp_hue_killpacket, &x->x_queue_id);
 	    break;
 
 	default:
@@ -125,7 +104,7 @@ static void pdp_hue_input_0(t_pdp_hue *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("bitmap/rgb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("bitmap/rgb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -139,8 +118,9 @@ static void pdp_hue_free(t_pdp_hue *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_stats_free(&x->x_stats);
 }
 
 t_class *pdp_hue_class;
@@ -157,6 +137,7 @@ void *pdp_hue_new(void)
 
     x->x_packet0 = -1;
     x->x_queue_id = -1;
+    pidip_stats_init(&x->x_stats);
 
     return (void *)x;
 }
@@ -23,6 +23,7 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "yuv.h"
 #include <math.h>
 #include <ctype.h>
@@ -48,10 +49,10 @@ typedef struct pdp_imgloader_struct
     t_object x_obj;
     t_float x_f;
 
-    t_int x_packet0;
-    t_int x_packet1;
-    t_int x_dropped;
-    t_int x_queue_id;
+    int x_packet0;
+    int x_packet1;
+    int x_dropped;
+    int x_queue_id;
 
     t_outlet *x_outlet0;
     t_int x_vwidth;
@@ -719,7 +720,7 @@ static void pdp_imgloader_process(t_pdp_imgloader *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_imgloader_process_yv12, pdp_imgloader_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_imgloader_process_yv12, pdp_imgloader_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -728,7 +729,7 @@ static void pdp_imgloader_process(t_pdp_imgloader *x)
 	    break;
 	  /*case PDP_IMAGE_RGBA8:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_imgloader_process_rgba, pdp_imgloader_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_imgloader_process_rgba, pdp_imgloader_sendpacket, &x->x_queue_id);
 	    break;*/
 	  default:
 	    /* don't know the type, so dont pdp_imgloader_process */
@@ -748,10 +749,10 @@ static void pdp_imgloader_input_0(t_pdp_imgloader *x, t_symbol *s, t_floatarg f)
 	switch(pdp_packet_header((int)f)->info.image.encoding)
         {
 	  case PDP_IMAGE_YV12:
-          x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+          x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 	  break;
 	  /*case PDP_IMAGE_RGBA8:
-          x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/rgba/*") );
+          x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/rgba/*") );
 	  break;*/
 	}
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -768,7 +769,7 @@ static void pdp_imgloader_free(t_pdp_imgloader *x)
   int i;
 
     pdp_imgloader_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
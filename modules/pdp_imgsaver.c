@@ -21,16 +21,34 @@
 /*  This object saves a snaphot to a file 
  *  Image type is specified by extension
  *  It uses imlib2 for all graphical operations
+ *  Frames to save are kept by reference in a queue
+ *  and saved by a worker thread, so the video is never blocked
  */
 
 #include "pdp.h"
 #include "yuv.h"
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <ctype.h>
 #include <pthread.h>
+#include <sys/time.h>
 #include <Imlib2.h>  // imlib2 is required
 
-static char   *pdp_imgsaver_version = "pdp_imgsaver: version 0.1 : image snapshot object written by ydegoyon@free.fr ";
+#define PDP_IMGSAVER_MAXJOBS 256
+#define PDP_IMGSAVER_DEFAULT_JOBS 32
+
+static char   *pdp_imgsaver_version = "pdp_imgsaver: version 0.2 : image snapshot object written by ydegoyon@free.fr ";
+
+typedef struct pdp_imgsaver_job
+{
+    int j_packet;            // read only reference, released by the pd thread
+    short int *j_data;
+    int j_width;
+    int j_height;
+    char j_filename[MAXPDSTRING];
+    struct timeval j_queued;
+} t_pdp_imgsaver_job;
 
 typedef struct pdp_imgsaver_struct
 {
@@ -38,231 +56,264 @@ typedef struct pdp_imgsaver_struct
     t_float x_f;
 
     int x_packet0;
-    int x_packet1;
     int x_dropped;
-    int x_queue_id;
 
     t_outlet *x_outlet0;
-    int x_vwidth;
-    int x_vheight;
-    int x_vsize;
-
-    int x_save_pending;
-
-        /* imlib data */
-    Imlib_Image x_image;
-    DATA32     *x_imdata;
-    int       x_iwidth;
-    int       x_iheight;
-
-    t_symbol    *x_filename;
-    short int   *x_datas;
-    pthread_t    x_savechild;    /* thread id for the saving child              */
+    t_outlet *x_outlet_queue;    // jobs waiting to be saved
+    t_outlet *x_outlet_latency;  // time to save the last image, in ms
+
+    t_symbol *x_filename;        // single snapshot of the next frame
+
+        /* numbered sequences */
+    t_symbol *x_seqname;
+    int x_seqcount;              // frames left, -1 for a time lapse
+    int x_seqevery;              // a frame out of x_seqevery in bursts
+    int x_seqframe;
+    int x_seqnumber;
+    t_float x_seqinterval;       // ms between frames of a time lapse
+    struct timeval x_seqlast;
+
+        /* job ring : the pd thread queues and releases, the worker saves */
+    t_pdp_imgsaver_job x_jobs[PDP_IMGSAVER_MAXJOBS];
+    int x_maxjobs;
+    volatile unsigned int x_jobin;
+    volatile unsigned int x_jobdone;
+    unsigned int x_jobreleased;
+    volatile t_float x_latency;
+    int x_refused;
+
+    int x_running;
+    int x_started;               /* the saving worker was launched */
+    pthread_mutex_t x_mutex;
+    pthread_cond_t x_cond;
+    pthread_t x_savechild;       /* thread id for the saving worker */
 
 } t_pdp_imgsaver;
 
-        /* do save the image */
-static void *pdp_imgsaver_do_save(void *tdata)
+static void pdp_imgsaver_save_job(t_pdp_imgsaver_job *job)
 {
   Imlib_Load_Error imliberr;
-  t_pdp_imgsaver *x = (t_pdp_imgsaver*) tdata;
-  int px, py;
-  short int *pY, *pU, *pV;
-  unsigned char y, u, v;
+  Imlib_Image image;
 
-   if ( ( x->x_vwidth == 0 ) || ( x->x_vheight == 0 ) )
+   image = imlib_create_image( job->j_width, job->j_height );
+   if ( image == NULL )
    {
-      post( "pdp_imgsaver : tried to save an image but no video is playing" );
-      x->x_save_pending = 0;
-      x->x_filename = NULL;
-      return NULL;
+      post( "pdp_imgsaver : severe error : could not allocate image !!" );
+      return;
    }
+   imlib_context_set_image(image);
+   yuv_YV12toRGB( job->j_data, (unsigned int*)imlib_image_get_data(), job->j_width, job->j_height );
+   imlib_image_put_back_data( imlib_image_get_data() );
 
-   x->x_image = imlib_create_image( x->x_vwidth, x->x_vheight );
-   if ( x->x_image == NULL )
+   imlib_save_image_with_error_return( job->j_filename, &imliberr );
+   if ( imliberr != IMLIB_LOAD_ERROR_NONE )
    {
-      post( "pdp_imgsaver : severe error : could not allocate image !!" );
-      x->x_save_pending = 0;
-      x->x_filename = NULL;
-      return NULL;
+      post( "pdp_imgsaver : severe error : could not save %s (err=%d)!!", job->j_filename, imliberr );
    }
-   imlib_context_set_image(x->x_image);
+   imlib_free_image();
+}
 
-   x->x_imdata = imlib_image_get_data();
-   x->x_iwidth = imlib_image_get_width();
-   x->x_iheight = imlib_image_get_height();
+        /* save the queued images, until the object is deleted */
+static void *pdp_imgsaver_worker(void *tdata)
+{
+  t_pdp_imgsaver *x = (t_pdp_imgsaver*) tdata;
+  t_pdp_imgsaver_job *job;
+  struct timeval now;
 
-   pY = x->x_datas;
-   pV = x->x_datas+x->x_vsize;
-   pU = x->x_datas+x->x_vsize+(x->x_vsize>>2);
-   for ( py=0; py<x->x_iheight; py++ )
+   while ( 1 )
    {
-     for ( px=0; px<x->x_iwidth; px++ )
-     {
-       y = *(pY)>>7;
-       v = (*(pV)>>8)+128;
-       u = (*(pU)>>8)+128;
-       x->x_imdata[ py*x->x_iwidth + px ] = yuv_YUVtoRGB( y, u, v );
-       pY++;
-       if ( (px%2==0) && (py%2==0) )
-       {
-         pV++;pU++;
-       }
-     }
+      pthread_mutex_lock( &x->x_mutex );
+      while ( x->x_running && ( x->x_jobdone == x->x_jobin ) )
+      {
+         pthread_cond_wait( &x->x_cond, &x->x_mutex );
+      }
+      pthread_mutex_unlock( &x->x_mutex );
+
+      // queued images are saved before quitting
+      if ( x->x_jobdone == x->x_jobin ) break;
+
+      // all the jobs queued so far are processed in a batch
+      while ( x->x_jobdone != x->x_jobin )
+      {
+         __sync_synchronize();
+         job = &x->x_jobs[x->x_jobdone%PDP_IMGSAVER_MAXJOBS];
+         pdp_imgsaver_save_job( job );
+         gettimeofday( &now, NULL );
+         x->x_latency = ( now.tv_sec - job->j_queued.tv_sec )*1000.
+                        + ( now.tv_usec - job->j_queued.tv_usec )/1000.;
+         __sync_synchronize();
+         x->x_jobdone++;
+      }
    }
 
-   post( "pdp_imgsaver : saving image to : %s", x->x_filename->s_name );
-   imlib_save_image_with_error_return(x->x_filename->s_name, &imliberr );
-   if ( imliberr != IMLIB_LOAD_ERROR_NONE )
+   return NULL;
+}
+
+        /* release the frames of saved images and report */
+static void pdp_imgsaver_collect(t_pdp_imgsaver *x)
+{
+  unsigned int done = x->x_jobdone;
+
+   if ( x->x_jobreleased == done ) return;
+   __sync_synchronize();
+   while ( x->x_jobreleased != done )
    {
-      post( "pdp_imgsaver : severe error : could not save image (err=%d)!!", imliberr );
+      pdp_packet_mark_unused( x->x_jobs[x->x_jobreleased%PDP_IMGSAVER_MAXJOBS].j_packet );
+      x->x_jobreleased++;
    }
-   else
+   outlet_float( x->x_outlet_latency, x->x_latency );
+   outlet_float( x->x_outlet_queue, (t_float)(x->x_jobin-done) );
+}
+
+        /* queue the current frame, it's only a new reference on the packet */
+static void pdp_imgsaver_queue(t_pdp_imgsaver *x, char *filename)
+{
+  t_pdp *header = pdp_packet_header(x->x_packet0);
+  t_pdp_imgsaver_job *job;
+
+   if ( !x->x_started )
    {
-      post( "pdp_imgsaver : saved to : %s", x->x_filename->s_name );
+      x->x_refused++;
+      post( "pdp_imgsaver : no save thread : %s not saved (%d images refused)", filename, x->x_refused );
+      return;
    }
 
-   //if ( x->x_image != NULL ) 
-   //{
-   //   imlib_free_image();
-   //}
-   x->x_image = NULL;
-
-   x->x_save_pending = 0;
-   x->x_filename = NULL;
+   if ( x->x_jobin - x->x_jobreleased >= (unsigned int)x->x_maxjobs )
+   {
+      x->x_refused++;
+      post( "pdp_imgsaver : queue is full : %s not saved (%d images refused)", filename, x->x_refused );
+      return;
+   }
 
-   post( "pdp_imgsaver : saving thread %d finished", x->x_savechild );
-   x->x_savechild = 0;
+   job = &x->x_jobs[x->x_jobin%PDP_IMGSAVER_MAXJOBS];
+   job->j_packet = pdp_packet_copy_ro(x->x_packet0);
+   job->j_data = (short int *)pdp_packet_data(job->j_packet);
+   job->j_width = header->info.image.width;
+   job->j_height = header->info.image.height;
+   strncpy( job->j_filename, filename, MAXPDSTRING-1 );
+   job->j_filename[MAXPDSTRING-1] = '\0';
+   gettimeofday( &job->j_queued, NULL );
+
+   pthread_mutex_lock( &x->x_mutex );
+   __sync_synchronize();
+   x->x_jobin++;
+   pthread_cond_signal( &x->x_cond );
+   pthread_mutex_unlock( &x->x_mutex );
+
+   outlet_float( x->x_outlet_queue, (t_float)(x->x_jobin-x->x_jobdone) );
+}
 
-   return NULL;
+        /* name-00001.ext for the images of a sequence */
+static void pdp_imgsaver_seqfile(t_pdp_imgsaver *x, char *filename)
+{
+  char *name = x->x_seqname->s_name;
+  char *ext = strrchr( name, '.' );
+  int len = ext ? (int)(ext-name) : (int)strlen(name);
 
+   if ( len > MAXPDSTRING-32 ) len = MAXPDSTRING-32;
+   snprintf( filename, MAXPDSTRING, "%.*s-%05d%s", len, name, ++x->x_seqnumber, ext ? ext : "" );
 }
 
-        /* launched the thread to save the image */
-static void pdp_imgsaver_save(t_pdp_imgsaver *x, t_symbol *filename)
+        /* is a frame of the current sequence due */
+static int pdp_imgsaver_seqdue(t_pdp_imgsaver *x)
 {
- pthread_attr_t save_child_attr;
+  struct timeval now;
+  t_float elapsed;
 
-   if ( x->x_save_pending  ) 
-   {
-      post( "pdp_imgsaver : a save operation is currently running...retry later" );
-      return;
-   }
-   x->x_save_pending = 1;
-   x->x_filename = filename;
-   //if ( x->x_image != NULL ) 
-   //{
-   //   imlib_free_image();
-   //}
-   x->x_image = NULL;
-
-   // launch saving thread
-   if ( pthread_attr_init( &save_child_attr ) < 0 ) 
-   {
-        post( "pdp_imgsaver : could not launch save thread" );
-        perror( "pthread_attr_init" );
-        return;
-   }
-   if ( pthread_attr_setdetachstate( &save_child_attr, PTHREAD_CREATE_DETACHED ) < 0 ) {
-        post( "pdp_imgsaver : could not launch save thread" );
-        perror( "pthread_attr_setdetachstate" );
-        return;
-   }
-   if ( pthread_create( &x->x_savechild, &save_child_attr, pdp_imgsaver_do_save, x ) < 0 ) {
-        post( "pdp_imgsaver : could not launch save thread" );
-        perror( "pthread_create" );
-        return;
-   }
-   else
+   if ( !x->x_seqname ) return 0;
+
+   if ( x->x_seqcount < 0 )
    {
-        post( "pdp_imgsaver : saving thread %d launched", (int)x->x_savechild );
+      gettimeofday( &now, NULL );
+      elapsed = ( now.tv_sec - x->x_seqlast.tv_sec )*1000.
+                + ( now.tv_usec - x->x_seqlast.tv_usec )/1000.;
+      if ( ( x->x_seqnumber > 0 ) && ( elapsed < x->x_seqinterval ) ) return 0;
+      x->x_seqlast = now;
+      return 1;
    }
+
+   if ( ( x->x_seqframe++ % x->x_seqevery ) != 0 ) return 0;
+   x->x_seqcount--;
+   return 1;
 }
 
-static void pdp_imgsaver_allocate(t_pdp_imgsaver *x)
+        /* save the next frame */
+static void pdp_imgsaver_save(t_pdp_imgsaver *x, t_symbol *filename)
 {
-   x->x_datas = (short int *)getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
+   x->x_filename = filename;
 }
 
-static void pdp_imgsaver_free_ressources(t_pdp_imgsaver *x)
+        /* save the next frames with numbered names */
+static void pdp_imgsaver_burst(t_pdp_imgsaver *x, t_symbol *filename, t_floatarg fcount, t_floatarg fevery)
 {
-   if ( x->x_datas ) freebytes( x->x_datas, (( x->x_vsize + (x->x_vsize>>1))<<1));
+   if ( fcount < 1 )
+   {
+      post( "pdp_imgsaver : burst : wrong number of images : %d", (int)fcount );
+      return;
+   }
+   x->x_seqname = filename;
+   x->x_seqcount = (int)fcount;
+   x->x_seqevery = ( fevery < 1 ) ? 1 : (int)fevery;
+   x->x_seqframe = 0;
+   x->x_seqnumber = 0;
 }
 
-static void pdp_imgsaver_process_yv12(t_pdp_imgsaver *x)
+        /* save a numbered image every 'fms' milliseconds */
+static void pdp_imgsaver_timelapse(t_pdp_imgsaver *x, t_symbol *filename, t_floatarg fms)
 {
-    t_pdp     *header = pdp_packet_header(x->x_packet0);
-    short int *data   = (short int *)pdp_packet_data(x->x_packet0);
-    t_pdp     *newheader = pdp_packet_header(x->x_packet1);
-    short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int     px, py;
-    t_float   alpha, factor;
-    unsigned  char y, u, v;
-    short int *pY, *pU, *pV;
-
-    if ( ( (int)(header->info.image.width) != x->x_vwidth ) ||
-         ( (int)(header->info.image.height) != x->x_vheight ) )
-    {
-         pdp_imgsaver_free_ressources(x);	    
-         x->x_vwidth = header->info.image.width;
-         x->x_vheight = header->info.image.height;
-         x->x_vsize = x->x_vwidth*x->x_vheight;
-         pdp_imgsaver_allocate(x);
-    }
-
-    newheader->info.image.encoding = header->info.image.encoding;
-    newheader->info.image.width = x->x_vwidth;
-    newheader->info.image.height = x->x_vheight;
-
-    memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
-    if ( !x->x_save_pending )
-    {
-      memcpy( x->x_datas, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
-    }
-
-    return;
+   if ( fms <= 0 )
+   {
+      post( "pdp_imgsaver : timelapse : wrong interval : %f", fms );
+      return;
+   }
+   x->x_seqname = filename;
+   x->x_seqcount = -1;
+   x->x_seqinterval = fms;
+   x->x_seqnumber = 0;
 }
 
-static void pdp_imgsaver_sendpacket(t_pdp_imgsaver *x)
+static void pdp_imgsaver_stop(t_pdp_imgsaver *x)
 {
-    /* delete source packet */
-    pdp_packet_mark_unused(x->x_packet0);
-    x->x_packet0 = -1;
+   x->x_seqname = NULL;
+}
 
-    /* unregister and propagate if valid dest packet */
-    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+static void pdp_imgsaver_maxjobs(t_pdp_imgsaver *x, t_floatarg fjobs)
+{
+   if ( ( fjobs < 1 ) || ( fjobs > PDP_IMGSAVER_MAXJOBS ) )
+   {
+      post( "pdp_imgsaver : queue size should be between 1 and %d", PDP_IMGSAVER_MAXJOBS );
+      return;
+   }
+   x->x_maxjobs = (int)fjobs;
 }
 
 static void pdp_imgsaver_process(t_pdp_imgsaver *x)
 {
-   int encoding;
-   t_pdp *header = 0;
+  t_pdp *header = 0;
+  char filename[MAXPDSTRING];
+
+   pdp_imgsaver_collect(x);
 
    /* check if image data packets are compatible */
    if ( (header = pdp_packet_header(x->x_packet0))
-	&& (PDP_IMAGE == header->type)){
-    
-	/* pdp_imgsaver_process inputs and write into active inlet */
-	switch(pdp_packet_header(x->x_packet0)->info.image.encoding)
-        {
-
-	  case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_imgsaver_process_yv12, pdp_imgsaver_sendpacket, &x->x_queue_id);
-	    break;
-
-	  case PDP_IMAGE_GREY:
-            // should write something to handle these one day
-            // but i don't use this mode                      
-	    break;
-
-	  default:
-	    /* don't know the type, so dont pdp_imgsaver_process */
-	    break;
-	    
-	}
-    }
+	&& (PDP_IMAGE == header->type)
+	&& (PDP_IMAGE_YV12 == header->info.image.encoding) ){
+
+      if ( x->x_filename )
+      {
+         pdp_imgsaver_queue( x, x->x_filename->s_name );
+         x->x_filename = NULL;
+      }
+      if ( pdp_imgsaver_seqdue(x) )
+      {
+         pdp_imgsaver_seqfile( x, filename );
+         pdp_imgsaver_queue( x, filename );
+         if ( x->x_seqcount == 0 ) x->x_seqname = NULL;
+      }
+   }
 
+   /* the frame goes through untouched */
+   pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet0);
 }
 
 static void pdp_imgsaver_input_0(t_pdp_imgsaver *x, t_symbol *s, t_floatarg f)
@@ -275,7 +326,6 @@ static void pdp_imgsaver_input_0(t_pdp_imgsaver *x, t_symbol *s, t_floatarg f)
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
-        /* add the process method and callback to the process queue */
         pdp_imgsaver_process(x);
 
     }
@@ -284,33 +334,59 @@ static void pdp_imgsaver_input_0(t_pdp_imgsaver *x, t_symbol *s, t_floatarg f)
 
 static void pdp_imgsaver_free(t_pdp_imgsaver *x)
 {
-  int i;
+  void *dummy;
+
+    // the worker saves what is queued before quitting
+    if ( x->x_started )
+    {
+       pthread_mutex_lock( &x->x_mutex );
+       x->x_running = 0;
+       pthread_cond_signal( &x->x_cond );
+       pthread_mutex_unlock( &x->x_mutex );
+       pthread_join( x->x_savechild, &dummy );
+    }
 
-    pdp_imgsaver_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    while ( x->x_jobreleased != x->x_jobin )
+    {
+       pdp_packet_mark_unused( x->x_jobs[x->x_jobreleased%PDP_IMGSAVER_MAXJOBS].j_packet );
+       x->x_jobreleased++;
+    }
     pdp_packet_mark_unused(x->x_packet0);
+    pthread_mutex_destroy( &x->x_mutex );
+    pthread_cond_destroy( &x->x_cond );
 }
 
 t_class *pdp_imgsaver_class;
 
 void *pdp_imgsaver_new(void)
 {
-    int i;
-
     t_pdp_imgsaver *x = (t_pdp_imgsaver *)pd_new(pdp_imgsaver_class);
 
     x->x_outlet0 = outlet_new(&x->x_obj, &s_anything); 
+    x->x_outlet_queue = outlet_new(&x->x_obj, &s_float); 
+    x->x_outlet_latency = outlet_new(&x->x_obj, &s_float); 
     x->x_packet0 = -1;
-    x->x_packet1 = -1;
-    x->x_datas = NULL;
-    x->x_queue_id = -1;
-    x->x_image = NULL;
 
-    x->x_vwidth = 0;
-    x->x_vheight = 0;
-
-    x->x_save_pending = 0;
     x->x_filename = NULL;
+    x->x_seqname = NULL;
+    x->x_seqnumber = 0;
+
+    x->x_maxjobs = PDP_IMGSAVER_DEFAULT_JOBS;
+    x->x_jobin = x->x_jobdone = x->x_jobreleased = 0;
+    x->x_latency = 0;
+    x->x_refused = 0;
+
+    pthread_mutex_init( &x->x_mutex, NULL );
+    pthread_cond_init( &x->x_cond, NULL );
+    x->x_running = 1;
+    x->x_started = 1;
+    if ( pthread_create( &x->x_savechild, NULL, pdp_imgsaver_worker, x ) != 0 )
+    {
+        post( "pdp_imgsaver : could not launch save thread" );
+        perror( "pthread_create" );
+        x->x_running = 0;
+        x->x_started = 0;
+    }
 
     return (void *)x;
 }
@@ -332,6 +408,10 @@ void pdp_imgsaver_setup(void)
     class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_input_0, gensym("pdp"),  
                              A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_save, gensym("save"),  A_SYMBOL, A_NULL);
+    class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_burst, gensym("burst"),  A_SYMBOL, A_FLOAT, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_timelapse, gensym("timelapse"),  A_SYMBOL, A_FLOAT, A_NULL);
+    class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_stop, gensym("stop"),  A_NULL);
+    class_addmethod(pdp_imgsaver_class, (t_method)pdp_imgsaver_maxjobs, gensym("queue"),  A_FLOAT, A_NULL);
 
 
 }
@@ -28,6 +28,9 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_bgmodel.h"
 #include <math.h>
 
 #define NB_IMAGES 4
@@ -61,6 +64,7 @@ typedef struct pdp_intrusion_struct
     int       x_phase;
     int       x_loopcount;
     int       x_threshfreq;
+    t_pidip_bgmodel *x_model;  // shared background model, NULL for the snapshot
 
 } t_pdp_intrusion;
 
@@ -130,22 +134,22 @@ static void pdp_intrusion_allocate(t_pdp_intrusion *x, int newsize)
   {
     if ( x->x_images[i] != NULL )
     {
-       freebytes( x->x_images[i], (x->x_vsize + (x->x_vsize>>1))<<1 );
+       pidip_pool_put( x->x_images[i] );
     }
   }
   if ( x->x_diff != NULL )
   {
-     freebytes( x->x_diff, (x->x_vsize + (x->x_vsize>>1))<<1 );
+     pidip_pool_put( x->x_diff );
   }
-  if ( x->x_bdata ) freebytes( x->x_bdata, (( x->x_vsize + (x->x_vsize>>1))<<1));
+  if ( x->x_bdata ) pidip_pool_put( x->x_bdata );
 
   x->x_vsize = newsize;
   for ( i=0; i<NB_IMAGES; i++ )
   {
-     x->x_images[i] = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
+     x->x_images[i] = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
   }
-  x->x_diff = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
-  x->x_bdata = (short int *)getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
+  x->x_diff = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
+  x->x_bdata = (short int *)pidip_pool_get((( x->x_vsize + (x->x_vsize>>1))<<1));
 }
 
 static void pdp_intrusion_process_yv12(t_pdp_intrusion *x)
@@ -195,7 +199,15 @@ static void pdp_intrusion_process_yv12(t_pdp_intrusion *x)
     if ( !x->x_bdata ) return;
 
     /* check pixels which has changed */
-    diff = pdp_intrusion_diff(x, data);
+    if ( x->x_model && pidip_bgmodel_update( x->x_model ) )
+    {
+       pidip_bgmodel_expand( x->x_model, x->x_diff, x->x_vwidth, x->x_vheight, 0 );
+       diff = x->x_diff;
+    }
+    else
+    {
+       diff = pdp_intrusion_diff(x, data);
+    }
 
     sy = data;
     su = (data+x->x_vsize);
@@ -320,7 +332,7 @@ static void pdp_intrusion_process(t_pdp_intrusion *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_intrusion_process_yv12, pdp_intrusion_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_intrusion_process_yv12, pdp_intrusion_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -340,7 +352,10 @@ static void pdp_intrusion_input_0(t_pdp_intrusion *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_bgmodel_push(x->x_model, x->x_packet0);
+    }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -350,17 +365,28 @@ static void pdp_intrusion_input_0(t_pdp_intrusion *x, t_symbol *s, t_floatarg f)
     }
 }
 
+/* use a shared background model instead of the snapshot, no name goes back to the snapshot */
+static void pdp_intrusion_bgmodel(t_pdp_intrusion *x, t_symbol *s)
+{
+    pdp_queue_finish(x->x_queue_id);
+    pidip_bgmodel_detach(x->x_model);
+    x->x_model = (s==&s_) ? NULL : pidip_bgmodel_attach(s);
+}
+
 static void pdp_intrusion_free(t_pdp_intrusion *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_bgmodel_detach(x->x_model);
 
     for (i=0; i<NB_IMAGES; i++ )
     {
-       if ( x->x_images[i] ) freebytes( x->x_images[i], (x->x_vsize + (x->x_vsize>>1))<<1 );
+       if ( x->x_images[i] ) pidip_pool_put( x->x_images[i] );
     }
+    pidip_pool_put( x->x_diff );
+    pidip_pool_put( x->x_bdata );
 
 }
 
@@ -387,6 +413,7 @@ void *pdp_intrusion_new(void)
     x->x_vsize = -1;
     x->x_loopcount = 0;
     x->x_threshfreq = 10;
+    x->x_model = NULL;
 
     // initialize noise pattern
     for(i=0; i<256; i++) 
@@ -420,6 +447,7 @@ void pdp_intrusion_setup(void)
     class_addmethod(pdp_intrusion_class, (t_method)pdp_intrusion_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_intrusion_class, (t_method)pdp_intrusion_background, gensym("background"),  A_NULL);
     class_addmethod(pdp_intrusion_class, (t_method)pdp_intrusion_threshold, gensym("threshold"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_intrusion_class, (t_method)pdp_intrusion_bgmodel, gensym("bgmodel"),  A_DEFSYMBOL, A_NULL);
 
 
 }
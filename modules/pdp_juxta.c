@@ -25,6 +25,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 static char   *pdp_juxta_version = "pdp_juxta: version 0.1, frames juxtaposition, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -179,7 +180,7 @@ static void pdp_juxta_process0(t_pdp_juxta *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_juxta_process_yv12, pdp_juxta_sendpacket0, &x->x_queue_id);
+            pidip_queue_add(x, pdp_juxta_process_yv12, pdp_juxta_sendpacket0, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -206,7 +207,7 @@ static void pdp_juxta_process1(t_pdp_juxta *x)
 	switch(pdp_packet_header(x->x_packet1)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_juxta_process_yv12, pdp_juxta_sendpacket1, &x->x_queue_id);
+            pidip_queue_add(x, pdp_juxta_process_yv12, pdp_juxta_sendpacket1, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -232,7 +233,7 @@ static void pdp_juxta_input_0(t_pdp_juxta *x, t_symbol *s, t_floatarg f)
         pdp_packet_mark_unused(x->x_packet0);
         x->x_packet0 = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -255,7 +256,7 @@ static void pdp_juxta_input_1(t_pdp_juxta *x, t_symbol *s, t_floatarg f)
         pdp_packet_mark_unused(x->x_packet1);
         x->x_packet1 = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet1, (int)f, pdp_gensym("image/YCrCb/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet1, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet1) && (!x->x_dropped)){
@@ -270,7 +271,7 @@ static void pdp_juxta_free(t_pdp_juxta *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_packet_mark_unused(x->x_packet1);
 }
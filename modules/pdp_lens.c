@@ -26,8 +26,13 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_remap.h"
+#include "pidip_roi.h"
 #include <math.h>
 
+#define NB_MAPS 2
+
 static char   *pdp_lens_version = "pdp_lens: version 0.1, port of lens from effectv( Fukuchi Kentaro ) adapted by Yves Degoyon (ydegoyon@free.fr)";
 
 typedef struct pdp_lens_struct
@@ -51,39 +56,50 @@ typedef struct pdp_lens_struct
     int     x_xd;
     int     x_yd;
     int     x_mode;
-    int     *x_lens;
+    int     *x_lens;     // displacements inside the lens
     int     x_init;
+    int     x_interpolate;
+    t_pidip_remapcache x_maps;
+    t_pidip_roi x_roi;  // the lens is only applied in this region
 
 } t_pdp_lens;
 
+static void pdp_lens_set(t_pdp_lens *x, int px, int py, int dx, int dy)
+{
+  if ( ( px < x->x_csize ) && ( py < x->x_csize ) )
+  {
+     x->x_lens[2*(py*x->x_csize+px)] = dx;
+     x->x_lens[2*(py*x->x_csize+px)+1] = dy;
+  }
+}
+
 static void pdp_lens_preset(t_pdp_lens *x, int oldsize, int newsize)
 {
  int px, py, r;
 
-  if ( x->x_lens ) freebytes(x->x_lens, oldsize * oldsize * sizeof( int) ); 
-  x->x_lens = (int *) getbytes( newsize * newsize * sizeof( int ) );
+  if ( x->x_lens ) freebytes(x->x_lens, 2 * oldsize * oldsize * sizeof( int) ); 
+  x->x_lens = (int *) getbytes( 2 * newsize * newsize * sizeof( int ) );
   r = x->x_csize / 2;
 
   /* it is sufficient to generate 1/4 of the lens and reflect this
-   * around; a sphere is mirrored on both the x and y axes */
+   * around; a sphere is mirrored on both the x and y axes,
+   * displacements are kept in 1/16 of pixels */
   for (py = 0; py < r; py++) {
         for (px = 0; px < r; px++) {
-            int ix, iy, offset, dist;
+            int ix, iy, dist;
                dist = px*px + py*py - r*r;
                if(dist < 0) {
                  double shift = x->x_zoom/sqrt(x->x_zoom*x->x_zoom - dist);
-                 ix = px * shift - px;
-                 iy = py * shift - py;
+                 ix = (px * shift - px)*PIDIP_REMAP_ONE;
+                 iy = (py * shift - py)*PIDIP_REMAP_ONE;
                } else {
                 ix = 0;
                 iy = 0;
                }
-               offset = (iy * x->x_vwidth + ix);
-                        x->x_lens[(r - py)*x->x_csize + r - px] = -offset;
-                        x->x_lens[(r + py)*x->x_csize + r + px] = offset;
-               offset = (-iy * x->x_vwidth + ix);
-                        x->x_lens[(r + py)*x->x_csize + r - px] = -offset;
-                        x->x_lens[(r - py)*x->x_csize + r + px] = offset;
+               pdp_lens_set(x, r - px, r - py, -ix, -iy);
+               pdp_lens_set(x, r + px, r + py, ix, iy);
+               pdp_lens_set(x, r - px, r + py, -ix, iy);
+               pdp_lens_set(x, r + px, r - py, ix, -iy);
         }
   }
 }
@@ -110,12 +126,14 @@ static void pdp_lens_zoom(t_pdp_lens *x, t_floatarg fzoom )
 
 static void pdp_lens_csize(t_pdp_lens *x, t_floatarg fcsize )
 {
+    int oldsize = x->x_csize;
+
     if ( fcsize>0 )
     {
        x->x_csize = (int)fcsize;
        if (x->x_csize>x->x_vheight) x->x_csize = x->x_vheight;
        if (x->x_csize<3) x->x_csize = 3;
-       pdp_lens_preset(x, x->x_csize, x->x_csize);
+       pdp_lens_preset(x, oldsize, x->x_csize);
        pdp_lens_cliplens(x);
     }
 }
@@ -138,6 +156,14 @@ static void pdp_lens_cx(t_pdp_lens *x, t_floatarg fcx )
     }
 }
 
+static void pdp_lens_interpolate(t_pdp_lens *x, t_floatarg finterpolate )
+{
+    if ( ( finterpolate == 0 ) || ( finterpolate == 1 ) )
+    {
+       x->x_interpolate = (int)finterpolate;
+    }
+}
+
 static void pdp_lens_mode(t_pdp_lens *x, t_floatarg fmode )
 {
     if ( ( fmode == 0 ) || ( fmode == 1 ) )
@@ -146,22 +172,53 @@ static void pdp_lens_mode(t_pdp_lens *x, t_floatarg fmode )
     }
 }
 
+/* the map covers the lens square within the region, the rest of the frame is copied */
+static t_pidip_remap *pdp_lens_get_map(t_pdp_lens *x)
+{
+  int px, py, lx, ly, build;
+  int x0, y0, x1, y1;
+  int key[8];
+  t_pidip_remap *map;
+
+    x0 = x->x_cx; y0 = x->x_cy; x1 = x->x_cx+x->x_csize; y1 = x->x_cy+x->x_csize;
+    if ( !pidip_roi_clip( &x->x_roi, x->x_vwidth, x->x_vheight, &x0, &y0, &x1, &y1 ) )
+    {
+       x1 = x0; y1 = y0;
+    }
+
+    key[0] = x->x_cx; key[1] = x->x_cy; key[2] = x->x_csize; key[3] = (int)(x->x_zoom*PIDIP_REMAP_ONE);
+    key[4] = x0; key[5] = y0; key[6] = x1; key[7] = y1;
+    map = pidip_remapcache_get( &x->x_maps, x->x_vwidth, x->x_vheight, x->x_interpolate, key, 8, &build );
+    if ( !map || !build ) return map;
+
+    pidip_remap_region( map, x0, y0, x1, y1 );
+    for (py = map->m_y0; py < map->m_y1; py++) 
+    {
+      for (px = map->m_x0; px < map->m_x1; px++) 
+      {
+        lx = px-x->x_cx;
+        ly = py-x->x_cy;
+        if ( ( lx >= 0 ) && ( ly >= 0 ) && ( lx < x->x_csize ) && ( ly < x->x_csize ) )
+        {
+           pidip_remap_point( map, px, py, px*PIDIP_REMAP_ONE + x->x_lens[2*(ly*x->x_csize+lx)],
+                                           py*PIDIP_REMAP_ONE + x->x_lens[2*(ly*x->x_csize+lx)+1] );
+        }
+        else
+        {
+           pidip_remap_point( map, px, py, px*PIDIP_REMAP_ONE, py*PIDIP_REMAP_ONE );
+        }
+      }
+    }
+    return map;
+}
+
 static void pdp_lens_process_yv12(t_pdp_lens *x)
 {
     t_pdp     *header = pdp_packet_header(x->x_packet0);
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int       i;
-
-    unsigned int totalnbpixels;
-    unsigned int u_offset;
-    unsigned int v_offset;
-    unsigned int totnbpixels;
-    short int *poy, *pou, *pov, *pny, *pnu, *pnv;
-    int px, py;
-    int noy, pos, posu, nox;
-    int *p;
+    t_pidip_remap *map;
 
     x->x_vwidth = header->info.image.width;
     x->x_vheight = header->info.image.height;
@@ -173,42 +230,17 @@ static void pdp_lens_process_yv12(t_pdp_lens *x)
          x->x_init = 1;
     }
 
-    totalnbpixels = x->x_vsize;
-    u_offset = x->x_vsize;
-    v_offset = x->x_vsize + (x->x_vsize>>2);
-    totnbpixels = x->x_vsize + (x->x_vsize>>1);
-
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy(newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1);
-
-    p = x->x_lens;
-    poy = data;
-    pou = data + x->x_vsize;
-    pov = data + x->x_vsize + (x->x_vsize>>2);
-    pny = newdata;
-    pnu = newdata + x->x_vsize;
-    pnv = newdata + x->x_vsize + (x->x_vsize>>2);
-    for (py = 0; py < x->x_csize; py++) 
+    if ( (map = pdp_lens_get_map( x )) )
     {
-      for (px = 0; px < x->x_csize; px++) 
-      {
-        noy=(py+x->x_cy);  
-        nox=(px+x->x_cx);
-        if ((nox>=0)&&(noy>=0)&&(nox<x->x_vwidth)&&(noy<x->x_vheight)){
-            pos = (noy * x->x_vwidth) + nox;
-            posu = ((noy>>1) * (x->x_vwidth>>1)) + (nox>>1);
-            if ( ( ( pos + *p )< x->x_vsize ) && ( pos < x->x_vsize ) ) 
-            {
-               *(pny+pos) = *(poy + pos + *p);
-               *(pnu+posu) = *(pou + posu + *p );
-               *(pnv+posu) = *(pov + posu + *p );
-            }
-        }
-        p++;
-      }
+       pidip_remap_apply( map, data, newdata );
+    }
+    else
+    {
+       memcpy(newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1);
     }
 
     if (x->x_mode==1)
@@ -228,7 +260,7 @@ static void pdp_lens_sendpacket(t_pdp_lens *x)
     x->x_packet0 = -1;
 
     /* unregister and propagate if valid dest packet */
-    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+    pidip_roi_pass(x->x_outlet0, &x->x_packet1, &x->x_roi);
 }
 
 static void pdp_lens_process(t_pdp_lens *x)
@@ -245,7 +277,7 @@ static void pdp_lens_process(t_pdp_lens *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_lens_process_yv12, pdp_lens_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_lens_process_yv12, pdp_lens_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -265,7 +297,10 @@ static void pdp_lens_input_0(t_pdp_lens *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_roi_get( (int)f, &x->x_roi );
+    }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -279,8 +314,10 @@ static void pdp_lens_free(t_pdp_lens *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    if ( x->x_lens ) freebytes(x->x_lens, 2 * x->x_csize * x->x_csize * sizeof( int) ); 
+    pidip_remapcache_free(&x->x_maps);
 }
 
 t_class *pdp_lens_class;
@@ -308,6 +345,9 @@ void *pdp_lens_new(void)
     x->x_zoom = 30;
     x->x_init = -1;
     x->x_mode = 0;
+    x->x_interpolate = PIDIP_REMAP_NEAREST;
+    pidip_remapcache_init(&x->x_maps, NB_MAPS);
+    pidip_roi_clear(&x->x_roi);
 
     return (void *)x;
 }
@@ -331,6 +371,7 @@ void pdp_lens_setup(void)
     class_addmethod(pdp_lens_class, (t_method)pdp_lens_csize, gensym("csize"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_lens_class, (t_method)pdp_lens_zoom, gensym("zoom"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_lens_class, (t_method)pdp_lens_mode, gensym("mode"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_lens_class, (t_method)pdp_lens_interpolate, gensym("interpolate"),  A_FLOAT, A_NULL);
 
 
 }
@@ -26,6 +26,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
 #include <math.h>
 
 #define MAX_LUMA 256
@@ -118,7 +120,7 @@ static void pdp_lumafilt_process_yv12(t_pdp_lumafilt *x)
     pnV = newdata+x->x_vsize;
     pnU = newdata+x->x_vsize+(x->x_vsize>>2);
 
-    memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
+    pidip_inplace_copy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
 
     for (py = 0; py < x->x_vheight; py++) {
       for (px = 0; px < x->x_vwidth; px++) {
@@ -170,8 +172,8 @@ static void pdp_lumafilt_process(t_pdp_lumafilt *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_lumafilt_process_yv12, pdp_lumafilt_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_lumafilt_process_yv12, pdp_lumafilt_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -192,7 +194,7 @@ static void pdp_lumafilt_input_0(t_pdp_lumafilt *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -205,7 +207,7 @@ static void pdp_lumafilt_free(t_pdp_lumafilt *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_lumafilt_free_ressources(x);
 }
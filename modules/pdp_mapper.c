@@ -23,6 +23,8 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_remap.h"
 #include <math.h>
 
 static char   *pdp_mapper_version = "pdp_mapper: version 0.1, a pixels mapper, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -43,6 +45,8 @@ typedef struct pdp_mapper_struct
     int x_vsize;
     unsigned int x_encoding;
     int *x_pixelmap;
+    int x_serial;       // changes with the pixel map
+    t_pidip_remapcache x_maps;
 
 } t_pdp_mapper;
 
@@ -54,6 +58,7 @@ static void pdp_mapper_copy(t_pdp_mapper *x, t_floatarg fromX, t_floatarg fromY,
         ( toY >= 0 ) && ( toY < x->x_vheight ) )
     {
         x->x_pixelmap[ (int)toY*x->x_vwidth+(int)toX ] = x->x_pixelmap[ (int)fromY*x->x_vwidth+(int)fromX ];
+        x->x_serial++;
     }
 }
 
@@ -70,6 +75,7 @@ static void pdp_mapper_reset(t_pdp_mapper *x)
          x->x_pixelmap[py*x->x_vwidth+px] = py*x->x_vwidth+px;
       }
     }
+    x->x_serial++;
   }
 }
 
@@ -86,6 +92,7 @@ static void pdp_mapper_swap(t_pdp_mapper *x, t_floatarg fromX, t_floatarg fromY,
         tval = x->x_pixelmap[ (int)toY*x->x_vwidth+(int)toX ];
         x->x_pixelmap[ (int)toY*x->x_vwidth+(int)toX ] = x->x_pixelmap[ (int)fromY*x->x_vwidth+(int)fromX ];
         x->x_pixelmap[ (int)fromY*x->x_vwidth+(int)fromX ] = tval;
+        x->x_serial++;
     }
 }
 
@@ -108,6 +115,30 @@ static void pdp_mapper_allocate(t_pdp_mapper *x, int newsize)
        x->x_pixelmap[py*x->x_vwidth+px] = py*x->x_vwidth+px;
     }
   }
+  x->x_serial++;
+}
+
+/* the remap is rebuilt from the pixel map when it was edited */
+static t_pidip_remap *pdp_mapper_get_map(t_pdp_mapper *x)
+{
+  int px, py, build;
+  int *spy;
+  t_pidip_remap *map;
+
+    map = pidip_remapcache_get( &x->x_maps, x->x_vwidth, x->x_vheight, PIDIP_REMAP_NEAREST, &x->x_serial, 1, &build );
+    if ( !map || !build ) return map;
+
+    spy = x->x_pixelmap;
+    for(py=0; py<x->x_vheight; py++) 
+    {
+       for(px=0; px<x->x_vwidth; px++) 
+       {
+          pidip_remap_point( map, px, py, ((*spy)%x->x_vwidth)*PIDIP_REMAP_ONE,
+                                          ((*spy)/x->x_vwidth)*PIDIP_REMAP_ONE );
+          spy++;
+       }
+    }
+    return map;
 }
 
 static void pdp_mapper_process_yv12(t_pdp_mapper *x)
@@ -116,12 +147,7 @@ static void pdp_mapper_process_yv12(t_pdp_mapper *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int       i;
-
-    int px, py, ppx, ppy, offset;
-    short int *sy, *su, *sv, t;
-    int *spy;
-    short int *sny, *snu, *snv;
+    t_pidip_remap *map;
 
     /* allocate all ressources */
     if ( ((int)header->info.image.width != x->x_vwidth ) || 
@@ -139,32 +165,13 @@ static void pdp_mapper_process_yv12(t_pdp_mapper *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    /* copy images if necessary */
-    // memcpy( newdata, data, (( x->x_vsize + (x->x_vsize>>1))<<1)); 
-
-    sy = data;
-    su = (data+x->x_vsize);
-    sv = (data+x->x_vsize+(x->x_vsize>>2));
-    spy = x->x_pixelmap;
-    sny = newdata;
-    snu = (newdata+x->x_vsize);
-    snv = (newdata+x->x_vsize+(x->x_vsize>>2));
-
-    for(py=1; py<x->x_vheight; py++) 
+    if ( (map = pdp_mapper_get_map( x )) )
     {
-       for(px=0; px<x->x_vwidth; px++) 
-       {
-          ppy = (*(spy)/x->x_vwidth); 
-          ppx = (*(spy)%x->x_vwidth); 
-          *(sny) = *(sy+ppy*x->x_vwidth+ppx);
-          *(snu) = *(su+(ppy>>1)*(x->x_vwidth>>1)+(ppx>>1));
-          *(snv) = *(sv+(ppy>>1)*(x->x_vwidth>>1)+(ppx>>1));
-          sny++; spy++;
-          if ( ( px%2 == 0 ) && ( py%2 == 0 ) )
-          {
-             snu++; snv++;
-          }
-       }
+       pidip_remap_apply( map, data, newdata );
+    }
+    else
+    {
+       memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
     }
 
     return;
@@ -194,7 +201,7 @@ static void pdp_mapper_process(t_pdp_mapper *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_mapper_process_yv12, pdp_mapper_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_mapper_process_yv12, pdp_mapper_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -215,7 +222,7 @@ static void pdp_mapper_input_0(t_pdp_mapper *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -229,10 +236,11 @@ static void pdp_mapper_free(t_pdp_mapper *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 
     if ( x->x_pixelmap ) freebytes( x->x_pixelmap, x->x_vsize*sizeof(int) );
+    pidip_remapcache_free(&x->x_maps);
 
 }
 
@@ -250,6 +258,8 @@ void *pdp_mapper_new(void)
     x->x_packet1 = -1;
     x->x_queue_id = -1;
     x->x_vsize = -1;
+    x->x_serial = 0;
+    pidip_remapcache_init(&x->x_maps, 1);
 
     return (void *)x;
 }
@@ -22,6 +22,7 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 #define DEFAULT_X_DIM 10
@@ -244,7 +245,7 @@ static void pdp_mgrid_process(t_pdp_mgrid *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_mgrid_process_yv12(x);
+            pidip_process_inline(x, pdp_mgrid_process_yv12);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -265,7 +266,7 @@ static void pdp_mgrid_input_0(t_pdp_mgrid *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -278,6 +279,7 @@ static void pdp_mgrid_free(t_pdp_mgrid *x)
 {
   int i;
 
+    pidip_queue_release(x, -1);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_mgrid_free_ressources(x);
 }
@@ -26,6 +26,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include <math.h>
 
 #define MAGIC_THRESHOLD 30
@@ -79,16 +81,16 @@ static void pdp_mosaic_background(t_pdp_mosaic *x )
 
 static void pdp_mosaic_free_ressources(t_pdp_mosaic *x)
 {
-  if ( x->x_diff != NULL ) freebytes( x->x_diff, (x->x_vsize + (x->x_vsize>>1))<<1 );
-  if ( x->x_bdata != NULL ) freebytes( x->x_bdata, (( x->x_vsize + (x->x_vsize>>1))<<1));
+  if ( x->x_diff != NULL ) pidip_pool_put( x->x_diff );
+  if ( x->x_bdata != NULL ) pidip_pool_put( x->x_bdata );
 }
 
 static void pdp_mosaic_allocate(t_pdp_mosaic *x)
 {
  int i;
 
-  x->x_diff = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
-  x->x_bdata = (short int *) getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
+  x->x_diff = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
+  x->x_bdata = (short int *) pidip_pool_get((( x->x_vsize + (x->x_vsize>>1))<<1));
   if( !x->x_bdata || ! x->x_diff ) {
       post( "pdp_mosaic : severe error : cannot allocate buffers" );
   }
@@ -227,7 +229,7 @@ static void pdp_mosaic_process(t_pdp_mosaic *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_mosaic_process_yv12, pdp_mosaic_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_mosaic_process_yv12, pdp_mosaic_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -246,7 +248,7 @@ static void pdp_mosaic_input_0(t_pdp_mosaic *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -259,7 +261,7 @@ static void pdp_mosaic_free(t_pdp_mosaic *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_mosaic_free_ressources(x);
 }
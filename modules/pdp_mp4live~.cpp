@@ -58,6 +58,11 @@
 #include "pdp_mp4videosource.h"
 #include "pdp_mp4audiosource.h"
 
+extern "C"
+{
+#include "pidip_profile.h"
+}
+
 #define VIDEO_BUFFER_SIZE (1024*1024)
 #define MAX_AUDIO_PACKET_SIZE (128 * 1024)
 #define AUDIO_PACKET_SIZE (2*1024*2) /* using aac encoding, 2 channels, 2 bytes per sample */
@@ -69,9 +74,9 @@ typedef struct pdp_mp4live_struct
     t_object x_obj;
     t_float x_f;
 
-    t_int x_packet0;
-    t_int x_dropped;
-    t_int x_queue_id;
+    int x_packet0;
+    int x_dropped;
+    int x_queue_id;
 
     t_int x_vwidth;
     t_int x_vheight;
@@ -523,7 +528,7 @@ static void pdp_mp4live_process(t_pdp_mp4live *x)
         {
 
 	  case PDP_BITMAP_YV12:
-            pdp_queue_add(x, (void*) pdp_mp4live_process_yv12, (void*) pdp_mp4live_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, (void*) pdp_mp4live_process_yv12, (void*) pdp_mp4live_killpacket, &x->x_queue_id);
             outlet_float( x->x_outlet_nbframes, x->x_nbframes );
             outlet_float( x->x_outlet_framerate, x->x_framerate );
 	    break;
@@ -546,7 +551,7 @@ static void pdp_mp4live_input_0(t_pdp_mp4live *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -561,7 +566,7 @@ static void pdp_mp4live_free(t_pdp_mp4live *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -27,6 +27,11 @@
 
 #include "pdp_mp4player~.h"
 
+extern "C"
+{
+#include "pidip_pool.h"
+}
+
 static char   *pdp_mp4player_version = "pdp_mp4player~: version 0.1, a mpeg4ip stream decoder ( ydegoyon@free.fr).";
 
 #ifdef __cplusplus
@@ -318,6 +323,8 @@ static void pdp_mp4player_free(t_pdp_mp4player *x)
     }
     post( "pdp_mp4player~ : freeing object" );
     pdp_packet_mark_unused(x->x_packet);
+    pidip_pool_put(x->x_datav);
+    x->x_datav = NULL;
 
     // remove invalid global ports
     close_plugins();
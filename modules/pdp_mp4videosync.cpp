@@ -33,6 +33,11 @@
 #include "player_util.h"
 #include "m_pd.h"
 
+extern "C"
+{
+#include "pidip_pool.h"
+}
+
 #define video_message(loglevel, fmt...) message(loglevel, "videosync", fmt)
 
 CPDPVideoSync::CPDPVideoSync (CPlayerSession *psptr, t_pdp_mp4player *pdp_father) : CVideoSync(psptr)
@@ -100,6 +105,10 @@ void CPDPVideoSync::config (int w, int h)
 {
   m_width = w;
   m_height = h;
+  // a new configuration replaces the buffers of the previous one
+  if (m_y_buffer[0] != NULL) free(m_y_buffer[0]);
+  if (m_u_buffer[0] != NULL) free(m_u_buffer[0]);
+  if (m_v_buffer[0] != NULL) free(m_v_buffer[0]);
   m_y_buffer[0] = (uint8_t *)malloc(w * h * sizeof(uint8_t));
   m_u_buffer[0] = (uint8_t *)malloc(w/2 * h/2 * sizeof(uint8_t));
   m_v_buffer[0] = (uint8_t *)malloc(w/2 * h/2 * sizeof(uint8_t));
@@ -194,8 +203,8 @@ void CPDPVideoSync::set_video_frame(const uint8_t *y,
     m_father->x_vsize = m_father->x_vheight*m_father->x_vwidth;
     post( "pdp_mp4videosync : allocating video data : %dx%d", m_width, m_height ); 
 
-    // allocate video data
-    m_father->x_datav = ( short int* ) malloc( (m_father->x_vsize+(m_father->x_vsize>>1))<<1 );
+    // allocate video data, the buffer of the previous size is given back
+    m_father->x_datav = ( short int* ) pidip_pool_resize( m_father->x_datav, (m_father->x_vsize+(m_father->x_vsize>>1))<<1 );
   }
 
   // post( "pdp_mp4videosync : set video frame : width : y:%d, uv:%d", pixelw_y, pixelw_uv );
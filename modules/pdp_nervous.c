@@ -26,6 +26,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_history.h"
 #include <math.h>
 
 #define DEFAULT_PLANES      32
@@ -36,8 +38,6 @@ static int fastrand_val=0;
 
 static char   *pdp_nervous_version = "pdp_nervous: version 0.1, port of nervous from effectv( Fukuchi Kentaro ) adapted by Yves Degoyon (ydegoyon@free.fr)";
 
-static char* the_wave_table = NULL;
-
 typedef struct pdp_nervous_struct
 {
     t_object x_obj;
@@ -47,16 +47,10 @@ typedef struct pdp_nervous_struct
     int x_packet0;
     int x_packet1;
     int x_dropped;
-    int x_queue_id;
 
-    int x_vwidth;
-    int x_vheight;
-    int x_vsize;
     int x_mode;
-    short int *x_buffer;
-    short int **x_planetable;
+    t_pidip_history *x_history;  // frames are kept there, by reference
     int x_planes;
-    int x_plane;
     int x_stock;
     int x_timer;
     int x_stride;
@@ -72,75 +66,31 @@ static void pdp_nervous_mode(t_pdp_nervous *x, t_floatarg fmode )
    }
 }
 
-static void pdp_nervous_free_ressources(t_pdp_nervous *x)
-{
-    if ( x->x_buffer ) free ( x->x_buffer );
-    if ( x->x_planetable ) free ( x->x_planetable );
-}
-
-static void pdp_nervous_allocate(t_pdp_nervous *x)
-{
-  int i;
-
-    // allocate space for the frame buffers.  A lot of memory is required -
-    // with the default settings, it totals nearly 5 megs.
-    x->x_buffer = (short int *) getbytes ( ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * 2 * x->x_planes);
-    x->x_planetable = (short int**) getbytes ( x->x_planes*sizeof(short int*) );
-
-    // set up the array of pointers to the frame buffers
-    for(i=0;i<x->x_planes;i++) 
-    {
-       x->x_planetable[i] = &x->x_buffer[ ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * i];
-    }
-
-    if ( !x->x_buffer )
-    {
-       post( "pdp_nervous : severe error : cannot allocate buffers !!! ");
-       return;
-    }
-}
-
 static void pdp_nervous_planes(t_pdp_nervous *x, t_floatarg fplanes )
 {
    if ( ( fplanes > 1 )  && ( fplanes < 100 ) )
    {
-      pdp_nervous_free_ressources(x);
+      pidip_history_depth(x->x_history, x->x_planes, (int)fplanes);
       x->x_planes = (int)fplanes;
-      x->x_plane = x->x_planes-1;
       x->x_readplane = 0;
-      x->x_stock = 0;
-      pdp_nervous_allocate(x);
    }
 }
 
-static void pdp_nervous_process_yv12(t_pdp_nervous *x)
+    /* share the frames with other temporal effects reading the same source */
+static void pdp_nervous_history(t_pdp_nervous *x, t_symbol *s)
 {
-    t_pdp     *header = pdp_packet_header(x->x_packet0);
-    short int *data   = (short int *)pdp_packet_data(x->x_packet0);
-    t_pdp     *newheader = pdp_packet_header(x->x_packet1);
-    short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int       i;
-
-    /* allocate all ressources */
-    if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
-    {
-        pdp_nervous_free_ressources(x);
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        x->x_plane = x->x_planes-1;
-        pdp_nervous_allocate(x);
-        post( "pdp_nervous : reallocated buffers" );
-    }
+    pidip_history_detach(x->x_history, x->x_planes);
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
+    x->x_readplane = 0;
+}
 
-    newheader->info.image.encoding = header->info.image.encoding;
-    newheader->info.image.width = x->x_vwidth;
-    newheader->info.image.height = x->x_vheight;
+    /* no pixel is touched : the output is one of the past frames */
+static void pdp_nervous_process_yv12(t_pdp_nervous *x)
+{
+    pidip_history_push(x->x_history, x->x_packet0);
 
-    memcpy(x->x_planetable[x->x_plane], data, ( x->x_vsize + (x->x_vsize>>1) ) << 1 );
-    if(x->x_stock < x->x_planes) {
-        x->x_stock++;
-    }
+    x->x_stock = pidip_history_count(x->x_history);
+    if ( x->x_stock > x->x_planes ) x->x_stock = x->x_planes;
 
     if(x->x_mode) 
     {
@@ -165,8 +115,9 @@ static void pdp_nervous_process_yv12(t_pdp_nervous *x)
       if(x->x_stock > 0) x->x_readplane = ( inline_fastrand() % x->x_stock );
       if ( x->x_readplane < 0 ) x->x_readplane = 0;
     }
-    memcpy(newdata, x->x_planetable[x->x_readplane], ( x->x_vsize + ( x->x_vsize>>1) ) << 1 );
-    x->x_plane = ( x->x_plane + 1 ) % x->x_planes;
+    if ( x->x_readplane >= x->x_stock ) x->x_readplane = 0;
+
+    x->x_packet1 = pdp_packet_copy_ro( pidip_history_get(x->x_history, x->x_readplane) );
 
     return;
 }
@@ -194,8 +145,9 @@ static void pdp_nervous_process(t_pdp_nervous *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_nervous_process_yv12, pdp_nervous_sendpacket, &x->x_queue_id);
+            /* nothing to compute, no need to go through the process queue */
+            pidip_process_inline(x, pdp_nervous_process_yv12);
+            pdp_nervous_sendpacket(x);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -216,7 +168,7 @@ static void pdp_nervous_input_0(t_pdp_nervous *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -229,14 +181,14 @@ static void pdp_nervous_free(t_pdp_nervous *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, -1);
     pdp_packet_mark_unused(x->x_packet0);
-    pdp_nervous_free_ressources(x);
+    pidip_history_detach(x->x_history, x->x_planes);
 }
 
 t_class *pdp_nervous_class;
 
-void *pdp_nervous_new(void)
+void *pdp_nervous_new(t_symbol *s)
 {
     int i;
 
@@ -248,13 +200,12 @@ void *pdp_nervous_new(void)
 
     x->x_packet0 = -1;
     x->x_packet1 = -1;
-    x->x_queue_id = -1;
 
     x->x_mode = 0;
-    x->x_buffer = NULL;
     x->x_planes = DEFAULT_PLANES;
     x->x_readplane = 0;
     x->x_stock = 0;
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
 
     return (void *)x;
 }
@@ -270,11 +221,12 @@ void pdp_nervous_setup(void)
 {
 //    post( pdp_nervous_version );
     pdp_nervous_class = class_new(gensym("pdp_nervous"), (t_newmethod)pdp_nervous_new,
-    	(t_method)pdp_nervous_free, sizeof(t_pdp_nervous), 0, A_NULL);
+    	(t_method)pdp_nervous_free, sizeof(t_pdp_nervous), 0, A_DEFSYMBOL, A_NULL);
 
     class_addmethod(pdp_nervous_class, (t_method)pdp_nervous_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_nervous_class, (t_method)pdp_nervous_mode, gensym("mode"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_nervous_class, (t_method)pdp_nervous_planes, gensym("planes"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_nervous_class, (t_method)pdp_nervous_history, gensym("history"),  A_DEFSYMBOL, A_NULL);
 
 
 }
@@ -26,9 +26,12 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_history.h"
 #include <math.h>
 
 #define DEFAULT_PLANES             16
+#define MAX_PLANES                 100
 #define DEFAULT_TOLERANCE          5
 
 static int fastrand_val=0;
@@ -53,53 +56,30 @@ typedef struct pdp_noquark_struct
     int x_vwidth;
     int x_vheight;
     int x_vsize;
-    short int *x_buffer;
-    short int **x_planetable;
-    int x_plane;
+    t_pidip_history *x_history;      // frames are kept there, by reference
+    int x_pinned[MAX_PLANES];        // frames used by the current process
+    int x_nbpinned;
     int x_planes;
     int x_tolerance;
 
 } t_pdp_noquark;
 
-static void pdp_noquark_free_ressources(t_pdp_noquark *x)
-{
-    if ( x->x_buffer ) free ( x->x_buffer );
-    if ( x->x_planetable ) free ( x->x_planetable );
-}
-
-static void pdp_noquark_allocate(t_pdp_noquark *x)
-{
-  int i;
-
-    // allocate space for the frame buffers.  A lot of memory is required -
-    // with the default settings, it totals nearly 5 megs.
-    x->x_buffer = (short int *) getbytes ( ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * 2 * x->x_planes);
-    x->x_planetable = (short int**) getbytes( x->x_planes*sizeof( short int* ) );
-
-    // set up the array of pointers to the frame buffers
-    for(i=0;i<x->x_planes;i++) 
-    {
-       x->x_planetable[i] = &x->x_buffer[ ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * i];
-    }
-
-    if ( !x->x_buffer )
-    {
-       post( "pdp_noquark : severe error : cannot allocate buffers !!! ");
-       return;
-    }
-}
-
 static void pdp_noquark_planes(t_pdp_noquark *x, t_floatarg fplanes)
 {
-   if ( ( (int)fplanes > 1 ) && ( (int)fplanes < 100 ) )
+   if ( ( (int)fplanes > 1 ) && ( (int)fplanes < MAX_PLANES ) )
    {
-      pdp_noquark_free_ressources(x); 
+      pidip_history_depth(x->x_history, x->x_planes, (int)fplanes);
       x->x_planes = (int) fplanes;
-      x->x_plane=x->x_planes-1;
-      pdp_noquark_allocate(x);
    }
 }
 
+    /* share the frames with other temporal effects reading the same source */
+static void pdp_noquark_history(t_pdp_noquark *x, t_symbol *s)
+{
+    pidip_history_detach(x->x_history, x->x_planes);
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
+}
+
 static void pdp_noquark_tolerance(t_pdp_noquark *x, t_floatarg ftolerance)
 {
    if ( (int)ftolerance > 1 )
@@ -114,34 +94,33 @@ static void pdp_noquark_process_yv12(t_pdp_noquark *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int     px, py, cf, diff, rx, ry;
+    int     i, px, py, cf, diff, rx, ry;
+
+    short int *planetable[MAX_PLANES];
 
-    /* allocate all ressources */
-    if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+
+    /* the pinned frames, newest first, the current one included */
+    for(i=0; i<x->x_nbpinned; i++)
     {
-        pdp_noquark_free_ressources(x);
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        x->x_plane = x->x_planes-1;
-        pdp_noquark_allocate(x);
-        post( "pdp_noquark : reallocated buffers" );
+       planetable[i] = (short int *)pdp_packet_data(x->x_pinned[i]);
     }
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy(x->x_planetable[x->x_plane], data, (x->x_vsize + (x->x_vsize>>1))<<1 );
     for(py=0; py<x->x_vheight; py++)
     {
       for(px=0; px<x->x_vwidth; px++)
       {
-        cf = (x->x_plane + (inline_fastrand()>>24))&(x->x_planes-1);
-        diff = (((x->x_planetable[cf])[py*x->x_vwidth+px] - data[py*x->x_vwidth+px])>>7) +
-               ((((x->x_planetable[cf])[x->x_vsize+((py>>1)*(x->x_vwidth>>1)+(px>>1))] - 
+        cf = ((((unsigned int)inline_fastrand())>>24)*x->x_nbpinned)>>8;
+        diff = (((planetable[cf])[py*x->x_vwidth+px] - data[py*x->x_vwidth+px])>>7) +
+               ((((planetable[cf])[x->x_vsize+((py>>1)*(x->x_vwidth>>1)+(px>>1))] - 
                    data[x->x_vsize+((py>>1)*(x->x_vwidth>>1)+(px>>1))] )>>8)) +
-               ((((x->x_planetable[cf])[x->x_vsize+(x->x_vsize>>2)+((py>>1)*(x->x_vwidth>>1)+(px>>1))] - 
+               ((((planetable[cf])[x->x_vsize+(x->x_vsize>>2)+((py>>1)*(x->x_vwidth>>1)+(px>>1))] - 
                    data[x->x_vsize+(x->x_vsize>>2)+((py>>1)*(x->x_vwidth>>1)+(px>>1))] )>>8));
         if ( abs ( diff ) > x->x_tolerance )
         {
@@ -164,17 +143,16 @@ static void pdp_noquark_process_yv12(t_pdp_noquark *x)
         (or, 'man rand') */
       }
     }
-    x->x_plane--;
-    if ( x->x_plane < 0 ) x->x_plane = x->x_planes-1;
-
     return;
 }
 
 static void pdp_noquark_sendpacket(t_pdp_noquark *x)
 {
-    /* release the packet */
+    /* release the packets */
     pdp_packet_mark_unused(x->x_packet0);
     x->x_packet0 = -1;
+    pidip_history_unpin(x->x_pinned, x->x_nbpinned);
+    x->x_nbpinned = 0;
 
     /* unregister and propagate if valid dest packet */
     pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
@@ -194,7 +172,9 @@ static void pdp_noquark_process(t_pdp_noquark *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_noquark_process_yv12, pdp_noquark_sendpacket, &x->x_queue_id);
+            pidip_history_push(x->x_history, x->x_packet0);
+            x->x_nbpinned = pidip_history_pin(x->x_history, x->x_pinned, x->x_planes);
+            pidip_queue_add(x, pdp_noquark_process_yv12, pdp_noquark_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -215,7 +195,7 @@ static void pdp_noquark_input_0(t_pdp_noquark *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -228,14 +208,15 @@ static void pdp_noquark_free(t_pdp_noquark *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
-    pdp_noquark_free_ressources(x);
+    pidip_history_unpin(x->x_pinned, x->x_nbpinned);
+    pidip_history_detach(x->x_history, x->x_planes);
 }
 
 t_class *pdp_noquark_class;
 
-void *pdp_noquark_new(void)
+void *pdp_noquark_new(t_symbol *s)
 {
     int i;
 
@@ -250,7 +231,8 @@ void *pdp_noquark_new(void)
     x->x_planes = DEFAULT_PLANES;
     x->x_tolerance = DEFAULT_TOLERANCE;
 
-    x->x_buffer = NULL;
+    x->x_nbpinned = 0;
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
 
     return (void *)x;
 }
@@ -266,11 +248,12 @@ void pdp_noquark_setup(void)
 {
 //    post( pdp_noquark_version );
     pdp_noquark_class = class_new(gensym("pdp_noquark"), (t_newmethod)pdp_noquark_new,
-    	(t_method)pdp_noquark_free, sizeof(t_pdp_noquark), 0, A_NULL);
+    	(t_method)pdp_noquark_free, sizeof(t_pdp_noquark), 0, A_DEFSYMBOL, A_NULL);
 
     class_addmethod(pdp_noquark_class, (t_method)pdp_noquark_input_0, gensym("pdp"), A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_noquark_class, (t_method)pdp_noquark_planes, gensym("planes"), A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_noquark_class, (t_method)pdp_noquark_tolerance, gensym("tolerance"), A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_noquark_class, (t_method)pdp_noquark_history, gensym("history"), A_DEFSYMBOL, A_NULL);
 
 
 }
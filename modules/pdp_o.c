@@ -25,6 +25,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "pdp_streaming.h"
 #include <math.h>
 #include <time.h>
@@ -498,7 +499,7 @@ static void pdp_o_process(t_pdp_o *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_o_process_yv12, pdp_o_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_o_process_yv12, pdp_o_killpacket, &x->x_queue_id);
             outlet_float( x->x_framesd, x->x_framesdropped );
             outlet_float( x->x_frames, x->x_framessent );
             outlet_float( x->x_bandwidth, x->x_bandwidthcount );
@@ -523,7 +524,7 @@ static void pdp_o_input_0(t_pdp_o *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -537,7 +538,7 @@ static void pdp_o_free(t_pdp_o *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     // close connection if existing
     pdp_o_disconnect(x);
@@ -25,6 +25,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 static char   *pdp_ocanvas_version = "pdp_ocanvas: version 0.1, display for several video sources, written by Yves Degoyon (ydegoyon@free.fr)";
@@ -151,7 +152,7 @@ static void pdp_ocanvas_process(t_pdp_ocanvas *x, int ni)
 	switch(pdp_packet_header(x->x_packets[ni])->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_ocanvas_process_yv12, pdp_ocanvas_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_ocanvas_process_yv12, pdp_ocanvas_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -257,7 +258,7 @@ static void pdp_ocanvas_input(t_pdp_ocanvas *x, t_symbol *s, t_floatarg f, int n
         pdp_packet_delete(x->x_packets[ni]);
         x->x_packets[ni] = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packets[ni], (int)f, pdp_gensym("image/YCrCb/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packets[ni], (int)f, pdp_gensym("image/YCrCb/*") );
       if ( x->x_packets[ni] != -1 )
       {
         header = pdp_packet_header(x->x_packets[ni]);
@@ -328,7 +329,7 @@ static void pdp_ocanvas_free(t_pdp_ocanvas *x)
 {
  int ii;
 
-  pdp_queue_finish(x->x_queue_id);
+  pidip_queue_release(x, x->x_queue_id);
   for ( ii=0; ii<x->x_nbinputs; ii++)
   {
     pdp_packet_mark_unused(x->x_packets[ii]);
@@ -0,0 +1,217 @@
+/*
+ *   Pure Data Packet module.
+ *   Copyright (c) by Yves Degoyon <ydegoyon@free.fr>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object drives a named frame clock ( see pidip_pacer.h )
+ *  Sources receiving 'pace <name>' get a tick for each frame
+ *  The clock is the dsp sample count or a monotonic timer
+ *  and frames are due at an exact rational rate
+ */
+
+#include "pdp.h"
+#include "pidip_pacer.h"
+
+#define PDP_PACER_DSP   0
+#define PDP_PACER_TIMER 1
+
+typedef struct pdp_pacer_struct
+{
+    t_object x_obj;
+    t_float x_f;
+
+    t_outlet *x_outlet0; // frame
+    t_outlet *x_outlet1; // late ticks
+    t_outlet *x_outlet2; // skipped frames
+
+    t_pidip_pacer *x_pacer;
+    t_clock *x_clock;
+
+    int x_mode;
+    int x_running;
+    double x_sr;
+    long long x_samples;  // samples since start
+    long long x_origin;   // timer at start, in microseconds
+    int x_due;            // frame due found by the dsp
+
+} t_pdp_pacer;
+
+static void pdp_pacer_output(t_pdp_pacer *x)
+{
+    outlet_float( x->x_outlet2, (float)x->x_pacer->p_skipped );
+    outlet_float( x->x_outlet1, (float)x->x_pacer->p_late );
+    outlet_float( x->x_outlet0, (float)x->x_pacer->p_frame );
+}
+
+static void pdp_pacer_tick(t_pdp_pacer *x)
+{
+  long long now, units, period;
+  int frame;
+  double delay;
+
+    if ( !x->x_running ) return;
+
+    if ( x->x_mode == PDP_PACER_DSP )
+    {
+       now = x->x_samples;
+       units = (long long)x->x_sr;
+       frame = x->x_due;
+    }
+    else
+    {
+       now = pidip_pacer_now() - x->x_origin;
+       units = 1000000;
+       frame = pidip_pacer_frameat( x->x_pacer, now, units );
+    }
+
+    if ( frame > x->x_pacer->p_frame )
+    {
+       period = pidip_pacer_timeof( x->x_pacer, 1, units );
+       pidip_pacer_advance( x->x_pacer, frame,
+                            ( now - pidip_pacer_timeof( x->x_pacer, frame, units ) ) > period/2 );
+       pdp_pacer_output( x );
+    }
+
+    // the next frame is computed from the start, so delays never accumulate
+    if ( x->x_running && ( x->x_mode == PDP_PACER_TIMER ) )
+    {
+       delay = ( pidip_pacer_timeof( x->x_pacer, x->x_pacer->p_frame+1, 1000000 )
+                 - ( pidip_pacer_now() - x->x_origin ) ) / 1000.;
+       clock_delay( x->x_clock, ( delay > 0 ) ? delay : 0 );
+    }
+}
+
+static void pdp_pacer_start(t_pdp_pacer *x)
+{
+    pidip_pacer_reset( x->x_pacer );
+    x->x_samples = 0;
+    x->x_due = -1;
+    x->x_origin = pidip_pacer_now();
+    x->x_running = 1;
+    if ( x->x_mode == PDP_PACER_TIMER ) clock_delay( x->x_clock, 0 );
+}
+
+static void pdp_pacer_stop(t_pdp_pacer *x)
+{
+    x->x_running = 0;
+    clock_unset( x->x_clock );
+}
+
+static void pdp_pacer_rate(t_pdp_pacer *x, t_floatarg fnum, t_floatarg fden)
+{
+    if ( fden <= 0 ) fden = 1;
+    if ( !pidip_pacer_rate( x->x_pacer, (int)fnum, (int)fden ) )
+    {
+       post( "pdp_pacer~ : wrong rate : %d/%d", (int)fnum, (int)fden );
+       return;
+    }
+    // frames are counted again from the new rate
+    if ( x->x_running ) pdp_pacer_start( x );
+}
+
+static void pdp_pacer_dspclock(t_pdp_pacer *x)
+{
+    x->x_mode = PDP_PACER_DSP;
+    if ( x->x_running ) pdp_pacer_start( x );
+}
+
+static void pdp_pacer_timer(t_pdp_pacer *x)
+{
+    x->x_mode = PDP_PACER_TIMER;
+    if ( x->x_running ) pdp_pacer_start( x );
+}
+
+static t_int *pdp_pacer_perform(t_int *w)
+{
+  t_pdp_pacer *x = (t_pdp_pacer *)(w[1]);
+  int n = (int)(w[2]);
+  int frame;
+
+    if ( x->x_running && ( x->x_mode == PDP_PACER_DSP ) )
+    {
+       x->x_samples += n;
+       frame = pidip_pacer_frameat( x->x_pacer, x->x_samples, (long long)x->x_sr );
+       // ticks are sent from the scheduler, not from the dsp chain
+       if ( ( frame > x->x_pacer->p_frame ) && ( frame != x->x_due ) )
+       {
+          x->x_due = frame;
+          clock_delay( x->x_clock, 0 );
+       }
+    }
+    return (w+3);
+}
+
+static void pdp_pacer_dsp(t_pdp_pacer *x, t_signal **sp)
+{
+    x->x_sr = sp[0]->s_sr;
+    dsp_add( pdp_pacer_perform, 2, x, sp[0]->s_n );
+}
+
+static void pdp_pacer_free(t_pdp_pacer *x)
+{
+    clock_free( x->x_clock );
+    pidip_pacer_detach( x->x_pacer );
+}
+
+t_class *pdp_pacer_class;
+
+void *pdp_pacer_new(t_symbol *name, t_floatarg fnum, t_floatarg fden)
+{
+    t_pdp_pacer *x = (t_pdp_pacer *)pd_new(pdp_pacer_class);
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_float);
+    x->x_outlet1 = outlet_new(&x->x_obj, &s_float);
+    x->x_outlet2 = outlet_new(&x->x_obj, &s_float);
+
+    x->x_pacer = pidip_pacer_attach( ( name == &s_ ) ? gensym("pacer") : name );
+    x->x_clock = clock_new( x, (t_method)pdp_pacer_tick );
+    x->x_mode = PDP_PACER_DSP;
+    x->x_running = 0;
+    x->x_sr = sys_getsr();
+    x->x_samples = 0;
+    x->x_origin = 0;
+    x->x_due = -1;
+    if ( fnum > 0 ) pidip_pacer_rate( x->x_pacer, (int)fnum, ( fden > 0 ) ? (int)fden : 1 );
+
+    return (void *)x;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_pacer_tilde_setup(void)
+{
+    pdp_pacer_class = class_new(gensym("pdp_pacer~"), (t_newmethod)pdp_pacer_new,
+    	(t_method)pdp_pacer_free, sizeof(t_pdp_pacer), 0, A_DEFSYMBOL, A_DEFFLOAT, A_DEFFLOAT, A_NULL);
+
+    CLASS_MAINSIGNALIN(pdp_pacer_class, t_pdp_pacer, x_f);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_start, gensym("start"), A_NULL);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_stop, gensym("stop"), A_NULL);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_rate, gensym("rate"), A_FLOAT, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_dspclock, gensym("dspclock"), A_NULL);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_timer, gensym("timer"), A_NULL);
+    class_addmethod(pdp_pacer_class, (t_method)pdp_pacer_dsp, gensym("dsp"), A_NULL);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,9 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
+#include "pidip_roi.h"
 #include "yuv.h"
 #include <math.h>
 
@@ -58,6 +61,7 @@ typedef struct pdp_pen_struct
     int x_mode;  // 0=draw ( default), 1=erase
 
     short int *x_bdata;
+    t_pidip_roi x_roi;  // the drawing is only shown in this region
 
 } t_pdp_pen;
 
@@ -363,6 +367,7 @@ static void pdp_pen_process_yv12(t_pdp_pen *x)
     short int  *pY, *pU, *pV;
     short int  *pbY, *pbU, *pbV;
     short int  *pnY, *pnU, *pnV;
+    int      x0, y0, x1, y1;
 
     /* allocate all ressources */
     if ( ((int)header->info.image.width != x->x_vwidth ) ||
@@ -382,7 +387,7 @@ static void pdp_pen_process_yv12(t_pdp_pen *x)
 
     if ( !x->x_bdata ) return;
 
-    memcpy( newdata, data, (( x->x_vsize + (x->x_vsize>>1))<<1) );
+    pidip_inplace_copy( newdata, data, (( x->x_vsize + (x->x_vsize>>1))<<1) );
 
     pY = data;
     pU = (data+x->x_vsize);
@@ -394,9 +399,12 @@ static void pdp_pen_process_yv12(t_pdp_pen *x)
     pnU = (newdata+x->x_vsize);
     pnV = (newdata+x->x_vsize+(x->x_vsize>>2));
 
-    for(py=1; py<x->x_vheight; py++) 
+    x0 = 0; y0 = 1; x1 = x->x_vwidth; y1 = x->x_vheight;
+    if ( !pidip_roi_clip( &x->x_roi, x->x_vwidth, x->x_vheight, &x0, &y0, &x1, &y1 ) ) return;
+
+    for(py=y0; py<y1; py++) 
     {
-      for(px=0; px<x->x_vwidth; px++) 
+      for(px=x0; px<x1; px++) 
       {
         if ( ( (px-x->x_xoffset)>=0 ) && ( (px-x->x_xoffset)<x->x_vwidth ) &&
              ( (py-x->x_yoffset)>=0 ) && ( (py-x->x_yoffset)<x->x_vheight ) )
@@ -427,7 +435,7 @@ static void pdp_pen_sendpacket(t_pdp_pen *x)
     x->x_packet0 = -1;
 
     /* unregister and propagate if valid dest packet */
-    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+    pidip_roi_pass(x->x_outlet0, &x->x_packet1, &x->x_roi);
 }
 
 static void pdp_pen_process(t_pdp_pen *x)
@@ -443,8 +451,8 @@ static void pdp_pen_process(t_pdp_pen *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_pen_process_yv12, pdp_pen_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_pen_process_yv12, pdp_pen_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -465,7 +473,8 @@ static void pdp_pen_input_0(t_pdp_pen *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_roi_get( (int)f, &x->x_roi );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -479,7 +488,7 @@ static void pdp_pen_free(t_pdp_pen *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 
 }
@@ -503,6 +512,7 @@ void *pdp_pen_new(void)
 
     x->x_bdata = NULL;
     x->x_vsize = -1;
+    pidip_roi_clear( &x->x_roi );
 
     x->x_red = 255;
     x->x_green = 255;
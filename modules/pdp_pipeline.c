@@ -0,0 +1,196 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object runs a chain of effects, given as arguments,
+ *  in one processing, band by band ( see pidip_pipe.h ) :
+ *  [pdp_pipeline lumafilt binary erode dilate]
+ *  a message '<effect> <parameter> <values>' sets the parameter
+ *  of all the stages of this effect
+ */
+
+#include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pipe.h"
+
+#define PIPELINE_MAXARGS 8
+
+static char   *pdp_pipeline_version = "pdp_pipeline: version 0.1, fused chain of effects, written by Yves Degoyon (ydegoyon@free.fr)";
+
+typedef struct pdp_pipeline_struct
+{
+    t_object x_obj;
+
+    t_outlet *x_outlet0;
+    int x_packet0;
+    int x_packet1;
+    int x_queue_id;
+    int x_dropped;
+
+    t_pidip_pipe x_pipe;
+
+} t_pdp_pipeline;
+
+static void pdp_pipeline_band(t_pdp_pipeline *x, t_floatarg fband )
+{
+    if ( fband < 2 ) return;
+    pdp_queue_finish(x->x_queue_id);
+    pidip_pipe_band( &x->x_pipe, (int)fband );
+}
+
+static void pdp_pipeline_param(t_pdp_pipeline *x, t_symbol *s, int argc, t_atom *argv)
+{
+    t_float values[PIPELINE_MAXARGS];
+    int vi;
+
+    if ( ( argc < 1 ) || ( argv[0].a_type != A_SYMBOL ) || ( argc-1 > PIPELINE_MAXARGS ) )
+    {
+       post( "pdp_pipeline : usage : <effect> <parameter> <values>" );
+       return;
+    }
+    for ( vi=0; vi<argc-1; vi++ ) values[vi] = atom_getfloat( argv+1+vi );
+
+    // stages are not changed while a frame goes through them
+    pdp_queue_finish(x->x_queue_id);
+    if ( !pidip_pipe_param( &x->x_pipe, s->s_name, atom_getsymbol( argv )->s_name, argc-1, values ) )
+    {
+       post( "pdp_pipeline : no stage %s takes %s with %d values", s->s_name, atom_getsymbol( argv )->s_name, argc-1 );
+    }
+}
+
+static void pdp_pipeline_process_yv12(t_pdp_pipeline *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    short int *data   = (short int *)pdp_packet_data(x->x_packet0);
+    t_pdp     *newheader = pdp_packet_header(x->x_packet1);
+    short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
+
+    if ( !newdata ) return;
+
+    newheader->info.image.encoding = header->info.image.encoding;
+    newheader->info.image.width = header->info.image.width;
+    newheader->info.image.height = header->info.image.height;
+
+    pidip_pipe_yv12( &x->x_pipe, data, newdata, header->info.image.width, header->info.image.height );
+}
+
+static void pdp_pipeline_sendpacket(t_pdp_pipeline *x)
+{
+    /* release the packet */
+    pdp_packet_mark_unused(x->x_packet0);
+    x->x_packet0 = -1;
+
+    /* unregister and propagate if valid dest packet */
+    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+}
+
+static void pdp_pipeline_process(t_pdp_pipeline *x)
+{
+   t_pdp *header = 0;
+
+   /* check if image data packets are compatible */
+   if ( (header = pdp_packet_header(x->x_packet0))
+	&& (PDP_IMAGE == header->type)){
+
+	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
+
+	case PDP_IMAGE_YV12:
+            // the stages read rows around the ones they write, so the output is a new packet
+            x->x_packet1 = pdp_packet_new_image_YCrCb( header->info.image.width, header->info.image.height );
+            pidip_queue_add(x, pdp_pipeline_process_yv12, pdp_pipeline_sendpacket, &x->x_queue_id);
+	    break;
+
+	default:
+	    break;
+
+	}
+    }
+}
+
+static void pdp_pipeline_input_0(t_pdp_pipeline *x, t_symbol *s, t_floatarg f)
+{
+    if (s== gensym("register_rw"))
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    }
+
+    if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
+
+        /* add the process method and callback to the process queue */
+        pdp_pipeline_process(x);
+
+    }
+}
+
+static void pdp_pipeline_free(t_pdp_pipeline *x)
+{
+    pidip_queue_release(x, x->x_queue_id);
+    pdp_packet_mark_unused(x->x_packet0);
+    pidip_pipe_free( &x->x_pipe );
+}
+
+t_class *pdp_pipeline_class;
+
+void *pdp_pipeline_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_pdp_pipeline *x = (t_pdp_pipeline *)pd_new(pdp_pipeline_class);
+    int ai;
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
+
+    x->x_packet0 = -1;
+    x->x_packet1 = -1;
+    x->x_queue_id = -1;
+    x->x_dropped = 0;
+
+    pidip_pipe_init( &x->x_pipe );
+    for ( ai=0; ai<argc; ai++ )
+    {
+       if ( argv[ai].a_type != A_SYMBOL ) continue;
+       if ( !pidip_pipe_add( &x->x_pipe, atom_getsymbol( argv+ai )->s_name ) )
+       {
+          post( "pdp_pipeline : cannot add stage %s ( known : lumafilt, binary, erode, dilate )",
+                atom_getsymbol( argv+ai )->s_name );
+       }
+    }
+
+    return (void *)x;
+}
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_pipeline_setup(void)
+{
+    // post( pdp_pipeline_version );
+    pdp_pipeline_class = class_new(gensym("pdp_pipeline"), (t_newmethod)pdp_pipeline_new,
+    	(t_method)pdp_pipeline_free, sizeof(t_pdp_pipeline), 0, A_GIMME, A_NULL);
+
+    class_addmethod(pdp_pipeline_class, (t_method)pdp_pipeline_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_pipeline_class, (t_method)pdp_pipeline_band, gensym("band"),  A_FLOAT, A_NULL);
+    class_addanything(pdp_pipeline_class, (t_method)pdp_pipeline_param);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,259 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object reports the processing time and the drops of
+ *  every object queueing its processing ( see pidip_profile.h ),
+ *  sorted, as a table in the console or as messages on its outlet,
+ *  and the use of the pool of scratch buffers ( see pidip_pool.h )
+ */
+
+#include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+
+#define PROFILE_WALL 0
+#define PROFILE_CPU 1
+#define PROFILE_WAIT 2
+#define PROFILE_DROPS 3
+
+static char   *pdp_profile_version = "pdp_profile: version 0.1, processing time of objects, written by Yves Degoyon (ydegoyon@free.fr)";
+
+typedef struct pdp_profile_struct
+{
+    t_object x_obj;
+
+    t_outlet *x_outlet0;      // a message for each object
+
+    int x_sort;
+
+} t_pdp_profile;
+
+/* what is shown of a record, times in ms */
+typedef struct _profile_line
+{
+    char *l_name;
+    int l_instance;
+    unsigned int l_frames;
+    unsigned int l_drops;
+    t_float l_wall;           // average
+    t_float l_wallmax;
+    t_float l_cpu;            // average
+    t_float l_wait;           // average
+    t_float l_waitmax;
+    t_float l_load;           // % of the time spent processing
+    double l_key;
+} t_profile_line;
+
+static int pdp_profile_compare(const void *a, const void *b)
+{
+    double ka = ((t_profile_line *)a)->l_key;
+    double kb = ((t_profile_line *)b)->l_key;
+
+    return ( ka < kb ) ? 1 : ( ka > kb ) ? -1 : 0;
+}
+
+/* reads the records and sorts them, returns the number of lines */
+static int pdp_profile_collect(t_pdp_profile *x, t_profile_line **lines)
+{
+    t_pidip_profile *p;
+    t_profile_line *l;
+    int nblines = 0;
+    double elapsed = pidip_profile_elapsed();
+    unsigned int frames;
+
+    for ( p=pidip_profile_first(); p; p=p->p_next ) nblines++;
+    *lines = NULL;
+    if ( !nblines ) return 0;
+    *lines = (t_profile_line *) getbytes( nblines*sizeof(t_profile_line) );
+    if ( !*lines ) return 0;
+
+    for ( p=pidip_profile_first(), l=*lines; p; p=p->p_next, l++ )
+    {
+       memset( l, 0x0, sizeof(t_profile_line) );
+       l->l_name = pidip_profile_name( p );
+       l->l_instance = p->p_instance;
+       l->l_drops = p->p_nbdropped;
+       // the process thread has not done the last reset yet
+       frames = ( p->p_reseen == p->p_reset ) ? p->p_nbprocessed : 0;
+       l->l_frames = frames;
+       if ( frames )
+       {
+          l->l_wall = p->p_wall/frames/1000.;
+          l->l_wallmax = p->p_wallmax/1000.;
+          l->l_cpu = p->p_cpu/frames/1000.;
+          l->l_wait = p->p_wait/frames/1000.;
+          l->l_waitmax = p->p_waitmax/1000.;
+          if ( elapsed > 0. ) l->l_load = 100.*p->p_wall/elapsed;
+       }
+       switch ( x->x_sort )
+       {
+          case PROFILE_CPU:
+            l->l_key = frames ? p->p_cpu : 0.;
+            break;
+          case PROFILE_WAIT:
+            l->l_key = l->l_wait;
+            break;
+          case PROFILE_DROPS:
+            l->l_key = l->l_drops;
+            break;
+          default:
+            l->l_key = frames ? p->p_wall : 0.;
+            break;
+       }
+    }
+    qsort( *lines, nblines, sizeof(t_profile_line), pdp_profile_compare );
+    return nblines;
+}
+
+/* outputs : <class> instance frames drops wall wallmax cpu wait waitmax load */
+static void pdp_profile_bang(t_pdp_profile *x)
+{
+    t_profile_line *lines;
+    t_atom alist[9];
+    int i, nblines = pdp_profile_collect( x, &lines );
+
+    for ( i=0; i<nblines; i++ )
+    {
+       SETFLOAT(&alist[0], lines[i].l_instance);
+       SETFLOAT(&alist[1], lines[i].l_frames);
+       SETFLOAT(&alist[2], lines[i].l_drops);
+       SETFLOAT(&alist[3], lines[i].l_wall);
+       SETFLOAT(&alist[4], lines[i].l_wallmax);
+       SETFLOAT(&alist[5], lines[i].l_cpu);
+       SETFLOAT(&alist[6], lines[i].l_wait);
+       SETFLOAT(&alist[7], lines[i].l_waitmax);
+       SETFLOAT(&alist[8], lines[i].l_load);
+       outlet_anything( x->x_outlet0, gensym(lines[i].l_name), 9, alist );
+    }
+    if ( lines ) freebytes( lines, nblines*sizeof(t_profile_line) );
+}
+
+static void pdp_profile_printpool(void)
+{
+    t_pidip_pool_stats stats;
+
+    pidip_pool_stats( &stats );
+    post( "pdp_profile : pool : %lu hits %lu misses %lu released, resident %lu kB, used %lu kB ( peak %lu kB, limit %lu kB )",
+          stats.s_hits, stats.s_misses, stats.s_released, stats.s_resident>>10,
+          stats.s_used>>10, stats.s_peak>>10, stats.s_limit>>10 );
+}
+
+/* outputs : pool hits misses released resident used peak limit, sizes in kB */
+static void pdp_profile_pool(t_pdp_profile *x)
+{
+    t_pidip_pool_stats stats;
+    t_atom alist[7];
+
+    pidip_pool_stats( &stats );
+    SETFLOAT(&alist[0], stats.s_hits);
+    SETFLOAT(&alist[1], stats.s_misses);
+    SETFLOAT(&alist[2], stats.s_released);
+    SETFLOAT(&alist[3], stats.s_resident>>10);
+    SETFLOAT(&alist[4], stats.s_used>>10);
+    SETFLOAT(&alist[5], stats.s_peak>>10);
+    SETFLOAT(&alist[6], stats.s_limit>>10);
+    outlet_anything( x->x_outlet0, gensym("pool"), 7, alist );
+}
+
+static void pdp_profile_trim(t_pdp_profile *x)
+{
+    pidip_pool_trim();
+}
+
+static void pdp_profile_poollimit(t_pdp_profile *x, t_floatarg fmbytes)
+{
+    if ( fmbytes < 0 ) return;
+    pidip_pool_limit( (unsigned long)fmbytes*1024*1024 );
+}
+
+static void pdp_profile_print(t_pdp_profile *x)
+{
+    t_profile_line *lines;
+    int i, nblines = pdp_profile_collect( x, &lines );
+
+    post( "pdp_profile : %-20s %4s %8s %6s %9s %9s %9s %9s %9s %6s", "object", "inst", "frames", "drops",
+          "wall ms", "max ms", "cpu ms", "wait ms", "max ms", "load %" );
+    for ( i=0; i<nblines; i++ )
+    {
+       post( "pdp_profile : %-20s %4d %8u %6u %9.3f %9.3f %9.3f %9.3f %9.3f %6.2f",
+             lines[i].l_name, lines[i].l_instance, lines[i].l_frames, lines[i].l_drops,
+             lines[i].l_wall, lines[i].l_wallmax, lines[i].l_cpu,
+             lines[i].l_wait, lines[i].l_waitmax, lines[i].l_load );
+    }
+    if ( lines ) freebytes( lines, nblines*sizeof(t_profile_line) );
+    pdp_profile_printpool();
+}
+
+static void pdp_profile_sort(t_pdp_profile *x, t_symbol *s)
+{
+    if ( s == gensym("wall") ) x->x_sort = PROFILE_WALL;
+    else if ( s == gensym("cpu") ) x->x_sort = PROFILE_CPU;
+    else if ( s == gensym("wait") ) x->x_sort = PROFILE_WAIT;
+    else if ( s == gensym("drops") ) x->x_sort = PROFILE_DROPS;
+    else post( "pdp_profile : unknown sort key : %s ( wall, cpu, wait or drops )", s->s_name );
+}
+
+static void pdp_profile_reset(t_pdp_profile *x)
+{
+    pidip_profile_reset();
+}
+
+static void pdp_profile_free(t_pdp_profile *x)
+{
+}
+
+t_class *pdp_profile_class;
+
+void *pdp_profile_new(void)
+{
+    t_pdp_profile *x = (t_pdp_profile *)pd_new(pdp_profile_class);
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
+    x->x_sort = PROFILE_WALL;
+
+    return (void *)x;
+}
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_profile_setup(void)
+{
+//    post( pdp_profile_version );
+    pdp_profile_class = class_new(gensym("pdp_profile"), (t_newmethod)pdp_profile_new,
+    	(t_method)pdp_profile_free, sizeof(t_pdp_profile), 0, A_NULL);
+
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_bang, gensym("bang"), A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_print, gensym("print"),  A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_sort, gensym("sort"),  A_SYMBOL, A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_reset, gensym("reset"),  A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_pool, gensym("pool"),  A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_trim, gensym("trim"),  A_NULL);
+    class_addmethod(pdp_profile_class, (t_method)pdp_profile_poollimit, gensym("poollimit"),  A_FLOAT, A_NULL);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,6 +27,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include <math.h>
 
 #define DEFAULT_BLOCK_NUMBER  5
@@ -167,10 +169,10 @@ static void pdp_puzzle_right(t_pdp_puzzle *x )
 
 static void pdp_puzzle_free_ressources(t_pdp_puzzle *x)
 {
-    if ( x->x_blockpos ) freebytes( x->x_blockpos, x->x_blocknum*sizeof(int) );
-    if ( x->x_blockoffset ) freebytes( x->x_blockoffset, x->x_blocknum*sizeof(int) );
-    if ( x->x_ublockoffset ) freebytes( x->x_ublockoffset, x->x_blocknum*sizeof(int) );
-    if ( x->x_vblockoffset ) freebytes( x->x_vblockoffset, x->x_blocknum*sizeof(int) );
+    if ( x->x_blockpos ) pidip_pool_put( x->x_blockpos );
+    if ( x->x_blockoffset ) pidip_pool_put( x->x_blockoffset );
+    if ( x->x_ublockoffset ) pidip_pool_put( x->x_ublockoffset );
+    if ( x->x_vblockoffset ) pidip_pool_put( x->x_vblockoffset );
 }
 
 static void pdp_puzzle_allocate(t_pdp_puzzle *x)
@@ -183,10 +185,10 @@ static void pdp_puzzle_allocate(t_pdp_puzzle *x)
    x->x_blockh = x->x_nbblocks;
    x->x_blocknum = x->x_blockw * x->x_blockh;
 
-   x->x_blockpos = (int *) getbytes( x->x_blocknum*sizeof(int) );
-   x->x_blockoffset = (int *) getbytes( x->x_blocknum*sizeof(int) );
-   x->x_ublockoffset = (int *) getbytes( x->x_blocknum*sizeof(int) );
-   x->x_vblockoffset = (int *) getbytes( x->x_blocknum*sizeof(int) );
+   x->x_blockpos = (int *) pidip_pool_get( x->x_blocknum*sizeof(int) );
+   x->x_blockoffset = (int *) pidip_pool_get( x->x_blocknum*sizeof(int) );
+   x->x_ublockoffset = (int *) pidip_pool_get( x->x_blocknum*sizeof(int) );
+   x->x_vblockoffset = (int *) pidip_pool_get( x->x_blocknum*sizeof(int) );
    if( x->x_blockpos == NULL ||  x->x_blockoffset == NULL ||
        x->x_ublockoffset == NULL || x->x_vblockoffset == NULL ) 
    {
@@ -332,7 +334,7 @@ static void pdp_puzzle_process(t_pdp_puzzle *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_puzzle_process_yv12, pdp_puzzle_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_puzzle_process_yv12, pdp_puzzle_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -355,7 +357,7 @@ static void pdp_puzzle_input_0(t_pdp_puzzle *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -371,7 +373,7 @@ static void pdp_puzzle_free(t_pdp_puzzle *x)
   int i;
 
     pdp_puzzle_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
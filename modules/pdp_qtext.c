@@ -30,7 +30,9 @@
 #define _GNU_SOURCE
 #include <string.h>
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "yuv.h"
+#include "pidip_sprite.h"
 #include <math.h>
 #include <wchar.h>
 #include <ctype.h>
@@ -96,10 +98,10 @@ typedef struct pdp_qtext_struct
     t_object x_obj;
     t_float x_f;
 
-    t_int x_packet0;
-    t_int x_packet1;
-    t_int x_dropped;
-    t_int x_queue_id;
+    int x_packet0;
+    int x_packet1;
+    int x_dropped;
+    int x_queue_id;
 
     t_outlet *x_outlet0;
     t_int x_vwidth;
@@ -112,19 +114,25 @@ typedef struct pdp_qtext_struct
 
     // text layers
     TEXTLAYER *x_layers;
-    /* imlib data */
-    Imlib_Image x_image;
+    // rendered lines
+    t_pidip_textcache x_cache;
 
 } t_pdp_qtext;
 
+/* frames and texts come from getbytes */
+static void text_frame_free(TEXT_FRAME *frame)
+{
+	if (frame->text_array) freebytes(frame->text_array, strlen(frame->text_array)+1);
+	freebytes(frame, sizeof(TEXT_FRAME));
+}
+
 void text_layer_flush(TEXTLAYER *layer)
 {
 	while(layer->l_texts != NULL)
 	{
 		TEXT_FRAME *oldframe = layer->l_texts;		
 		layer->l_texts = oldframe->next;
-		free(oldframe->text_array);
-		free(oldframe);
+		text_frame_free(oldframe);
 	}
 	layer->l_last_text = NULL;
 	layer->l_ntexts = 0;
@@ -166,11 +174,11 @@ void text_layer_delete_start(TEXTLAYER *layer)
 	if (layer->l_texts != NULL)
 	{
 		TEXT_FRAME *oldframe = layer->l_texts;
-		//free(oldframe->text_array);
-		free(oldframe);
 		layer->l_texts = oldframe->next;
+		if (layer->l_texts == NULL) layer->l_last_text = NULL;
+		text_frame_free(oldframe);
+		layer->l_ntexts--;
 	}
-	layer->l_ntexts--;
 }
 
 TEXT_FRAME * text_layer_find_last(TEXTLAYER *layer)
@@ -197,21 +205,19 @@ void text_layer_delete_end(TEXTLAYER *layer)
 	if (layer->l_texts != NULL)
 	{
 		TEXT_FRAME *oldframe = layer->l_last_text;
-		//free(oldframe->text_array);
 		if (oldframe == layer->l_texts) // IF IT WAS FIRST
 		{
 			layer->l_last_text = NULL;
 			layer->l_texts = NULL;
-			free(oldframe);
 		}
 		else
 		{
 			layer->l_last_text = text_layer_find_ancestor(layer,layer->l_last_text);
 			layer->l_last_text->next = NULL;
 		}
-		free(oldframe);
+		text_frame_free(oldframe);
+		layer->l_ntexts--;
 	}
-	layer->l_ntexts--;
 }
 
 static void pdp_qtext_delete(t_pdp_qtext *x,  t_floatarg fnum  );
@@ -664,28 +670,13 @@ static void pdp_qtext_font(t_pdp_qtext *x, t_symbol *sfont  )
     x->x_layers[x->x_current].l_font = font;
 }
 
-static void pdp_qtext_allocate(t_pdp_qtext *x)
-{
-   x->x_image = imlib_create_image( x->x_vwidth, x->x_vheight );
-   if ( x->x_image == NULL )
-   {
-      post( "pdp_qtext : severe error : could not allocate image !!" );
-      return;
-   }
-   imlib_context_set_image(x->x_image);
-}
-
-static void pdp_qtext_free_ressources(t_pdp_qtext *x)
-{
-   // if ( x->x_image != NULL ) imlib_free_image();
-}
-
-void qtext_line_draw(t_pdp_qtext *x,char *text,int text_width,int text_height,int tlayer, int ti, int linenumber,double stime)
+void qtext_line_draw(t_pdp_qtext *x,short int *frame,char *text,int text_width,int text_height,int tlayer, int ti, int linenumber,double stime)
 {
    int base = tlayer;
    double newyoffset = 0;
    int yfinalposition;
    int alpha = x->x_layers[base].l_a;
+   t_pidip_textsprite *line;
    if (x->x_layers[base].l_mode == PIDIP_TEXT_MODE_SCROLL)
    {
 	if ((x->x_layers[base].l_upwards))
@@ -702,15 +693,26 @@ void qtext_line_draw(t_pdp_qtext *x,char *text,int text_width,int text_height,in
 	   base = x->x_chat_base;*/
    if (((text_height)*(linenumber+1)) + x->x_layers[base].l_yoffset + x->x_layers[base].l_marginv < x->x_vheight)		// CABE EN LOS  MARGENES ESPECIFICADOS (DE ALTO)
    {
+       // the line is rendered once, then blended with its alpha
        if ((x->x_layers[base].l_feed_turn+ti)%2&&(x->x_layers[base].l_mode==PIDIP_TEXT_MODE_FEED))
-              imlib_context_set_color( x->x_layers[base].l_2r, x->x_layers[base].l_2g, x->x_layers[base].l_2b, x->x_layers[base].l_2a);
+       {
+              line = pidip_textcache_get( &x->x_cache, text, x->x_layers[base].l_font, 
+                                          x->x_layers[base].l_2r, x->x_layers[base].l_2g, x->x_layers[base].l_2b,
+                                          x->x_layers[base].l_angle );
+              alpha = x->x_layers[base].l_2a;
+       }
        else
-              imlib_context_set_color( x->x_layers[base].l_r, x->x_layers[base].l_g, x->x_layers[base].l_b, alpha );
+       {
+              line = pidip_textcache_get( &x->x_cache, text, x->x_layers[base].l_font, 
+                                          x->x_layers[base].l_r, x->x_layers[base].l_g, x->x_layers[base].l_b,
+                                          x->x_layers[base].l_angle );
+       }
        if (x->x_layers[base].l_alignment == PIDIP_ALIGNMENT_CENTER)   
        {
-       		imlib_text_draw( x->x_layers[base].l_xoffset - (0.5*text_width) + (cos(x->x_layers[base].l_angle) * x->x_layers[base].l_scroll), 
+       		pidip_sprite_blend( &line->t_sprite, frame, x->x_vwidth, x->x_vheight,
+                        x->x_layers[base].l_xoffset - (0.5*text_width) + (cos(x->x_layers[base].l_angle) * x->x_layers[base].l_scroll), 
                         yfinalposition, 
-                        text );
+                        alpha+(alpha>>7) );
        }
        else		// left aligned text
        {
@@ -730,15 +732,16 @@ void qtext_line_draw(t_pdp_qtext *x,char *text,int text_width,int text_height,in
                 x->x_yoffsets[base] + (linenumber*(text_height)) + (sin(x->x_angle[base]) * x->x_scroll[base])+borde, 
                 text );*/
 	  // SET ALTERNATING COLORS
-       	  imlib_text_draw( x->x_layers[base].l_xoffset + (cos(x->x_layers[base].l_angle) * x->x_layers[base].l_scroll), 
-                           yfinalposition,text);
+       	  pidip_sprite_blend( &line->t_sprite, frame, x->x_vwidth, x->x_vheight,
+                           x->x_layers[base].l_xoffset + (cos(x->x_layers[base].l_angle) * x->x_layers[base].l_scroll), 
+                           yfinalposition, alpha+(alpha>>7) );
        }
    }
 }
 
 // DRAW ALL TEXTS
 
-static void pdp_qtext_draw_all_texts(t_pdp_qtext *x)
+static void pdp_qtext_draw_all_texts(t_pdp_qtext *x, short int *frame)
 {
     int	text_width, text_height;
     int chat_lines = 0;        // total lines of chat rendered
@@ -803,7 +806,7 @@ static void pdp_qtext_draw_all_texts(t_pdp_qtext *x)
 			else
 				textofinal = prev;
        			imlib_get_text_size( textofinal, &text_width, &text_height);
-	       			qtext_line_draw(x,textofinal, text_width,text_height,tlayer,feed_mes,chat_lines+linenumber,curr_text->time);
+	       			qtext_line_draw(x,frame,textofinal, text_width,text_height,tlayer,feed_mes,chat_lines+linenumber,curr_text->time);
 			if (wordcount == 1)
 			{
 				position = stpcpy(buf,"");
@@ -822,7 +825,7 @@ static void pdp_qtext_draw_all_texts(t_pdp_qtext *x)
 	      if (strlen(buf)>0)
 	      {
 	        imlib_get_text_size( buf, &text_width, &text_height);
-	        qtext_line_draw(x,buf, text_width,text_height,tlayer,feed_mes,chat_lines+linenumber,curr_text->time);
+	        qtext_line_draw(x,frame,buf, text_width,text_height,tlayer,feed_mes,chat_lines+linenumber,curr_text->time);
                 linenumber++;
 	      }
 	      free(cp);
@@ -833,7 +836,7 @@ static void pdp_qtext_draw_all_texts(t_pdp_qtext *x)
 	      	cp = strdup (curr_text->text_array);
 	      if (x->x_layers[base].l_mode == PIDIP_TEXT_MODE_SLOW && curr_text->time/10<strlen(curr_text->text_array))
 		      cp[(int)(curr_text->time/10)] = '\0';
-	       qtext_line_draw(x,cp, text_width,text_height,tlayer,feed_mes,chat_lines,curr_text->time);
+	       qtext_line_draw(x,frame,cp, text_width,text_height,tlayer,feed_mes,chat_lines,curr_text->time);
 	       linenumber=1;
 	      free(cp);
        }
@@ -845,7 +848,10 @@ static void pdp_qtext_draw_all_texts(t_pdp_qtext *x)
      curr_text->time++;
      if (curr_text->time > 400 && x->x_layers[tlayer].l_mode == PIDIP_TEXT_MODE_SCROLL && curr_text == x->x_layers[tlayer].l_texts)
      {
+	 // the next text is read before the frame is freed
+	 curr_text = curr_text->next;
 	 text_layer_delete_start(&x->x_layers[tlayer]);
+	 continue;
      }
      curr_text = curr_text->next;
     } // while(curr_text != NULL);
@@ -858,53 +864,21 @@ static void pdp_qtext_process_yv12(t_pdp_qtext *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    t_int     ti;
-    t_int     px, py;
-    unsigned char y, u, v;
-    DATA32    *imdata;
-    DATA32    bgcolor=0;
-    short int *pY, *pU, *pV;
-    int	text_width, text_height;
-    int chat_lines = 0;
 
-    // ensure the prepared surface is the same size as the image
-    if ( ( (int)(header->info.image.width) != x->x_vwidth ) ||
-         ( (int)(header->info.image.height) != x->x_vheight ) )
-    {
-         pdp_qtext_free_ressources(x);
-         x->x_vwidth = header->info.image.width;
-         x->x_vheight = header->info.image.height;
-         x->x_vsize = x->x_vwidth*x->x_vheight;
-         pdp_qtext_allocate(x);
-         post( "pdp_qtext : size change!!");
-    }
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
 
     // prepare packets
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
+    memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
 
-    // prepare image
-    if ( x->x_image != NULL ) imlib_context_set_image(x->x_image);
-    imdata = imlib_image_get_data();
-
-    // copy incoming packet to Imlib image
-    //llconv_yvu16planar2bgra(data, imdata, x->x_vwidth, x->x_vheight);
-    //pdp_llconv(data, RIF_YVU__P411_S16, imdata, RIF_BGRA_P____U8, x->x_vwidth, x->x_vheight);
- //   draw_rgb_image(x);
-
-    yuv_Y122RGB( data, imdata, x->x_vwidth, x->x_vheight );
-
-    imlib_image_put_back_data(imdata);
-    // draw all texts to imlib surface
-    pdp_qtext_draw_all_texts(x);
-    imdata = imlib_image_get_data();
-    
-    // copy Imlib image to outgoing packet
-    //llconv_bgra2yvu_planar16sub(imdata, newdata, x->x_vwidth, x->x_vheight);
-    //yuv_RGB2Y12( imdata, newdata, x->x_vwidth, x->x_vheight );
-    pdp_llconv(imdata, RIF_RGBA_P____U8, newdata, RIF_YVU__P411_S16, x->x_vwidth, x->x_vheight);
+    // blend all texts, lines are only rendered when they change
+    pdp_qtext_draw_all_texts(x, newdata);
+    pidip_textcache_collect( &x->x_cache );
 
     return;
 }
@@ -934,7 +908,7 @@ static void pdp_qtext_process(t_pdp_qtext *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_qtext_process_yv12, pdp_qtext_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_qtext_process_yv12, pdp_qtext_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -960,7 +934,7 @@ static void pdp_qtext_input_0(t_pdp_qtext *x, t_symbol *s, t_floatarg f)
 	switch(pdp_packet_header((int)f)->info.image.encoding)
         {
 	  case PDP_IMAGE_YV12:
-          x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+          x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 	  break;
 	}
     }
@@ -977,9 +951,9 @@ static void pdp_qtext_free(t_pdp_qtext *x)
 {
   int i;
 
-    pdp_qtext_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_textcache_flush( &x->x_cache );
 }
 
 t_class *pdp_qtext_class;
@@ -1002,7 +976,7 @@ void *pdp_qtext_new(void)
    x->x_packet0 = -1;
    x->x_packet1 = -1;
    x->x_queue_id = -1;
-   x->x_image = NULL;
+   pidip_textcache_init( &x->x_cache );
 
 
    x->x_capacity = DEFAULT_CAPACITY;
@@ -26,9 +26,12 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_history.h"
 #include <math.h>
 
 #define DEFAULT_PLANES             16
+#define MAX_PLANES                 100
 
 static int fastrand_val=0;
 #define inline_fastrand() (fastrand_val=fastrand_val*1103515245+12345)
@@ -52,53 +55,30 @@ typedef struct pdp_quark_struct
     int x_vwidth;
     int x_vheight;
     int x_vsize;
-    short int *x_buffer;
-    short int **x_planetable;
-    int x_plane;
+    t_pidip_history *x_history;      // frames are kept there, by reference
+    int x_pinned[MAX_PLANES];        // frames used by the current process
+    int x_nbpinned;
     int x_planes;
     int x_tolerance;
 
 } t_pdp_quark;
 
-static void pdp_quark_free_ressources(t_pdp_quark *x)
-{
-    if ( x->x_buffer ) free ( x->x_buffer );
-    if ( x->x_planetable ) free ( x->x_planetable );
-}
-
-static void pdp_quark_allocate(t_pdp_quark *x)
-{
-  int i;
-
-    // allocate space for the frame buffers.  A lot of memory is required -
-    // with the default settings, it totals nearly 5 megs.
-    x->x_buffer = (short int *) getbytes ( ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * 2 * x->x_planes);
-    x->x_planetable = (short int**) getbytes( x->x_planes*sizeof( short int* ) );
-
-    // set up the array of pointers to the frame buffers
-    for(i=0;i<x->x_planes;i++) 
-    {
-       x->x_planetable[i] = &x->x_buffer[ ( ( x->x_vsize + ( x->x_vsize>>1 ) ) << 1 ) * i];
-    }
-
-    if ( !x->x_buffer )
-    {
-       post( "pdp_quark : severe error : cannot allocate buffers !!! ");
-       return;
-    }
-}
-
 static void pdp_quark_planes(t_pdp_quark *x, t_floatarg fplanes)
 {
-   if ( ( (int)fplanes > 1 ) && ( (int)fplanes < 100 ) )
+   if ( ( (int)fplanes > 1 ) && ( (int)fplanes < MAX_PLANES ) )
    {
-      pdp_quark_free_ressources(x); 
+      pidip_history_depth(x->x_history, x->x_planes, (int)fplanes);
       x->x_planes = (int) fplanes;
-      x->x_plane=x->x_planes-1;
-      pdp_quark_allocate(x);
    }
 }
 
+    /* share the frames with other temporal effects reading the same source */
+static void pdp_quark_history(t_pdp_quark *x, t_symbol *s)
+{
+    pidip_history_detach(x->x_history, x->x_planes);
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
+}
+
 static void pdp_quark_tolerance(t_pdp_quark *x, t_floatarg ftolerance)
 {
    if ( (int)ftolerance > 1 )
@@ -115,37 +95,36 @@ static void pdp_quark_process_yv12(t_pdp_quark *x)
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int     i, cf, diff;
 
-    /* allocate all ressources */
-    if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
+    short int *planetable[MAX_PLANES];
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
+
+    /* the pinned frames, newest first, the current one included */
+    for(i=0; i<x->x_nbpinned; i++)
     {
-        pdp_quark_free_ressources(x);
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        x->x_plane = x->x_planes-1;
-        pdp_quark_allocate(x);
-        post( "pdp_quark : reallocated buffers" );
+       planetable[i] = (short int *)pdp_packet_data(x->x_pinned[i]);
     }
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy(x->x_planetable[x->x_plane], data, (x->x_vsize + (x->x_vsize>>1))<<1 );
     for(i=0; i<x->x_vsize+(x->x_vsize>>1); i++) 
     {
-       cf = (x->x_plane + (inline_fastrand()>>24))&(x->x_planes-1);
+       cf = ((((unsigned int)inline_fastrand())>>24)*x->x_nbpinned)>>8;
        if ( i<x->x_vsize )
        {
-          diff = ((x->x_planetable[cf])[i] - data[i])>>7;
+          diff = ((planetable[cf])[i] - data[i])>>7;
        }
        else
        {
-          diff = (((x->x_planetable[cf])[i] - data[i] )>>8)+128;
+          diff = (((planetable[cf])[i] - data[i] )>>8)+128;
        }
        if ( abs ( diff ) > x->x_tolerance )
        {
-         newdata[i] = (x->x_planetable[cf])[i];
+         newdata[i] = (planetable[cf])[i];
        }
        else
        {
@@ -154,17 +133,16 @@ static void pdp_quark_process_yv12(t_pdp_quark *x)
        /* The reason why I use high order 8 bits is written in utils.c
         (or, 'man rand') */
     }
-    x->x_plane--;
-    if ( x->x_plane < 0 ) x->x_plane = x->x_planes-1;
-
     return;
 }
 
 static void pdp_quark_sendpacket(t_pdp_quark *x)
 {
-    /* release the packet */
+    /* release the packets */
     pdp_packet_mark_unused(x->x_packet0);
     x->x_packet0 = -1;
+    pidip_history_unpin(x->x_pinned, x->x_nbpinned);
+    x->x_nbpinned = 0;
 
     /* unregister and propagate if valid dest packet */
     pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
@@ -184,7 +162,9 @@ static void pdp_quark_process(t_pdp_quark *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_quark_process_yv12, pdp_quark_sendpacket, &x->x_queue_id);
+            pidip_history_push(x->x_history, x->x_packet0);
+            x->x_nbpinned = pidip_history_pin(x->x_history, x->x_pinned, x->x_planes);
+            pidip_queue_add(x, pdp_quark_process_yv12, pdp_quark_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -205,7 +185,7 @@ static void pdp_quark_input_0(t_pdp_quark *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -218,14 +198,15 @@ static void pdp_quark_free(t_pdp_quark *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
-    pdp_quark_free_ressources(x);
+    pidip_history_unpin(x->x_pinned, x->x_nbpinned);
+    pidip_history_detach(x->x_history, x->x_planes);
 }
 
 t_class *pdp_quark_class;
 
-void *pdp_quark_new(void)
+void *pdp_quark_new(t_symbol *s)
 {
     int i;
 
@@ -239,7 +220,8 @@ void *pdp_quark_new(void)
     x->x_queue_id = -1;
     x->x_planes = DEFAULT_PLANES;
 
-    x->x_buffer = NULL;
+    x->x_nbpinned = 0;
+    x->x_history = pidip_history_attach( (s==&s_)?NULL:s, x->x_planes );
 
     return (void *)x;
 }
@@ -255,11 +237,12 @@ void pdp_quark_setup(void)
 {
 //    post( pdp_quark_version );
     pdp_quark_class = class_new(gensym("pdp_quark"), (t_newmethod)pdp_quark_new,
-    	(t_method)pdp_quark_free, sizeof(t_pdp_quark), 0, A_NULL);
+    	(t_method)pdp_quark_free, sizeof(t_pdp_quark), 0, A_DEFSYMBOL, A_NULL);
 
     class_addmethod(pdp_quark_class, (t_method)pdp_quark_input_0, gensym("pdp"), A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_quark_class, (t_method)pdp_quark_planes, gensym("planes"), A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_quark_class, (t_method)pdp_quark_tolerance, gensym("tolerance"), A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_quark_class, (t_method)pdp_quark_history, gensym("history"), A_DEFSYMBOL, A_NULL);
 
 
 }
@@ -26,6 +26,10 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_inplace.h"
+#include "pidip_bgmodel.h"
 #include <math.h>
 
 #define COLORS 32
@@ -69,17 +73,18 @@ typedef struct pdp_radioactiv_struct
     short int *x_diff;
     short int *x_bdata;
     int x_snapshot;
+    t_pidip_bgmodel *x_model;  // shared background model, NULL for the snapshot
 
 } t_pdp_radioactiv;
 
 static void pdp_radioactiv_free_ressources(t_pdp_radioactiv *x)
 {
-   if ( x->x_blurzoombuf ) freebytes ( x->x_blurzoombuf, x->x_buf_area*2 );
-   if ( x->x_blurzoomx ) freebytes ( x->x_blurzoomx, x->x_buf_width*sizeof(int) );
-   if ( x->x_blurzoomy ) freebytes ( x->x_blurzoomy, x->x_buf_height*sizeof(int) );
-   if ( x->x_snapframe ) freebytes ( x->x_snapframe, ( ( x->x_vsize + x->x_vsize>>1 ) << 1 ) );
-   if ( x->x_diff ) freebytes( x->x_diff, (x->x_vsize + (x->x_vsize>>1))<<1 );
-   if ( x->x_bdata ) freebytes( x->x_bdata, (( x->x_vsize + (x->x_vsize>>1))<<1));
+   if ( x->x_blurzoombuf ) pidip_pool_put ( x->x_blurzoombuf );
+   if ( x->x_blurzoomx ) pidip_pool_put ( x->x_blurzoomx );
+   if ( x->x_blurzoomy ) pidip_pool_put ( x->x_blurzoomy );
+   if ( x->x_snapframe ) pidip_pool_put ( x->x_snapframe );
+   if ( x->x_diff ) pidip_pool_put( x->x_diff );
+   if ( x->x_bdata ) pidip_pool_put( x->x_bdata );
 }
 
 static void pdp_radioactiv_allocate(t_pdp_radioactiv *x)
@@ -93,12 +98,12 @@ static void pdp_radioactiv_allocate(t_pdp_radioactiv *x)
    x->x_buf_margin_left = (x->x_vwidth - x->x_buf_width)/2;
    x->x_buf_margin_right = x->x_vwidth - x->x_buf_width - x->x_buf_margin_left;
 
-   x->x_blurzoombuf = (unsigned char *) getbytes (x->x_buf_area*2);
-   x->x_blurzoomx = (int *) getbytes (x->x_buf_width*sizeof(int));
-   x->x_blurzoomy = (int *) getbytes (x->x_buf_height*sizeof(int));
-   x->x_snapframe = (short int *) getbytes ( ( ( x->x_vsize + x->x_vsize>>1 ) << 1 ) );
-   x->x_diff = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
-   x->x_bdata = (short int *) getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
+   x->x_blurzoombuf = (unsigned char *) pidip_pool_get (x->x_buf_area*2);
+   x->x_blurzoomx = (int *) pidip_pool_get (x->x_buf_width*sizeof(int));
+   x->x_blurzoomy = (int *) pidip_pool_get (x->x_buf_height*sizeof(int));
+   x->x_snapframe = (short int *) pidip_pool_get ( ( ( x->x_vsize + x->x_vsize>>1 ) << 1 ) );
+   x->x_diff = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
+   x->x_bdata = (short int *) pidip_pool_get((( x->x_vsize + (x->x_vsize>>1))<<1));
 
    if ( !x->x_blurzoombuf || !x->x_blurzoomx || !x->x_blurzoomy || 
         !x->x_snapframe || !x->x_diff || !x->x_bdata )
@@ -299,6 +304,7 @@ static void pdp_radioactiv_process_yv12(t_pdp_radioactiv *x)
     short int a, b;
     unsigned char *p;
     short int *diff, *src;
+    int v;
 
     /* allocate all ressources */
     if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize ) 
@@ -327,20 +333,41 @@ static void pdp_radioactiv_process_yv12(t_pdp_radioactiv *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1);
+    pidip_inplace_copy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
 
     if(x->x_mode != 2 || x->x_snap_time <= 0) 
     {
-       pdp_radioactiv_diff(x, data);
+       if ( x->x_model && pidip_bgmodel_update( x->x_model ) )
+       {
+          pidip_bgmodel_expand( x->x_model, x->x_diff, x->x_vwidth, x->x_vheight,
+                                PIDIP_BGMODEL_ABS|PIDIP_BGMODEL_MASKED );
+       }
+       else
+       {
+          pdp_radioactiv_diff(x, data);
+       }
        if(x->x_mode == 0 || x->x_snap_time <= 0) 
        {
            diff = x->x_diff + x->x_buf_margin_left;
            p = x->x_blurzoombuf;
            for(py=0; py<x->x_buf_height; py++) 
            {
-             for(px=0; px<x->x_buf_width; px++) 
+             if ( x->x_model )
              {
-               p[px] |= diff[px] >> 3;
+               // model differences are on 0..255<<7, brighter moves glow more
+               for(px=0; px<x->x_buf_width; px++) 
+               {
+                 p[px] |= diff[px] >> 10;
+               }
+             }
+             else
+             {
+               // frame differences are signed and can go beyond the palette
+               for(px=0; px<x->x_buf_width; px++) 
+               {
+                 v = diff[px] >> 3;
+                 p[px] |= ( v < 0 ) ? 0 : ( v >= COLORS ) ? COLORS-1 : v;
+               }
              }
              diff += x->x_vwidth;
              p += x->x_buf_width;
@@ -417,8 +444,8 @@ static void pdp_radioactiv_process(t_pdp_radioactiv *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_radioactiv_process_yv12, pdp_radioactiv_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_radioactiv_process_yv12, pdp_radioactiv_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -438,7 +465,10 @@ static void pdp_radioactiv_input_0(t_pdp_radioactiv *x, t_symbol *s, t_floatarg
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_bgmodel_push(x->x_model, x->x_packet0);
+    }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -448,12 +478,21 @@ static void pdp_radioactiv_input_0(t_pdp_radioactiv *x, t_symbol *s, t_floatarg
     }
 }
 
+/* use a shared background model instead of the snapshot, no name goes back to the snapshot */
+static void pdp_radioactiv_bgmodel(t_pdp_radioactiv *x, t_symbol *s)
+{
+    pdp_queue_finish(x->x_queue_id);
+    pidip_bgmodel_detach(x->x_model);
+    x->x_model = (s==&s_) ? NULL : pidip_bgmodel_attach(s);
+}
+
 static void pdp_radioactiv_free(t_pdp_radioactiv *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_bgmodel_detach(x->x_model);
     pdp_radioactiv_free_ressources(x);
 
 }
@@ -474,6 +513,7 @@ void *pdp_radioactiv_new(void)
     x->x_packet0 = -1;
     x->x_packet1 = -1;
     x->x_queue_id = -1;
+    x->x_model = NULL;
 
     x->x_mode = 0; 	/* 0=normal/1=strobe/2=strobe2/3=trigger */
     x->x_blurzoombuf = NULL;
@@ -506,6 +546,7 @@ void pdp_radioactiv_setup(void)
 
     class_addmethod(pdp_radioactiv_class, (t_method)pdp_radioactiv_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_radioactiv_class, (t_method)pdp_radioactiv_mode, gensym("mode"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_radioactiv_class, (t_method)pdp_radioactiv_bgmodel, gensym("bgmodel"),  A_DEFSYMBOL, A_NULL);
     class_addmethod(pdp_radioactiv_class, (t_method)pdp_radioactiv_snap_time, gensym("snaptime"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_radioactiv_class, (t_method)pdp_radioactiv_snap_interval, gensym("snapinterval"),  A_FLOAT, A_NULL);
 
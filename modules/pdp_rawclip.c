@@ -0,0 +1,211 @@
+/*
+ *   Pure Data Packet module.
+ *   Copyright (c) by Yves Degoyon <ydegoyon@free.fr>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object plays raw clips ( see pdp_rawconv )
+ *  The clip is mapped in memory, so opening is instant,
+ *  and the pages of the next frames are read ahead in the play direction
+ */
+
+#include "pdp.h"
+#include "pidip_clip.h"
+#include "pidip_pacer.h"
+
+#define PDP_RAWCLIP_READAHEAD 25 // default number of frames read ahead
+
+typedef struct pdp_rawclip_struct
+{
+    t_object x_obj;
+    t_float x_f;
+
+    t_outlet *x_outlet0;
+    t_outlet *x_curframe;
+    t_outlet *x_nbframes;
+    t_outlet *x_framerate;
+
+    t_pidip_clip x_clip;
+    t_pidip_pacer *x_pacer; // frame clock driving the playback
+
+    int x_frame;      // next frame to output
+    int x_last;       // last output frame
+    int x_direction;  // 1 or -1
+    int x_loop;
+    int x_readahead;
+
+} t_pdp_rawclip;
+
+static void pdp_rawclip_close(t_pdp_rawclip *x)
+{
+    pidip_clip_close( &x->x_clip );
+}
+
+static void pdp_rawclip_open(t_pdp_rawclip *x, t_symbol *name)
+{
+  t_pidip_clipheader *h = &x->x_clip.c_header;
+
+    if ( !pidip_clip_open( &x->x_clip, name->s_name ) )
+    {
+       post( "pdp_rawclip : could not open %s ( not a raw clip ? )", name->s_name );
+       return;
+    }
+
+    x->x_frame = 0;
+    x->x_last = -1;
+    x->x_direction = 1;
+    pidip_clip_readahead( &x->x_clip, -1, x->x_readahead, x->x_loop );
+
+    outlet_float( x->x_framerate, (float)h->h_ratenum/h->h_rateden );
+    outlet_float( x->x_nbframes, (float)h->h_nbframes );
+}
+
+static void pdp_rawclip_output(t_pdp_rawclip *x, int frame)
+{
+  t_pidip_clipheader *h = &x->x_clip.c_header;
+  int object, last = h->h_nbframes-1;
+  t_pdp *header;
+
+    if ( !x->x_clip.c_map || ( h->h_nbframes <= 0 ) ) return;
+
+    if ( x->x_loop ) frame = ( ( frame % h->h_nbframes ) + h->h_nbframes ) % h->h_nbframes;
+    if ( frame > last ) frame = last;
+    if ( frame < 0 ) frame = 0;
+
+    // the play direction, loops included
+    if ( ( x->x_last == last ) && ( frame == 0 ) && x->x_loop )
+       x->x_direction = 1;
+    else if ( ( x->x_last == 0 ) && ( frame == last ) && x->x_loop )
+       x->x_direction = -1;
+    else if ( ( x->x_last >= 0 ) && ( frame != x->x_last ) )
+       x->x_direction = ( frame > x->x_last ) ? 1 : -1;
+
+    pidip_clip_readahead( &x->x_clip, frame, x->x_direction*x->x_readahead, x->x_loop );
+
+    object = pdp_packet_new_image_YCrCb( h->h_width, h->h_height );
+    header = pdp_packet_header( object );
+    if ( !header ) return;
+    header->info.image.encoding = PDP_IMAGE_YV12;
+    header->info.image.width = h->h_width;
+    header->info.image.height = h->h_height;
+
+    pidip_clip_frame( &x->x_clip, frame, (short int *)pdp_packet_data( object ) );
+
+    x->x_last = frame;
+    x->x_frame = frame+1;
+    outlet_float( x->x_curframe, (float)frame );
+    pdp_packet_pass_if_valid( x->x_outlet0, &object );
+}
+
+static void pdp_rawclip_bang(t_pdp_rawclip *x)
+{
+    pdp_rawclip_output( x, x->x_frame );
+}
+
+static void pdp_rawclip_frame(t_pdp_rawclip *x, t_floatarg frameindex)
+{
+    pdp_rawclip_output( x, (int)frameindex );
+}
+
+static void pdp_rawclip_frame_cold(t_pdp_rawclip *x, t_floatarg frameindex)
+{
+    x->x_frame = (int)frameindex;
+}
+
+static void pdp_rawclip_loop(t_pdp_rawclip *x, t_floatarg loop)
+{
+    x->x_loop = ( (int)loop != 0 );
+}
+
+static void pdp_rawclip_readahead(t_pdp_rawclip *x, t_floatarg frames)
+{
+    if ( frames < 0 )
+    {
+       post( "pdp_rawclip : wrong number of frames to read ahead : %d", (int)frames );
+       return;
+    }
+    x->x_readahead = (int)frames;
+}
+
+/* a tick of the frame clock, frames skipped by the clock are dropped */
+static void pdp_rawclip_tick(void *owner, int frame, int skipped)
+{
+    t_pdp_rawclip *x = (t_pdp_rawclip *)owner;
+
+    pdp_rawclip_output( x, x->x_frame + skipped );
+}
+
+static void pdp_rawclip_pace(t_pdp_rawclip *x, t_symbol *s)
+{
+    x->x_pacer = pidip_pacer_follow( x->x_pacer, s, x, pdp_rawclip_tick );
+}
+
+static void pdp_rawclip_free(t_pdp_rawclip *x)
+{
+    pdp_rawclip_pace(x, &s_);
+    pdp_rawclip_close(x);
+}
+
+t_class *pdp_rawclip_class;
+
+void *pdp_rawclip_new(void)
+{
+    t_pdp_rawclip *x = (t_pdp_rawclip *)pd_new(pdp_rawclip_class);
+
+    inlet_new(&x->x_obj, &x->x_obj.ob_pd, gensym("float"), gensym("frame_cold"));
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
+    x->x_curframe = outlet_new(&x->x_obj, &s_float);
+    x->x_nbframes = outlet_new(&x->x_obj, &s_float);
+    x->x_framerate = outlet_new(&x->x_obj, &s_float);
+
+    pidip_clip_init( &x->x_clip );
+    x->x_pacer = NULL;
+    x->x_frame = 0;
+    x->x_last = -1;
+    x->x_direction = 1;
+    x->x_loop = 1;
+    x->x_readahead = PDP_RAWCLIP_READAHEAD;
+
+    return (void *)x;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_rawclip_setup(void)
+{
+    pdp_rawclip_class = class_new(gensym("pdp_rawclip"), (t_newmethod)pdp_rawclip_new,
+    	(t_method)pdp_rawclip_free, sizeof(t_pdp_rawclip), 0, A_NULL);
+
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_bang, gensym("bang"), A_NULL);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_close, gensym("close"), A_NULL);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_open, gensym("open"), A_SYMBOL, A_NULL);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_loop, gensym("loop"), A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_readahead, gensym("readahead"), A_FLOAT, A_NULL);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_pace, gensym("pace"), A_DEFSYMBOL, A_NULL);
+    class_addfloat (pdp_rawclip_class, (t_method)pdp_rawclip_frame);
+    class_addmethod(pdp_rawclip_class, (t_method)pdp_rawclip_frame_cold, gensym("frame_cold"), A_FLOAT, A_NULL);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,227 @@
+/*
+ *   Pure Data Packet module.
+ *   Copyright (c) by Yves Degoyon <ydegoyon@free.fr>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object converts any file a pidip source can read
+ *  into a raw clip ( see pdp_rawclip ), in a separate thread
+ *  The clip is written to <name>.part and renamed when it's complete
+ */
+
+#include "pdp.h"
+#include "pidip_source.h"
+#include "pidip_clip.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef struct pdp_rawconv_struct
+{
+    t_object x_obj;
+    t_float x_f;
+
+    t_outlet *x_outlet0; // converted frames
+    t_outlet *x_outlet1; // number of frames
+    t_outlet *x_outlet2; // bang when a conversion is over
+
+    char x_input[MAXPDSTRING];
+    char x_output[MAXPDSTRING];
+
+    t_pidip_source x_source;
+
+    pthread_t x_thread;
+    int x_thread_running;     // a thread was launched and not joined yet
+    volatile int x_converting;
+    volatile int x_stop;
+    volatile int x_converted;
+    volatile int x_nbframes;
+    volatile int x_result;    // 1 when done, -1 on failure
+    int x_reported;
+
+} t_pdp_rawconv;
+
+static void *pdp_rawconv_thread(void *tdata)
+{
+  t_pdp_rawconv *x = (t_pdp_rawconv *)tdata;
+  t_pidip_source_info *info = &x->x_source.s_info;
+  t_pidip_clipwriter writer;
+  char partname[MAXPDSTRING+8];
+  short int *data;
+  int fi, num, den, ok = 0;
+
+    snprintf( partname, sizeof(partname), "%s.part", x->x_output );
+
+    // the source decodes the next frames while this one is written
+    if ( pidip_source_open( &x->x_source, x->x_input, PIDIP_SOURCE_CACHE, PIDIP_SOURCE_PREFETCH ) )
+    {
+       x->x_nbframes = info->i_nbframes;
+       pidip_clip_rate( info->i_framerate, &num, &den );
+       data = (short int *) getbytes( x->x_source.s_framesize );
+       if ( data && pidip_clip_create( &writer, partname, info->i_width, info->i_height, num, den ) )
+       {
+          ok = 1;
+          for ( fi=0; ( fi<info->i_nbframes ) && !x->x_stop; fi++ )
+          {
+             if ( !pidip_source_frame( &x->x_source, fi, data ) || !pidip_clip_write( &writer, data ) )
+             {
+                ok = 0;
+                break;
+             }
+             x->x_converted = fi+1;
+          }
+          if ( !pidip_clip_finish( &writer ) || x->x_stop ) ok = 0;
+          if ( ok && ( rename( partname, x->x_output ) < 0 ) )
+          {
+             post( "pdp_rawconv : could not rename %s", partname );
+             ok = 0;
+          }
+          if ( !ok ) unlink( partname );
+       }
+       if ( data ) freebytes( data, x->x_source.s_framesize );
+       pidip_source_close( &x->x_source );
+    }
+
+    x->x_result = ( ok ) ? 1 : -1;
+    x->x_converting = 0;
+    return NULL;
+}
+
+static void pdp_rawconv_join(t_pdp_rawconv *x)
+{
+    if ( x->x_thread_running )
+    {
+       pthread_join( x->x_thread, NULL );
+       x->x_thread_running = 0;
+    }
+}
+
+static void pdp_rawconv_convert(t_pdp_rawconv *x, t_symbol *input, t_symbol *output)
+{
+  pthread_attr_t convert_attr;
+
+    if ( x->x_converting )
+    {
+       post( "pdp_rawconv : a conversion is running, stop it first" );
+       return;
+    }
+    pdp_rawconv_join( x );
+
+    // a truncated name would convert to the wrong file
+    if ( ( snprintf( x->x_input, MAXPDSTRING, "%s", input->s_name ) >= MAXPDSTRING )
+         || ( snprintf( x->x_output, MAXPDSTRING, "%s%s", ( output != &s_ ) ? output->s_name : input->s_name,
+                        ( output != &s_ ) ? "" : PIDIP_CLIP_EXTENSION ) >= MAXPDSTRING ) )
+    {
+       post( "pdp_rawconv : file name too long : %s", input->s_name );
+       return;
+    }
+
+    x->x_stop = 0;
+    x->x_converted = 0;
+    x->x_nbframes = 0;
+    x->x_result = 0;
+    x->x_reported = 0;
+    x->x_converting = 1;
+
+    pthread_attr_init( &convert_attr );
+    pthread_attr_setdetachstate( &convert_attr, PTHREAD_CREATE_JOINABLE );
+    if ( pthread_create( &x->x_thread, &convert_attr, pdp_rawconv_thread, x ) != 0 )
+    {
+       post( "pdp_rawconv : could not launch conversion thread" );
+       x->x_converting = 0;
+       return;
+    }
+    x->x_thread_running = 1;
+    post( "pdp_rawconv : converting %s to %s", x->x_input, x->x_output );
+}
+
+/* the progress is polled, a bang is sent once when the conversion is over */
+static void pdp_rawconv_bang(t_pdp_rawconv *x)
+{
+    outlet_float( x->x_outlet1, (float)x->x_nbframes );
+    outlet_float( x->x_outlet0, (float)x->x_converted );
+
+    if ( x->x_result && !x->x_reported )
+    {
+       x->x_reported = 1;
+       pdp_rawconv_join( x );
+       if ( x->x_result > 0 )
+       {
+          post( "pdp_rawconv : %s : %d frames converted", x->x_output, x->x_converted );
+          outlet_bang( x->x_outlet2 );
+       }
+       else
+       {
+          post( "pdp_rawconv : conversion of %s failed or stopped", x->x_input );
+       }
+    }
+}
+
+static void pdp_rawconv_stop(t_pdp_rawconv *x)
+{
+    x->x_stop = 1;
+}
+
+static void pdp_rawconv_free(t_pdp_rawconv *x)
+{
+    x->x_stop = 1;
+    pdp_rawconv_join( x );
+    pidip_source_free( &x->x_source );
+}
+
+t_class *pdp_rawconv_class;
+
+void *pdp_rawconv_new(void)
+{
+    t_pdp_rawconv *x = (t_pdp_rawconv *)pd_new(pdp_rawconv_class);
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_float);
+    x->x_outlet1 = outlet_new(&x->x_obj, &s_float);
+    x->x_outlet2 = outlet_new(&x->x_obj, &s_bang);
+
+    pidip_source_init( &x->x_source );
+    x->x_thread_running = 0;
+    x->x_converting = 0;
+    x->x_stop = 0;
+    x->x_converted = 0;
+    x->x_nbframes = 0;
+    x->x_result = 0;
+    x->x_reported = 1;
+
+    return (void *)x;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_rawconv_setup(void)
+{
+    pdp_rawconv_class = class_new(gensym("pdp_rawconv"), (t_newmethod)pdp_rawconv_new,
+    	(t_method)pdp_rawconv_free, sizeof(t_pdp_rawconv), 0, A_NULL);
+
+    class_addmethod(pdp_rawconv_class, (t_method)pdp_rawconv_bang, gensym("bang"), A_NULL);
+    class_addmethod(pdp_rawconv_class, (t_method)pdp_rawconv_convert, gensym("convert"), A_SYMBOL, A_DEFSYMBOL, A_NULL);
+    class_addmethod(pdp_rawconv_class, (t_method)pdp_rawconv_stop, gensym("stop"), A_NULL);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
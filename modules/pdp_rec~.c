@@ -20,14 +20,25 @@
 
 /*  This object is a video recording object 
  *  It records its input in quicktime format
+ *  or in uncompressed YUV4MPEG2 format ( files ending with .y4m ),
+ *  then frames and audio are written by a separate thread
+ *  and audio goes to a wav file next to the video
  */
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "pidip_config.h"
+#include "pidip_clip.h"
+#include <stdio.h>
 #include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #ifdef QUICKTIME_NEWER
 #include <lqt/lqt.h>
 #include <lqt/colormodels.h>
@@ -42,6 +53,11 @@
 #define DEFAULT_QUALITY 75 // from 1 to 100
 #define MAX_COMP_LENGTH 8
 #define MAX_AUDIO_PACKET_SIZE (128 * 1024)
+#define DEFAULT_Y4M_BUFFERS 16
+#define MAX_Y4M_BUFFERS 64
+#define Y4M_AUDIO_RING (1<<18) // stereo frames, a power of 2
+#define Y4M_HEADER_SIZE 64
+#define Y4M_FRAME_HEADER 6     // "FRAME\n"
 
 static char   *pdp_rec_version = "pdp_rec~: version 0.1, a video/audio recording object, written by ydegoyon@free.fr";
 
@@ -63,7 +79,7 @@ typedef struct pdp_rec_struct
     quicktime_t *x_qtfile;
     unsigned char **x_yuvpointers;
     unsigned char *x_yuvbuffer;
-    int x_framerate;
+    double x_framerate;
     int x_forced_framerate;
     int x_jpeg_quality;
     int x_newfile;
@@ -82,6 +98,32 @@ typedef struct pdp_rec_struct
     int x_samplerate;    // audio sample rate 
     int x_bits;          // audio bits
 
+     /* YUV4MPEG2 recording */
+    int x_y4mfd;         // video file
+    int x_wavfd;         // audio file
+    int x_y4mwidth;      // dimensions of the file, from the first frame
+    int x_y4mheight;
+    int x_y4mwarned;
+    int x_nbbuffers;     // frame buffers asked, for the next file
+    int x_y4mbuffers;    // frame buffers between the pdp thread and the writer
+    int x_buffersize;
+    unsigned char *x_buffers[MAX_Y4M_BUFFERS];
+    volatile unsigned int x_bufferin;  // frames converted ( pdp thread )
+    volatile unsigned int x_bufferout; // frames written ( writer thread )
+    int x_framesdropped;
+    int x_writing;       // writer thread is running
+    pthread_t x_writechild;
+    pthread_mutex_t x_writemutex;
+    pthread_cond_t x_writecond;
+
+     /* audio ring, filled by the dsp and emptied by the writer, without locks */
+    int16_t *x_aring;
+    volatile unsigned int x_ain;
+    volatile unsigned int x_aout;
+    unsigned int x_samplesdropped;
+    unsigned int x_samplesrecorded; // dsp clock of the recording
+    unsigned int x_sampleswritten;
+
 } t_pdp_rec;
 
 static void pdp_rec_free_ressources(t_pdp_rec *x)
@@ -143,7 +185,7 @@ static void pdp_rec_set_framerate(t_pdp_rec *x)
     }
 
     quicktime_set_framerate(x->x_qtfile, (float)x->x_framerate );
-    post( "pdp_rec~ : framerate set to : %d", x->x_framerate );
+    post( "pdp_rec~ : framerate set to : %g", x->x_framerate );
 
 }
 
@@ -204,9 +246,9 @@ static void pdp_rec_frame_rate(t_pdp_rec *x, t_floatarg frate )
 {
     if ( frate >= 1 )
     {
-       x->x_framerate = (int) frate;
+       x->x_framerate = frate;
        x->x_forced_framerate = 1;
-       post( "pdp_rec~ : frame rate set to %d : open a new file to activate it", x->x_framerate );
+       post( "pdp_rec~ : frame rate set to %g : open a new file to activate it", x->x_framerate );
     }
 }
 
@@ -331,11 +373,350 @@ static void pdp_rec_acompressor(t_pdp_rec *x, t_symbol *scompressor )
     post( "pdp_rec~ : audio compressor set to %s : open a new file to activate it", scomp );
 }
 
+static int pdp_rec_opened(t_pdp_rec *x)
+{
+    return ( x->x_qtfile || ( x->x_y4mfd >= 0 ) );
+}
+
+    /* write all the data, returns 0 on errors */
+static int pdp_rec_writeall(int fd, struct iovec *iov, int iovcnt)
+{
+  ssize_t ret;
+
+    while ( iovcnt > 0 )
+    {
+       if ( ( ret = writev( fd, iov, iovcnt ) ) < 0 )
+       {
+          if ( errno == EINTR ) continue;
+          return 0;
+       }
+       while ( ( iovcnt > 0 ) && ( ret >= (ssize_t)iov->iov_len ) )
+       {
+          ret -= iov->iov_len;
+          iov++; iovcnt--;
+       }
+       if ( iovcnt > 0 )
+       {
+          iov->iov_base = (char*)iov->iov_base + ret;
+          iov->iov_len -= ret;
+       }
+    }
+    return 1;
+}
+
+    /* the frame rate is written as a ratio with a fixed width,
+       so that the header can be rewritten when the recording stops */
+static int pdp_rec_y4m_header(t_pdp_rec *x)
+{
+  char header[Y4M_HEADER_SIZE];
+  int len, ratenum, rateden;
+
+    pidip_clip_rate( x->x_framerate, &ratenum, &rateden );
+    len = snprintf( header, Y4M_HEADER_SIZE, "YUV4MPEG2 W%d H%d F%08d:%04d Ip A1:1 C420jpeg\n",
+                    x->x_y4mwidth, x->x_y4mheight, ratenum, rateden );
+    if ( pwrite( x->x_y4mfd, header, len, 0 ) != len )
+    {
+       post( "pdp_rec~ : error writing y4m header : %s", strerror(errno) );
+    }
+    return len;
+}
+
+static void pdp_rec_put32(unsigned char *p, unsigned int v)
+{
+    p[0] = v&0xff; p[1] = (v>>8)&0xff; p[2] = (v>>16)&0xff; p[3] = (v>>24)&0xff;
+}
+
+static void pdp_rec_put16(unsigned char *p, unsigned int v)
+{
+    p[0] = v&0xff; p[1] = (v>>8)&0xff;
+}
+
+    /* 16 bits pcm wav header */
+static void pdp_rec_wav_header(t_pdp_rec *x)
+{
+  unsigned char header[44];
+  unsigned int datasize = x->x_sampleswritten*x->x_channels*sizeof(int16_t);
+
+    memcpy( header, "RIFF", 4 );
+    pdp_rec_put32( header+4, 36+datasize );
+    memcpy( header+8, "WAVEfmt ", 8 );
+    pdp_rec_put32( header+16, 16 );
+    pdp_rec_put16( header+20, 1 );
+    pdp_rec_put16( header+22, x->x_channels );
+    pdp_rec_put32( header+24, x->x_samplerate );
+    pdp_rec_put32( header+28, x->x_samplerate*x->x_channels*sizeof(int16_t) );
+    pdp_rec_put16( header+32, x->x_channels*sizeof(int16_t) );
+    pdp_rec_put16( header+34, 16 );
+    memcpy( header+36, "data", 4 );
+    pdp_rec_put32( header+40, datasize );
+    if ( pwrite( x->x_wavfd, header, 44, 0 ) != 44 )
+    {
+       post( "pdp_rec~ : error writing wav header : %s", strerror(errno) );
+    }
+}
+
+    /* write the audio received since the last call */
+static void pdp_rec_y4m_audio(t_pdp_rec *x)
+{
+  unsigned int ain = x->x_ain, aout = x->x_aout;
+  unsigned int pos, count;
+  struct iovec iov;
+
+    __sync_synchronize();
+    while ( aout != ain )
+    {
+       pos = aout&(Y4M_AUDIO_RING-1);
+       count = ain-aout;
+       if ( count > Y4M_AUDIO_RING-pos ) count = Y4M_AUDIO_RING-pos;
+       iov.iov_base = x->x_aring+pos*x->x_channels;
+       iov.iov_len = count*x->x_channels*sizeof(int16_t);
+       if ( !pdp_rec_writeall( x->x_wavfd, &iov, 1 ) )
+       {
+          post( "pdp_rec~ : error writing audio : %s", strerror(errno) );
+       }
+       x->x_sampleswritten += count;
+       aout += count;
+       __sync_synchronize();
+       x->x_aout = aout;
+    }
+}
+
+static void *pdp_rec_y4m_writer(void *tdata)
+{
+  t_pdp_rec *x = (t_pdp_rec*)tdata;
+  struct iovec iov;
+  struct timeval now;
+  struct timespec timeout;
+  int running;
+
+    do
+    {
+       pthread_mutex_lock( &x->x_writemutex );
+       if ( x->x_writing && ( x->x_bufferout == x->x_bufferin ) )
+       {
+          // audio is written at least every 20 ms
+          gettimeofday( &now, NULL );
+          timeout.tv_sec = now.tv_sec;
+          timeout.tv_nsec = ( now.tv_usec + 20000 ) * 1000;
+          if ( timeout.tv_nsec >= 1000000000 )
+          {
+             timeout.tv_sec++;
+             timeout.tv_nsec -= 1000000000;
+          }
+          pthread_cond_timedwait( &x->x_writecond, &x->x_writemutex, &timeout );
+       }
+       running = x->x_writing;
+       pthread_mutex_unlock( &x->x_writemutex );
+
+       while ( x->x_bufferout != x->x_bufferin )
+       {
+          __sync_synchronize();
+          // one write per frame, header included
+          iov.iov_base = x->x_buffers[x->x_bufferout%x->x_y4mbuffers];
+          iov.iov_len = x->x_buffersize;
+          if ( !pdp_rec_writeall( x->x_y4mfd, &iov, 1 ) )
+          {
+             post( "pdp_rec~ : error writing frame : %s", strerror(errno) );
+          }
+          __sync_synchronize();
+          x->x_bufferout++;
+       }
+
+       if ( x->x_wavfd >= 0 ) pdp_rec_y4m_audio(x);
+    }
+    while ( running );
+
+    return NULL;
+}
+
+static void pdp_rec_y4m_free_buffers(t_pdp_rec *x)
+{
+  int i;
+
+    for ( i=0; i<MAX_Y4M_BUFFERS; i++ )
+    {
+       if ( x->x_buffers[i] ) free( x->x_buffers[i] );
+       x->x_buffers[i] = NULL;
+    }
+    x->x_buffersize = 0;
+}
+
+    /* called from the pdp thread with the first frame */
+static int pdp_rec_y4m_allocate(t_pdp_rec *x, int width, int height)
+{
+  int i;
+
+    x->x_y4mwidth = width;
+    x->x_y4mheight = height;
+    x->x_buffersize = Y4M_FRAME_HEADER + width*height + ((width*height)>>1);
+    for ( i=0; i<x->x_y4mbuffers; i++ )
+    {
+       // page aligned for the kernel copies
+       if ( posix_memalign( (void**)&x->x_buffers[i], 4096, x->x_buffersize ) != 0 )
+       {
+          x->x_buffers[i] = NULL;
+          post( "pdp_rec~ : cannot allocate frame buffers" );
+          pdp_rec_y4m_free_buffers(x);
+          return 0;
+       }
+       memcpy( x->x_buffers[i], "FRAME\n", Y4M_FRAME_HEADER );
+    }
+    // frames follow the header
+    lseek( x->x_y4mfd, pdp_rec_y4m_header(x), SEEK_SET );
+    return 1;
+}
+
+    /* S16 to 8 bits, planes reordered to Y, U, V,
+       without branches so that the compiler can vectorize it */
+static void pdp_rec_y4m_convert(short int *data, unsigned char *buffer, int vsize)
+{
+  int i, v;
+  short int *pV = data+vsize, *pU = data+vsize+(vsize>>2);
+  unsigned char *bU = buffer+vsize, *bV = buffer+vsize+(vsize>>2);
+
+    for ( i=0; i<vsize; i++ )
+    {
+       v = data[i]>>7;
+       buffer[i] = v & ~(v>>31);
+    }
+    for ( i=0; i<(vsize>>2); i++ )
+    {
+       bU[i] = (pU[i]>>8)+128;
+       bV[i] = (pV[i]>>8)+128;
+    }
+}
+
+    /* convert a frame for the writer, dropped if the writer is late */
+static void pdp_rec_y4m_frame(t_pdp_rec *x, t_pdp *header, short int *data)
+{
+  int width = header->info.image.width;
+  int height = header->info.image.height;
+
+    if ( !x->x_buffersize && !pdp_rec_y4m_allocate(x, width, height) ) return;
+
+    if ( ( width != x->x_y4mwidth ) || ( height != x->x_y4mheight ) )
+    {
+       if ( !x->x_y4mwarned ) post( "pdp_rec~ : frame size changed : frames are dropped" );
+       x->x_y4mwarned = 1;
+       x->x_framesdropped++;
+       return;
+    }
+
+    if ( x->x_bufferin - x->x_bufferout >= (unsigned int)x->x_y4mbuffers )
+    {
+       x->x_framesdropped++;
+       return;
+    }
+
+    pdp_rec_y4m_convert( data, x->x_buffers[x->x_bufferin%x->x_y4mbuffers]+Y4M_FRAME_HEADER, width*height );
+    __sync_synchronize();
+    x->x_bufferin++;
+    x->x_frameswritten++;
+
+    pthread_mutex_lock( &x->x_writemutex );
+    pthread_cond_signal( &x->x_writecond );
+    pthread_mutex_unlock( &x->x_writemutex );
+}
+
+    /* stop the writer once everything is on disk */
+static void pdp_rec_y4m_close(t_pdp_rec *x)
+{
+  void *dummy;
+
+    if ( x->x_y4mfd < 0 ) return;
+
+    pdp_queue_finish(x->x_queue_id);
+    x->x_recflag = 0;
+    if ( x->x_writing )
+    {
+       pthread_mutex_lock( &x->x_writemutex );
+       x->x_writing = 0;
+       pthread_cond_signal( &x->x_writecond );
+       pthread_mutex_unlock( &x->x_writemutex );
+       pthread_join( x->x_writechild, &dummy );
+    }
+
+    if ( x->x_buffersize ) pdp_rec_y4m_header(x);
+    close( x->x_y4mfd );
+    x->x_y4mfd = -1;
+    if ( x->x_wavfd >= 0 )
+    {
+       pdp_rec_wav_header(x);
+       close( x->x_wavfd );
+       x->x_wavfd = -1;
+    }
+    pdp_rec_y4m_free_buffers(x);
+
+    post( "pdp_rec~ : closed y4m file : %d frames : %d dropped : %u audio samples dropped",
+          x->x_frameswritten, x->x_framesdropped, x->x_samplesdropped );
+}
+
+static int pdp_rec_y4m_open(t_pdp_rec *x, char *filename)
+{
+  char *wavname;
+  int len = strlen( filename );
+
+    if ( ( x->x_y4mfd = open( filename, O_WRONLY|O_CREAT|O_TRUNC, 0644 ) ) < 0 )
+    {
+       post( "pdp_rec~ : cannot open >%s< : %s", filename, strerror(errno) );
+       return 0;
+    }
+
+    // the audio goes to the same name with a .wav extension
+    wavname = (char *) getbytes( len+1 );
+    strcpy( wavname, filename );
+    strcpy( wavname+len-4, ".wav" );
+    if ( ( x->x_wavfd = open( wavname, O_WRONLY|O_CREAT|O_TRUNC, 0644 ) ) < 0 )
+    {
+       post( "pdp_rec~ : cannot open >%s< : %s : no audio", wavname, strerror(errno) );
+    }
+    else
+    {
+       lseek( x->x_wavfd, 44, SEEK_SET );
+       post( "pdp_rec~ : audio goes to >%s<", wavname );
+    }
+    freebytes( wavname, len+1 );
+
+    x->x_buffersize = 0;
+    x->x_y4mbuffers = x->x_nbbuffers;
+    x->x_bufferin = x->x_bufferout = 0;
+    x->x_ain = x->x_aout = 0;
+    x->x_framesdropped = 0;
+    x->x_samplesdropped = 0;
+    x->x_samplesrecorded = 0;
+    x->x_sampleswritten = 0;
+    x->x_y4mwarned = 0;
+    x->x_samplerate = sys_getsr();
+
+    x->x_writing = 1;
+    if ( pthread_create( &x->x_writechild, NULL, pdp_rec_y4m_writer, x ) != 0 )
+    {
+       post( "pdp_rec~ : could not launch writer thread" );
+       x->x_writing = 0;
+       pdp_rec_y4m_close(x);
+       return 0;
+    }
+    return 1;
+}
+
+static void pdp_rec_y4m_buffers(t_pdp_rec *x, t_floatarg fbuffers )
+{
+    if ( ( fbuffers < 2 ) || ( fbuffers > MAX_Y4M_BUFFERS ) )
+    {
+       post( "pdp_rec~ : number of buffers should be between 2 and %d", MAX_Y4M_BUFFERS );
+       return;
+    }
+    x->x_nbbuffers = (int) fbuffers;
+    post( "pdp_rec~ : %d frame buffers : open a new file to activate it", x->x_nbbuffers );
+}
+
     /* close a video file */
 static void pdp_rec_close(t_pdp_rec *x)
 {
   int ret;
 
+    pdp_rec_y4m_close(x);
+
     if ( x->x_qtfile ) {
        if( ( ret = quicktime_close(x->x_qtfile) ) != 0 ) {
           post( "pdp_rec~ : error closing file ret=%d", ret );
@@ -349,7 +730,7 @@ static void pdp_rec_close(t_pdp_rec *x)
     /* open a new video file */
 static void pdp_rec_open(t_pdp_rec *x, t_symbol *sfile)
 {
-  int ret=0;
+  int ret=0, len;
 
     // close previous video file if existing
     pdp_rec_close(x);
@@ -358,6 +739,17 @@ static void pdp_rec_open(t_pdp_rec *x, t_symbol *sfile)
        x->x_recflag = 0;
     }
 
+    len = strlen( sfile->s_name );
+    if ( ( len > 4 ) && !strcmp( sfile->s_name+len-4, ".y4m" ) )
+    {
+       x->x_frameswritten = 0;
+       if ( pdp_rec_y4m_open(x, sfile->s_name) )
+       {
+          post( "pdp_rec~ : opened >%s< ( YUV4MPEG2 )", sfile->s_name);
+       }
+       return;
+    }
+
     if ( ( x->x_qtfile = quicktime_open(sfile->s_name, 0, 1) ) == NULL )
     {
        error( "pdp_rec~ : cannot open >%s<", sfile->s_name);
@@ -375,7 +767,7 @@ static void pdp_rec_open(t_pdp_rec *x, t_symbol *sfile)
    /* start recording */
 static void pdp_rec_start(t_pdp_rec *x)
 {
-    if ( !x->x_qtfile ) {
+    if ( !pdp_rec_opened(x) ) {
        post("pdp_rec~ : start received but no file has been opened ... ignored.");
        return;
     }
@@ -397,7 +789,7 @@ static void pdp_rec_start(t_pdp_rec *x)
    /* stop recording */
 static void pdp_rec_stop(t_pdp_rec *x)
 {
-    if ( !x->x_qtfile ) {
+    if ( !pdp_rec_opened(x) ) {
        post("pdp_rec~ : stop received but no file has been opened ... ignored.");
        return;
     }
@@ -413,11 +805,18 @@ static void pdp_rec_stop(t_pdp_rec *x)
     }
 
     // calculate frame rate if it hasn't been set
-    if ( !x->x_forced_framerate )
+    // with the dsp clock if the audio was running
+    if ( !x->x_forced_framerate && ( x->x_y4mfd >= 0 ) && ( x->x_samplesrecorded >= (unsigned int)x->x_samplerate ) )
+    {
+      x->x_framerate = (double)x->x_frameswritten*x->x_samplerate/x->x_samplesrecorded;
+      if ( x->x_framerate < 1 ) x->x_framerate = 1;
+    }
+    else if ( !x->x_forced_framerate )
     {
       if ( ( x->x_tstop.tv_sec - x->x_tstart.tv_sec ) > 0 )
       {
-        x->x_framerate = x->x_frameswritten / ( x->x_tstop.tv_sec - x->x_tstart.tv_sec );
+        x->x_framerate = x->x_frameswritten / ( ( x->x_tstop.tv_sec - x->x_tstart.tv_sec ) +
+                                                ( x->x_tstop.tv_usec - x->x_tstart.tv_usec )/1000000. );
       }
       else
       {
@@ -425,7 +824,7 @@ static void pdp_rec_stop(t_pdp_rec *x)
       }
     }
 
-    pdp_rec_set_framerate(x);
+    if ( x->x_qtfile ) pdp_rec_set_framerate(x);
 
     x->x_recflag = 0;
     pdp_rec_close(x);
@@ -442,8 +841,36 @@ static t_int *pdp_rec_perform(t_int *w)
   int n = (int)(w[4]);                      // number of samples
   t_float fsample;
   int   isample, i;
+  unsigned int ain, pos;
 
-   if ( x->x_recflag ) 
+   if ( x->x_recflag && ( x->x_y4mfd >= 0 ) )
+   {
+    // every sample of the dsp is recorded, unless the writer is late
+    ain = x->x_ain;
+    x->x_samplesrecorded += n;
+    while (n--)
+    {
+       if ( ain - x->x_aout >= Y4M_AUDIO_RING )
+       {
+          x->x_samplesdropped++;
+          in1++; in2++;
+          continue;
+       }
+       pos = (ain&(Y4M_AUDIO_RING-1))*x->x_channels;
+       fsample=*(in1++);
+       if (fsample > 1.0) { fsample = 1.0; }
+       if (fsample < -1.0) { fsample = -1.0; }
+       x->x_aring[pos]=(short) (32767.0 * fsample);
+       fsample=*(in2++);
+       if (fsample > 1.0) { fsample = 1.0; }
+       if (fsample < -1.0) { fsample = -1.0; }
+       if ( x->x_channels > 1 ) x->x_aring[pos+1]=(short) (32767.0 * fsample);
+       ain++;
+    }
+    __sync_synchronize();
+    x->x_ain = ain;
+   }
+   else if ( x->x_recflag ) 
    {
 
     // just fills the buffer
@@ -487,6 +914,12 @@ static void pdp_rec_process_yv12(t_pdp_rec *x)
   int     nbaudiosamples, nbusecs, nbrecorded;
   t_float   fframerate=0.0;
 
+    if ( ( x->x_y4mfd >= 0 ) && x->x_recflag )
+    {
+      pdp_rec_y4m_frame(x, header, data);
+      return;
+    }
+
     x->x_vwidth = header->info.image.width;
     x->x_vheight = header->info.image.height;
     x->x_vsize = x->x_vwidth*x->x_vheight;
@@ -594,11 +1027,11 @@ static void pdp_rec_process(t_pdp_rec *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            if ( x->x_qtfile && x->x_recflag )
+            if ( pdp_rec_opened(x) && x->x_recflag )
             {
               outlet_float( x->x_obj.ob_outlet, x->x_frameswritten );
             }
-            pdp_queue_add(x, pdp_rec_process_yv12, pdp_rec_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_rec_process_yv12, pdp_rec_killpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -620,7 +1053,7 @@ static void pdp_rec_input_0(t_pdp_rec *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-        x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+        x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -634,7 +1067,7 @@ static void pdp_rec_free(t_pdp_rec *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     // close video file if existing
     pdp_rec_close(x);
@@ -644,6 +1077,9 @@ static void pdp_rec_free(t_pdp_rec *x)
        if ( x->x_audio_buf[i] ) freebytes( x->x_audio_buf[i], MAX_AUDIO_PACKET_SIZE*sizeof(int16_t) );
     }
     if ( x->x_audio_buf ) freebytes( x->x_audio_buf, x->x_channels*sizeof(int16_t*) );
+    if ( x->x_aring ) freebytes( x->x_aring, Y4M_AUDIO_RING*x->x_channels*sizeof(int16_t) );
+    pthread_mutex_destroy( &x->x_writemutex );
+    pthread_cond_destroy( &x->x_writecond );
     
 }
 
@@ -685,6 +1121,17 @@ void *pdp_rec_new(void)
     x->x_yuvpointers = NULL;
     x->x_jpeg_quality = DEFAULT_QUALITY;
 
+    x->x_y4mfd = -1;
+    x->x_wavfd = -1;
+    x->x_writing = 0;
+    x->x_nbbuffers = DEFAULT_Y4M_BUFFERS;
+    x->x_y4mbuffers = DEFAULT_Y4M_BUFFERS;
+    x->x_buffersize = 0;
+    for ( i=0; i<MAX_Y4M_BUFFERS; i++ ) x->x_buffers[i] = NULL;
+    x->x_aring = (int16_t*) getbytes( Y4M_AUDIO_RING*x->x_channels*sizeof(int16_t) );
+    pthread_mutex_init( &x->x_writemutex, NULL );
+    pthread_cond_init( &x->x_writecond, NULL );
+
     return (void *)x;
 }
 
@@ -712,6 +1159,7 @@ void pdp_rec_tilde_setup(void)
     class_addmethod(pdp_rec_class, (t_method)pdp_rec_jpeg, gensym("jpeg"), A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_rec_class, (t_method)pdp_rec_start, gensym("start"), A_NULL);
     class_addmethod(pdp_rec_class, (t_method)pdp_rec_stop, gensym("stop"), A_NULL);
+    class_addmethod(pdp_rec_class, (t_method)pdp_rec_y4m_buffers, gensym("buffers"), A_FLOAT, A_NULL);
 
 
 }
@@ -26,6 +26,9 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
+#include "pidip_bgmodel.h"
 #include <math.h>
 
 #define MAGIC_THRESHOLD 30
@@ -75,6 +78,7 @@ typedef struct pdp_ripple_struct
     short int *x_diff;
     short int *x_bdata;
     int x_snapshot;
+    t_pidip_bgmodel *x_model;  // shared background model, NULL for the snapshot
 
 } t_pdp_ripple;
 
@@ -103,22 +107,22 @@ static void pdp_ripple_background(t_pdp_ripple *x )
 
 static void pdp_ripple_free_ressources(t_pdp_ripple *x)
 {
-  if ( x->x_diff != NULL ) freebytes( x->x_diff, (x->x_vsize + (x->x_vsize>>1))<<1 );
-  if ( x->x_bdata ) freebytes( x->x_bdata, (( x->x_vsize + (x->x_vsize>>1))<<1));
-  if ( x->x_map ) freebytes(x->x_map, x->x_maph*x->x_mapw*3*sizeof(int));
-  if ( x->x_vtable ) freebytes(x->x_vtable, x->x_maph*x->x_mapw*2*sizeof(signed char));
+  if ( x->x_diff != NULL ) pidip_pool_put( x->x_diff );
+  if ( x->x_bdata ) pidip_pool_put( x->x_bdata );
+  if ( x->x_map ) pidip_pool_put( x->x_map );
+  if ( x->x_vtable ) pidip_pool_put( x->x_vtable );
 }
 
 static void pdp_ripple_allocate(t_pdp_ripple *x)
 {
  int i;
 
-  x->x_diff = (short int*) getbytes((x->x_vsize + (x->x_vsize>>1))<<1);
-  x->x_bdata = (short int *) getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
+  x->x_diff = (short int*) pidip_pool_get((x->x_vsize + (x->x_vsize>>1))<<1);
+  x->x_bdata = (short int *) pidip_pool_get((( x->x_vsize + (x->x_vsize>>1))<<1));
   x->x_maph = x->x_vheight / 2 + 1;
   x->x_mapw = x->x_vwidth / 2 + 1;
-  x->x_map = (int *)getbytes(x->x_maph*x->x_mapw*3*sizeof(int));
-  x->x_vtable = (signed char *)getbytes(x->x_maph*x->x_mapw*2*sizeof(signed char));
+  x->x_map = (int *)pidip_pool_get(x->x_maph*x->x_mapw*3*sizeof(int));
+  x->x_vtable = (signed char *)pidip_pool_get(x->x_maph*x->x_mapw*2*sizeof(signed char));
   if( !x->x_map || !x->x_vtable || !x->x_bdata || !x->x_diff ) {
       post( "pdp_ripple : severe error : cannot allocate buffers" );
   }
@@ -159,7 +163,15 @@ static void pdp_ripple_motion_detect(t_pdp_ripple *x, short int *src)
   int *p, *q;
   int px, py, h;
 
-    diff = pdp_ripple_diff(x, src);
+    if ( x->x_model && pidip_bgmodel_update( x->x_model ) )
+    {
+       pidip_bgmodel_expand( x->x_model, x->x_diff, x->x_vwidth, x->x_vheight, PIDIP_BGMODEL_MASKED );
+       diff = x->x_diff;
+    }
+    else
+    {
+       diff = pdp_ripple_diff(x, src);
+    }
     width = x->x_vwidth;
     p = x->x_map1+x->x_mapw+1;
     q = x->x_map2+x->x_mapw+1;
@@ -465,7 +477,7 @@ static void pdp_ripple_process(t_pdp_ripple *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_ripple_process_yv12, pdp_ripple_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_ripple_process_yv12, pdp_ripple_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -485,7 +497,10 @@ static void pdp_ripple_input_0(t_pdp_ripple *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    {
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_bgmodel_push(x->x_model, x->x_packet0);
+    }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -494,12 +509,21 @@ static void pdp_ripple_input_0(t_pdp_ripple *x, t_symbol *s, t_floatarg f)
     }
 }
 
+/* use a shared background model instead of the snapshot, no name goes back to the snapshot */
+static void pdp_ripple_bgmodel(t_pdp_ripple *x, t_symbol *s)
+{
+    pdp_queue_finish(x->x_queue_id);
+    pidip_bgmodel_detach(x->x_model);
+    x->x_model = (s==&s_) ? NULL : pidip_bgmodel_attach(s);
+}
+
 static void pdp_ripple_free(t_pdp_ripple *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_bgmodel_detach(x->x_model);
     pdp_ripple_free_ressources(x);
 }
 
@@ -520,6 +544,7 @@ void *pdp_ripple_new(void)
     x->x_packet0 = -1;
     x->x_packet1 = -1;
     x->x_queue_id = -1;
+    x->x_model = NULL;
 
     x->x_mode = 0;
     x->x_vsize = -1;
@@ -555,6 +580,7 @@ void pdp_ripple_setup(void)
 
     class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_mode, gensym("mode"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_bgmodel, gensym("bgmodel"),  A_DEFSYMBOL, A_NULL);
     class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_background, gensym("background"), A_NULL);
     class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_threshold, gensym("threshold"), A_FLOAT, A_NULL);
     class_addmethod(pdp_ripple_class, (t_method)pdp_ripple_increment, gensym("increment"), A_FLOAT, A_NULL);
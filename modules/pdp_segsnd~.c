@@ -19,6 +19,12 @@
  */
 
 /*  This object turns an image into sound
+ *  each channel scans a path ( segment, polyline or spiral ) of the luminosity
+ *  with bilinear reads, either one pixel per sample from the start of the path
+ *  at each block, or back and forth at a frequency, which does not click.
+ *  the luminosity is copied in snapshots, the dsp reads the last two of them
+ *  and fades from one to the other over a block, as it moves from a path to
+ *  the next one.
  */
 
 /*  Listening to :
@@ -27,13 +33,44 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "yuv.h"
 #include <math.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <Imlib2.h>  // imlib2 is required
+#include "pidip_pool.h"
+
+#define MAX_CHANNELS 8
+#define MAX_POINTS 256
+#define NB_SNAPSHOTS 3     // two read by the dsp, one written by the process thread
 
 static char   *pdp_segsnd_version = "pdp_segsnd~: version 0.1 : turns an image into sound written by ydegoyon@free.fr ";
 
+typedef struct _segsnd_path
+{
+    int p_npoints;
+    t_float p_x[MAX_POINTS];
+    t_float p_y[MAX_POINTS];
+    t_float p_len[MAX_POINTS];  // length of the path up to each point
+} t_segsnd_path;
+
+typedef struct _segsnd_channel
+{
+    t_segsnd_path c_path;
+    t_segsnd_path c_last;       // path read by the previous block
+    int c_changed;
+    t_float c_frequency;        // scans per second, 0 : one pixel per sample
+    double c_phase;
+} t_segsnd_channel;
+
+typedef struct _segsnd_snapshot
+{
+    short int *s_data;          // luminosity
+    int s_width;
+    int s_height;
+} t_segsnd_snapshot;
+
 typedef struct pdp_segsnd_struct
 {
     t_object x_obj;
@@ -55,18 +92,77 @@ typedef struct pdp_segsnd_struct
     int x_y2;
     int x_random;
 
-    short int *x_data;
+    int x_nchannels;
+    t_segsnd_channel x_channels[MAX_CHANNELS];
+    t_float x_sr;
+
+    t_segsnd_snapshot x_snapshots[NB_SNAPSHOTS];
+    int x_current;              // snapshot read by the dsp
+    int x_previous;             // snapshot faded out by the dsp
+    int x_fresh;                // snapshot written and not read yet
+    int x_fade;
+    pthread_mutex_t x_snaplock;
 
     /* imlib data */
     Imlib_Image x_image;
 
 } t_pdp_segsnd;
 
+static void pdp_segsnd_path_measure(t_segsnd_path *path)
+{
+  int i;
+  t_float dx, dy;
+
+    if ( path->p_npoints > 0 ) path->p_len[0] = 0;
+    for ( i=1; i<path->p_npoints; i++ )
+    {
+       dx = path->p_x[i]-path->p_x[i-1];
+       dy = path->p_y[i]-path->p_y[i-1];
+       path->p_len[i] = path->p_len[i-1] + sqrt( dx*dx + dy*dy );
+    }
+}
+
+static t_segsnd_channel *pdp_segsnd_channel(t_pdp_segsnd *x, t_floatarg fchannel)
+{
+    if ( ( (int)fchannel < 0 ) || ( (int)fchannel >= x->x_nchannels ) )
+    {
+       post( "pdp_segsnd~ : wrong channel : %d ( 0 to %d )", (int)fchannel, x->x_nchannels-1 );
+       return NULL;
+    }
+    return &x->x_channels[(int)fchannel];
+}
+
+// the new path is read by the next block, coming from the last one
+static void pdp_segsnd_path_changed(t_segsnd_channel *channel)
+{
+    pdp_segsnd_path_measure( &channel->c_path );
+    channel->c_changed = 1;
+}
+
+static void pdp_segsnd_set_segment(t_segsnd_channel *channel, t_float x1, t_float y1, t_float x2, t_float y2)
+{
+    channel->c_path.p_npoints = 2;
+    channel->c_path.p_x[0] = x1;
+    channel->c_path.p_y[0] = y1;
+    channel->c_path.p_x[1] = x2;
+    channel->c_path.p_y[1] = y2;
+    pdp_segsnd_path_changed( channel );
+}
+
+static void pdp_segsnd_update_segment(t_pdp_segsnd *x)
+{
+    if ( x->x_x1 != -1 )
+    {
+       pdp_segsnd_set_segment( &x->x_channels[0], x->x_x1, x->x_y1, x->x_x2, x->x_y2 );
+    }
+}
+
 static void pdp_segsnd_x1(t_pdp_segsnd *x, t_floatarg fx )
 {
     if ( ( fx >= 0 ) && ( fx < x->x_x2 ) )
     {
        x->x_x1 = fx;
+       pdp_segsnd_update_segment(x);
     }
 }
 
@@ -75,6 +171,7 @@ static void pdp_segsnd_y1(t_pdp_segsnd *x, t_floatarg fy )
     if ( ( fy >= 0 ) && ( fy < x->x_y2 ) )
     {
        x->x_y1 = fy;
+       pdp_segsnd_update_segment(x);
     }
 }
 
@@ -83,6 +180,7 @@ static void pdp_segsnd_x2(t_pdp_segsnd *x, t_floatarg fx )
     if ( ( fx >= x->x_x1 ) && ( fx < x->x_vwidth ) )
     {
        x->x_x2 = fx;
+       pdp_segsnd_update_segment(x);
     }
 }
 
@@ -91,6 +189,7 @@ static void pdp_segsnd_y2(t_pdp_segsnd *x, t_floatarg fy )
     if ( ( fy >= x->x_y1 ) && ( fy < x->x_vheight ) )
     {
        x->x_y2 = fy;
+       pdp_segsnd_update_segment(x);
     }
 }
 
@@ -102,6 +201,80 @@ static void pdp_segsnd_random(t_pdp_segsnd *x, t_floatarg frand )
     }
 }
 
+static void pdp_segsnd_segment(t_pdp_segsnd *x, t_floatarg fchannel, t_floatarg fx1, t_floatarg fy1, t_floatarg fx2, t_floatarg fy2 )
+{
+  t_segsnd_channel *channel;
+
+    if ( ( channel = pdp_segsnd_channel(x, fchannel) ) )
+    {
+       pdp_segsnd_set_segment( channel, fx1, fy1, fx2, fy2 );
+    }
+}
+
+static void pdp_segsnd_polyline(t_pdp_segsnd *x, t_symbol *s, int argc, t_atom *argv)
+{
+  t_segsnd_channel *channel;
+  int i;
+
+    if ( ( argc < 3 ) || ( argc%2 == 0 ) )
+    {
+       post( "pdp_segsnd~ : polyline <channel> <x> <y> <x> <y> ..." );
+       return;
+    }
+    if ( !( channel = pdp_segsnd_channel(x, atom_getfloat(argv)) ) ) return;
+    if ( (argc-1)/2 > MAX_POINTS )
+    {
+       post( "pdp_segsnd~ : polyline : only %d points are kept", MAX_POINTS );
+    }
+
+    channel->c_path.p_npoints = 0;
+    for ( i=1; ( i+1<argc ) && ( channel->c_path.p_npoints<MAX_POINTS ); i+=2 )
+    {
+       channel->c_path.p_x[channel->c_path.p_npoints] = atom_getfloat(argv+i);
+       channel->c_path.p_y[channel->c_path.p_npoints] = atom_getfloat(argv+i+1);
+       channel->c_path.p_npoints++;
+    }
+    pdp_segsnd_path_changed( channel );
+}
+
+static void pdp_segsnd_spiral(t_pdp_segsnd *x, t_floatarg fchannel, t_floatarg fcx, t_floatarg fcy, t_floatarg fradius, t_floatarg fturns )
+{
+  t_segsnd_channel *channel;
+  int i, npoints;
+  t_float angle, radius;
+
+    if ( !( channel = pdp_segsnd_channel(x, fchannel) ) ) return;
+    if ( fturns <= 0 )
+    {
+       post( "pdp_segsnd~ : spiral : wrong number of turns : %f", fturns );
+       return;
+    }
+
+    // 32 points per turn, at least a segment
+    npoints = fturns*32+1;
+    if ( npoints < 2 ) npoints = 2;
+    if ( npoints > MAX_POINTS ) npoints = MAX_POINTS;
+    for ( i=0; i<npoints; i++ )
+    {
+       angle = 2*M_PI*fturns*i/(npoints-1);
+       radius = fradius*i/(npoints-1);
+       channel->c_path.p_x[i] = fcx + radius*cos(angle);
+       channel->c_path.p_y[i] = fcy + radius*sin(angle);
+    }
+    channel->c_path.p_npoints = npoints;
+    pdp_segsnd_path_changed( channel );
+}
+
+static void pdp_segsnd_frequency(t_pdp_segsnd *x, t_floatarg fchannel, t_floatarg ffrequency )
+{
+  t_segsnd_channel *channel;
+
+    if ( ( channel = pdp_segsnd_channel(x, fchannel) ) && ( ffrequency >= 0 ) )
+    {
+       channel->c_frequency = ffrequency;
+    }
+}
+
 static void pdp_segsnd_allocate(t_pdp_segsnd *x)
 {
    x->x_image = imlib_create_image( x->x_vwidth, x->x_vheight );
@@ -110,15 +283,42 @@ static void pdp_segsnd_allocate(t_pdp_segsnd *x)
       post( "pdp_form : severe error : could not allocate image !!" );
    }
    imlib_context_set_image(x->x_image);
-   x->x_data = (short int *)getbytes((( x->x_vsize + (x->x_vsize>>1))<<1));
 }
 
 static void pdp_segsnd_free_ressources(t_pdp_segsnd *x)
 {
    // if ( x->x_image != NULL ) imlib_free_image();
    x->x_image = NULL;
-   if ( x->x_data ) freebytes( x->x_data, (( x->x_vsize + (x->x_vsize>>1))<<1));
-   x->x_data = NULL;
+}
+
+// copies the luminosity in a snapshot that the dsp does not read
+static void pdp_segsnd_snapshot(t_pdp_segsnd *x, short int *data)
+{
+  int s;
+  t_segsnd_snapshot *snapshot;
+
+    pthread_mutex_lock( &x->x_snaplock );
+    x->x_fresh = -1;
+    for ( s=0; ( s == x->x_current ) || ( s == x->x_previous ); s++ );
+    pthread_mutex_unlock( &x->x_snaplock );
+
+    snapshot = &x->x_snapshots[s];
+    if ( ( snapshot->s_width != x->x_vwidth ) || ( snapshot->s_height != x->x_vheight ) )
+    {
+       snapshot->s_data = (short int *)pidip_pool_resize( snapshot->s_data, x->x_vsize*sizeof(short int) );
+       snapshot->s_width = x->x_vwidth;
+       snapshot->s_height = x->x_vheight;
+    }
+    if ( !snapshot->s_data ) 
+    {
+       snapshot->s_width = snapshot->s_height = 0;
+       return;
+    }
+    memcpy( snapshot->s_data, data, x->x_vsize*sizeof(short int) );
+
+    pthread_mutex_lock( &x->x_snaplock );
+    x->x_fresh = s;
+    pthread_mutex_unlock( &x->x_snaplock );
 }
 
 static void pdp_segsnd_process_yv12(t_pdp_segsnd *x)
@@ -127,8 +327,9 @@ static void pdp_segsnd_process_yv12(t_pdp_segsnd *x)
   short int *data   = (short int *)pdp_packet_data(x->x_packet0);
   t_pdp     *newheader = pdp_packet_header(x->x_packet1);
   short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-  int     ti;
+  int     ti, c, i;
   int     px, py;
+  t_segsnd_path *path;
   unsigned char y, u, v;
   short int *pY, *pU, *pV;
   DATA32    *imdata;
@@ -149,7 +350,7 @@ static void pdp_segsnd_process_yv12(t_pdp_segsnd *x)
     newheader->info.image.height = x->x_vheight;
 
     memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
-    memcpy( x->x_data, data, ((x->x_vsize+(x->x_vsize>>1))<<1));
+    pdp_segsnd_snapshot(x, data);
 
     if ( x->x_image != NULL ) imlib_context_set_image(x->x_image);
     imlib_image_clear();
@@ -158,10 +359,18 @@ static void pdp_segsnd_process_yv12(t_pdp_segsnd *x)
     bgcolor = imdata[0];
 
     // post( "pdp_segsnd : x1=%d y1=%d x2=%d y2=%d", x->x_x1, x->x_y1, x->x_x2, x->x_y2 );
-    if ( x->x_x1 != -1 )
+    for ( ti=0, c=0; c<x->x_nchannels; c++ ) ti += x->x_channels[c].c_path.p_npoints;
+    if ( ti > 0 )
     {
       imlib_context_set_color( 255, 255, 255, 255 );
-      imlib_image_draw_line( x->x_x1, x->x_y1, x->x_x2, x->x_y2, 1);
+      for ( c=0; c<x->x_nchannels; c++ )
+      {
+        path = &x->x_channels[c].c_path;
+        for ( i=1; i<path->p_npoints; i++ )
+        {
+          imlib_image_draw_line( (int)path->p_x[i-1], (int)path->p_y[i-1], (int)path->p_x[i], (int)path->p_y[i], 1);
+        }
+      }
 
       pY = newdata;
       pV = newdata+x->x_vsize;
@@ -190,13 +399,6 @@ static void pdp_segsnd_process_yv12(t_pdp_segsnd *x)
           }
        }
       }
-      if ( x->x_random )
-      {
-         x->x_x2 = ((t_float)rand()/RAND_MAX)*x->x_vwidth;
-         x->x_x1 = ((t_float)rand()/RAND_MAX)*x->x_x2;
-         x->x_y2 = ((t_float)rand()/RAND_MAX)*x->x_vheight;
-         x->x_y1 = ((t_float)rand()/RAND_MAX)*x->x_y2;
-      }
     }
 
     return;
@@ -210,6 +412,16 @@ static void pdp_segsnd_sendpacket(t_pdp_segsnd *x)
 
     /* unregister and propagate if valid dest packet */
     pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+
+    // the paths are only changed in the thread of the dsp
+    if ( x->x_random && ( x->x_x1 != -1 ) )
+    {
+       x->x_x2 = ((t_float)rand()/RAND_MAX)*x->x_vwidth;
+       x->x_x1 = ((t_float)rand()/RAND_MAX)*x->x_x2;
+       x->x_y2 = ((t_float)rand()/RAND_MAX)*x->x_vheight;
+       x->x_y1 = ((t_float)rand()/RAND_MAX)*x->x_y2;
+       pdp_segsnd_update_segment(x);
+    }
 }
 
 static void pdp_segsnd_process(t_pdp_segsnd *x)
@@ -228,7 +440,7 @@ static void pdp_segsnd_process(t_pdp_segsnd *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_segsnd_process_yv12, pdp_segsnd_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_segsnd_process_yv12, pdp_segsnd_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -252,7 +464,7 @@ static void pdp_segsnd_input_0(t_pdp_segsnd *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))  
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
     // post( "pdp_segsnd : action=%s dropped=%d", s->s_name, x->x_dropped );
 
@@ -270,85 +482,199 @@ static void pdp_segsnd_free(t_pdp_segsnd *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    for ( i=0; i<NB_SNAPSHOTS; i++ ) pidip_pool_put( x->x_snapshots[i].s_data );
+    pthread_mutex_destroy( &x->x_snaplock );
+}
+
+// point at a distance from the start of a path
+static void pdp_segsnd_point(t_segsnd_path *path, t_float dist, t_float *px, t_float *py)
+{
+  int lo = 0, hi = path->p_npoints-1, mid;
+  t_float seg, t;
+
+    if ( dist <= 0 || hi == 0 )
+    {
+       *px = path->p_x[0];
+       *py = path->p_y[0];
+       return;
+    }
+    if ( dist >= path->p_len[hi] )
+    {
+       *px = path->p_x[hi];
+       *py = path->p_y[hi];
+       return;
+    }
+    while ( hi-lo > 1 )
+    {
+       mid = (lo+hi)>>1;
+       if ( path->p_len[mid] <= dist ) lo = mid;
+       else hi = mid;
+    }
+    seg = path->p_len[hi]-path->p_len[lo];
+    t = ( seg > 0 ) ? (dist-path->p_len[lo])/seg : 0;
+    *px = path->p_x[lo] + t*(path->p_x[hi]-path->p_x[lo]);
+    *py = path->p_y[lo] + t*(path->p_y[hi]-path->p_y[lo]);
+}
+
+// bilinear read of the luminosity, scaled to -1 ... 1
+static t_float pdp_segsnd_read(t_segsnd_snapshot *snapshot, t_float fx, t_float fy)
+{
+  int ix, iy, ix1, iy1;
+  t_float ax, ay, l0, l1;
+  short int *data = snapshot->s_data;
+  int w = snapshot->s_width;
+
+    // a path of nan or infinite coordinates reads nothing
+    if ( !isfinite( fx ) || !isfinite( fy ) ) return 0.;
+    if ( fx < 0 ) fx = 0;
+    if ( fx > w-1 ) fx = w-1;
+    if ( fy < 0 ) fy = 0;
+    if ( fy > snapshot->s_height-1 ) fy = snapshot->s_height-1;
+    ix = (int)fx; ax = fx-ix; ix1 = ( ix < w-1 ) ? ix+1 : ix;
+    iy = (int)fy; ay = fy-iy; iy1 = ( iy < snapshot->s_height-1 ) ? iy+1 : iy;
+
+    l0 = data[iy*w+ix] + ax*(data[iy*w+ix1]-data[iy*w+ix]);
+    l1 = data[iy1*w+ix] + ax*(data[iy1*w+ix1]-data[iy1*w+ix]);
+    return ( (l0+ay*(l1-l0))/128.0 - 127 )/128.0;
+}
+
+// takes the last snapshot at the start of each block
+static t_int *pdp_segsnd_tick(t_int *w)
+{
+  t_pdp_segsnd *x = (t_pdp_segsnd *)(w[1]);
+  int n = (int)(w[2]);
+
+    pthread_mutex_lock( &x->x_snaplock );
+    x->x_fade = 0;
+    if ( x->x_fresh != -1 )
+    {
+       x->x_previous = x->x_current;
+       x->x_current = x->x_fresh;
+       x->x_fresh = -1;
+       x->x_fade = ( x->x_previous != -1 );
+    }
+    pthread_mutex_unlock( &x->x_snaplock );
+
+    // set initial coordinates
+    if ( ( x->x_x1 == -1 ) && ( x->x_current != -1 ) )
+    {
+      x->x_x1 = 10;
+      x->x_y1 = 10;
+      if ( 10+n > (x->x_snapshots[x->x_current].s_width-1) )
+      {
+         x->x_x2 = x->x_snapshots[x->x_current].s_width-1;
+      }
+      else
+      {
+         x->x_x2 = 10+n;
+      }
+      if ( 10+n > (x->x_snapshots[x->x_current].s_height-1) )
+      {
+         x->x_y2 = x->x_snapshots[x->x_current].s_height-1;
+      }
+      else
+      {
+         x->x_y2 = 10+n;
+      }
+      if ( x->x_channels[0].c_path.p_npoints == 0 ) pdp_segsnd_update_segment(x);
+    }
+
+    return (w+3);
 }
 
 static t_int *pdp_segsnd_perform(t_int *w)
 {
   t_float *out   = (t_float *)(w[1]);       // audio generated sound
   t_pdp_segsnd *x = (t_pdp_segsnd *)(w[2]);
-  int n = (int)(w[3]); 
-  int npoints, xi, px, py;
-  t_float a=0;
-
-   // set initial coordinates
-   if ( ( x->x_x1 == -1 ) && (x->x_vwidth != -1 ))
+  t_segsnd_channel *channel = &x->x_channels[(int)(w[3])];
+  int n = (int)(w[4]);
+  t_segsnd_snapshot *current, *previous;
+  t_float len, lastlen, dist, lastdist, u, t, px, py, lx, ly, value, lastvalue;
+  double phase, inc;
+  int xi, move;
+
+   if ( ( x->x_current == -1 ) || ( channel->c_path.p_npoints == 0 ) )
    {
-     x->x_x1 = 10; 
-     x->x_y1 = 10; 
-     if ( 10+n > (x->x_vwidth-1) )
-     {
-        x->x_x2 = x->x_vwidth-1;
-     }
-     else
-     {
-        x->x_x2 = 10+n;
-     }
-     if ( 10+n > (x->x_vheight-1) )
-     {
-        x->x_y2 = x->x_vheight-1;
-     }
-     else
-     {
-        x->x_y2 = 10+n;
-     }
+      while (n--) *out++ = 0.0;
+      return (w+5);
    }
-   // post( "pdp_segsnd : x1=%d y1=%d x2=%d y2=%d", x->x_x1, x->x_y1, x->x_x2, x->x_y2 );
+   current = &x->x_snapshots[x->x_current];
+   previous = x->x_fade ? &x->x_snapshots[x->x_previous] : NULL;
 
-   // output image data
-   if ( x->x_x1 == -1 ) 
-   {
-      npoints = 0;
-   }
-   else if ( x->x_x2-x->x_x1 > n )
-   {
-      npoints = n;
-   }
-   else
-   {
-      npoints = x->x_x2-x->x_x1;
-   }
-   if ( (x->x_x2-x->x_x1) > 0 )
-   {
-      a = (x->x_y2-x->x_y1)/(x->x_x2-x->x_x1);
-   } 
-   // post( "pdp_segsnd : npoints=%d a=%f", npoints, a );
-   // read pixels
-   for (xi=0; xi<npoints; xi++)
+   // move from the last path to the new one over the block
+   move = channel->c_changed && ( channel->c_last.p_npoints > 0 );
+   len = channel->c_path.p_len[channel->c_path.p_npoints-1];
+   lastlen = move ? channel->c_last.p_len[channel->c_last.p_npoints-1] : len;
+
+   phase = channel->c_phase;
+   inc = ( x->x_sr > 0 ) ? channel->c_frequency/x->x_sr : 0;
+   for (xi=0; xi<n; xi++)
    {
-      px = x->x_x1 + xi; 
-      py = x->x_y1 + (int)(a*xi);
-      *out = (((t_float)(x->x_data[py*x->x_vwidth+px]>>7))-127)/128.0; // scaled to -1 ... 1
-      out++;
+      t = (t_float)(xi+1)/n;
+      if ( channel->c_frequency > 0 )
+      {
+         // back and forth, so that the end of the path is not a jump
+         u = ( phase < 0.5 ) ? 2*phase : 2-2*phase;
+         dist = u*len;
+         lastdist = u*lastlen;
+         phase += inc;
+         if ( phase >= 1 ) phase -= floor( phase );
+      }
+      else
+      {
+         // one pixel per sample, as long as the path lasts
+         dist = lastdist = xi;
+         if ( dist > len )
+         {
+            *out++ = 0.0;
+            continue;
+         }
+      }
+
+      pdp_segsnd_point( &channel->c_path, dist, &px, &py );
+      if ( move )
+      {
+         pdp_segsnd_point( &channel->c_last, lastdist, &lx, &ly );
+         px = lx + t*(px-lx);
+         py = ly + t*(py-ly);
+      }
+
+      value = pdp_segsnd_read( current, px, py );
+      if ( previous )
+      {
+         lastvalue = pdp_segsnd_read( previous, px, py );
+         value = lastvalue + t*(value-lastvalue);
+      }
+      *out++ = value;
    }
-   // fill up with zeros
-   for (xi=npoints; xi<n; xi++)
+   channel->c_phase = phase;
+
+   if ( channel->c_changed )
    {
-       *out++ = 0.0;
+      channel->c_last = channel->c_path;
+      channel->c_changed = 0;
    }
 
-   return (w+4);
+   return (w+5);
 }
 
 static void pdp_segsnd_dsp(t_pdp_segsnd *x, t_signal **sp)
 {
-    dsp_add(pdp_segsnd_perform, 3, sp[0]->s_vec, x, sp[0]->s_n);
+  int c;
+
+    x->x_sr = sp[0]->s_sr;
+    dsp_add(pdp_segsnd_tick, 2, x, sp[0]->s_n);
+    for ( c=0; c<x->x_nchannels; c++ )
+    {
+       dsp_add(pdp_segsnd_perform, 4, sp[c]->s_vec, x, c, sp[c]->s_n);
+    }
 }
 
 t_class *pdp_segsnd_class;
 
-void *pdp_segsnd_new(void)
+void *pdp_segsnd_new(t_floatarg fchannels)
 {
     int i;
 
@@ -359,11 +685,19 @@ void *pdp_segsnd_new(void)
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("y2"));
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("random"));
 
+    x->x_nchannels = (int)fchannels;
+    if ( x->x_nchannels < 1 ) x->x_nchannels = 1;
+    if ( x->x_nchannels > MAX_CHANNELS )
+    {
+       post( "pdp_segsnd~ : only %d channels", MAX_CHANNELS );
+       x->x_nchannels = MAX_CHANNELS;
+    }
+
     // pdp output
     x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
 
-    // sound output
-    outlet_new (&x->x_obj, &s_signal);
+    // sound outputs
+    for ( i=0; i<x->x_nchannels; i++ ) outlet_new (&x->x_obj, &s_signal);
 
     x->x_packet0 = -1;
     x->x_packet1 = -1;
@@ -373,13 +707,34 @@ void *pdp_segsnd_new(void)
     x->x_vheight = -1;
 
     x->x_image = NULL;
-    x->x_data = NULL;
     x->x_x1 = -1;
     x->x_y1 = -1;
     x->x_x2 = -1;
     x->x_y2 = -1;
     x->x_random = 0;
 
+    for ( i=0; i<MAX_CHANNELS; i++ )
+    {
+       x->x_channels[i].c_path.p_npoints = 0;
+       x->x_channels[i].c_last.p_npoints = 0;
+       x->x_channels[i].c_changed = 0;
+       x->x_channels[i].c_frequency = 0;
+       x->x_channels[i].c_phase = 0;
+    }
+    x->x_sr = 0;
+
+    for ( i=0; i<NB_SNAPSHOTS; i++ )
+    {
+       x->x_snapshots[i].s_data = NULL;
+       x->x_snapshots[i].s_width = 0;
+       x->x_snapshots[i].s_height = 0;
+    }
+    x->x_current = -1;
+    x->x_previous = -1;
+    x->x_fresh = -1;
+    x->x_fade = 0;
+    pthread_mutex_init( &x->x_snaplock, NULL );
+
     return (void *)x;
 }
 
@@ -395,7 +750,7 @@ void pdp_segsnd_tilde_setup(void)
 
     // post( pdp_segsnd_version );
     pdp_segsnd_class = class_new(gensym("pdp_segsnd~"), (t_newmethod)pdp_segsnd_new,
-    	(t_method)pdp_segsnd_free, sizeof(t_pdp_segsnd), 0, A_NULL);
+    	(t_method)pdp_segsnd_free, sizeof(t_pdp_segsnd), 0, A_DEFFLOAT, A_NULL);
 
     class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_dsp, gensym("dsp"), 0);
     class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_input_0, gensym("pdp"),  
@@ -405,6 +760,10 @@ void pdp_segsnd_tilde_setup(void)
     class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_x2, gensym("x2"),  A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_y2, gensym("y2"),  A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_random, gensym("random"),  A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_segment, gensym("segment"),  A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, A_NULL);
+    class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_polyline, gensym("polyline"),  A_GIMME, A_NULL);
+    class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_spiral, gensym("spiral"),  A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, A_NULL);
+    class_addmethod(pdp_segsnd_class, (t_method)pdp_segsnd_frequency, gensym("frequency"),  A_FLOAT, A_FLOAT, A_NULL);
 
 
 }
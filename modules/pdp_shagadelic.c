@@ -25,6 +25,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_pool.h"
 #include <math.h>
 
 #define MAX_TABLES 6
@@ -115,14 +117,14 @@ static void pdp_shagadelic_init_tables(t_pdp_shagadelic *x)
 
 static void pdp_shagadelic_free_ressources(t_pdp_shagadelic *x)
 {
-    if (x->x_ripple) freebytes( x->x_ripple, x->x_vsize*4 );
-    if (x->x_spiral) freebytes( x->x_spiral, x->x_vsize );
+    if (x->x_ripple) pidip_pool_put( x->x_ripple );
+    if (x->x_spiral) pidip_pool_put( x->x_spiral );
 }
 
 static void pdp_shagadelic_allocate(t_pdp_shagadelic *x)
 {
-    x->x_ripple = (char *) getbytes( x->x_vsize*4 );
-    x->x_spiral = (char *) getbytes( x->x_vsize );
+    x->x_ripple = (char *) pidip_pool_get( x->x_vsize*4 );
+    x->x_spiral = (char *) pidip_pool_get( x->x_vsize );
 }
 
 static void pdp_shagadelic_process_yv12(t_pdp_shagadelic *x)
@@ -217,7 +219,7 @@ static void pdp_shagadelic_process(t_pdp_shagadelic *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_shagadelic_process_yv12, pdp_shagadelic_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_shagadelic_process_yv12, pdp_shagadelic_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -240,7 +242,7 @@ static void pdp_shagadelic_input_0(t_pdp_shagadelic *x, t_symbol *s, t_floatarg
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -256,7 +258,7 @@ static void pdp_shagadelic_free(t_pdp_shagadelic *x)
   int i;
 
     pdp_shagadelic_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 
 #define PLANE_POWER         (4)     // 2 exp 4 = 16
@@ -363,24 +364,15 @@ static void pdp_spiral_process_yv12(t_pdp_spiral *x)
         pdp_spiral_move_focus(x);
     }
 
-    i = 0;
-    iu = 0;
-    for(py = 0; py < x->x_vheight; py++) 
+    // the depth map selects a past frame, not a position,
+    // so the luminance is gathered across planes
+    for(i = 0; i < x->x_vsize; i++) 
     {
-      for(px = 0; px < x->x_vwidth; px++) 
-      {
         cf = (x->x_plane + x->x_depthmap[i]) & PLANE_MASK;
         newdata[i] = (x->x_planetable[cf])[i];
-        // u & v are untouched
-        newdata[x->x_vsize+iu] = data[x->x_vsize+iu];
-        newdata[x->x_vsize+(x->x_vsize>>2)+iu] = data[x->x_vsize+(x->x_vsize>>2)+iu];
-        i++;
-        if ( (px%2==0) && (py%2==0) )
-        {
-           iu++;
-        }
-      }
     }
+    // u & v are untouched
+    memcpy( newdata+x->x_vsize, data+x->x_vsize, (x->x_vsize>>1)<<1 );
 
     x->x_plane--;
     x->x_plane &= PLANE_MASK;
@@ -412,7 +404,7 @@ static void pdp_spiral_process(t_pdp_spiral *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_spiral_process_yv12, pdp_spiral_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_spiral_process_yv12, pdp_spiral_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -431,7 +423,7 @@ static void pdp_spiral_input_0(t_pdp_spiral *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -444,7 +436,7 @@ static void pdp_spiral_free(t_pdp_spiral *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_spiral_free_ressources(x);
 }
@@ -26,6 +26,9 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
+#include "pidip_roi.h"
 #include "yuv.h"
 #include <math.h>
 
@@ -54,6 +57,8 @@ typedef struct pdp_spotlight_struct
     int x_colorG;   // green component of the color
     int x_colorB;   // blue component of the color
 
+    t_pidip_roi x_roi;  // the spotlight is only drawn in this region
+
 } t_pdp_spotlight;
 
 static void pdp_spotlight_ssize(t_pdp_spotlight *x, t_floatarg fssize )
@@ -121,7 +126,7 @@ static void pdp_spotlight_process_yv12(t_pdp_spotlight *x)
     int       i;
 
     short int *poy, *pou, *pov, *pny, *pnu, *pnv;
-    short int pmx, pMx, pmy, pMy;
+    int pmx, pMx, pmy, pMy;
     int px, py, ray2;
 
     x->x_vwidth = header->info.image.width;
@@ -132,7 +137,7 @@ static void pdp_spotlight_process_yv12(t_pdp_spotlight *x)
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy(newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1);
+    pidip_inplace_copy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
 
     poy = data;
     pou = data + x->x_vsize;
@@ -150,11 +155,11 @@ static void pdp_spotlight_process_yv12(t_pdp_spotlight *x)
     }
     if ( x->x_cy+x->x_ssize > x->x_vheight ) 
     {
-      pMy=x->x_vheight-1; 
+      pMy=x->x_vheight; 
     }
     else
     {
-      pMy=x->x_cy+x->x_ssize; 
+      pMy=x->x_cy+x->x_ssize+1; 
     }
     if ( x->x_cx-x->x_ssize < 0 ) 
     {
@@ -166,16 +171,20 @@ static void pdp_spotlight_process_yv12(t_pdp_spotlight *x)
     }
     if ( x->x_cx+x->x_ssize > x->x_vwidth ) 
     {
-      pMx=x->x_vwidth-1; 
+      pMx=x->x_vwidth; 
     }
     else
     {
-      pMx=x->x_cx+x->x_ssize; 
+      pMx=x->x_cx+x->x_ssize+1; 
+    }
+    if ( !pidip_roi_clip( &x->x_roi, x->x_vwidth, x->x_vheight, &pmx, &pmy, &pMx, &pMy ) )
+    {
+      return;
     }
     ray2 = pow( x->x_ssize, 2 );
-    for (py = pmy; py <= pMy ; py++) 
+    for (py = pmy; py < pMy ; py++) 
     {
-      for (px = pmx; px <= pMx; px++) 
+      for (px = pmx; px < pMx; px++) 
       {
         if ( ( pow( (px-x->x_cx), 2 ) + pow( (py-x->x_cy), 2 ) ) < ray2 )
         {
@@ -205,7 +214,7 @@ static void pdp_spotlight_sendpacket(t_pdp_spotlight *x)
     x->x_packet0 = -1;
 
     /* unregister and propagate if valid dest packet */
-    pdp_packet_pass_if_valid(x->x_outlet0, &x->x_packet1);
+    pidip_roi_pass(x->x_outlet0, &x->x_packet1, &x->x_roi);
 }
 
 static void pdp_spotlight_process(t_pdp_spotlight *x)
@@ -221,8 +230,8 @@ static void pdp_spotlight_process(t_pdp_spotlight *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_spotlight_process_yv12, pdp_spotlight_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_spotlight_process_yv12, pdp_spotlight_sendpacket, &x->x_queue_id);
 	    break;
 
 	default:
@@ -239,7 +248,8 @@ static void pdp_spotlight_input_0(t_pdp_spotlight *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       if ( !x->x_dropped ) pidip_roi_get( (int)f, &x->x_roi );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -254,7 +264,7 @@ static void pdp_spotlight_free(t_pdp_spotlight *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 }
 
@@ -286,6 +296,7 @@ void *pdp_spotlight_new(void)
     x->x_colorG = 255;
     x->x_colorB = 255;
     x->x_strength = 0.5;
+    pidip_roi_clear( &x->x_roi );
 
     return (void *)x;
 }
@@ -0,0 +1,353 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  This object computes frame statistics :
+ *  extrema, mean, variance and percentiles of each channel,
+ *  histograms and per cell statistics of a grid written to arrays
+ */
+
+#include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_stats.h"
+#include <math.h>
+
+#define MAX_PERCENTILES 16
+#define NB_CELLSTATS 4   // mean, variance, min, max
+
+static char   *pdp_stats_version = "pdp_stats: version 0.1, frame statistics, written by Yves Degoyon (ydegoyon@free.fr)";
+
+static char *pdp_stats_cellnames[NB_CELLSTATS] = { "mean", "variance", "min", "max" };
+
+typedef struct pdp_stats_struct
+{
+    t_object x_obj;
+    t_float x_f;
+
+    t_outlet *x_outlet0;
+
+    int x_packet0;
+    int x_dropped;
+    int x_queue_id;
+
+    int x_vwidth;
+    int x_vheight;
+    int x_cols;          // wanted grid
+    int x_rows;
+    t_pidip_stats x_stats;
+
+    int x_nbpercentiles;
+    t_float x_percentiles[MAX_PERCENTILES];
+    t_symbol *x_histarray[PIDIP_STATS_CHANNELS];
+    t_symbol *x_cellarray[PIDIP_STATS_CHANNELS][NB_CELLSTATS];
+
+} t_pdp_stats;
+
+static void pdp_stats_grid(t_pdp_stats *x, t_floatarg fcols, t_floatarg frows )
+{
+    if ( ( fcols >= 0 ) && ( frows >= 0 ) && ( fcols*frows <= PIDIP_STATS_MAXCELLS ) )
+    {
+       x->x_cols = (int)fcols;
+       x->x_rows = (int)frows;
+    }
+    else
+    {
+       post( "pdp_stats : wrong grid : %dx%d ( maximum %d cells )", (int)fcols, (int)frows, PIDIP_STATS_MAXCELLS );
+    }
+}
+
+static void pdp_stats_percentiles(t_pdp_stats *x, t_symbol *s, int argc, t_atom *argv)
+{
+  int i;
+
+    x->x_nbpercentiles = 0;
+    for ( i=0; ( i<argc ) && ( i<MAX_PERCENTILES ); i++ )
+    {
+       if ( argv[i].a_type != A_FLOAT ) continue;
+       x->x_percentiles[x->x_nbpercentiles++] = argv[i].a_w.w_float;
+    }
+}
+
+static int pdp_stats_channel(t_floatarg fchannel)
+{
+    if ( ( fchannel < 0 ) || ( fchannel >= PIDIP_STATS_CHANNELS ) )
+    {
+       post( "pdp_stats : wrong channel : %d", (int)fchannel );
+       return -1;
+    }
+    return (int)fchannel;
+}
+
+static void pdp_stats_histogram(t_pdp_stats *x, t_floatarg fchannel, t_symbol *array )
+{
+  int ch;
+
+    if ( ( ch = pdp_stats_channel( fchannel ) ) < 0 ) return;
+    x->x_histarray[ch] = ( array == &s_ ) ? NULL : array;
+}
+
+static void pdp_stats_cells(t_pdp_stats *x, t_floatarg fchannel, t_symbol *stat, t_symbol *array )
+{
+  int ch, i;
+
+    if ( ( ch = pdp_stats_channel( fchannel ) ) < 0 ) return;
+    for ( i=0; i<NB_CELLSTATS; i++ )
+    {
+       if ( stat == gensym( pdp_stats_cellnames[i] ) )
+       {
+          x->x_cellarray[ch][i] = ( array == &s_ ) ? NULL : array;
+          return;
+       }
+    }
+    post( "pdp_stats : unknown cell statistic : %s", stat->s_name );
+}
+
+/* write values to an array, resizing it */
+static void pdp_stats_tabwrite(t_symbol *array, t_float *values, int nvalues)
+{
+  t_garray *a;
+  t_word *vec;
+  int size, i;
+
+    if ( !(a = (t_garray *)pd_findbyclass(array, garray_class)) )
+    {
+       post( "pdp_stats : %s : no such array", array->s_name );
+       return;
+    }
+    if ( !garray_getfloatwords( a, &size, &vec ) )
+    {
+       post( "pdp_stats : %s : bad template", array->s_name );
+       return;
+    }
+    if ( size != nvalues )
+    {
+       garray_resize( a, nvalues );
+       if ( !garray_getfloatwords( a, &size, &vec ) ) return;
+    }
+    for ( i=0; ( i<size ) && ( i<nvalues ); i++ )
+    {
+       vec[i].w_float = values[i];
+    }
+    garray_redraw( a );
+}
+
+static void pdp_stats_outlist(t_pdp_stats *x, char *selector, t_float first, t_float *values, int withfirst)
+{
+  t_atom atoms[PIDIP_STATS_CHANNELS+1];
+  int i, n=0;
+
+    if ( withfirst ) SETFLOAT( &atoms[n++], first );
+    for ( i=0; i<PIDIP_STATS_CHANNELS; i++ ) SETFLOAT( &atoms[n++], values[i] );
+    outlet_anything( x->x_outlet0, gensym(selector), n, atoms );
+}
+
+static void pdp_stats_process_yv12(t_pdp_stats *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    short int *data   = (short int *)pdp_packet_data(x->x_packet0);
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    pidip_stats_grid( &x->x_stats, x->x_cols, x->x_rows );
+    pidip_stats_yv12( &x->x_stats, data, x->x_vwidth, x->x_vheight );
+}
+
+static void pdp_stats_process_rgb(t_pdp_stats *x)
+{
+    t_pdp     *header = pdp_packet_header(x->x_packet0);
+    unsigned char *data = (unsigned char *)pdp_packet_data(x->x_packet0);
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    pidip_stats_grid( &x->x_stats, x->x_cols, x->x_rows );
+    pidip_stats_rgb( &x->x_stats, data, x->x_vwidth, x->x_vheight );
+}
+
+/* results are sent from the pd thread */
+static void pdp_stats_sendstats(t_pdp_stats *x)
+{
+  t_pidip_stats *st = &x->x_stats;
+  t_pidip_cellstats *c;
+  t_float values[PIDIP_STATS_CHANNELS];
+  t_float *cellvalues;
+  t_float histo[256];
+  int ch, i, v, ncells;
+
+    /* release the packet */
+    pdp_packet_mark_unused(x->x_packet0);
+    x->x_packet0 = -1;
+
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) values[ch] = pidip_stats_min( st, ch );
+    pdp_stats_outlist( x, "min", 0, values, 0 );
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) values[ch] = pidip_stats_max( st, ch );
+    pdp_stats_outlist( x, "max", 0, values, 0 );
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) values[ch] = pidip_stats_mean( st, ch );
+    pdp_stats_outlist( x, "mean", 0, values, 0 );
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) values[ch] = pidip_stats_variance( st, ch );
+    pdp_stats_outlist( x, "variance", 0, values, 0 );
+    for ( i=0; i<x->x_nbpercentiles; i++ )
+    {
+       for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) values[ch] = pidip_stats_percentile( st, ch, x->x_percentiles[i] );
+       pdp_stats_outlist( x, "percentile", x->x_percentiles[i], values, 1 );
+    }
+
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ )
+    {
+       if ( !x->x_histarray[ch] ) continue;
+       for ( v=0; v<256; v++ ) histo[v] = st->s_histo[ch][v];
+       pdp_stats_tabwrite( x->x_histarray[ch], histo, 256 );
+    }
+
+    ncells = st->s_cols*st->s_rows;
+    if ( ncells <= 0 ) return;
+    cellvalues = (t_float *) getbytes( ncells*sizeof(t_float) );
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ )
+    {
+       for ( i=0; i<NB_CELLSTATS; i++ )
+       {
+          if ( !x->x_cellarray[ch][i] ) continue;
+          for ( v=0; v<ncells; v++ )
+          {
+             c = pidip_stats_cell( st, ch, v );
+             if ( !c->c_count )
+             {
+                cellvalues[v] = 0;
+                continue;
+             }
+             switch ( i )
+             {
+               case 0 :
+                 cellvalues[v] = (t_float)c->c_sum/c->c_count;
+                 break;
+               case 1 :
+                 cellvalues[v] = (t_float)((double)c->c_sum2/c->c_count -
+                                 ((double)c->c_sum/c->c_count)*((double)c->c_sum/c->c_count));
+                 break;
+               case 2 :
+                 cellvalues[v] = c->c_min;
+                 break;
+               default :
+                 cellvalues[v] = c->c_max;
+                 break;
+             }
+          }
+          pdp_stats_tabwrite( x->x_cellarray[ch][i], cellvalues, ncells );
+       }
+    }
+    freebytes( cellvalues, ncells*sizeof(t_float) );
+}
+
+static void pdp_stats_process(t_pdp_stats *x)
+{
+   t_pdp *header = 0;
+
+   /* check if image data packets are compatible */
+   if ( (header = pdp_packet_header(x->x_packet0)) )
+   {
+      if ( ( PDP_IMAGE == header->type ) && ( PDP_IMAGE_YV12 == header->info.image.encoding ) )
+      {
+         pidip_queue_add(x, pdp_stats_process_yv12, pdp_stats_sendstats, &x->x_queue_id);
+      }
+      else if ( ( PDP_BITMAP == header->type ) && ( PDP_BITMAP_RGB == header->info.image.encoding ) )
+      {
+         pidip_queue_add(x, pdp_stats_process_rgb, pdp_stats_sendstats, &x->x_queue_id);
+      }
+   }
+}
+
+static void pdp_stats_input_0(t_pdp_stats *x, t_symbol *s, t_floatarg f)
+{
+  t_pdp *header;
+
+    /* if this is a register_ro message or register_rw message, register with packet factory */
+
+    if (s== gensym("register_rw"))
+    {
+       /* rgb bitmaps are analyzed as they are, anything else as YV12 */
+       if ( (header = pdp_packet_header((int)f)) && ( PDP_BITMAP == header->type ) )
+          x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("bitmap/rgb/*") );
+       else
+          x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+    }
+
+    if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
+    {
+        /* add the process method and callback to the process queue */
+        pdp_stats_process(x);
+    }
+}
+
+static void pdp_stats_free(t_pdp_stats *x)
+{
+    pidip_queue_release(x, x->x_queue_id);
+    pdp_packet_mark_unused(x->x_packet0);
+    pidip_stats_free( &x->x_stats );
+}
+
+t_class *pdp_stats_class;
+
+void *pdp_stats_new(t_floatarg fcols, t_floatarg frows)
+{
+    int i, j;
+
+    t_pdp_stats *x = (t_pdp_stats *)pd_new(pdp_stats_class);
+
+    x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
+
+    x->x_packet0 = -1;
+    x->x_queue_id = -1;
+
+    pidip_stats_init( &x->x_stats );
+    x->x_cols = x->x_rows = 0;
+    pdp_stats_grid( x, fcols, frows );
+    x->x_nbpercentiles = 0;
+    for ( i=0; i<PIDIP_STATS_CHANNELS; i++ )
+    {
+       x->x_histarray[i] = NULL;
+       for ( j=0; j<NB_CELLSTATS; j++ ) x->x_cellarray[i][j] = NULL;
+    }
+
+    return (void *)x;
+}
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+void pdp_stats_setup(void)
+{
+//    post( pdp_stats_version );
+    pdp_stats_class = class_new(gensym("pdp_stats"), (t_newmethod)pdp_stats_new,
+    	(t_method)pdp_stats_free, sizeof(t_pdp_stats), 0, A_DEFFLOAT, A_DEFFLOAT, A_NULL);
+
+    class_addmethod(pdp_stats_class, (t_method)pdp_stats_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_stats_class, (t_method)pdp_stats_grid, gensym("grid"),  A_FLOAT, A_FLOAT, A_NULL);
+    class_addmethod(pdp_stats_class, (t_method)pdp_stats_percentiles, gensym("percentiles"),  A_GIMME, A_NULL);
+    class_addmethod(pdp_stats_class, (t_method)pdp_stats_histogram, gensym("histogram"),  A_FLOAT, A_DEFSYMBOL, A_NULL);
+    class_addmethod(pdp_stats_class, (t_method)pdp_stats_cells, gensym("cells"),  A_FLOAT, A_SYMBOL, A_DEFSYMBOL, A_NULL);
+
+
+}
+
+#ifdef __cplusplus
+}
+#endif
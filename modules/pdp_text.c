@@ -28,7 +28,10 @@
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_inplace.h"
 #include "yuv.h"
+#include "pidip_sprite.h"
 #include <math.h>
 #include <ctype.h>
 #include <Imlib2.h>  // imlib2 is required
@@ -68,9 +71,12 @@ typedef struct pdp_text_struct
     int x_capacity;
 
         /* imlib data */
-    Imlib_Image x_image;
     Imlib_Font x_font;
 
+        /* rendered texts */
+    t_pidip_textcache x_cache;
+    int x_flushcache;
+
 } t_pdp_text;
 
         /* add a new text : syntax : text <my%20text> x y */
@@ -244,16 +250,19 @@ static void pdp_text_scroll(t_pdp_text *x, t_floatarg fscroll )
 static void pdp_text_dither(t_pdp_text *x, t_floatarg fdither )
 {
     imlib_context_set_dither( (char)fdither );
+    x->x_flushcache = 1;
 }
 
 static void pdp_text_blend(t_pdp_text *x, t_floatarg fblend )
 {
     imlib_context_set_blend( (char)fblend );
+    x->x_flushcache = 1;
 }
 
 static void pdp_text_antialias(t_pdp_text *x, t_floatarg fantialias )
 {
     imlib_context_set_anti_alias( (char)fantialias );
+    x->x_flushcache = 1;
 }
 
 static void pdp_text_clear(t_pdp_text *x )
@@ -387,23 +396,6 @@ static void pdp_text_font(t_pdp_text *x, t_symbol *sfont  )
     x->x_font = font;
 }
 
-static void pdp_text_allocate(t_pdp_text *x)
-{
-   x->x_image = imlib_create_image( x->x_vwidth, x->x_vheight );
-   if ( x->x_image == NULL )
-   {
-       pd_error( x, "[%s] error: could not allocate image!!", 
-                 class_getname(*(t_pd *)x) );
-       return;
-   }
-   imlib_context_set_image(x->x_image);
-}
-
-static void pdp_text_free_ressources(t_pdp_text *x)
-{
-   // if ( x->x_image != NULL ) imlib_free_image();
-}
-
 static void pdp_text_process_yv12(t_pdp_text *x)
 {
     t_pdp     *header = pdp_packet_header(x->x_packet0);
@@ -411,76 +403,37 @@ static void pdp_text_process_yv12(t_pdp_text *x)
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
     int     ti;
-    int     px, py;
-    unsigned char y, u, v;
-    DATA32    *imdata;
-    DATA32    bgcolor;
-    short int *pY, *pU, *pV;
-    int	text_width, text_height;
-
-    if ( ( (int)(header->info.image.width) != x->x_vwidth ) ||
-         ( (int)(header->info.image.height) != x->x_vheight ) )
-    {
-         pdp_text_free_ressources(x);
-         x->x_vwidth = header->info.image.width;
-         x->x_vheight = header->info.image.height;
-         x->x_vsize = x->x_vwidth*x->x_vheight;
-         pdp_text_allocate(x);
-    }
+    t_pidip_textsprite *text;
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
-
-    // draw all texts
-    if ( x->x_image != NULL ) imlib_context_set_image(x->x_image);
-    imlib_image_clear();
-    imlib_context_set_direction(IMLIB_TEXT_TO_ANGLE);
-    imdata = imlib_image_get_data();
-    bgcolor = imdata[0];
+    pidip_inplace_copy( newdata, data, (x->x_vsize+(x->x_vsize>>1))<<1 );
 
-    for (ti=0; ti<x->x_nbtexts; ti++)
+    if ( x->x_flushcache )
     {
-       imlib_context_set_angle( x->x_angle[ti] );
-       imlib_context_set_color( x->x_r[ti], x->x_g[ti], x->x_b[ti], 255 );
-
-       imlib_context_set_font( x->x_font );
-       imlib_get_text_size( x->x_text_array[ti], &text_width, &text_height);
-
-       imlib_text_draw( x->x_xoffsets[ti] - (0.5*text_width) + (cos(x->x_angle[ti]) * x->x_scroll[ti]), 
-                        x->x_yoffsets[ti] - (0.5*text_height) + (sin(x->x_angle[ti]) * x->x_scroll[ti]), 
-                        x->x_text_array[ti] );
+       pidip_textcache_flush( &x->x_cache );
+       x->x_flushcache = 0;
     }
 
-    pY = newdata;
-    pV = newdata+x->x_vsize;
-    pU = newdata+x->x_vsize+(x->x_vsize>>2);
-    for ( py=0; py<x->x_vheight; py++ )
+    // texts are only rendered when they change,
+    // then blended within their bounding box
+    for (ti=0; ti<x->x_nbtexts; ti++)
     {
-       for ( px=0; px<x->x_vwidth; px++ )
-       {
-          if ( imdata[py*x->x_vwidth+px] != bgcolor )
-          {
-            y = yuv_RGBtoY(imdata[py*x->x_vwidth+px]);
-            u = yuv_RGBtoU(imdata[py*x->x_vwidth+px]);
-            v = yuv_RGBtoV(imdata[py*x->x_vwidth+px]);
-          
-            *(pY) = ((y)<<7)*x->x_alpha + (*pY)*(1-x->x_alpha);
-            if ( (px%2==0) && (py%2==0) )
-            {
-              *(pV) = ((v-128)<<8)*x->x_alpha + *(pV)*(1-x->x_alpha);
-              *(pU) = ((u-128)<<8)*x->x_alpha + *(pU)*(1-x->x_alpha);
-            }
-          }
-          pY++;
-          if ( (px%2==0) && (py%2==0) )
-          {
-            pV++;pU++;
-          }
-       }
+       text = pidip_textcache_get( &x->x_cache, x->x_text_array[ti], x->x_font,
+                                   x->x_r[ti], x->x_g[ti], x->x_b[ti], x->x_angle[ti] );
+
+       pidip_sprite_blend( &text->t_sprite, newdata, x->x_vwidth, x->x_vheight,
+                        x->x_xoffsets[ti] - (0.5*text->t_width) + (cos(x->x_angle[ti]) * x->x_scroll[ti]), 
+                        x->x_yoffsets[ti] - (0.5*text->t_height) + (sin(x->x_angle[ti]) * x->x_scroll[ti]), 
+                        (int)(x->x_alpha*256) );
     }
+    pidip_textcache_collect( &x->x_cache );
 
     return;
 }
@@ -509,8 +462,8 @@ static void pdp_text_process(t_pdp_text *x)
         {
 
 	  case PDP_IMAGE_YV12:
-            x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_text_process_yv12, pdp_text_sendpacket, &x->x_queue_id);
+            x->x_packet1 = pidip_inplace_rw(x->x_packet0);
+            pidip_queue_add(x, pdp_text_process_yv12, pdp_text_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -533,7 +486,7 @@ static void pdp_text_input_0(t_pdp_text *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -548,9 +501,9 @@ static void pdp_text_free(t_pdp_text *x)
 {
   int i;
 
-    pdp_text_free_ressources(x);
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_textcache_flush( &x->x_cache );
 }
 
 t_class *pdp_text_class;
@@ -574,9 +527,9 @@ void *pdp_text_new(void)
     x->x_packet0 = -1;
     x->x_packet1 = -1;
     x->x_queue_id = -1;
-    x->x_image = NULL;
-
     x->x_font = imlib_context_get_font();
+    pidip_textcache_init( &x->x_cache );
+    x->x_flushcache = 0;
 
     x->x_capacity = DEFAULT_CAPACITY;
 
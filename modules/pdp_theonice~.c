@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <pthread.h>
 #include <unistd.h>
 #include <math.h>
@@ -1210,7 +1211,7 @@ static void pdp_theonice_process(t_pdp_theonice *x)
         {
 
 	  case PDP_BITMAP_YV12:
-            pdp_queue_add(x, pdp_theonice_process_yv12, pdp_theonice_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_theonice_process_yv12, pdp_theonice_killpacket, &x->x_queue_id);
 	    break;
 
 	  default:
@@ -1227,7 +1228,7 @@ static void pdp_theonice_input_0(t_pdp_theonice *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-        x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
+        x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -1242,7 +1243,7 @@ static void pdp_theonice_free(t_pdp_theonice *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     // close video file if existing
     pdp_theonice_disconnect(x);
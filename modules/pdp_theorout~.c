@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
 #include <time.h>
 #include <sys/time.h>
@@ -810,7 +811,7 @@ static void pdp_theorout_process(t_pdp_theorout *x)
             {
               outlet_float( x->x_obj.ob_outlet, x->x_frameswritten );
             }
-            pdp_queue_add(x, pdp_theorout_process_yv12, pdp_theorout_killpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_theorout_process_yv12, pdp_theorout_killpacket, &x->x_queue_id);
 	    break;
 
 	  default:
@@ -828,7 +829,7 @@ static void pdp_theorout_input_0(t_pdp_theorout *x, t_symbol *s, t_floatarg f)
 
     if (s== gensym("register_rw"))
     {
-        x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
+        x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("bitmap/yv12/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
@@ -843,7 +844,7 @@ static void pdp_theorout_free(t_pdp_theorout *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     // close video file if existing
     pdp_theorout_close(x);
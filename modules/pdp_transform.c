@@ -25,6 +25,8 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_remap.h"
 #include <math.h>
 
 #define MAX_TABLES 6
@@ -48,8 +50,7 @@ typedef struct pdp_transform_struct
     int x_vheight;
     int x_vsize;
 
-    int **x_table_list; // mapping tables
-    int **x_table_list_u; // mapping tables
+    t_pidip_remapcache x_maps; // mapping tables
     int x_table; // current table
     int x_t;
 
@@ -64,115 +65,80 @@ static void pdp_transform_table(t_pdp_transform *x, t_floatarg ftable )
     }
 }
 
-static int pdp_transform_map_from_table(t_pdp_transform *x, int px, int py, int t) 
+/* source of a pixel for each table */
+static void pdp_transform_source(t_pdp_transform *x, int table, int px, int py, int *sx, int *sy)
 {
-  int xd,yd;
+  const int size = 16;
+  int tx, ty;
 
-    yd = py + (inline_fastrand() >> 30)-2;
-    xd = px + (inline_fastrand() >> 30)-2;
-    if (xd > x->x_vwidth) {
-      xd-=1;
+    switch ( table )
+    {
+      case 1:
+        *sx = x->x_vwidth-1-px; *sy = py;
+        break;
+
+      case 2:
+        *sx = px; *sy = x->x_vheight-1-py;
+        break;
+
+      case 3:
+        *sx = x->x_vwidth-1-px; *sy = x->x_vheight-1-py;
+        break;
+
+      case 4:
+        *sy = py + (inline_fastrand() >> 30)-2;
+        *sx = px + (inline_fastrand() >> 30)-2;
+        break;
+
+      case 5:
+        ty = py % size - size / 2;
+        if((py/size)%2)
+        {
+          ty = py - ty;
+        }
+        else
+        {
+          ty = py + ty;
+        }
+        tx = px % size - size / 2;
+        if((px/size)%2)
+        {
+          tx = px - tx;
+        }
+        else
+        {
+          tx = px + tx;
+        }
+        *sx = tx; *sy = ty;
+        break;
+
+      default:
+        *sx = px; *sy = py;
+        break;
     }
-    return (xd+yd*x->x_vwidth);
 }
 
-static int pdp_transform_map_from_table_u(t_pdp_transform *x, int px, int py, int t) 
+/* maps are kept for each table, the random one is rebuilt for each frame */
+static t_pidip_remap *pdp_transform_get_map(t_pdp_transform *x)
 {
-  int xd,yd;
+  int px, py, sx, sy, build;
+  int key[2];
+  t_pidip_remap *map;
 
-    yd = py + (inline_fastrand() >> 30)-2;
-    xd = px + (inline_fastrand() >> 30)-2;
-    if (xd > x->x_vwidth) {
-      xd-=1;
-    }
-    return ((xd>>1)+(yd>>1)*(x->x_vwidth>>1));
-}
-
-static void pdp_transform_square_table_init(t_pdp_transform *x)
-{
-  const int size = 16;
-  int px, py, tx, ty;
+    key[0] = x->x_table;
+    key[1] = ( x->x_table == 4 ) ? x->x_t : 0;
+    map = pidip_remapcache_get( &x->x_maps, x->x_vwidth, x->x_vheight, PIDIP_REMAP_NEAREST, key, 2, &build );
+    if ( !map || !build ) return map;
 
     for(py=0; py<x->x_vheight; py++) 
     {
-       ty = py % size - size / 2;
-       if((py/size)%2)
-       {
-         ty = py - ty;
-       }
-       else
-       {
-         ty = py + ty;
-       }
-       if(ty<0) ty = 0;
-       if(ty>=x->x_vheight) 
-       {
-         ty = x->x_vheight - 1;
-       }
-       for(px=0; px<x->x_vwidth; px++) 
-       {
-          tx = px % size - size / 2;
-          if((px/size)%2)
-          {
-            tx = px - tx;
-          }
-          else
-          {
-            tx = px + tx;
-          }
-          if(tx<0) tx = 0;
-          if(tx>=x->x_vwidth) tx = x->x_vwidth - 1;
-          x->x_table_list[5][px+py*x->x_vwidth] = ty*x->x_vwidth+tx;
-          x->x_table_list_u[5][px+py*x->x_vwidth] = (ty>>1)*(x->x_vwidth>>1)+(tx>>1);
-       }
-     }
-}
-
-static void pdp_transform_init_tables(t_pdp_transform *x)
-{
-  int px, py;
-
-    for (py=0;py<x->x_vheight;py++) 
-    {
-      for (px=0;px<x->x_vwidth;px++) 
+      for(px=0; px<x->x_vwidth; px++) 
       {
-        x->x_table_list[0][px+py*x->x_vwidth] = px+py*x->x_vwidth;
-        x->x_table_list[1][px+py*x->x_vwidth] = (x->x_vwidth-1-px)+py*x->x_vwidth;
-        x->x_table_list[2][px+py*x->x_vwidth] = px+(x->x_vheight-1-py)*x->x_vwidth;
-        x->x_table_list[3][px+py*x->x_vwidth] = (x->x_vwidth-1-px)+(x->x_vheight-1-py)*x->x_vwidth;
-        x->x_table_list_u[0][px+py*x->x_vwidth]=  (px>>1)+((py*x->x_vwidth)>>2);
-        x->x_table_list_u[1][px+py*x->x_vwidth] = (x->x_vwidth>>1)-1-(px>>1)+(py>>1)*(x->x_vwidth>>1);
-        x->x_table_list_u[2][px+py*x->x_vwidth] = (px>>1)+((x->x_vheight>>1)-1-(py>>1))*(x->x_vwidth>>1);
-        x->x_table_list_u[3][px+py*x->x_vwidth] = ((x->x_vwidth-1-px)>>1)+((x->x_vheight-1-py)>>1)*(x->x_vwidth>>1);
-        x->x_table_list[4][px+py*x->x_vwidth] = -2; /* Function */
-        x->x_table_list_u[4][px+py*x->x_vwidth] = -2; /* Function */
+        pdp_transform_source( x, x->x_table, px, py, &sx, &sy );
+        pidip_remap_point( map, px, py, sx*PIDIP_REMAP_ONE, sy*PIDIP_REMAP_ONE );
       }
     }
-    pdp_transform_square_table_init(x);
-}
-
-static void pdp_transform_free_ressources(t_pdp_transform *x)
-{
-  int i;
-
-    // free tables
-    for(i=0;i<MAX_TABLES;i++)
-    {
-       if ( x->x_table_list[i] ) freebytes( x->x_table_list[i], x->x_vsize*sizeof(int) );
-       if ( x->x_table_list_u[i] ) freebytes( x->x_table_list_u[i], x->x_vsize*sizeof(int) );
-    }
-}
-
-static void pdp_transform_allocate(t_pdp_transform *x)
-{
-  int i;
-
-    // allocate tables
-    for(i=0;i<MAX_TABLES;i++)
-    {
-       x->x_table_list[i] = (int *) getbytes( x->x_vsize*sizeof(int) );
-       x->x_table_list_u[i] = (int *) getbytes( x->x_vsize*sizeof(int) );
-    }
+    return map;
 }
 
 static void pdp_transform_process_yv12(t_pdp_transform *x)
@@ -181,64 +147,25 @@ static void pdp_transform_process_yv12(t_pdp_transform *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int     i, iu;
-    int     px, py;
-    int     d, o, du=0, ou;
-    short int *pY, *pU, *pV, *pnY, *pnU, *pnV;
-
-    /* allocate all ressources */
-    if ( ((int)header->info.image.width != x->x_vwidth) ||
-         ((int)header->info.image.height != x->x_vheight) )
-    {
-        pdp_transform_free_ressources(x);
-        x->x_vwidth = header->info.image.width;
-        x->x_vheight = header->info.image.height;
-        x->x_vsize = x->x_vwidth*x->x_vheight;
-        pdp_transform_allocate(x);
-        post( "pdp_transform : reallocated buffers" );
-        pdp_transform_init_tables(x);
-        post( "pdp_transform : initialized tables" );
-    }
+    t_pidip_remap *map;
+
+    x->x_vwidth = header->info.image.width;
+    x->x_vheight = header->info.image.height;
+    x->x_vsize = x->x_vwidth*x->x_vheight;
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
     x->x_t++;
- 
-    pnY = newdata;
-    pnV = newdata+x->x_vsize;
-    pnU = newdata+x->x_vsize+(x->x_vsize>>2);
-    iu = 0;
-    for(py=0; py<x->x_vheight; py++)
+
+    if ( (map = pdp_transform_get_map( x )) )
     {
-      for(px=0; px<x->x_vwidth; px++)
-      {
-         d = x->x_table_list[x->x_table][py*x->x_vwidth+px];
-         if ( (px%2==0) && (py%2==0) ) 
-         {
-           du = x->x_table_list_u[x->x_table][py*x->x_vwidth+px];
-           iu++;
-         }
-         if ( d==-2 )
-         {
-            d = pdp_transform_map_from_table( x, px, py, x->x_t );
-            du = pdp_transform_map_from_table_u( x, px, py, x->x_t );
-         }
-         if ( d < 0) {
-              o = 0;
-              ou = 0;
-         } else {
-              o = d;
-              ou = du;
-         }
-         *pnY++ = *(data+o);
-         if ( (px%2==0) && (py%2==0) ) 
-         {
-           *pnV++ = *(data+x->x_vsize+ou);
-           *pnU++ = *(data+x->x_vsize+(x->x_vsize>>2)+ou);
-         }
-      }
+       pidip_remap_apply( map, data, newdata );
+    }
+    else
+    {
+       memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
     }
 
     return;
@@ -269,7 +196,7 @@ static void pdp_transform_process(t_pdp_transform *x)
 
 	  case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_transform_process_yv12, pdp_transform_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_transform_process_yv12, pdp_transform_sendpacket, &x->x_queue_id);
 	    break;
 
 	  case PDP_IMAGE_GREY:
@@ -292,7 +219,7 @@ static void pdp_transform_input_0(t_pdp_transform *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
 
@@ -307,10 +234,9 @@ static void pdp_transform_free(t_pdp_transform *x)
 {
   int i;
 
-    pdp_transform_free_ressources(x);
-    if ( x->x_table_list ) freebytes(x->x_table_list, MAX_TABLES * sizeof(int *));
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
+    pidip_remapcache_free(&x->x_maps);
 }
 
 t_class *pdp_transform_class;
@@ -327,8 +253,7 @@ void *pdp_transform_new(void)
     x->x_packet1 = -1;
     x->x_queue_id = -1;
 
-    x->x_table_list = (int **) getbytes(MAX_TABLES * sizeof(int *));
-    x->x_table_list_u = (int **) getbytes(MAX_TABLES * sizeof(int *));
+    pidip_remapcache_init(&x->x_maps, MAX_TABLES);
     x->x_t = 0;
 
     return (void *)x;
@@ -21,15 +21,23 @@
 /*  This object is an object allowing transitions between two video sources
  *  "circle", "wipe", "random", "melt", "page" and "blend"
  *  Written by Yves Degoyon                                 
+ *
+ *  every transition is a luma key : an 8 bits map, generated once
+ *  per transition and frame size ( or loaded from an image ),
+ *  gives for each pixel the moment it switches to the other source.
+ *  the frame is then a single blend driven by a table
+ *  of the 256 map values for the current progress.
  */
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include <math.h>
+#include <Imlib2.h>  // imlib2 is required
 
 #define BLEND_MAX 200
 #define PAGE_RAY  50
 
-static char   *pdp_transition_version = "pdp_transition: version 0.1, two sources transition, written by Yves Degoyon (ydegoyon@free.fr)";
+static char   *pdp_transition_version = "pdp_transition: version 0.2, two sources transition, written by Yves Degoyon (ydegoyon@free.fr)";
 
 typedef struct pdp_transition_struct
 {
@@ -55,16 +63,29 @@ typedef struct pdp_transition_struct
     int x_vheight;
     int x_vsize;
 
-    int x_transition_mode; // 1 : "circle"
+    int x_transition_mode; // 1 : "circle", ..., 11 : custom map
     int x_transition_pending; 
 
     int x_current_source;
     int x_target_source;
 
-    int x_pos; // current position for transition
     int x_inc; // increment for various mode
     int x_rand;// randomizing argument
 
+    unsigned char *x_map;  // transition map : value at which each pixel switches
+    int x_mapwidth;
+    int x_mapheight;
+    int x_mapvalid;        // the map is up to date for the pending transition
+    int x_progress;        // current position in map units, 8 bits of fraction
+    int x_step;            // progress per frame
+    int x_softness;        // width of the blended edge in map units
+    int x_border;          // white edge in map units ( page )
+    int x_lut[256];        // alpha for each map value, -1 for the border
+
+    unsigned char *x_custom; // luminance of the loaded map
+    int x_cwidth;
+    int x_cheight;
+
 } t_pdp_transition;
 
 static int pdp_transition_min( int a, int b )
@@ -75,22 +96,7 @@ static int pdp_transition_min( int a, int b )
    else return b;
 }
 
-static void pdp_transition_circle(t_pdp_transition *x, t_floatarg finc )
-{
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    x->x_transition_mode = 1;
-    x->x_transition_pending = 1;
-}
-
-static void pdp_transition_wipelr(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
+static void pdp_transition_start(t_pdp_transition *x, int mode, t_floatarg finc, t_floatarg frand )
 {
     if ( x->x_transition_pending )
     {
@@ -105,156 +111,284 @@ static void pdp_transition_wipelr(t_pdp_transition *x, t_floatarg finc, t_floata
     {
        x->x_rand = (int)frand;
     }
-    x->x_transition_mode = 2;
+    x->x_transition_mode = mode;
+    x->x_mapvalid = 0;
+    x->x_progress = 0;
     x->x_transition_pending = 1;
 }
 
+static void pdp_transition_circle(t_pdp_transition *x, t_floatarg finc )
+{
+    pdp_transition_start( x, 1, finc, -1 );
+}
+
+static void pdp_transition_wipelr(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
+{
+    pdp_transition_start( x, 2, finc, frand );
+}
+
 static void pdp_transition_wiperl(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    if ( (int) frand >= 0 )
-    {
-       x->x_rand = (int)frand;
-    }
-    x->x_transition_mode = 3;
-    x->x_transition_pending = 1;
-    x->x_pos = x->x_vwidth;
+    pdp_transition_start( x, 3, finc, frand );
 }
 
 static void pdp_transition_mwipe(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    if ( (int) frand >= 0 )
-    {
-       x->x_rand = (int)frand;
-    }
-    x->x_transition_mode = 4;
-    x->x_transition_pending = 1;
-    x->x_pos = 0;
+    pdp_transition_start( x, 4, finc, frand );
 }
 
 static void pdp_transition_wipetd(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    if ( (int) frand >= 0 )
-    {
-       x->x_rand = (int)frand;
-    }
-    x->x_transition_mode = 5;
-    x->x_transition_pending = 1;
-    x->x_pos = 0;
+    pdp_transition_start( x, 5, finc, frand );
 }
 
 static void pdp_transition_wipebu(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    if ( (int) frand >= 0 )
-    {
-       x->x_rand = (int)frand;
-    }
-    x->x_transition_mode = 6;
-    x->x_transition_pending = 1;
-    x->x_pos = x->x_vheight;
+    pdp_transition_start( x, 6, finc, frand );
 }
 
 static void pdp_transition_random(t_pdp_transition *x, t_floatarg finc )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    x->x_transition_mode = 7;
-    x->x_transition_pending = 1;
-    x->x_rand = x->x_vsize/(x->x_inc*(pdp_transition_min( x->x_vwidth, 100 )));
+    pdp_transition_start( x, 7, finc, -1 );
 }
 
 static void pdp_transition_melt(t_pdp_transition *x, t_floatarg finc )
 {
-    if ( x->x_transition_pending )
-    {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
-       return;
-    }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    x->x_transition_mode = 8;
-    x->x_transition_pending = 1;
-    x->x_rand = 20;
+    pdp_transition_start( x, 8, finc, 20 );
 }
 
 static void pdp_transition_blend(t_pdp_transition *x, t_floatarg finc, t_floatarg frand )
 {
-    if ( x->x_transition_pending )
+    pdp_transition_start( x, 9, finc, frand );
+}
+
+static void pdp_transition_page(t_pdp_transition *x, t_floatarg finc )
+{
+    pdp_transition_start( x, 10, finc, -1 );
+}
+
+static void pdp_transition_custom(t_pdp_transition *x, t_floatarg finc )
+{
+    if ( !x->x_custom )
     {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
+       post ( "pdp_transition : no map loaded, use : load <file>" );
        return;
     }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
-    }
-    if ( (int) frand >= 0 )
-    {
-       x->x_rand = (int)frand;
-    }
-    x->x_transition_mode = 9;
-    x->x_transition_pending = 1;
-    x->x_pos = 0;
+    pdp_transition_start( x, 11, finc, -1 );
 }
 
-static void pdp_transition_page(t_pdp_transition *x, t_floatarg finc )
+static void pdp_transition_softness(t_pdp_transition *x, t_floatarg fsoftness )
 {
-    if ( x->x_transition_pending )
+    if ( ( fsoftness < 0 ) || ( fsoftness > 255 ) )
     {
-       post ( "pdp_transition : a transition is already pending, retry later...." );
+       post ( "pdp_transition : wrong softness : %d : must be between 0 and 255", (int)fsoftness );
        return;
     }
-    if ( (int) finc > 0 )
-    {
-       x->x_inc = (int)finc;
+    x->x_softness = (int)fsoftness;
+}
+
+        /* load a custom map : the luminance of an image, dark pixels switch first */
+static void pdp_transition_load(t_pdp_transition *x, t_symbol *filename )
+{
+  Imlib_Image image;
+  Imlib_Load_Error imliberr;
+  unsigned int *argb;
+  int i, width, height;
+
+   image = imlib_load_image_with_error_return( filename->s_name, &imliberr );
+   if ( imliberr != IMLIB_LOAD_ERROR_NONE )
+   {
+      post( "pdp_transition : could not load map %s (err=%d)", filename->s_name, imliberr );
+      return;
+   }
+   imlib_context_set_image( image );
+   width = imlib_image_get_width();
+   height = imlib_image_get_height();
+   argb = (unsigned int *)imlib_image_get_data_for_reading_only();
+
+   // the map might be in use in the process thread
+   pdp_queue_finish(x->x_queue_id);
+   if ( x->x_custom ) freebytes( x->x_custom, x->x_cwidth*x->x_cheight );
+   x->x_custom = (unsigned char *) getbytes( width*height );
+   x->x_cwidth = width;
+   x->x_cheight = height;
+   for ( i=0; i<width*height; i++ )
+   {
+      x->x_custom[i] = ( 77*((argb[i]>>16)&0xff) + 150*((argb[i]>>8)&0xff) + 29*(argb[i]&0xff) ) >> 8;
+   }
+   imlib_free_image();
+   x->x_mapvalid = 0;
+   post( "pdp_transition : loaded map : %s (%dx%d)", filename->s_name, width, height );
+}
+
+static inline int pdp_transition_random_offset( t_pdp_transition *x )
+{
+    return (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
+}
+
+static inline unsigned char pdp_transition_mapvalue( int pos, int length )
+{
+    if ( pos <= 0 ) return 0;
+    if ( pos >= length ) return 255;
+    return ( pos*255 )/length;
+}
+
+/* builds the map of the pending transition for the current size,
+   'length' is the course of the transition in pixels, as in the old modes */
+static int pdp_transition_build_map(t_pdp_transition *x)
+{
+  int px, py, i, rvalue, length, cx, cy;
+  t_float maxdist;
+  unsigned char *pmap;
+
+    if ( ( x->x_mapwidth != x->x_vwidth ) || ( x->x_mapheight != x->x_vheight ) )
+    {
+       if ( x->x_map ) freebytes( x->x_map, x->x_mapwidth*x->x_mapheight );
+       x->x_map = (unsigned char *) getbytes( x->x_vsize );
+       if ( !x->x_map )
+       {
+          x->x_mapwidth = x->x_mapheight = 0;
+          return 0;
+       }
+       x->x_mapwidth = x->x_vwidth;
+       x->x_mapheight = x->x_vheight;
+    }
+
+    pmap = x->x_map;
+    x->x_border = 0;
+    switch ( x->x_transition_mode )
+    {
+      case 1: // circle
+        maxdist = sqrt( (x->x_vwidth/2)*(x->x_vwidth/2) + (x->x_vheight/2)*(x->x_vheight/2) );
+        length = (int)maxdist+1;
+        for ( py=0; py<x->x_vheight; py++ )
+        {
+          cy = py-(x->x_vheight/2);
+          for ( px=0; px<x->x_vwidth; px++ )
+          {
+             cx = px-(x->x_vwidth/2);
+             *(pmap++) = pdp_transition_mapvalue( (int)sqrt( cx*cx + cy*cy ), length );
+          }
+        }
+        break;
+
+      case 2: // wipelr
+      case 3: // wiperl
+        length = x->x_vwidth+x->x_rand;
+        for ( py=0; py<x->x_vheight; py++ )
+        {
+          rvalue = pdp_transition_random_offset( x );
+          for ( px=0; px<x->x_vwidth; px++ )
+          {
+             if ( x->x_transition_mode == 2 )
+                *(pmap++) = pdp_transition_mapvalue( px-rvalue+x->x_rand, length );
+             else
+                *(pmap++) = pdp_transition_mapvalue( x->x_vwidth-1-px-rvalue+x->x_rand, length );
+          }
+        }
+        break;
+
+      case 4: // mwipe : columns run over the frame as if it was transposed
+        length = x->x_vheight+x->x_rand;
+        for ( px=0; px<x->x_vwidth; px++ )
+        {
+          rvalue = pdp_transition_random_offset( x );
+          for ( py=0; py<x->x_vheight; py++ )
+          {
+             *(pmap++) = pdp_transition_mapvalue( py-rvalue+x->x_rand, length );
+          }
+        }
+        break;
+
+      case 5: // wipetd
+      case 6: // wipebu
+      case 8: // melt
+        length = x->x_vheight+x->x_rand;
+        for ( px=0; px<x->x_vwidth; px++ )
+        {
+          rvalue = pdp_transition_random_offset( x );
+          if ( x->x_transition_mode == 8 ) rvalue += abs(px-x->x_vwidth/2)/5;
+          for ( py=0; py<x->x_vheight; py++ )
+          {
+             if ( x->x_transition_mode == 6 )
+                pmap[py*x->x_vwidth+px] = pdp_transition_mapvalue( x->x_vheight-1-py-rvalue+x->x_rand, length );
+             else
+                pmap[py*x->x_vwidth+px] = pdp_transition_mapvalue( py-rvalue+x->x_rand, length );
+          }
+        }
+        break;
+
+      case 7: // random
+        length = x->x_vsize/pdp_transition_min( x->x_vwidth, 100 );
+        for ( i=0; i<x->x_vsize; i++ )
+        {
+           *(pmap++) = random()&0xff;
+        }
+        break;
+
+      case 9: // blend : a grain of x_rand over a crossfade of BLEND_MAX
+        length = BLEND_MAX;
+        for ( i=0; i<x->x_vsize; i++ )
+        {
+           *(pmap++) = pdp_transition_mapvalue( pdp_transition_random_offset( x ), BLEND_MAX );
+        }
+        break;
+
+      case 10: // page : a diagonal sweeping down from the top left corner, with a white fold
+        length = 2*x->x_vheight;
+        for ( py=0; py<x->x_vheight; py++ )
+        {
+          for ( px=0; px<x->x_vwidth; px++ )
+          {
+             *(pmap++) = pdp_transition_mapvalue( x->x_vheight - py + (x->x_vheight*px)/x->x_vwidth, length );
+          }
+        }
+        x->x_border = ( ( ( PAGE_RAY < length/8 ) ? PAGE_RAY : length/8 )*255 )/length;
+        break;
+
+      case 11: // custom map, scaled to the frame
+        length = 256;
+        for ( py=0; py<x->x_vheight; py++ )
+        {
+          cy = ( py*x->x_cheight )/x->x_vheight;
+          for ( px=0; px<x->x_vwidth; px++ )
+          {
+             cx = ( px*x->x_cwidth )/x->x_vwidth;
+             *(pmap++) = x->x_custom[cy*x->x_cwidth+cx];
+          }
+        }
+        break;
+
+      default:
+        return 0;
+    }
+
+    // as many frames as the old modes took to cover 'length'
+    x->x_step = ( x->x_inc<<16 )/length;
+    if ( x->x_step <= 0 ) x->x_step = 1;
+    x->x_mapvalid = 1;
+    return 1;
+}
+
+/* alpha of the target source for each map value at the current progress */
+static void pdp_transition_build_lut(t_pdp_transition *x)
+{
+  int v, d, softness;
+
+    softness = x->x_softness;
+    if ( x->x_transition_mode == 9 ) softness = 255;   // blend is a crossfade
+    for ( v=0; v<256; v++ )
+    {
+       d = x->x_progress - (v<<8);
+       if ( d <= 0 )
+          x->x_lut[v] = 0;
+       else if ( d < (x->x_border<<8) )
+          x->x_lut[v] = -1;
+       else if ( ( d -= (x->x_border<<8) ) >= (softness<<8) )
+          x->x_lut[v] = 256;
+       else
+          x->x_lut[v] = d/softness;
     }
-    x->x_transition_mode = 10;
-    x->x_transition_pending = 1;
-    x->x_pos = x->x_vheight;
 }
 
 static void pdp_transition_process_yv12(t_pdp_transition *x)
@@ -265,10 +399,8 @@ static void pdp_transition_process_yv12(t_pdp_transition *x)
     short int *data1 = (short int *)pdp_packet_data(x->x_packet1);
     t_pdp     *header;
     short int *data;
-    int     tsource, cx=0, cy=0;
-    int     px, py, rvalue=0, h1pos, h2pos, xcent, ycent;
-    t_float   factor, alpha;
-    int       i;
+    int     tsource, px, py, a, mi, ci, cw0, cw1, cw;
+    int     width0, width1, size0, size1, softness;
     short int *poY, *poV, *poU, *p0Y, *p0V, *p0U, *p1Y, *p1V, *p1U;
 
     if ( header0 )
@@ -298,6 +430,21 @@ static void pdp_transition_process_yv12(t_pdp_transition *x)
     x->x_vsize = x->x_vwidth*x->x_vheight;
     // post( "pdp_transition : resulting frame : %dx%d", x->x_vwidth, x->x_vheight );
 
+    // no transition : the current source goes through untouched
+    if ( !x->x_transition_pending || ( x->x_vsize0 == 0 ) || ( x->x_vsize1 == 0 ) )
+    {
+      x->x_packet = pdp_packet_copy_ro( ( x->x_current_source == 0 ) ? x->x_packet0 : x->x_packet1 );
+      return;
+    }
+
+    if ( ( !x->x_mapvalid || ( x->x_mapwidth != x->x_vwidth ) || ( x->x_mapheight != x->x_vheight ) )
+         && !pdp_transition_build_map( x ) )
+    {
+      x->x_packet = pdp_packet_copy_ro( ( x->x_current_source == 0 ) ? x->x_packet0 : x->x_packet1 );
+      return;
+    }
+    pdp_transition_build_lut( x );
+
     x->x_packet = pdp_packet_new_image_YCrCb( x->x_vwidth, x->x_vheight );
 
     header = pdp_packet_header(x->x_packet);
@@ -307,374 +454,88 @@ static void pdp_transition_process_yv12(t_pdp_transition *x)
     header->info.image.width = x->x_vwidth;
     header->info.image.height = x->x_vheight;
 
-    poY = data;
-    poV = data+x->x_vsize;
-    poU = data+x->x_vsize+(x->x_vsize>>2);
+    // source 0 is the one shown, source 1 the one coming in
     if ( x->x_current_source == 0 )
     {
-      if ( x->x_vsize0 > 0 ) memcpy( data, data0, (x->x_vsize+(x->x_vsize>>1))<<1 );
-      p0Y = data0;
-      p0V = data0+x->x_vsize0;
-      p0U = data0+x->x_vsize0+(x->x_vsize0>>2);
-      p1Y = data1;
-      p1V = data1+x->x_vsize1;
-      p1U = data1+x->x_vsize1+(x->x_vsize1>>2);
+      p0Y = data0; width0 = x->x_vwidth0; size0 = x->x_vsize0;
+      p1Y = data1; width1 = x->x_vwidth1; size1 = x->x_vsize1;
     }
     else
     {
-      if ( x->x_vsize1 > 0 ) memcpy( data, data1, (x->x_vsize+(x->x_vsize>>1))<<1 );
-      p0Y = data1;
-      p0V = data1+x->x_vsize0;
-      p0U = data1+x->x_vsize0+(x->x_vsize0>>2);
-      p1Y = data0;
-      p1V = data0+x->x_vsize1;
-      p1U = data0+x->x_vsize1+(x->x_vsize1>>2);
+      p0Y = data1; width0 = x->x_vwidth1; size0 = x->x_vsize1;
+      p1Y = data0; width1 = x->x_vwidth0; size1 = x->x_vsize0;
     }
-    if ( ( x->x_transition_pending ) && ( x->x_vsize0 > 0 ) && ( x->x_vsize1 > 0 ) )
+    p0V = p0Y+size0;
+    p0U = p0Y+size0+(size0>>2);
+    p1V = p1Y+size1;
+    p1U = p1Y+size1+(size1>>2);
+    poY = data;
+    poV = data+x->x_vsize;
+    poU = data+x->x_vsize+(x->x_vsize>>2);
+    cw0 = width0>>1;
+    cw1 = width1>>1;
+    cw = x->x_vwidth>>1;
+
+    for ( py=0; py<x->x_vheight; py++ )
     {
-      switch ( x->x_transition_mode )
+      mi = py*x->x_vwidth;
+      for ( px=0; px<x->x_vwidth; px++ )
       {
-        case 1: // circle
-          for ( py=0; py<x->x_vheight; py++ )
-          {
-            for ( px=0; px<x->x_vwidth; px++ )
-            {
-               cx = px-(x->x_vwidth/2);          
-               cy = py-(x->x_vheight/2);          
-               if ( cx*cx + cy*cy < x->x_pos*x->x_pos )
-               {
-                 *(poY) = *(p1Y);     
-                 *(poU) = *(p1U);     
-                 *(poV) = *(p1V);     
-               }
-               poY++; p1Y++;
-               if ( (px%2==0) && (py%2==0) )
-               {
-                 poU++; poV++;
-                 p1U++; p1V++;
-               }
-            }
-          }
-          if ( ( x->x_pos > (x->x_vwidth/2) ) && ( x->x_pos > (x->x_vheight/2) ) )
-          {
-            post( "pdp_transition : circle transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 2: // wipelr
-          for ( py=0; py<x->x_vheight; py++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-            for ( px=0; px<x->x_vwidth; px++ )
-            {
-               if ( px <= x->x_pos + rvalue )
-               {
-                 *(poY) = *(p1Y);     
-                 *(poU) = *(p1U);     
-                 *(poV) = *(p1V);     
-               }
-               poY++; p1Y++;
-               if ( (px%2==0) && (py%2==0) )
-               {
-                 poU++; poV++;
-                 p1U++; p1V++;
-               }
-            }
-          }
-          if ( x->x_pos > x->x_vwidth )
-          {
-            post( "pdp_transition : wipelr transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 3: // wiperl
-          for ( py=0; py<x->x_vheight; py++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-            for ( px=0; px<x->x_vwidth; px++ )
-            {
-               if ( px >= x->x_pos + rvalue )
-               {
-                 *(poY) = *(p1Y);     
-                 *(poU) = *(p1U);     
-                 *(poV) = *(p1V);     
-               }
-               poY++; p1Y++;
-               if ( (px%2==0) && (py%2==0) )
-               {
-                 poU++; poV++;
-                 p1U++; p1V++;
-               }
-            }
-          }
-          if ( x->x_pos <= 0 )
-          {
-            post( "pdp_transition : wiperl transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos -= x->x_inc;
-          break;
-
-        case 4: // mwipe
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-               if ( py <= x->x_pos + rvalue )
-               {
-                 *(poY) = *(p1Y);     
-                 *(poU) = *(p1U);     
-                 *(poV) = *(p1V);     
-               }
-               poY++; p1Y++;
-               if ( (px%2==0) && (py%2==0) )
-               {
-                 poU++; poV++;
-                 p1U++; p1V++;
-               }
-            }
-          }
-          if ( x->x_pos >= x->x_vheight )
-          {
-            post( "pdp_transition : mwipe transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 5: // wipetd
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-               if ( py <= x->x_pos + rvalue )
-               {
-                 *(poY+py*x->x_vwidth+px) = *(p1Y+py*x->x_vwidth1+px);     
-                 *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1U+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-                 *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1V+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-               }
-            }
-          }
-          if ( x->x_pos >= x->x_vheight )
-          {
-            post( "pdp_transition : wipetd transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 6: // wipebu
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-               if ( py >= x->x_pos + rvalue )
-               {
-                 *(poY+py*x->x_vwidth+px) = *(p1Y+py*x->x_vwidth1+px);     
-                 *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1U+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-                 *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1V+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-               }
-            }
-          }
-          if ( x->x_pos <= 0 )
-          {
-            post( "pdp_transition : wipebu transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos -= x->x_inc;
-          break;
-
-        case 7: // random
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-	       rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-               if ( rvalue <= x->x_pos )
-               {
-                 *(poY+py*x->x_vwidth+px) = *(p1Y+py*x->x_vwidth1+px);     
-                 *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1U+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-                 *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1V+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-               }
-            }
-          }
-          if ( x->x_pos >= x->x_rand )
-          {
-            post( "pdp_transition : wipebu transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 8: // melt
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-	    rvalue = (int)(((float) x->x_rand )*( (float)random() ) / RAND_MAX)+(abs(px-x->x_vwidth/2)/5);
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-               if ( py <= x->x_pos + rvalue )
-               {
-                 *(poY+py*x->x_vwidth+px) = 0;
-                 *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0; 
-                 *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0;
-               }
-            }
-          }
-          if ( x->x_pos >= x->x_vheight )
-          {
-            post( "pdp_transition : melt transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 9: // blend
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-	       rvalue = (((float) x->x_rand )*( (float)random() ) / RAND_MAX);
-	       factor = ( (float) x->x_pos + rvalue ) / BLEND_MAX;
-               *(poY+py*x->x_vwidth+px) = 
-		       (int)((1.0-factor)*(*(poY+py*x->x_vwidth+px)) + 
-		                 factor*(*(p1Y+py*x->x_vwidth1+px)));     
-               *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-		       (int)((1.0-factor)*(*(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1))) + 
-		                 factor*(*(p1U+(py>>1)*(x->x_vwidth1>>1)+(px>>1))));     
-               *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-		       (int)((1.0-factor)*(*(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1))) + 
-		                 factor*(*(p1V+(py>>1)*(x->x_vwidth1>>1)+(px>>1))));     
-            }
-          }
-          if ( x->x_pos >= BLEND_MAX )
-          {
-            post( "pdp_transition : blend transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos += x->x_inc;
-          break;
-
-        case 10: // page
-          xcent = (int) ( (float) ( x->x_vheight - x->x_pos ) * (( float ) x->x_vwidth ) /
-                  ( 2.0 * ( (float) x->x_vheight ) ) );
-          ycent = (int) ( ( (float) x->x_pos + (float) x->x_vheight ) / 2.0 );
-          for ( px=0; px<x->x_vwidth; px++ )
-          {
-            for ( py=0; py<x->x_vheight; py++ )
-            {
-               if ( ( ((float) py)-
-                    ((float)x->x_vheight)/((float)x->x_vwidth)*((float)px) ) >= x->x_pos )
-               {
-                 *(poY+py*x->x_vwidth+px) = *(p1Y+py*x->x_vwidth1+px);     
-                 *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1U+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-                 *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 
-			 *(p1V+(py>>1)*(x->x_vwidth1>>1)+(px>>1));     
-               }
-	       else
-	       {
-		  h1pos = ((float) py) + ((float)x->x_vheight)/((float)x->x_vwidth)*((float)px);
-		  h2pos = ((float) py) - ((float)x->x_vheight)/((float)x->x_vwidth)*((float)px);
-		  alpha = atan( ( (float) x->x_vheight ) / ( (float) x->x_vwidth ) );
-                  if ( ( h1pos <= x->x_vheight ) &&
-		       ( h1pos >= ( (float) x->x_vheight - PAGE_RAY*cos(alpha) ) ) &&
-		       ( h2pos >= ( x->x_pos - PAGE_RAY*sin(alpha) ) ) &&
-		       ( pow ( px-xcent, 2 ) + pow ( py-(ycent-PAGE_RAY), 2 ) 
-		                        >= pow( PAGE_RAY*cos(alpha), 2 ) ) )
-		  {
-                     *(poY+py*x->x_vwidth+px) = 0xff<<7;     
-                     *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0xff<<8;
-                     *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0xff<<8;
-		  }
-                  if ( ( h1pos >= x->x_vheight ) &&
-		       ( h1pos <= ( (float) x->x_vheight + PAGE_RAY*cos(alpha) ) ) &&
-		       ( h2pos >= ( x->x_pos - PAGE_RAY*sin(alpha) ) ) &&
-		       ( pow ( px-(xcent+PAGE_RAY), 2 ) + pow ( py-ycent, 2 ) 
-		                        >= pow( PAGE_RAY*sin(alpha), 2 ) ) )
-		  {
-                     *(poY+py*x->x_vwidth+px) = 0xff<<7;     
-                     *(poU+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0xff<<8;
-                     *(poV+(py>>1)*(x->x_vwidth>>1)+(px>>1)) = 0xff<<8;
-		  }
-	       }
-            }
-          }
-          if ( x->x_pos <= -x->x_vheight )
-          {
-            post( "pdp_transition : page transition finished" );
-            x->x_transition_pending = 0;
-            x->x_transition_mode = 0;
-            tsource = x->x_current_source;
-            x->x_current_source = x->x_target_source;
-            x->x_target_source = tsource;
-            x->x_pos = 0;
-          }
-          x->x_pos -= x->x_inc;
-          break;
+         a = x->x_lut[x->x_map[mi+px]];
+         if ( a == 0 )
+           poY[mi+px] = p0Y[py*width0+px];
+         else if ( a < 0 )
+           poY[mi+px] = 0xff<<7;
+         else if ( x->x_transition_mode == 8 ) // melt goes to black
+           poY[mi+px] = p0Y[py*width0+px] - ( ( p0Y[py*width0+px]*a )>>8 );
+         else
+           poY[mi+px] = p0Y[py*width0+px] + ( ( ( p1Y[py*width1+px]-p0Y[py*width0+px] )*a )>>8 );
+      }
+    }
 
-        default:
-          break;
+    for ( py=0; py<(x->x_vheight>>1); py++ )
+    {
+      for ( px=0; px<cw; px++ )
+      {
+         a = x->x_lut[x->x_map[(py<<1)*x->x_vwidth+(px<<1)]];
+         ci = py*cw+px;
+         if ( a == 0 )
+         {
+           poV[ci] = p0V[py*cw0+px];
+           poU[ci] = p0U[py*cw0+px];
+         }
+         else if ( a < 0 )
+         {
+           poV[ci] = 0;
+           poU[ci] = 0;
+         }
+         else if ( x->x_transition_mode == 8 )
+         {
+           poV[ci] = p0V[py*cw0+px] - ( ( p0V[py*cw0+px]*a )>>8 );
+           poU[ci] = p0U[py*cw0+px] - ( ( p0U[py*cw0+px]*a )>>8 );
+         }
+         else
+         {
+           poV[ci] = p0V[py*cw0+px] + ( ( ( p1V[py*cw1+px]-p0V[py*cw0+px] )*a )>>8 );
+           poU[ci] = p0U[py*cw0+px] + ( ( ( p1U[py*cw1+px]-p0U[py*cw0+px] )*a )>>8 );
+         }
       }
     }
 
+    softness = ( x->x_transition_mode == 9 ) ? 255 : x->x_softness;
+    if ( x->x_progress >= ( (255+softness+x->x_border)<<8 ) )
+    {
+      post( "pdp_transition : transition finished" );
+      x->x_transition_pending = 0;
+      x->x_transition_mode = 0;
+      x->x_mapvalid = 0;
+      tsource = x->x_current_source;
+      x->x_current_source = x->x_target_source;
+      x->x_target_source = tsource;
+      x->x_progress = 0;
+    }
+    x->x_progress += x->x_step;
+
     return;
 }
 
@@ -703,7 +564,7 @@ static void pdp_transition_process0(t_pdp_transition *x)
 	switch(pdp_packet_header(x->x_packet0)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_transition_process_yv12, pdp_transition_sendpacket0, &x->x_queue_id);
+            pidip_queue_add(x, pdp_transition_process_yv12, pdp_transition_sendpacket0, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -730,7 +591,7 @@ static void pdp_transition_process1(t_pdp_transition *x)
 	switch(pdp_packet_header(x->x_packet1)->info.image.encoding){
 
 	case PDP_IMAGE_YV12:
-            pdp_queue_add(x, pdp_transition_process_yv12, pdp_transition_sendpacket1, &x->x_queue_id);
+            pidip_queue_add(x, pdp_transition_process_yv12, pdp_transition_sendpacket1, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -756,7 +617,7 @@ static void pdp_transition_input_0(t_pdp_transition *x, t_symbol *s, t_floatarg
         pdp_packet_mark_unused(x->x_packet0);
         x->x_packet0 = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped)){
@@ -779,7 +640,7 @@ static void pdp_transition_input_1(t_pdp_transition *x, t_symbol *s, t_floatarg
         pdp_packet_mark_unused(x->x_packet1);
         x->x_packet1 = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet1, (int)f, pdp_gensym("image/YCrCb/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet1, (int)f, pdp_gensym("image/YCrCb/*") );
     }
 
     if ((s == gensym("process")) && (-1 != x->x_packet1) && (!x->x_dropped)){
@@ -794,9 +655,11 @@ static void pdp_transition_free(t_pdp_transition *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_packet_mark_unused(x->x_packet1);
+    if ( x->x_map ) freebytes( x->x_map, x->x_mapwidth*x->x_mapheight );
+    if ( x->x_custom ) freebytes( x->x_custom, x->x_cwidth*x->x_cheight );
 }
 
 t_class *pdp_transition_class;
@@ -823,8 +686,19 @@ void *pdp_transition_new(void)
     x->x_current_source = 0;
     x->x_target_source = 1;
 
-    x->x_pos = 0;
     x->x_inc = 1;
+    x->x_rand = 0;
+
+    x->x_map = NULL;
+    x->x_mapwidth = 0;
+    x->x_mapheight = 0;
+    x->x_mapvalid = 0;
+    x->x_progress = 0;
+    x->x_softness = 0;
+    x->x_border = 0;
+    x->x_custom = NULL;
+    x->x_cwidth = 0;
+    x->x_cheight = 0;
 
     return (void *)x;
 }
@@ -854,6 +728,9 @@ void pdp_transition_setup(void)
     class_addmethod(pdp_transition_class, (t_method)pdp_transition_melt, gensym("melt"),  A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_transition_class, (t_method)pdp_transition_blend, gensym("blend"),  A_DEFFLOAT, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_transition_class, (t_method)pdp_transition_page, gensym("page"),  A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_transition_class, (t_method)pdp_transition_custom, gensym("custom"),  A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_transition_class, (t_method)pdp_transition_load, gensym("load"),  A_SYMBOL, A_NULL);
+    class_addmethod(pdp_transition_class, (t_method)pdp_transition_softness, gensym("softness"),  A_FLOAT, A_NULL);
 
 
 
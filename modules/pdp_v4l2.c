@@ -54,21 +54,30 @@
 
 
 #define DEVICENO 0
-#define NBUF 2
 #define COMPOSITEIN 1
-#define WANTED_BUFFERS 2
+#define WANTED_BUFFERS 4
+#define MAX_BUFFERS 32
 #define MAX_INPUT   16
 #define MAX_NORM    16
 #define MAX_FORMAT  32
 #define MAX_CTRL    32
 
 
+// a frame converted by the capture thread
+typedef struct pdp_v4l2_frame
+{
+  int f_packet;
+  short int *f_data;
+  double f_stamp;        // kernel timestamp in ms, from the start of the capture
+} t_pdp_v4l2_frame;
+
 typedef struct pdp_v4l2_struct
 {
   t_object x_obj;
   t_float x_f;
   
   t_outlet *x_outlet0;
+  t_outlet *x_outlet1;
 
   bool x_initialized;
   bool x_auto_open;
@@ -91,14 +100,14 @@ typedef struct pdp_v4l2_struct
   struct v4l2_fmtdesc x_formats[MAX_FORMAT];
   struct v4l2_streamparm x_streamparam;
   struct v4l2_queryctrl x_controls[MAX_CTRL*2];
-  struct v4l2_buffer x_v4l2_buf[WANTED_BUFFERS];
+  struct v4l2_buffer x_v4l2_buf[MAX_BUFFERS];
   struct v4l2_format x_v4l2_format;
   struct v4l2_requestbuffers x_reqbufs;
 
-  unsigned char *x_pdp_buf[WANTED_BUFFERS];
- 
+  unsigned char *x_pdp_buf[MAX_BUFFERS];
+  int x_nbuffers;        // driver buffers requested
+
   int x_tvfd;
-  int x_frame;
   int x_skipnext;
   int x_mytopmargin, x_mybottommargin;
   int x_myleftmargin, x_myrightmargin;
@@ -106,10 +115,17 @@ typedef struct pdp_v4l2_struct
   t_symbol *x_device;
 
   pthread_t x_thread_id;
+  int x_thread_running;
   int x_continue_thread;
-  int x_frame_ready;
-  int x_only_new_frames;
-  int x_last_frame;
+  int x_capture_error;
+
+  // the capture thread converts into x_fill, then swaps it with x_ready,
+  // the pd thread takes x_ready and provides a new packet in x_spare
+  pthread_mutex_t x_mutex;
+  t_pdp_v4l2_frame x_fill;
+  t_pdp_v4l2_frame x_ready;
+  t_pdp_v4l2_frame x_spare;
+  double x_stamp0;
 
   int x_open_retry;
 
@@ -129,9 +145,10 @@ static void pdp_v4l2_close(t_pdp_v4l2 *x)
   int i;
 
     /* terminate thread if there is one */
-    if(x->x_continue_thread){
+    if(x->x_thread_running){
 	x->x_continue_thread = 0;
 	pthread_join (x->x_thread_id, &dummy);
+	x->x_thread_running = 0;
     }
 
     if (x->x_tvfd >= 0)
@@ -141,13 +158,23 @@ static void pdp_v4l2_close(t_pdp_v4l2 *x)
     }
 
     if (x->x_initialized){
-        for( i=0; i<WANTED_BUFFERS; i++ )
+        for( i=0; i<(int)x->x_reqbufs.count; i++ )
         {
            munmap(x->x_pdp_buf[i], x->x_v4l2_buf[i].length);
         }
+        x->x_reqbufs.count = 0;
 	x->x_initialized = false;
     }
 
+    /* the thread is gone, its packets can be released */
+    pdp_packet_mark_unused(x->x_fill.f_packet);
+    pdp_packet_mark_unused(x->x_ready.f_packet);
+    pdp_packet_mark_unused(x->x_spare.f_packet);
+    x->x_fill.f_packet = -1;
+    x->x_ready.f_packet = -1;
+    x->x_spare.f_packet = -1;
+    x->x_capture_error = 0;
+
 }
 
 static void pdp_v4l2_close_manual(t_pdp_v4l2 *x)
@@ -162,13 +189,49 @@ static void pdp_v4l2_close_error(t_pdp_v4l2 *x)
     if(x->x_open_retry) x->x_open_retry--;
 }
 
+static int pdp_v4l2_convert(t_pdp_v4l2 *x, unsigned char *newimage, short int *data)
+{
+    /* convert data to pdp packet */
+
+    switch(x->x_v4l2_format.fmt.pix.pixelformat){
+    case  V4L2_PIX_FMT_YUV420:
+	pdp_llconv(newimage, RIF_YUV__P411_U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
+	break;
+	
+	/* long live standards. v4l's rgb is in fact ogl's bgr */
+    case  V4L2_PIX_FMT_RGB24:
+	pdp_llconv(newimage, RIF_BGR__P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
+	break;
+
+    case  V4L2_PIX_FMT_RGB32:
+	pdp_llconv(newimage, RIF_BGRA_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
+	break;
+
+    case  V4L2_PIX_FMT_YUYV:
+	pdp_llconv(newimage, RIF_YUYV_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
+	break;
+
+    case  V4L2_PIX_FMT_UYVY: 
+        pdp_llconv(newimage, RIF_UYVY_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height);
+        break;
+
+    default:
+	return -1;
+    }
+    return 0;
+}
+
 static int pdp_v4l2_capture_frame(t_pdp_v4l2* x)
 {
-    x->x_v4l2_buf[x->x_frame].index  = x->x_frame;
-    x->x_v4l2_buf[x->x_frame].type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    x->x_v4l2_buf[x->x_frame].memory = V4L2_MEMORY_MMAP;
+  struct v4l2_buffer buf;
+  t_pdp_v4l2_frame frame;
+  double stamp;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
  
-    if (-1 == ioctl (x->x_tvfd, VIDIOC_DQBUF, &x->x_v4l2_buf[x->x_frame])) 
+    if (-1 == ioctl (x->x_tvfd, VIDIOC_DQBUF, &buf)) 
     {
        switch (errno) 
        {
@@ -180,21 +243,51 @@ static int pdp_v4l2_capture_frame(t_pdp_v4l2* x)
 
           default:
             post( "pdp_v4l2 : error reading buffer : thread exiting");
-            exit(-1);
+            return -1;
        }
     }
 
-    // reenqueing buffer
-    if (-1 == ioctl (x->x_tvfd, VIDIOC_QBUF, &x->x_v4l2_buf[x->x_frame]))
+    /* a packet left by the pd thread replaces the one it took */
+    if (x->x_fill.f_packet == -1){
+        pthread_mutex_lock(&x->x_mutex);
+        x->x_fill = x->x_spare;
+        x->x_spare.f_packet = -1;
+        pthread_mutex_unlock(&x->x_mutex);
+    }
+
+    /* convert while the driver still has the other buffers to fill,
+       if no packet is available, the frame is dropped */
+    if (x->x_fill.f_packet != -1){
+        if (pdp_v4l2_convert(x, x->x_pdp_buf[buf.index], x->x_fill.f_data) < 0)
+        {
+            post( "pdp_v4l2 : unsupported color model : thread exiting");
+            return -1;
+        }
+        stamp = buf.timestamp.tv_sec*1000. + buf.timestamp.tv_usec/1000.;
+        if (x->x_stamp0 < 0) x->x_stamp0 = stamp;
+        x->x_fill.f_stamp = stamp - x->x_stamp0;
+    }
+
+    // reenqueing buffer once it's converted
+    if (-1 == ioctl (x->x_tvfd, VIDIOC_QBUF, &buf))
     {
-       perror("pdp_v4l2 : error queing buffers : thread exiting");
-       exit(-1);
+       post( "pdp_v4l2 : error queing buffers : thread exiting");
+       return -1;
+    }
+
+    /* publish the frame, an unread one is recycled */
+    if (x->x_fill.f_packet != -1){
+        pthread_mutex_lock(&x->x_mutex);
+        frame = x->x_ready;
+        x->x_ready = x->x_fill;
+        x->x_fill = frame;
+        pthread_mutex_unlock(&x->x_mutex);
     }
 
     return 0;
 } 
 
-static void pdp_v4l2_wait_frame(t_pdp_v4l2* x)
+static int pdp_v4l2_wait_frame(t_pdp_v4l2* x)
 {
     // wait an event on file descriptor
     fd_set fds;
@@ -211,15 +304,16 @@ static void pdp_v4l2_wait_frame(t_pdp_v4l2* x)
     ret = select (x->x_tvfd + 1, &fds, NULL, NULL, &tv);
 
     if (-1 == ret) {
-       if (EINTR == errno) return;
-       post ( "pdp_v4l2 : select timeout : closing device");
-       pdp_v4l2_close(x);
+       if (EINTR == errno) return 0;
+       post ( "pdp_v4l2 : select error : thread exiting");
+       return -1;
     }
     if (0 == ret) 
     {
-       post ( "pdp_v4l2 : select timeout : closing device");
-       pdp_v4l2_close(x);
+       post ( "pdp_v4l2 : select timeout : thread exiting");
+       return -1;
     }
+    return 0;
 }
 
 static int pdp_v4l2_start_capturing(t_pdp_v4l2 *x)
@@ -253,26 +347,22 @@ static void *pdp_v4l2_thread(void *voidx)
 {
     t_pdp_v4l2 *x = ((t_pdp_v4l2 *)voidx);
 
-    x->x_frame ^= 0x1;
     if ( -1 == pdp_v4l2_start_capturing( x ) )
     {
        post( "pdp_v4l2 : problem starting capture.. exiting " );
-       exit( -1 );
+       x->x_capture_error = 1;
+       return 0;
     }
 
-    /* capture with a double buffering scheme */
+    /* capture and convert with a ring of driver buffers */
     while (x->x_continue_thread)
     {
-        /* schedule capture command for next frame */
-        pdp_v4l2_wait_frame(x);
-
-        /* wait until previous capture is ready */
-        x->x_frame ^= 0x1;
-        pdp_v4l2_capture_frame(x);
-
-        /* setup pointers for main thread */
-        x->x_frame_ready = 1;
-        x->x_last_frame = x->x_frame;
+        if ( ( pdp_v4l2_wait_frame(x) < 0 ) || ( pdp_v4l2_capture_frame(x) < 0 ) )
+        {
+           /* the device is closed from the pd thread */
+           x->x_capture_error = 1;
+           break;
+        }
     }
 
     if ( -1 == pdp_v4l2_stop_capturing( x ) )
@@ -323,16 +413,24 @@ static int pdp_v4l2_init_mmap(t_pdp_v4l2 *x)
   unsigned int i;
 
     // get mmap numbers 
-    x->x_reqbufs.count  = WANTED_BUFFERS;
+    x->x_reqbufs.count  = x->x_nbuffers;
     x->x_reqbufs.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     x->x_reqbufs.memory = V4L2_MEMORY_MMAP;
     if (-1 == ioctl(x->x_tvfd, VIDIOC_REQBUFS, &x->x_reqbufs, 0))
     {
         post( "pdp_v4l2 : error : couldn't init driver buffers" ); 
+        x->x_reqbufs.count = 0;
         return -1;
     }
     post("pdp_v4l2: got %d buffers type %d memory %d", 
         x->x_reqbufs.count, x->x_reqbufs.type, x->x_reqbufs.memory );
+    if (x->x_reqbufs.count < 2)
+    {
+        post( "pdp_v4l2 : error : not enough driver buffers" ); 
+        x->x_reqbufs.count = 0;
+        return -1;
+    }
+    if (x->x_reqbufs.count > MAX_BUFFERS) x->x_reqbufs.count = MAX_BUFFERS;
 
     for (i = 0; i < x->x_reqbufs.count; i++) 
     {
@@ -342,6 +440,7 @@ static int pdp_v4l2_init_mmap(t_pdp_v4l2 *x)
         if (-1 == ioctl(x->x_tvfd, VIDIOC_QUERYBUF, &x->x_v4l2_buf[i], 0))
         {
             post( "pdp_v4l2 : error : couldn't query buffer %d", i ); 
+            x->x_reqbufs.count = i;
             return -1;
         }
         x->x_pdp_buf[i] = (unsigned char *) mmap(NULL, x->x_v4l2_buf[i].length,
@@ -350,12 +449,13 @@ static int pdp_v4l2_init_mmap(t_pdp_v4l2 *x)
         if (MAP_FAILED == x->x_pdp_buf[i]) 
         {
             perror("pdp_v4l2 : mmap");
+            x->x_reqbufs.count = i;
             return -1;
         }
     }
     post( "pdp_v4l2 : mapped %d buffers", x->x_reqbufs.count ); 
 
-    for (i = 0; i < WANTED_BUFFERS; i++) 
+    for (i = 0; i < x->x_reqbufs.count; i++) 
     {
         x->x_v4l2_buf[i].type        = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         x->x_v4l2_buf[i].memory      = V4L2_MEMORY_MMAP;
@@ -372,6 +472,18 @@ static int pdp_v4l2_init_mmap(t_pdp_v4l2 *x)
     return 0;
 }
 
+static void pdp_v4l2_newframe(t_pdp_v4l2 *x, t_pdp_v4l2_frame *frame)
+{
+    frame->f_packet = pdp_packet_new_image(PDP_IMAGE_YV12, x->x_width, x->x_height);
+    frame->f_data = (short int *) pdp_packet_data(frame->f_packet);
+    frame->f_stamp = 0;
+    if (!frame->f_data){
+	post("pdp_v4l2: ERROR: can't allocate packet");
+	pdp_packet_mark_unused(frame->f_packet);
+	frame->f_packet = -1;
+    }
+}
+
 static void pdp_v4l2_open(t_pdp_v4l2 *x, t_symbol *name)
 {
     // open a v4l device and allocate a buffer
@@ -556,17 +668,23 @@ static void pdp_v4l2_open(t_pdp_v4l2 *x, t_symbol *name)
     if ( pdp_v4l2_init_mmap(x) < 0 )
     {
       post( "pdp_v4l2 : error : couldn't initialize memory mapping : closing..." );
+      x->x_initialized = true; // unmap what was mapped
       pdp_v4l2_close_error(x);
-      x->x_initialized = false;
       return;
     }
 
     x->x_initialized=true;
     post( "pdp_v4l2 : device initialized" );
 
+    /* packets for the capture thread */
+    pdp_v4l2_newframe(x, &x->x_fill);
+    pdp_v4l2_newframe(x, &x->x_spare);
+    x->x_stamp0 = -1;
+    x->x_capture_error = 0;
+
     // create thread 
     x->x_continue_thread = 1;
-    x->x_frame_ready = 0;
+    x->x_thread_running = 1;
     pthread_create(&x->x_thread_id, 0, pdp_v4l2_thread, x);
     post( "pdp_v4l2 : created thread : %u", x->x_thread_id );
 
@@ -662,16 +780,10 @@ static void pdp_v4l2_freqMHz(t_pdp_v4l2 *x, t_float f)
 static void pdp_v4l2_bang(t_pdp_v4l2 *x)
 {
    
-  /* if initialized, grab a frame and output it */
+  /* if initialized, output the last converted frame */
 
-  unsigned int w,h,nbpixels,packet_size,plane1,plane2;
-  unsigned char *newimage=NULL;
-  int pdp_packt,length,pos,i,encoding;
-  t_pdp* header;
-  t_image* image;
-  short int * data;
-
-  static short int gain[4] = {0x7fff, 0x7fff, 0x7fff, 0x7fff};
+  t_pdp_v4l2_frame frame;
+  int needspare;
 
   if (!(x->x_initialized)){
 	post("pdp_v4l2: no device opened");
@@ -687,55 +799,34 @@ static void pdp_v4l2_bang(t_pdp_v4l2 *x)
 	else return;
     }
 
-    /* do nothing if there is no frame ready */
-    if((!x->x_frame_ready) && (x->x_only_new_frames)) return;
-    x->x_frame_ready = 0;
-
-    newimage = x->x_pdp_buf[x->x_last_frame];
-
-    /* create new packet */
-
-    pdp_packt = pdp_packet_new_image(PDP_IMAGE_YV12, x->x_width, x->x_height);
-    header = pdp_packet_header(pdp_packt);
-    image = pdp_packet_image_info(pdp_packt);
-
-    if (!header){
-	post("pdp_v4l2: ERROR: can't allocate packet");
-	return;
+    /* the capture thread stopped on an error */
+    if (x->x_capture_error){
+        pdp_v4l2_close_error(x);
+        return;
     }
 
-    data = (short int *) pdp_packet_data(pdp_packt);
-
-    /* convert data to pdp packet */
-
-    switch(x->x_v4l2_format.fmt.pix.pixelformat){
-    case  V4L2_PIX_FMT_YUV420:
-	pdp_llconv(newimage, RIF_YUV__P411_U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
-	break;
-	
-	/* long live standards. v4l's rgb is in fact ogl's bgr */
-    case  V4L2_PIX_FMT_RGB24:
-	pdp_llconv(newimage, RIF_BGR__P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
-	break;
-
-    case  V4L2_PIX_FMT_RGB32:
-	pdp_llconv(newimage, RIF_BGRA_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
-	break;
-
-    case  V4L2_PIX_FMT_YUYV:
-	pdp_llconv(newimage, RIF_YUYV_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height); 
-	break;
+    pthread_mutex_lock(&x->x_mutex);
+    frame = x->x_ready;
+    x->x_ready.f_packet = -1;
+    needspare = (x->x_spare.f_packet == -1);
+    pthread_mutex_unlock(&x->x_mutex);
 
-    case  V4L2_PIX_FMT_UYVY: 
-        pdp_llconv(newimage, RIF_UYVY_P____U8, data, RIF_YVU__P411_S16, x->x_width, x->x_height);
-        break;
+    /* only the pd thread creates packets, the capture thread
+       picks the spare one up when it needs it */
+    if (needspare){
+        t_pdp_v4l2_frame spare;
 
-    default:
-	post("pdp_v4l2: unsupported color model");
-	break;
+        pdp_v4l2_newframe(x, &spare);
+        pthread_mutex_lock(&x->x_mutex);
+        x->x_spare = spare;
+        pthread_mutex_unlock(&x->x_mutex);
     }
 
-    pdp_packet_pass_if_valid(x->x_outlet0, &pdp_packt);
+    /* do nothing if there is no frame ready */
+    if (frame.f_packet == -1) return;
+
+    outlet_float(x->x_outlet1, (t_float)frame.f_stamp);
+    pdp_packet_pass_if_valid(x->x_outlet0, &frame.f_packet);
 
 }
 
@@ -771,9 +862,24 @@ static void pdp_v4l2_dim(t_pdp_v4l2 *x, t_floatarg xx, t_floatarg yy)
     }
 }
 
+static void pdp_v4l2_buffers(t_pdp_v4l2 *x, t_floatarg fbuffers)
+{
+    if ( ( (int)fbuffers < 2 ) || ( (int)fbuffers > MAX_BUFFERS ) )
+    {
+       post( "pdp_v4l2 : number of buffers should be between 2 and %d", MAX_BUFFERS );
+       return;
+    }
+    x->x_nbuffers = (int)fbuffers;
+    if (x->x_initialized){
+        pdp_v4l2_close(x);
+        pdp_v4l2_open(x, x->x_device);
+    }
+}
+
 static void pdp_v4l2_free(t_pdp_v4l2 *x)
 {
     pdp_v4l2_close(x);
+    pthread_mutex_destroy(&x->x_mutex);
 }
 
 t_class *pdp_v4l2_class;
@@ -783,6 +889,7 @@ void *pdp_v4l2_new(t_symbol *vdef)
     t_pdp_v4l2 *x = (t_pdp_v4l2 *)pd_new(pdp_v4l2_class);
 
     x->x_outlet0 = outlet_new(&x->x_obj, &s_anything);
+    x->x_outlet1 = outlet_new(&x->x_obj, &s_float);
 
     x->x_initialized = false;
 
@@ -794,8 +901,8 @@ void *pdp_v4l2_new(t_symbol *vdef)
     x->x_freq = -1;
     x->x_nstandards = 0;
     x->x_nformats = 0;
-    x->x_frame = 0;
-    x->x_last_frame = 0;
+    x->x_nbuffers = WANTED_BUFFERS;
+    x->x_reqbufs.count = 0;
 
     x->x_auto_open = true;
     if (vdef != gensym("")){
@@ -805,8 +912,13 @@ void *pdp_v4l2_new(t_symbol *vdef)
 	x->x_device = gensym("/dev/video0");
     }
 
+    x->x_thread_running = 0;
     x->x_continue_thread = 0;
-    x->x_only_new_frames = 1;
+    x->x_capture_error = 0;
+    x->x_fill.f_packet = -1;
+    x->x_ready.f_packet = -1;
+    x->x_spare.f_packet = -1;
+    pthread_mutex_init(&x->x_mutex, NULL);
 
     x->x_width = 320;
     x->x_height = 240;
@@ -844,6 +956,7 @@ void pdp_v4l2_setup(void)
     class_addmethod(pdp_v4l2_class, (t_method)pdp_v4l2_freq, gensym("freq"), A_FLOAT, A_NULL);
     class_addmethod(pdp_v4l2_class, (t_method)pdp_v4l2_freqMHz, gensym("freqMHz"), A_FLOAT, A_NULL);
     class_addmethod(pdp_v4l2_class, (t_method)pdp_v4l2_bang, gensym("bang"), A_NULL);
+    class_addmethod(pdp_v4l2_class, (t_method)pdp_v4l2_buffers, gensym("buffers"), A_FLOAT, A_NULL);
 
 }
 
@@ -26,8 +26,12 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_remap.h"
 #include <math.h>
 
+#define NB_MAPS 2
+
 static char   *pdp_vertigo_version = "pdp_vertigo: version 0.1, port of vertigo from effectv( Fukuchi Kentaro ) adapted by Yves Degoyon (ydegoyon@free.fr)";
 
 typedef struct pdp_vertigo_struct
@@ -54,6 +58,8 @@ typedef struct pdp_vertigo_struct
     double x_phase;
     double x_phase_increment;
     double x_zoomrate;
+    int x_interpolate;
+    t_pidip_remapcache x_maps;
 
 
 } t_pdp_vertigo;
@@ -68,6 +74,14 @@ static void pdp_vertigo_zoomrate(t_pdp_vertigo *x, t_floatarg fzoomrate )
     x->x_zoomrate = (int)fzoomrate;
 }
 
+static void pdp_vertigo_interpolate(t_pdp_vertigo *x, t_floatarg finterpolate )
+{
+    if ( ( finterpolate == 0 ) || ( finterpolate == 1 ) )
+    {
+       x->x_interpolate = (int)finterpolate;
+    }
+}
+
 static void pdp_vertigo_allocate(t_pdp_vertigo *x, t_floatarg fnewsize )
 {
   int nsize = (int) fnewsize;
@@ -133,22 +147,51 @@ static void pdp_vertigo_set_params(t_pdp_vertigo *x)
 }
 
 
+/* the zoom and rotation of the previous frame, for the current parameters */
+static void pdp_vertigo_remap(t_pdp_vertigo *x, short int *src, short int *dest)
+{
+  int px, py, ox, oy, sx, sy, build;
+  int key[4];
+  t_pidip_remap *map;
+
+    // the zoom moves with the phase, the map is only kept while it stands still
+    key[0] = x->x_sx; key[1] = x->x_sy; key[2] = x->x_dx; key[3] = x->x_dy;
+    map = pidip_remapcache_steady( &x->x_maps, x->x_vwidth, x->x_vheight, x->x_interpolate, key, 4, &build );
+    if ( map && !build )
+    {
+       pidip_remap_apply( map, src, dest );
+       return;
+    }
+
+    sx = x->x_sx;
+    sy = x->x_sy;
+    for(py=0; py<x->x_vheight; py++) 
+    {
+       ox = sx;
+       oy = sy;
+       for(px=0; px<x->x_vwidth; px++) 
+       {
+          if ( map )
+             pidip_remap_point( map, px, py, ox>>12, oy>>12 );
+          else
+             pidip_remap_pixel( src, dest, x->x_vwidth, x->x_vheight, x->x_interpolate, px, py, ox>>12, oy>>12 );
+          ox += x->x_dx;
+          oy += x->x_dy;
+       }
+       sx -= x->x_dy;
+       sy += x->x_dx;
+    }
+    if ( map ) pidip_remap_apply( map, src, dest );
+}
+
 static void pdp_vertigo_process_yv12(t_pdp_vertigo *x)
 {
     t_pdp     *header = pdp_packet_header(x->x_packet0);
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-
-    unsigned int totalnbpixels;
-    unsigned int u_offset;
-    unsigned int v_offset;
-    unsigned int totnbpixels;
-    short int *poy, *pou, *pov, *pny, *pnu, *pnv, *pcy, *pcu, *pcv;
-    int px, py;
-    short int v;
-    int ox, oy;
-    int i, ninc;
+    short int *pn, *pc;
+    int i, totnbpixels;
 
     /* allocate all ressources */
     if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
@@ -160,80 +203,29 @@ static void pdp_vertigo_process_yv12(t_pdp_vertigo *x)
     x->x_vwidth = header->info.image.width;
     x->x_vheight = header->info.image.height;
     x->x_vsize = x->x_vwidth*x->x_vheight;
-
-    totalnbpixels = x->x_vsize;
-    u_offset = x->x_vsize;
-    v_offset = x->x_vsize + (x->x_vsize>>2);
     totnbpixels = x->x_vsize + (x->x_vsize>>1);
 
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
+    if ( !x->x_buffer ) return;
+
     pdp_vertigo_set_params(x);
 
-    poy = data;
-    pou = data + x->x_vsize;
-    pov = data + x->x_vsize + (x->x_vsize>>2);
-    pcy = x->x_current_buffer;
-    pcu = x->x_current_buffer + x->x_vsize;
-    pcv = x->x_current_buffer + x->x_vsize + (x->x_vsize>>2);
-    pny = x->x_alt_buffer;
-    pnu = x->x_alt_buffer + x->x_vsize;
-    pnv = x->x_alt_buffer + x->x_vsize + (x->x_vsize>>2);
-    ninc=0;
-    for(py=x->x_vheight; py>0; py--) 
+    // zoom the previous frame and mix it with the new one
+    pdp_vertigo_remap( x, x->x_current_buffer, x->x_alt_buffer );
+    pn = x->x_alt_buffer;
+    for ( i=0; i<totnbpixels; i++ )
     {
-       ox = x->x_sx;
-       oy = x->x_sy;
-       for(px=x->x_vwidth; px>0; px--) 
-       {
-          if ( pny >= ( x->x_alt_buffer + x->x_vsize ) )
-          {
-             post( "pdp_vertigo : abnormal pointer position : pny=%x, start=%x, size=%x ninc=%d px=%d py=%d",
-                        pny, x->x_alt_buffer , x->x_vsize-1, ninc, px, py );
-             break;
-          }
-          if ( pnu >= ( x->x_alt_buffer + x->x_vsize + (x->x_vsize>>2) ) ) 
-          {
-             post( "pdp_vertigo : abnormal pointer position : pnu=%x, start=%x, size=%x ninc=%d px=%d py=%d",
-                       pnu, x->x_alt_buffer + x->x_vsize, (x->x_vsize>>2)-1, ninc, px, py );
-             break;
-          }
-          if ( pnv >= ( x->x_alt_buffer + x->x_vsize + (x->x_vsize>>1) ) ) 
-          {
-             post( "pdp_vertigo : abnormal pointer position : pnv=%x, start=%x, size=%x ninc=%d px=%d py=%d",
-                       pnv, x->x_alt_buffer + x->x_vsize + (x->x_vsize>>2), (x->x_vsize>>2)-1, ninc, px, py );
-             break;
-          }
-          i = (oy>>16)*x->x_vwidth + (ox>>16);
-          if (i<0) i = 0;
-          if ( i >= (x->x_vsize + (x->x_vsize>>1)) ) i = (x->x_vsize + (x->x_vsize>>1))-1;
-          v = pcy[i] & 0xffff;
-          v = (v * 3) + ((*poy++) & 0xffff);
-          *pny++ = (v>>2)<<7;
-          if ( (((px+1)%2)==0) && (((py+1)%2)==0) )
-          {
-              ninc++;
-              v = pcu[(i/4)] & 0xffff;
-              v = (v * 3) + ((*pou++) & 0xffff);
-              *pnu++ = (v>>2);
-              v = pcv[(i/4)] & 0xffff;
-              v = (v * 3) + ((*pov++) & 0xffff);
-              *pnv++ = (v>>2);
-          }
-          ox += x->x_dx;
-          oy += x->x_dy;
-       }
-       x->x_sx -= x->x_dy;
-       x->x_sy += x->x_dx;
+       pn[i] = ( pn[i]*3 + data[i] ) >> 2;
     }
 
-    memcpy(newdata, x->x_alt_buffer, (x->x_vsize + (x->x_vsize>>1))<<1);
+    memcpy(newdata, x->x_alt_buffer, totnbpixels<<1);
 
-    poy = x->x_current_buffer;
+    pc = x->x_current_buffer;
     x->x_current_buffer = x->x_alt_buffer;
-    x->x_alt_buffer = poy;
+    x->x_alt_buffer = pc;
 
     return;
 }
@@ -262,7 +254,7 @@ static void pdp_vertigo_process(t_pdp_vertigo *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_vertigo_process_yv12, pdp_vertigo_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_vertigo_process_yv12, pdp_vertigo_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -282,7 +274,7 @@ static void pdp_vertigo_input_0(t_pdp_vertigo *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw"))
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -295,10 +287,11 @@ static void pdp_vertigo_free(t_pdp_vertigo *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
 
     if ( x->x_buffer ) freebytes( x->x_buffer, 2*((x->x_vsize + (x->x_vsize>>1))<<1) );
+    pidip_remapcache_free(&x->x_maps);
 }
 
 t_class *pdp_vertigo_class;
@@ -321,6 +314,8 @@ void *pdp_vertigo_new(void)
     x->x_buffer = NULL;
     x->x_phase_increment = 0.02;
     x->x_zoomrate = 1.01;
+    x->x_interpolate = PIDIP_REMAP_NEAREST;
+    pidip_remapcache_init(&x->x_maps, NB_MAPS);
 
     return (void *)x;
 }
@@ -341,6 +336,7 @@ void pdp_vertigo_setup(void)
     class_addmethod(pdp_vertigo_class, (t_method)pdp_vertigo_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_vertigo_class, (t_method)pdp_vertigo_increment, gensym("increment"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_vertigo_class, (t_method)pdp_vertigo_zoomrate, gensym("zoomrate"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_vertigo_class, (t_method)pdp_vertigo_interpolate, gensym("interpolate"),  A_FLOAT, A_NULL);
 
 
 }
@@ -26,9 +26,12 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
+#include "pidip_remap.h"
 #include <math.h>
 
 #define CTABLE_SIZE 1024
+#define NB_MAPS 2
 
 static int sintable[CTABLE_SIZE+256];
 
@@ -52,7 +55,8 @@ typedef struct pdp_warp_struct
     int x_mode;
     int x_ctable[CTABLE_SIZE];
     int *x_disttable;
-    int *x_offstable;
+    int x_interpolate;
+    t_pidip_remapcache x_maps;
 
 } t_pdp_warp;
 
@@ -69,6 +73,14 @@ static void pdp_warp_tval(t_pdp_warp *x, t_floatarg ftval )
    x->x_tval = (int)ftval;
 }
 
+static void pdp_warp_interpolate(t_pdp_warp *x, t_floatarg finterpolate )
+{
+   if ( ( finterpolate == 0 ) || ( finterpolate == 1 ) )
+   {
+       x->x_interpolate = (int)finterpolate;
+   }
+}
+
 static void pdp_warp_init_sin_table(void) 
 {
   int  *tptr, *tsinptr;
@@ -87,15 +99,6 @@ static void pdp_warp_init_sin_table(void)
    }
 }
 
-static void pdp_warp_init_offs_table(t_pdp_warp* x) 
-{
-  int y;
-
-  for (y = 0; y < x->x_vheight; y++) {
-      x->x_offstable[y] = y * x->x_vwidth;
-  }
-}
-
 static void pdp_warp_init_dist_table(t_pdp_warp *x) 
 {
   int  halfw, halfh, *distptr;
@@ -120,35 +123,24 @@ static void pdp_warp_init_dist_table(t_pdp_warp *x)
 
 static void pdp_warp_free_ressources(t_pdp_warp *x)
 {
-  if ( x->x_offstable ) freebytes( x->x_offstable, x->x_vheight * sizeof (int) );
   if ( x->x_disttable ) freebytes( x->x_disttable, x->x_vwidth * x->x_vheight * sizeof (int) );
+  x->x_disttable = NULL;
 }
 
 static void pdp_warp_allocate(t_pdp_warp *x)
 {
- int i;
-
-  x->x_offstable = (int*) getbytes ( x->x_vheight * sizeof (int) );
   x->x_disttable = (int*) getbytes ( x->x_vwidth * x->x_vheight * sizeof (int) );
-  pdp_warp_init_offs_table(x); 
   pdp_warp_init_dist_table(x);
-  
 }
 
-void pdp_warp_do_warp(t_pdp_warp *x, short int* src, short int *dest, int xw, int yw, int cw) 
+/* the displacement of each pixel only depends on the distance 
+   to the center, through this table */
+static void pdp_warp_init_ctable(t_pdp_warp *x, int xw, int yw, int cw) 
 {
-  int c, i, px, py, dx, dy, dxu, dyu, maxx, maxy;
-  int width, height, skip, *ctptr, *distptr;
-  short int *destptr, *destptru, *destptrv;
+  int c, i, px;
+  int *ctptr;
 
     ctptr = x->x_ctable;
-    distptr = x->x_disttable;
-    width = x->x_vwidth;
-    height = x->x_vheight;
-    destptr = dest;
-    destptrv = dest+x->x_vsize;
-    destptru = dest+x->x_vsize+(x->x_vsize>>2);
-    skip = 0 ; /* x->x_vwidth*sizeof(short int)/4 - x->x_vwidth; */
     c = 0;
     for (px = 0; px < 512; px++) 
     {
@@ -157,35 +149,42 @@ void pdp_warp_do_warp(t_pdp_warp *x, short int* src, short int *dest, int xw, in
        *ctptr++ = ((sintable[i+256] * xw) >> 15);
        c += cw;
     }
-    maxx = width - 2; maxy = height - 2;
-    for (py = 0; py < height-1; py++) 
+}
+
+/* the map is rebuilt when the wave changes, unless it moves on
+   every frame : the pixels are then remapped directly */
+static void pdp_warp_remap(t_pdp_warp *x, short int *src, short int *dest, int xw, int yw, int cw) 
+{
+  int i, px, py, build;
+  int *distptr;
+  int key[3];
+  t_pidip_remap *map;
+
+    key[0] = xw; key[1] = yw; key[2] = cw;
+    map = pidip_remapcache_steady( &x->x_maps, x->x_vwidth, x->x_vheight, x->x_interpolate, key, 3, &build );
+    if ( map && !build ) 
+    {
+       pidip_remap_apply( map, src, dest );
+       return;
+    }
+
+    pdp_warp_init_ctable( x, xw, yw, cw );
+    distptr = x->x_disttable;
+    for (py = 0; py < x->x_vheight; py++) 
     {
-      for (px = 0; px < width; px++) 
+      for (px = 0; px < x->x_vwidth; px++) 
       {
         i = *distptr++;
-        dx = x->x_ctable [i+1] + px;
-        dxu = x->x_ctable [i+1] + (px>>1);
-        dy = x->x_ctable [i] + py;
-        dyu = x->x_ctable [i] + (py>>1);
-
-        if (dx < 0) dx = 0;
-        else if (dx > maxx) dx = maxx;
-        if (dy < 0) dy = 0;
-        else if (dy > maxy) dy = maxy;
-        if (dxu < 0) dxu = 0;
-        else if (dxu > (maxx>>1)) dxu = (maxx>>1);
-        if (dyu < 0) dyu = 0;
-        else if (dyu > (maxy>>1)) dyu = (maxy>>1);
-
-        *destptr++ = src[dy*x->x_vwidth+dx];
-        if ( (py%2==0) && (px%2==0) )
-        {
-           *destptrv++ = src[x->x_vsize+((dyu*x->x_vwidth)>>1)+dxu];
-           *destptru++ = src[x->x_vsize+(x->x_vsize>>2)+((dyu*x->x_vwidth)>>1)+dxu];
-        }
+        if ( map )
+          pidip_remap_point( map, px, py, (x->x_ctable[i+1] + px)*PIDIP_REMAP_ONE,
+                                          (x->x_ctable[i] + py)*PIDIP_REMAP_ONE );
+        else
+          pidip_remap_pixel( src, dest, x->x_vwidth, x->x_vheight, x->x_interpolate, px, py, 
+                             (x->x_ctable[i+1] + px)*PIDIP_REMAP_ONE,
+                             (x->x_ctable[i] + py)*PIDIP_REMAP_ONE );
       }
-   }
-
+    }
+    if ( map ) pidip_remap_apply( map, src, dest );
 }
 
 static void pdp_warp_process_yv12(t_pdp_warp *x)
@@ -194,23 +193,11 @@ static void pdp_warp_process_yv12(t_pdp_warp *x)
     short int *data   = (short int *)pdp_packet_data(x->x_packet0);
     t_pdp     *newheader = pdp_packet_header(x->x_packet1);
     short int *newdata = (short int *)pdp_packet_data(x->x_packet1);
-    int       i;
-
-    unsigned int totalnbpixels;
-    unsigned int u_offset;
-    unsigned int v_offset;
-    unsigned int totnbpixels;
-
-    int px, py;
-    int dx, dy;
-    int h, v;
-    int width, height;
-    int *p, *q, *r;
-    signed char *vp;
     int xw, yw, cw;
 
     /* allocate all ressources */
-    if ( (int)(header->info.image.width*header->info.image.height) != x->x_vsize )
+    if ( ((int)header->info.image.width != x->x_vwidth) ||
+         ((int)header->info.image.height != x->x_vheight) )
     {
         pdp_warp_free_ressources(x);
         x->x_vwidth = header->info.image.width;
@@ -220,24 +207,17 @@ static void pdp_warp_process_yv12(t_pdp_warp *x)
         post( "pdp_warp : reallocated buffers" );
     }
 
-    totalnbpixels = x->x_vsize;
-    u_offset = x->x_vsize;
-    v_offset = x->x_vsize + (x->x_vsize>>2);
-    totnbpixels = x->x_vsize + (x->x_vsize>>1);
-
     newheader->info.image.encoding = header->info.image.encoding;
     newheader->info.image.width = x->x_vwidth;
     newheader->info.image.height = x->x_vheight;
 
-    memcpy( newdata, data, (x->x_vsize + (x->x_vsize>>1))<<1 );
-
     xw  = (int) (sin((x->x_tval+100)*M_PI/128) * 30);
     yw  = (int) (sin((x->x_tval)*M_PI/256) * -35);
     cw  = (int) (sin((x->x_tval-70)*M_PI/64) * 50);
     xw += (int) (sin((x->x_tval-10)*M_PI/512) * 40);
     yw += (int) (sin((x->x_tval+30)*M_PI/512) * 40);
 
-    pdp_warp_do_warp( x, data, newdata, xw, yw, cw);
+    pdp_warp_remap( x, data, newdata, xw, yw, cw );
     if ( x->x_mode )  x->x_tval = (x->x_tval+1) &511;
 
     return;
@@ -267,7 +247,7 @@ static void pdp_warp_process(t_pdp_warp *x)
 
 	case PDP_IMAGE_YV12:
             x->x_packet1 = pdp_packet_clone_rw(x->x_packet0);
-            pdp_queue_add(x, pdp_warp_process_yv12, pdp_warp_sendpacket, &x->x_queue_id);
+            pidip_queue_add(x, pdp_warp_process_yv12, pdp_warp_sendpacket, &x->x_queue_id);
 	    break;
 
 	case PDP_IMAGE_GREY:
@@ -286,7 +266,7 @@ static void pdp_warp_input_0(t_pdp_warp *x, t_symbol *s, t_floatarg f)
     /* if this is a register_ro message or register_rw message, register with packet factory */
 
     if (s== gensym("register_rw")) 
-       x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
+       x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packet0, (int)f, pdp_gensym("image/YCrCb/*") );
 
     if ((s == gensym("process")) && (-1 != x->x_packet0) && (!x->x_dropped))
     {
@@ -299,9 +279,10 @@ static void pdp_warp_free(t_pdp_warp *x)
 {
   int i;
 
-    pdp_queue_finish(x->x_queue_id);
+    pidip_queue_release(x, x->x_queue_id);
     pdp_packet_mark_unused(x->x_packet0);
     pdp_warp_free_ressources(x);
+    pidip_remapcache_free(&x->x_maps);
 }
 
 t_class *pdp_warp_class;
@@ -322,6 +303,10 @@ void *pdp_warp_new(void)
 
     x->x_mode = 0;
     x->x_tval = 0;
+    x->x_interpolate = PIDIP_REMAP_NEAREST;
+    x->x_vwidth = x->x_vheight = x->x_vsize = 0;
+    x->x_disttable = NULL;
+    pidip_remapcache_init(&x->x_maps, NB_MAPS);
 
     return (void *)x;
 }
@@ -344,6 +329,7 @@ void pdp_warp_setup(void)
     class_addmethod(pdp_warp_class, (t_method)pdp_warp_input_0, gensym("pdp"),  A_SYMBOL, A_DEFFLOAT, A_NULL);
     class_addmethod(pdp_warp_class, (t_method)pdp_warp_mode, gensym("mode"),  A_FLOAT, A_NULL);
     class_addmethod(pdp_warp_class, (t_method)pdp_warp_tval, gensym("tval"),  A_FLOAT, A_NULL);
+    class_addmethod(pdp_warp_class, (t_method)pdp_warp_interpolate, gensym("interpolate"),  A_FLOAT, A_NULL);
 
 
 }
@@ -26,6 +26,7 @@
 
 
 #include "pdp.h"
+#include "pidip_profile.h"
 #include "pdp_xwindow.h"
 #include <X11/extensions/XShm.h>
 #include <math.h>
@@ -253,7 +254,7 @@ static void pdp_xcanvas_process(t_pdp_xcanvas *x, int ni)
 	switch(pdp_packet_header(x->x_packets[ni])->info.image.encoding){
 
 	case PDP_BITMAP_YV12:
-            pdp_queue_add(x, pdp_xcanvas_process_yv12, pdp_xcanvas_display_packet, &x->x_queue_id);
+            pidip_queue_add(x, pdp_xcanvas_process_yv12, pdp_xcanvas_display_packet, &x->x_queue_id);
 	    break;
 
 	default:
@@ -334,7 +335,7 @@ static void pdp_xcanvas_input(t_pdp_xcanvas *x, t_symbol *s, t_floatarg f, int n
         pdp_packet_mark_unused(x->x_packets[ni]);
         x->x_packets[ni] = -1;
       }
-      x->x_dropped = pdp_packet_convert_ro_or_drop(&x->x_packets[ni], (int)f, pdp_gensym("bitmap/yv12/*") );
+      x->x_dropped = pidip_convert_ro_or_drop(x, &x->x_packets[ni], (int)f, pdp_gensym("bitmap/yv12/*") );
       if ( x->x_packets[ni] != -1 )
       {
         header = pdp_packet_header(x->x_packets[ni]);
@@ -405,7 +406,7 @@ static void pdp_xcanvas_free(t_pdp_xcanvas *x)
 {
  int ii;
 
-  pdp_queue_finish(x->x_queue_id);
+  pidip_queue_release(x, x->x_queue_id);
   for ( ii=0; ii<x->x_nbinputs; ii++)
   {
     pdp_packet_mark_unused(x->x_packets[ii]);
@@ -25,6 +25,8 @@
 #include "time.h"
 #include "sys/time.h"
 #include "pidip_config.h"
+#include "pidip_source.h"
+#include "pidip_pacer.h"
 #ifdef QUICKTIME_NEWER
 #include <lqt/lqt.h>
 #include <lqt/colormodels.h>
@@ -59,11 +61,11 @@ typedef struct pdp_yqt_struct
 
     bool loop;
 
-    unsigned char * qt_rows[3];
-
-    unsigned char *qt_frame;
-    quicktime_t *qt;
-    int qt_cmodel;
+    t_pidip_source x_source;    /* video frames, decoded ahead         */
+    int x_frame;                /* next frame to output                */
+    int x_nbvframes;            /* number of video frames              */
+    quicktime_t *qt;            /* only opened for the audio track     */
+    t_pidip_pacer *x_pacer;     /* frame clock driving the playback    */
 
     int    x_audio;             /* indicates the existence of an audio track */
     int    x_audio_channels;	  /* number of audio channels of first track   */
@@ -87,8 +89,10 @@ typedef struct pdp_yqt_struct
 static void pdp_yqt_close(t_pdp_yqt *x)
 {
     if (x->initialized){
-	quicktime_close(x->qt);
-	free(x->qt_frame);
+	pidip_source_close(&x->x_source);
+	if (x->qt) quicktime_close(x->qt);
+	x->qt = NULL;
+	x->x_audio = 0;
 	x->initialized = false;
     }
 
@@ -102,47 +106,29 @@ static void pdp_yqt_open(t_pdp_yqt *x, t_symbol *name)
 
     pdp_yqt_close(x);
 
-    x->qt = quicktime_open(name->s_name, 1, 0);
-
-    if (!(x->qt)){
+    if (!pidip_source_open(&x->x_source, name->s_name, PIDIP_SOURCE_CACHE, PIDIP_SOURCE_PREFETCH)){
 	post("pdp_yqt: error opening qt file");
 	x->initialized = false;
 	return;
     }
-
-    if (!quicktime_has_video(x->qt)) {
-	post("pdp_yqt: no video stream");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-	
-    }
-    else if (!quicktime_supported_video(x->qt,0)) {
-	post("pdp_yqt: unsupported video codec\n");
-	quicktime_close(x->qt);
-	x->initialized = false;
-	return;
-    }
-    else 
-    {
-	x->qt_cmodel = BC_YUV420P;
-	x->x_vwidth  = quicktime_video_width(x->qt,0);
-	x->x_vheight = quicktime_video_height(x->qt,0);
-	x->qt_frame = (unsigned char*)malloc(x->x_vwidth*x->x_vheight*4);
-	size = x->x_vwidth * x->x_vheight;
-	x->qt_rows[0] = &x->qt_frame[0];
-	x->qt_rows[2] = &x->qt_frame[size];
-	x->qt_rows[1] = &x->qt_frame[size + (size>>2)];
-    
-	quicktime_set_cmodel(x->qt, x->qt_cmodel);
-	x->initialized = true;
-	outlet_float(x->x_nbframes, (float)quicktime_video_length(x->qt,0));
-
-    }
+    pidip_source_loop(&x->x_source, x->loop);
+    x->x_vwidth  = x->x_source.s_info.i_width;
+    x->x_vheight = x->x_source.s_info.i_height;
+    x->x_nbvframes = x->x_source.s_info.i_nbframes;
+    x->x_frame = 0;
+    x->initialized = true;
+    outlet_float(x->x_nbframes, (float)x->x_nbvframes);
+
+    // the audio track is decoded in the dsp thread with its own handle
+    x->x_audio = 0;
+    x->qt = quicktime_open(name->s_name, 1, 0);
+    if (!(x->qt)) return;
 
     if (!quicktime_has_audio(x->qt)) {
 	post("pdp_yqt: warning : no audio stream");
         x->x_audio = 0;
+        quicktime_close(x->qt);
+        x->qt = NULL;
         return;
     }
     
@@ -164,6 +150,8 @@ static void pdp_yqt_open(t_pdp_yqt *x, t_symbol *name)
     if (!quicktime_supported_audio(x->qt,0)) {
         post("pdp_yqt: warning : audio not supported" ); 
 	x->x_audio = 0;
+        quicktime_close(x->qt);
+        x->qt = NULL;
     } else {
 	x->x_audio = 1;
     }
@@ -210,43 +198,25 @@ static void pdp_yqt_bang(t_pdp_yqt *x)
     header->info.image.width = w;
     header->info.image.height = h;
 
-    length = quicktime_video_length(x->qt,0);
-    pos = quicktime_video_position(x->qt,0);
-    // post("pdp_yqt : video position : %d length =%d", pos, length );
+    length = x->x_nbvframes;
+    pos = x->x_frame;
 
     if (pos >= length){
-	pos = (x->loop) ? 0 : length - 1;
-        // post("pdp_yqt : setting video position to %d", pos);
-	quicktime_set_video_position(x->qt, pos, 0);
+	pos = (x->loop) ? pos % length : length - 1;
 	if (x->loop) 
         {
-           // post("pdp_yqt : resetting audio position");
-           if ( x->x_audio ) quicktime_set_audio_position(x->qt, 0, 0);
+           if ( x->x_audio ) quicktime_set_audio_position(x->qt, x->x_audio_rate*((float)pos/(float)quicktime_frame_rate (x->qt, 0)), 0);
            x->x_outreadposition = 0;
            x->x_outwriteposition = 0;
            x->x_outunread = 0;
         }
     }
 
-    lqt_decode_video(x->qt, x->qt_rows, 0);
-
-    switch(x->qt_cmodel){
-    case BC_YUV420P:
-        pdp_llconv(x->qt_frame, RIF_YVU__P411_U8, data, RIF_YVU__P411_S16, x->x_vwidth, x->x_vheight);
-        break;
-
-    case BC_YUV422:
-        pdp_llconv(x->qt_frame, RIF_YUYV_P____U8, data, RIF_YVU__P411_S16, x->x_vwidth, x->x_vheight);
-        break;
-
-    case BC_RGB888:
-        pdp_llconv(x->qt_frame, RIF_RGB__P____U8, data, RIF_YVU__P411_S16, x->x_vwidth, x->x_vheight);
-        break;
-
-    default:
-        post("pdp_yqt : error on decode: unkown colour model");
-        break;
+    if (!pidip_source_frame(&x->x_source, pos, data)){
+        pdp_packet_mark_unused(object);
+        return;
     }
+    x->x_frame = pos+1;
 
     if ( gettimeofday(&etime, NULL) == -1)
     {
@@ -270,6 +240,7 @@ static void pdp_yqt_loop(t_pdp_yqt *x, t_floatarg loop)
 {
     int loopi = (int)loop;
     x->loop = !(loopi == 0);
+    pidip_source_loop(&x->x_source, x->loop);
 }
 
 static void pdp_yqt_frame_cold(t_pdp_yqt *x, t_floatarg frameindex)
@@ -279,13 +250,12 @@ static void pdp_yqt_frame_cold(t_pdp_yqt *x, t_floatarg frameindex)
 
     if (!(x->initialized)) return;
 
-    length = quicktime_video_length(x->qt,0);
+    length = x->x_nbvframes;
 
     frame = (frame >= length) ? length-1 : frame;
     frame = (frame < 0) ? 0 : frame;
 
-    // post("pdp_yqt : frame cold : setting video position to : %d", frame );
-    quicktime_set_video_position(x->qt, frame, 0);
+    x->x_frame = frame;
     if ( x->x_audio )
     {
       sample = x->x_audio_rate*((float)frame/(float)quicktime_frame_rate (x->qt, 0));
@@ -302,10 +272,27 @@ static void pdp_yqt_frame(t_pdp_yqt *x, t_floatarg frameindex)
     pdp_yqt_bang(x);
 }
 
+/* a tick of the frame clock, frames skipped by the clock are dropped */
+static void pdp_yqt_tick(void *owner, int frame, int skipped)
+{
+    t_pdp_yqt *x = (t_pdp_yqt *)owner;
+
+    // the bang wraps the position and the audio with it
+    x->x_frame += skipped;
+    pdp_yqt_bang(x);
+}
+
+static void pdp_yqt_pace(t_pdp_yqt *x, t_symbol *s)
+{
+    x->x_pacer = pidip_pacer_follow(x->x_pacer, s, x, pdp_yqt_tick);
+}
+
 static void pdp_yqt_free(t_pdp_yqt *x)
 {
   
+    pdp_yqt_pace(x, &s_);
     pdp_yqt_close(x);
+    pidip_source_free(&x->x_source);
 
     freebytes(x->x_outbuffer, OUTPUT_BUFFER_SIZE*sizeof(t_float));
     freebytes(x->x_outl, DECODE_PACKET_SIZE*sizeof(t_float));
@@ -331,6 +318,10 @@ void *pdp_yqt_new(void)
     x->packet0 = -1;
 
     x->initialized = false;
+    x->qt = NULL;
+    x->x_audio = 0;
+    x->x_pacer = NULL;
+    pidip_source_init(&x->x_source);
 
     x->loop = false;
 
@@ -369,7 +360,7 @@ static t_int *pdp_yqt_perform(t_int *w)
      int i = 0;
 
     // fills in the audio buffer with a chunk if necessary
-    if ( (x->initialized) && (quicktime_video_position(x->qt,0)>0) && x->x_audio && ( x->x_outunread < n ) )
+    if ( (x->initialized) && (x->x_frame>0) && x->x_audio && ( x->x_outunread < n ) )
     {
       int csize, rsize, i, j;
 
@@ -447,6 +438,7 @@ void pdp_yqt_setup(void)
     class_addmethod(pdp_yqt_class, (t_method)pdp_yqt_close, gensym("close"), A_NULL);
     class_addmethod(pdp_yqt_class, (t_method)pdp_yqt_open, gensym("open"), A_SYMBOL, A_NULL);
     class_addmethod(pdp_yqt_class, (t_method)pdp_yqt_loop, gensym("loop"), A_DEFFLOAT, A_NULL);
+    class_addmethod(pdp_yqt_class, (t_method)pdp_yqt_pace, gensym("pace"), A_DEFSYMBOL, A_NULL);
     class_addfloat (pdp_yqt_class, (t_method)pdp_yqt_frame);
     class_addmethod(pdp_yqt_class, (t_method)pdp_yqt_frame_cold, gensym("frame_cold"), A_FLOAT, A_NULL);
     class_addmethod(pdp_yqt_class, nullfn, gensym("signal"), 0);
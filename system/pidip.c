@@ -80,6 +80,13 @@ extern "C"
     void pdp_fdiff_setup(void);
     void pdp_hue_setup(void);
     void pdp_dot_setup(void);
+    void pdp_stats_setup(void);
+    void pdp_rawclip_setup(void);
+    void pdp_rawconv_setup(void);
+    void pdp_pacer_tilde_setup(void);
+    void pdp_bgmodel_setup(void);
+    void pdp_profile_setup(void);
+    void pdp_pipeline_setup(void);
 
 #ifdef HAVE_V4L2
     void pdp_v4l2_setup(void);
@@ -183,6 +190,13 @@ void pidip_setup(void){
     pdp_fdiff_setup();
     pdp_hue_setup();
     pdp_dot_setup();
+    pdp_stats_setup();
+    pdp_rawclip_setup();
+    pdp_rawconv_setup();
+    pdp_pacer_tilde_setup();
+    pdp_bgmodel_setup();
+    pdp_profile_setup();
+    pdp_pipeline_setup();
 
 #ifdef HAVE_V4L2
     pdp_v4l2_setup();
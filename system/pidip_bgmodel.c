@@ -0,0 +1,496 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  shared adaptive background model : running average
+ *  or mixture of gaussians on a decimated luminance
+ *  ( see pidip_bgmodel.h )
+ */
+
+#include <math.h>
+#include "pdp.h"
+#include "pidip_bgmodel.h"
+
+#define PIDIP_BGMODEL_INITVAR 225.     // variance of a new gaussian ( 15^2 )
+#define PIDIP_BGMODEL_MINVAR 16.
+#define PIDIP_BGMODEL_MATCH 6.25       // a gaussian matches at 2.5 deviations
+#define PIDIP_BGMODEL_BGWEIGHT 0.7     // weight of the gaussians making the background
+
+static t_pidip_bgmodel *pidip_bgmodels = NULL;
+
+static void pidip_bgmodel_stopthreads( t_pidip_bgmodel *m );
+
+t_pidip_bgmodel *pidip_bgmodel_attach( t_symbol *name )
+{
+  t_pidip_bgmodel *m = NULL;
+
+    if ( name )
+    {
+       for ( m=pidip_bgmodels; m; m=m->m_next )
+       {
+          if ( m->m_name == name ) break;
+       }
+    }
+
+    if ( !m )
+    {
+       m = (t_pidip_bgmodel*) getbytes( sizeof(t_pidip_bgmodel) );
+       m->m_name = name;
+       m->m_nbusers = 0;
+       m->m_mode = PIDIP_BGMODEL_RUNNING;
+       m->m_rate = 0.02;
+       m->m_threshold = 20;
+       m->m_wantshift = 1;
+       m->m_wantthreads = 1;
+       m->m_reset = 1;
+       m->m_shift = -1;
+       m->m_width = m->m_height = 0;
+       m->m_fwidth = m->m_fheight = 0;
+       m->m_frames = 0;
+       m->m_average = NULL;
+       m->m_gaussians = NULL;
+       m->m_luma = NULL;
+       m->m_diff = NULL;
+       m->m_mask = NULL;
+       m->m_foreground = 0.;
+       m->m_packet = -1;
+       m->m_learnt = 1;
+       m->m_nthreads = 1;
+       m->m_running = 0;
+       m->m_generation = 0;
+       m->m_finished = 0;
+       pthread_mutex_init( &m->m_mutex, NULL );
+       pthread_cond_init( &m->m_start, NULL );
+       pthread_cond_init( &m->m_done, NULL );
+       m->m_next = pidip_bgmodels;
+       pidip_bgmodels = m;
+    }
+
+    m->m_nbusers++;
+    return m;
+}
+
+static void pidip_bgmodel_freebuffers( t_pidip_bgmodel *m )
+{
+  int size = m->m_width*m->m_height;
+
+    if ( m->m_average ) freebytes( m->m_average, size*sizeof(int) );
+    if ( m->m_gaussians ) freebytes( m->m_gaussians, size*PIDIP_BGMODEL_GAUSSIANS*sizeof(t_pidip_bgmodel_gaussian) );
+    if ( m->m_luma ) freebytes( m->m_luma, size );
+    if ( m->m_diff ) freebytes( m->m_diff, size*sizeof(short int) );
+    if ( m->m_mask ) freebytes( m->m_mask, size );
+    m->m_average = NULL;
+    m->m_gaussians = NULL;
+    m->m_luma = NULL;
+    m->m_diff = NULL;
+    m->m_mask = NULL;
+    m->m_width = m->m_height = 0;
+}
+
+void pidip_bgmodel_detach( t_pidip_bgmodel *m )
+{
+  t_pidip_bgmodel **pm;
+
+    if ( !m ) return;
+    if ( --m->m_nbusers > 0 ) return;
+
+    pidip_bgmodel_stopthreads( m );
+    pidip_bgmodel_freebuffers( m );
+    if ( m->m_packet >= 0 ) pdp_packet_mark_unused( m->m_packet );
+    pthread_mutex_destroy( &m->m_mutex );
+    pthread_cond_destroy( &m->m_start );
+    pthread_cond_destroy( &m->m_done );
+    for ( pm=&pidip_bgmodels; *pm; pm=&(*pm)->m_next )
+    {
+       if ( *pm == m )
+       {
+          *pm = m->m_next;
+          break;
+       }
+    }
+    freebytes( m, sizeof(t_pidip_bgmodel) );
+}
+
+void pidip_bgmodel_mode( t_pidip_bgmodel *m, int mode )
+{
+    if ( ( mode != PIDIP_BGMODEL_RUNNING ) && ( mode != PIDIP_BGMODEL_MOG ) ) return;
+    if ( mode != m->m_mode ) m->m_reset = 1;
+    m->m_mode = mode;
+}
+
+void pidip_bgmodel_rate( t_pidip_bgmodel *m, float rate )
+{
+    if ( rate < 0.0001 ) rate = 0.0001;
+    if ( rate > 1. ) rate = 1.;
+    m->m_rate = rate;
+}
+
+void pidip_bgmodel_threshold( t_pidip_bgmodel *m, int threshold )
+{
+    if ( threshold < 0 ) threshold = 0;
+    if ( threshold > 255 ) threshold = 255;
+    m->m_threshold = threshold;
+}
+
+void pidip_bgmodel_decimation( t_pidip_bgmodel *m, int shift )
+{
+    if ( shift < 0 ) shift = 0;
+    if ( shift > PIDIP_BGMODEL_MAXSHIFT ) shift = PIDIP_BGMODEL_MAXSHIFT;
+    m->m_wantshift = shift;
+}
+
+void pidip_bgmodel_threads( t_pidip_bgmodel *m, int threads )
+{
+    if ( threads < 1 ) threads = 1;
+    if ( threads > PIDIP_BGMODEL_MAXTHREADS ) threads = PIDIP_BGMODEL_MAXTHREADS;
+    m->m_wantthreads = threads;
+}
+
+void pidip_bgmodel_reset( t_pidip_bgmodel *m )
+{
+    m->m_reset = 1;
+}
+
+void pidip_bgmodel_push( t_pidip_bgmodel *m, int packet )
+{
+    if ( !m || ( packet == m->m_packet ) ) return;
+
+    // the process thread may be decimating the previous frame
+    pthread_mutex_lock( &m->m_mutex );
+    if ( m->m_packet >= 0 ) pdp_packet_mark_unused( m->m_packet );
+    m->m_packet = pdp_packet_copy_ro( packet );
+    m->m_learnt = 0;
+    pthread_mutex_unlock( &m->m_mutex );
+}
+
+/* learn rows [first, last[, returns the number of foreground pixels */
+static int pidip_bgmodel_learn( t_pidip_bgmodel *m, int first, int last )
+{
+  int i, k, y, d, fg, count = 0;
+  int end = last*m->m_width;
+  int threshold = m->m_threshold;
+  int learning = ( m->m_frames == 0 );
+
+    if ( m->m_mode == PIDIP_BGMODEL_RUNNING )
+    {
+      // foreground pixels are learnt 8 times slower, so that people standing still fade in slowly
+      int abg = (int)( m->m_rate*65536 );
+      int afg = abg>>3;
+      int *average = m->m_average;
+
+       if ( abg < 1 ) abg = 1;
+       if ( afg < 1 ) afg = 1;
+       for ( i=first*m->m_width; i<end; i++ )
+       {
+          y = m->m_luma[i];
+          if ( learning ) average[i] = y<<8;
+          d = (average[i]>>8) - y;
+          fg = ( ( d > threshold ) | ( d < -threshold ) );
+          average[i] += (int)( ( (long long)( (y<<8) - average[i] ) * ( fg ? afg : abg ) ) >> 16 );
+          m->m_diff[i] = d;
+          m->m_mask[i] = -fg;
+          count += fg;
+       }
+    }
+    else
+    {
+      float rate = m->m_rate;
+      float fy, dist, rho, total, above;
+      t_pidip_bgmodel_gaussian *g, *best, *match, tmp;
+
+       for ( i=first*m->m_width; i<end; i++ )
+       {
+          y = m->m_luma[i];
+          fy = y;
+          g = &m->m_gaussians[i*PIDIP_BGMODEL_GAUSSIANS];
+          if ( learning )
+          {
+             for ( k=0; k<PIDIP_BGMODEL_GAUSSIANS; k++ )
+             {
+                g[k].g_weight = ( k == 0 ) ? 1. : 0.;
+                g[k].g_mean = fy;
+                g[k].g_var = PIDIP_BGMODEL_INITVAR;
+             }
+          }
+
+          // gaussians are kept sorted by weight/deviation, most probable first
+          match = NULL;
+          total = 0.;
+          for ( k=0; k<PIDIP_BGMODEL_GAUSSIANS; k++ )
+          {
+             dist = fy - g[k].g_mean;
+             if ( !match && ( g[k].g_weight > 0. ) && ( dist*dist < PIDIP_BGMODEL_MATCH*g[k].g_var ) )
+             {
+                match = &g[k];
+                g[k].g_weight += rate*( 1. - g[k].g_weight );
+                rho = rate/g[k].g_weight;
+                g[k].g_mean += rho*dist;
+                g[k].g_var += rho*( dist*dist - g[k].g_var );
+                if ( g[k].g_var < PIDIP_BGMODEL_MINVAR ) g[k].g_var = PIDIP_BGMODEL_MINVAR;
+             }
+             else
+             {
+                g[k].g_weight *= ( 1. - rate );
+             }
+             total += g[k].g_weight;
+          }
+          if ( !match )
+          {
+             // the least probable gaussian is replaced
+             match = &g[PIDIP_BGMODEL_GAUSSIANS-1];
+             total -= match->g_weight;
+             match->g_weight = rate;
+             match->g_mean = fy;
+             match->g_var = PIDIP_BGMODEL_INITVAR;
+             total += rate;
+          }
+          for ( k=0; k<PIDIP_BGMODEL_GAUSSIANS; k++ ) g[k].g_weight /= total;
+          for ( k=1; k<PIDIP_BGMODEL_GAUSSIANS; k++ )
+          {
+             best = &g[k];
+             while ( ( best > g ) && ( best->g_weight*best->g_weight*(best-1)->g_var
+                                       > (best-1)->g_weight*(best-1)->g_weight*best->g_var ) )
+             {
+                if ( match == best ) match = best-1;
+                else if ( match == best-1 ) match = best;
+                tmp = *best;
+                *best = *(best-1);
+                *(best-1) = tmp;
+                best--;
+             }
+          }
+
+          // the matched gaussian is background if the more probable ones don't make the background alone
+          above = 0.;
+          for ( best=g; best<match; best++ ) above += best->g_weight;
+          fg = ( above >= PIDIP_BGMODEL_BGWEIGHT );
+          d = (int)g[0].g_mean - y;
+          m->m_diff[i] = d;
+          m->m_mask[i] = -fg;
+          count += fg;
+       }
+    }
+    return count;
+}
+
+static void *pidip_bgmodel_worker( void *tdata )
+{
+  t_pidip_bgmodel *m = (t_pidip_bgmodel *) tdata;
+  int band, generation, nbands;
+
+    pthread_mutex_lock( &m->m_mutex );
+    // the band of a worker is its rank, the caller does band 0
+    band = ++m->m_finished;
+    generation = m->m_generation;
+    pthread_cond_signal( &m->m_done );
+    while ( 1 )
+    {
+       while ( m->m_running && ( m->m_generation == generation ) )
+          pthread_cond_wait( &m->m_start, &m->m_mutex );
+       if ( !m->m_running ) break;
+       generation = m->m_generation;
+       nbands = m->m_nthreads;
+       pthread_mutex_unlock( &m->m_mutex );
+
+       m->m_counts[band] = pidip_bgmodel_learn( m, ( band*m->m_height )/nbands,
+                                                ( ( band+1 )*m->m_height )/nbands );
+
+       pthread_mutex_lock( &m->m_mutex );
+       m->m_finished++;
+       pthread_cond_signal( &m->m_done );
+    }
+    pthread_mutex_unlock( &m->m_mutex );
+    return NULL;
+}
+
+static void pidip_bgmodel_stopthreads( t_pidip_bgmodel *m )
+{
+  int i;
+
+    if ( m->m_nthreads <= 1 ) return;
+    pthread_mutex_lock( &m->m_mutex );
+    m->m_running = 0;
+    pthread_cond_broadcast( &m->m_start );
+    pthread_mutex_unlock( &m->m_mutex );
+    for ( i=1; i<m->m_nthreads; i++ ) pthread_join( m->m_threads[i], NULL );
+    m->m_nthreads = 1;
+}
+
+static void pidip_bgmodel_startthreads( t_pidip_bgmodel *m, int threads )
+{
+  int i;
+
+    pidip_bgmodel_stopthreads( m );
+    if ( threads <= 1 ) return;
+
+    m->m_running = 1;
+    m->m_finished = 0;
+    for ( i=1; i<threads; i++ )
+    {
+       if ( pthread_create( &m->m_threads[i], NULL, pidip_bgmodel_worker, m ) != 0 )
+       {
+          post( "pidip_bgmodel : could not launch worker thread" );
+          break;
+       }
+    }
+    // wait for the workers to know their band
+    pthread_mutex_lock( &m->m_mutex );
+    m->m_nthreads = i;
+    while ( m->m_finished < m->m_nthreads-1 ) pthread_cond_wait( &m->m_done, &m->m_mutex );
+    pthread_mutex_unlock( &m->m_mutex );
+    if ( m->m_nthreads <= 1 ) m->m_running = 0;
+}
+
+/* called with the mutex locked, average blocks of luminance into m_luma */
+static void pidip_bgmodel_decimate( t_pidip_bgmodel *m, short int *data )
+{
+  int mx, my, px, py, sum, v;
+  int block = 1<<m->m_shift;
+  int shift = 2*m->m_shift;
+  short int *row;
+
+    for ( my=0; my<m->m_height; my++ )
+    {
+       for ( mx=0; mx<m->m_width; mx++ )
+       {
+          sum = 0;
+          for ( py=0; py<block; py++ )
+          {
+             row = data + ( (my<<m->m_shift)+py )*m->m_fwidth + (mx<<m->m_shift);
+             for ( px=0; px<block; px++ )
+             {
+                v = row[px]>>7;
+                sum += ( v < 0 ) ? 0 : ( ( v > 255 ) ? 255 : v );
+             }
+          }
+          m->m_luma[my*m->m_width+mx] = sum>>shift;
+       }
+    }
+}
+
+int pidip_bgmodel_update( t_pidip_bgmodel *m )
+{
+  t_pdp *header;
+  int i, size, count, width, height;
+
+    if ( !m ) return 0;
+
+    pthread_mutex_lock( &m->m_mutex );
+    if ( m->m_learnt || ( m->m_packet < 0 ) )
+    {
+       pthread_mutex_unlock( &m->m_mutex );
+       return ( m->m_width > 0 );
+    }
+    m->m_learnt = 1;
+    if ( !( header = pdp_packet_header( m->m_packet ) ) || ( header->info.image.encoding != PDP_IMAGE_YV12 ) )
+    {
+       pthread_mutex_unlock( &m->m_mutex );
+       return 0;
+    }
+
+    width = header->info.image.width;
+    height = header->info.image.height;
+    if ( ( width != m->m_fwidth ) || ( height != m->m_fheight ) || ( m->m_wantshift != m->m_shift ) )
+    {
+       pidip_bgmodel_freebuffers( m );
+       m->m_fwidth = width;
+       m->m_fheight = height;
+       m->m_shift = m->m_wantshift;
+       m->m_width = width>>m->m_shift;
+       m->m_height = height>>m->m_shift;
+       size = m->m_width*m->m_height;
+       m->m_average = (int*) getbytes( size*sizeof(int) );
+       m->m_gaussians = (t_pidip_bgmodel_gaussian*) getbytes( size*PIDIP_BGMODEL_GAUSSIANS*sizeof(t_pidip_bgmodel_gaussian) );
+       m->m_luma = (unsigned char*) getbytes( size );
+       m->m_diff = (short int*) getbytes( size*sizeof(short int) );
+       m->m_mask = (unsigned char*) getbytes( size );
+       if ( !m->m_average || !m->m_gaussians || !m->m_luma || !m->m_diff || !m->m_mask )
+       {
+          post( "pidip_bgmodel : could not allocate model" );
+          pidip_bgmodel_freebuffers( m );
+          pthread_mutex_unlock( &m->m_mutex );
+          return 0;
+       }
+       m->m_reset = 1;
+    }
+    if ( m->m_reset )
+    {
+       m->m_reset = 0;
+       m->m_frames = 0;
+    }
+    pidip_bgmodel_decimate( m, (short int *) pdp_packet_data( m->m_packet ) );
+    pthread_mutex_unlock( &m->m_mutex );
+
+    if ( m->m_wantthreads != m->m_nthreads ) pidip_bgmodel_startthreads( m, m->m_wantthreads );
+
+    if ( m->m_nthreads > 1 )
+    {
+       pthread_mutex_lock( &m->m_mutex );
+       m->m_finished = 0;
+       m->m_generation++;
+       pthread_cond_broadcast( &m->m_start );
+       pthread_mutex_unlock( &m->m_mutex );
+
+       count = pidip_bgmodel_learn( m, 0, m->m_height/m->m_nthreads );
+
+       pthread_mutex_lock( &m->m_mutex );
+       while ( m->m_finished < m->m_nthreads-1 ) pthread_cond_wait( &m->m_done, &m->m_mutex );
+       pthread_mutex_unlock( &m->m_mutex );
+       for ( i=1; i<m->m_nthreads; i++ ) count += m->m_counts[i];
+    }
+    else
+    {
+       count = pidip_bgmodel_learn( m, 0, m->m_height );
+    }
+
+    m->m_frames++;
+    m->m_foreground = (float)count/(m->m_width*m->m_height);
+    return 1;
+}
+
+void pidip_bgmodel_expand( t_pidip_bgmodel *m, short int *dst, int width, int height, int flags )
+{
+  int px, py, mx, my, v;
+  short int *diff;
+  unsigned char *mask;
+
+    if ( !m || !m->m_diff )
+    {
+       memset( dst, 0x0, width*height*sizeof(short int) );
+       return;
+    }
+
+    for ( py=0; py<height; py++ )
+    {
+       my = ( height == m->m_fheight ) ? py>>m->m_shift : ( py*m->m_height )/height;
+       if ( my >= m->m_height ) my = m->m_height-1;
+       diff = m->m_diff + my*m->m_width;
+       mask = m->m_mask + my*m->m_width;
+       for ( px=0; px<width; px++ )
+       {
+          mx = ( width == m->m_fwidth ) ? px>>m->m_shift : ( px*m->m_width )/width;
+          if ( mx >= m->m_width ) mx = m->m_width-1;
+          v = diff[mx];
+          if ( ( flags & PIDIP_BGMODEL_ABS ) && ( v < 0 ) ) v = -v;
+          if ( flags & PIDIP_BGMODEL_MASKED ) v &= -( mask[mx] != 0 );
+          *dst++ = v<<7;
+       }
+    }
+}
@@ -0,0 +1,321 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  raw clips : mapped YV12 frames read ahead in the play direction
+ *  ( see pidip_clip.h )
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "pdp.h"
+#include "pdp_llconv.h"
+#include "pidip_clip.h"
+#include "pidip_source.h"
+
+static int pidip_clip_pagesize( void )
+{
+  long size = sysconf( _SC_PAGESIZE );
+
+    return ( size > 0 ) ? (int)size : 4096;
+}
+
+void pidip_clip_init( t_pidip_clip *clip )
+{
+    clip->c_fd = -1;
+    clip->c_map = NULL;
+    clip->c_maplen = 0;
+    memset( &clip->c_header, 0x0, sizeof(t_pidip_clipheader) );
+}
+
+static int pidip_clip_probe( int fd, t_pidip_clipheader *header )
+{
+    if ( pread( fd, header, sizeof(t_pidip_clipheader), 0 ) != sizeof(t_pidip_clipheader) ) return 0;
+    return ( strncmp( header->h_magic, PIDIP_CLIP_MAGIC, sizeof(header->h_magic) ) == 0 );
+}
+
+int pidip_clip_open( t_pidip_clip *clip, char *filename )
+{
+  struct stat st;
+  t_pidip_clipheader *h = &clip->c_header;
+  int fd;
+
+    pidip_clip_close( clip );
+
+    if ( ( fd = open( filename, O_RDONLY ) ) < 0 ) return 0;
+    if ( !pidip_clip_probe( fd, h ) )
+    {
+       close( fd );
+       return 0;
+    }
+
+    if ( ( h->h_version != PIDIP_CLIP_VERSION ) || ( h->h_width <= 0 ) || ( h->h_height <= 0 )
+         || ( h->h_width % 2 ) || ( h->h_height % 2 ) || ( h->h_nbframes < 0 )
+         || ( h->h_ratenum <= 0 ) || ( h->h_rateden <= 0 )
+         || ( h->h_framesize != h->h_width*h->h_height*3/2 ) || ( h->h_framestride < h->h_framesize )
+         || ( h->h_offset % pidip_clip_pagesize() ) || ( h->h_framestride % pidip_clip_pagesize() )
+         || ( fstat( fd, &st ) < 0 )
+         || ( st.st_size < (off_t)h->h_offset + (off_t)h->h_nbframes*h->h_framestride ) )
+    {
+       post( "pidip_clip : %s : corrupted or truncated clip", filename );
+       close( fd );
+       return 0;
+    }
+
+    clip->c_maplen = (size_t)h->h_offset + (size_t)h->h_nbframes*h->h_framestride;
+    clip->c_map = (unsigned char *) mmap( NULL, clip->c_maplen, PROT_READ, MAP_SHARED, fd, 0 );
+    if ( clip->c_map == MAP_FAILED )
+    {
+       post( "pidip_clip : %s : could not map clip : %s", filename, strerror(errno) );
+       clip->c_map = NULL;
+       clip->c_maplen = 0;
+       close( fd );
+       return 0;
+    }
+    // the kernel read ahead is only forward, ours follows the player
+    madvise( clip->c_map, clip->c_maplen, MADV_RANDOM );
+    clip->c_fd = fd;
+    return 1;
+}
+
+void pidip_clip_close( t_pidip_clip *clip )
+{
+    if ( clip->c_map ) munmap( clip->c_map, clip->c_maplen );
+    if ( clip->c_fd >= 0 ) close( clip->c_fd );
+    pidip_clip_init( clip );
+}
+
+int pidip_clip_frame( t_pidip_clip *clip, int frame, short int *data )
+{
+  t_pidip_clipheader *h = &clip->c_header;
+
+    if ( !clip->c_map || ( frame < 0 ) || ( frame >= h->h_nbframes ) ) return 0;
+    pdp_llconv( clip->c_map + h->h_offset + (size_t)frame*h->h_framestride, RIF_YVU__P411_U8,
+                data, RIF_YVU__P411_S16, h->h_width, h->h_height );
+    return 1;
+}
+
+static void pidip_clip_willneed( t_pidip_clip *clip, int first, int last )
+{
+  t_pidip_clipheader *h = &clip->c_header;
+
+    if ( first > last ) return;
+    madvise( clip->c_map + h->h_offset + (size_t)first*h->h_framestride,
+             (size_t)(last-first)*h->h_framestride + h->h_framesize, MADV_WILLNEED );
+}
+
+void pidip_clip_readahead( t_pidip_clip *clip, int frame, int count, int loop )
+{
+  int nbframes = clip->c_header.h_nbframes;
+  int first, last;
+
+    if ( !clip->c_map || !count || !nbframes ) return;
+    if ( count >= nbframes ) count = nbframes-1;
+    if ( count <= -nbframes ) count = -(nbframes-1);
+
+    if ( count > 0 )
+    {
+       first = frame+1;
+       last = frame+count;
+       if ( last >= nbframes )
+       {
+          if ( loop ) pidip_clip_willneed( clip, 0, last-nbframes );
+          last = nbframes-1;
+       }
+    }
+    else
+    {
+       first = frame+count;
+       last = frame-1;
+       if ( first < 0 )
+       {
+          if ( loop ) pidip_clip_willneed( clip, nbframes+first, nbframes-1 );
+          first = 0;
+       }
+    }
+    pidip_clip_willneed( clip, first, last );
+}
+
+int pidip_clip_create( t_pidip_clipwriter *writer, char *filename, int width, int height,
+                       int ratenum, int rateden )
+{
+  t_pidip_clipheader *h = &writer->w_header;
+  int pagesize = pidip_clip_pagesize();
+  char page[PIDIP_CLIP_HEADERSIZE];
+
+    writer->w_frame = NULL;
+    writer->w_fd = -1;
+    // what pidip_clip_open would refuse is not written
+    if ( ( width <= 0 ) || ( height <= 0 ) || ( width % 2 ) || ( height % 2 )
+         || ( ratenum <= 0 ) || ( rateden <= 0 ) )
+    {
+       post( "pidip_clip : cannot create %s : wrong size %dx%d or rate %d/%d", filename, width, height, ratenum, rateden );
+       return 0;
+    }
+    if ( ( writer->w_fd = open( filename, O_WRONLY|O_CREAT|O_TRUNC, 0644 ) ) < 0 )
+    {
+       post( "pidip_clip : could not create %s : %s", filename, strerror(errno) );
+       return 0;
+    }
+
+    memset( h, 0x0, sizeof(t_pidip_clipheader) );
+    strncpy( h->h_magic, PIDIP_CLIP_MAGIC, sizeof(h->h_magic) );
+    h->h_version = PIDIP_CLIP_VERSION;
+    h->h_width = width;
+    h->h_height = height;
+    h->h_nbframes = 0;
+    h->h_ratenum = ratenum;
+    h->h_rateden = rateden;
+    h->h_framesize = width*height*3/2;
+    h->h_framestride = ( ( h->h_framesize + pagesize-1 ) / pagesize ) * pagesize;
+    h->h_offset = ( ( PIDIP_CLIP_HEADERSIZE + pagesize-1 ) / pagesize ) * pagesize;
+
+    writer->w_frame = (unsigned char *) getbytes( h->h_framestride );
+    memset( page, 0x0, PIDIP_CLIP_HEADERSIZE );
+    memcpy( page, h, sizeof(t_pidip_clipheader) );
+    if ( !writer->w_frame || ( write( writer->w_fd, page, PIDIP_CLIP_HEADERSIZE ) != PIDIP_CLIP_HEADERSIZE )
+         || ( lseek( writer->w_fd, h->h_offset, SEEK_SET ) != h->h_offset ) )
+    {
+       post( "pidip_clip : could not write header of %s", filename );
+       if ( writer->w_frame ) freebytes( writer->w_frame, h->h_framestride );
+       writer->w_frame = NULL;
+       close( writer->w_fd );
+       writer->w_fd = -1;
+       return 0;
+    }
+    return 1;
+}
+
+static inline unsigned char pidip_clip_clip8( int v )
+{
+    if ( v < 0 ) return 0;
+    if ( v > 255 ) return 255;
+    return v;
+}
+
+int pidip_clip_write( t_pidip_clipwriter *writer, short int *data )
+{
+  t_pidip_clipheader *h = &writer->w_header;
+  int vsize = h->h_width*h->h_height;
+  unsigned char *frame = writer->w_frame;
+  int i;
+
+    if ( writer->w_fd < 0 ) return 0;
+
+    for ( i=0; i<vsize; i++ ) frame[i] = pidip_clip_clip8( data[i]>>7 );
+    for ( ; i<h->h_framesize; i++ ) frame[i] = pidip_clip_clip8( (data[i]>>8)+128 );
+
+    if ( write( writer->w_fd, frame, h->h_framestride ) != h->h_framestride )
+    {
+       post( "pidip_clip : could not write frame : %s", strerror(errno) );
+       return 0;
+    }
+    h->h_nbframes++;
+    return 1;
+}
+
+int pidip_clip_finish( t_pidip_clipwriter *writer )
+{
+  int ret = 1;
+
+    if ( writer->w_fd < 0 ) return 0;
+    if ( pwrite( writer->w_fd, &writer->w_header, sizeof(t_pidip_clipheader), 0 ) != sizeof(t_pidip_clipheader) )
+    {
+       post( "pidip_clip : could not update header : %s", strerror(errno) );
+       ret = 0;
+    }
+    if ( close( writer->w_fd ) < 0 ) ret = 0;
+    writer->w_fd = -1;
+    if ( writer->w_frame ) freebytes( writer->w_frame, writer->w_header.h_framestride );
+    writer->w_frame = NULL;
+    return ret;
+}
+
+void pidip_clip_rate( double framerate, int *ratenum, int *rateden )
+{
+  double ntsc = framerate*1.001;
+
+    if ( framerate <= 0 )
+    {
+       *ratenum = 25;
+       *rateden = 1;
+    }
+    else if ( ( fabs( ntsc - floor( ntsc + 0.5 ) ) < 0.005 ) && ( fabs( framerate - floor( framerate + 0.5 ) ) > 0.005 ) )
+    {
+       // 23.976, 29.97, 59.94 ...
+       *ratenum = (int)floor( ntsc + 0.5 )*1000;
+       *rateden = 1001;
+    }
+    else
+    {
+       *ratenum = (int)floor( framerate*1000 + 0.5 );
+       *rateden = 1000;
+       while ( ( *rateden > 1 ) && !( *ratenum % 10 ) )
+       {
+          *ratenum /= 10;
+          *rateden /= 10;
+       }
+    }
+}
+
+/* backend, so that the file players and the converter read clips too */
+
+static void *pidip_source_clip_open( char *filename, t_pidip_source_info *info )
+{
+  t_pidip_clip *clip = (t_pidip_clip *) getbytes( sizeof(t_pidip_clip) );
+
+    pidip_clip_init( clip );
+    if ( !pidip_clip_open( clip, filename ) )
+    {
+       freebytes( clip, sizeof(t_pidip_clip) );
+       return NULL;
+    }
+    // sources decode forward most of the time
+    madvise( clip->c_map, clip->c_maplen, MADV_SEQUENTIAL );
+    info->i_width = clip->c_header.h_width;
+    info->i_height = clip->c_header.h_height;
+    info->i_nbframes = clip->c_header.h_nbframes;
+    info->i_framerate = (double)clip->c_header.h_ratenum/clip->c_header.h_rateden;
+    return clip;
+}
+
+static int pidip_source_clip_decode( void *handle, int frame, short int *data )
+{
+    return pidip_clip_frame( (t_pidip_clip *) handle, frame, data );
+}
+
+static void pidip_source_clip_close( void *handle )
+{
+    pidip_clip_close( (t_pidip_clip *) handle );
+    freebytes( handle, sizeof(t_pidip_clip) );
+}
+
+t_pidip_source_backend pidip_source_clip =
+{
+  "clip",
+  pidip_source_clip_open,
+  pidip_source_clip_decode,
+  pidip_source_clip_close
+};
@@ -0,0 +1,242 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  shared frame history : a ring of retained packets
+ *  that several temporal effects can read from
+ *  ( see pidip_history.h )
+ */
+
+#include "pdp.h"
+#include "pidip_history.h"
+
+static t_pidip_history *pidip_histories = NULL;
+
+static int pidip_history_maxdepth(t_pidip_history *h)
+{
+  int i;
+
+    for ( i=PIDIP_HISTORY_MAXDEPTH; i>0; i-- )
+    {
+       if ( h->h_readers[i] > 0 ) return i;
+    }
+    return 0;
+}
+
+static void pidip_history_flush(t_pidip_history *h)
+{
+  int i;
+
+    for ( i=0; i<h->h_count; i++ )
+    {
+       pdp_packet_mark_unused( h->h_packets[(h->h_head+i)%h->h_size] );
+    }
+    for ( i=0; i<h->h_size; i++ )
+    {
+       h->h_packets[i] = -1;
+    }
+    h->h_count = 0;
+    h->h_head = 0;
+}
+
+/* resize the ring to the deepest reader, keeping the newest frames */
+static void pidip_history_resize(t_pidip_history *h)
+{
+  int newsize, i;
+  int *newpackets;
+
+    newsize = pidip_history_maxdepth(h);
+    if ( newsize == h->h_size ) return;
+
+    newpackets = NULL;
+    if ( newsize > 0 )
+    {
+       newpackets = (int*) getbytes( newsize*sizeof(int) );
+       for ( i=0; i<newsize; i++ ) newpackets[i] = -1;
+    }
+    for ( i=0; i<h->h_count; i++ )
+    {
+       if ( i < newsize )
+       {
+          newpackets[i] = h->h_packets[(h->h_head+i)%h->h_size];
+       }
+       else
+       {
+          pdp_packet_mark_unused( h->h_packets[(h->h_head+i)%h->h_size] );
+       }
+    }
+    if ( h->h_packets ) freebytes( h->h_packets, h->h_size*sizeof(int) );
+    if ( h->h_count > newsize ) h->h_count = newsize;
+    h->h_packets = newpackets;
+    h->h_size = newsize;
+    h->h_head = 0;
+}
+
+static int pidip_history_clipdepth(int depth)
+{
+    if ( depth < 1 ) return 1;
+    if ( depth > PIDIP_HISTORY_MAXDEPTH ) return PIDIP_HISTORY_MAXDEPTH;
+    return depth;
+}
+
+t_pidip_history *pidip_history_attach( t_symbol *name, int depth )
+{
+  t_pidip_history *h = NULL;
+  int i;
+
+    depth = pidip_history_clipdepth( depth );
+
+    if ( name )
+    {
+       for ( h=pidip_histories; h; h=h->h_next )
+       {
+          if ( h->h_name == name ) break;
+       }
+    }
+
+    if ( !h )
+    {
+       h = (t_pidip_history*) getbytes( sizeof(t_pidip_history) );
+       h->h_name = name;
+       h->h_packets = NULL;
+       h->h_size = 0;
+       h->h_head = 0;
+       h->h_count = 0;
+       h->h_width = 0;
+       h->h_height = 0;
+       h->h_nbreaders = 0;
+       for ( i=0; i<=PIDIP_HISTORY_MAXDEPTH; i++ ) h->h_readers[i] = 0;
+       h->h_next = pidip_histories;
+       pidip_histories = h;
+    }
+
+    h->h_readers[depth]++;
+    h->h_nbreaders++;
+    pidip_history_resize( h );
+
+    return h;
+}
+
+void pidip_history_detach( t_pidip_history *h, int depth )
+{
+  t_pidip_history **ph;
+
+    if ( !h ) return;
+
+    depth = pidip_history_clipdepth( depth );
+    if ( h->h_readers[depth] > 0 ) h->h_readers[depth]--;
+    h->h_nbreaders--;
+
+    if ( h->h_nbreaders > 0 )
+    {
+       pidip_history_resize( h );
+       return;
+    }
+
+    pidip_history_flush( h );
+    if ( h->h_packets ) freebytes( h->h_packets, h->h_size*sizeof(int) );
+    for ( ph=&pidip_histories; *ph; ph=&(*ph)->h_next )
+    {
+       if ( *ph == h )
+       {
+          *ph = h->h_next;
+          break;
+       }
+    }
+    freebytes( h, sizeof(t_pidip_history) );
+}
+
+void pidip_history_depth( t_pidip_history *h, int olddepth, int newdepth )
+{
+    if ( !h ) return;
+
+    olddepth = pidip_history_clipdepth( olddepth );
+    newdepth = pidip_history_clipdepth( newdepth );
+    if ( h->h_readers[olddepth] > 0 ) h->h_readers[olddepth]--;
+    h->h_readers[newdepth]++;
+    pidip_history_resize( h );
+}
+
+void pidip_history_push( t_pidip_history *h, int packet )
+{
+  t_pdp *header;
+
+    if ( !h || ( h->h_size <= 0 ) ) return;
+    if ( !(header = pdp_packet_header(packet)) ) return;
+
+    /* another reader already stored this frame :
+       it is retained, so its number cannot have been reused */
+    if ( ( h->h_count > 0 ) && ( h->h_packets[h->h_head] == packet ) ) return;
+
+    /* frames of different sizes don't mix */
+    if ( ( (int)header->info.image.width != h->h_width ) ||
+         ( (int)header->info.image.height != h->h_height ) )
+    {
+       pidip_history_flush( h );
+       h->h_width = header->info.image.width;
+       h->h_height = header->info.image.height;
+    }
+
+    h->h_head = ( h->h_head + h->h_size - 1 ) % h->h_size;
+    if ( h->h_count == h->h_size )
+    {
+       pdp_packet_mark_unused( h->h_packets[h->h_head] );
+    }
+    else
+    {
+       h->h_count++;
+    }
+    h->h_packets[h->h_head] = pdp_packet_copy_ro( packet );
+}
+
+int pidip_history_count( t_pidip_history *h )
+{
+    if ( !h ) return 0;
+    return h->h_count;
+}
+
+int pidip_history_get( t_pidip_history *h, int age )
+{
+    if ( !h || ( age < 0 ) || ( age >= h->h_count ) ) return -1;
+    return h->h_packets[(h->h_head+age)%h->h_size];
+}
+
+int pidip_history_pin( t_pidip_history *h, int *packets, int nb )
+{
+  int i;
+
+    if ( !h ) return 0;
+    if ( nb > h->h_count ) nb = h->h_count;
+    for ( i=0; i<nb; i++ )
+    {
+       packets[i] = pdp_packet_copy_ro( h->h_packets[(h->h_head+i)%h->h_size] );
+    }
+    return nb;
+}
+
+void pidip_history_unpin( int *packets, int nb )
+{
+  int i;
+
+    for ( i=0; i<nb; i++ )
+    {
+       pdp_packet_mark_unused( packets[i] );
+       packets[i] = -1;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  in place processing of packets owned by one effect
+ *  ( see pidip_inplace.h )
+ */
+
+#include "pdp.h"
+#include "pidip_inplace.h"
+
+int pidip_inplace_rw( int packet )
+{
+  t_pdp *header = pdp_packet_header( packet );
+
+    if ( !header ) return -1;
+
+    if ( header->users == 1 )
+    {
+       return pdp_packet_copy_ro( packet );
+    }
+    return pdp_packet_clone_rw( packet );
+}
+
+void pidip_inplace_copy( short int *newdata, short int *data, int size )
+{
+    if ( newdata != data ) memcpy( newdata, data, size );
+}
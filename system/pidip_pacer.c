@@ -0,0 +1,186 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  shared frame clocks : sources subscribe to a named pacer
+ *  and get ticks at an exact rational frame rate
+ *  ( see pidip_pacer.h )
+ */
+
+#include <time.h>
+#include "pdp.h"
+#include "pidip_pacer.h"
+
+static t_pidip_pacer *pidip_pacers = NULL;
+
+t_pidip_pacer *pidip_pacer_attach( t_symbol *name )
+{
+  t_pidip_pacer *p;
+
+    for ( p=pidip_pacers; p; p=p->p_next )
+    {
+       if ( p->p_name == name ) break;
+    }
+
+    if ( !p )
+    {
+       p = (t_pidip_pacer*) getbytes( sizeof(t_pidip_pacer) );
+       p->p_name = name;
+       p->p_ratenum = 25;
+       p->p_rateden = 1;
+       p->p_frame = -1;
+       p->p_late = 0;
+       p->p_skipped = 0;
+       p->p_nbusers = 0;
+       p->p_clients = NULL;
+       p->p_next = pidip_pacers;
+       pidip_pacers = p;
+    }
+
+    p->p_nbusers++;
+    return p;
+}
+
+void pidip_pacer_detach( t_pidip_pacer *p )
+{
+  t_pidip_pacer **pp;
+  t_pidip_pacerclient *c;
+
+    if ( !p ) return;
+    if ( --p->p_nbusers > 0 ) return;
+
+    while ( ( c = p->p_clients ) )
+    {
+       p->p_clients = c->c_next;
+       freebytes( c, sizeof(t_pidip_pacerclient) );
+    }
+    for ( pp=&pidip_pacers; *pp; pp=&(*pp)->p_next )
+    {
+       if ( *pp == p )
+       {
+          *pp = p->p_next;
+          break;
+       }
+    }
+    freebytes( p, sizeof(t_pidip_pacer) );
+}
+
+void pidip_pacer_subscribe( t_pidip_pacer *p, void *owner, t_pidip_pacer_tick tick )
+{
+  t_pidip_pacerclient *c;
+
+    if ( !p ) return;
+    c = (t_pidip_pacerclient*) getbytes( sizeof(t_pidip_pacerclient) );
+    c->c_owner = owner;
+    c->c_tick = tick;
+    c->c_next = p->p_clients;
+    p->p_clients = c;
+}
+
+void pidip_pacer_unsubscribe( t_pidip_pacer *p, void *owner )
+{
+  t_pidip_pacerclient **pc, *c;
+
+    if ( !p ) return;
+    for ( pc=&p->p_clients; *pc; pc=&(*pc)->c_next )
+    {
+       if ( (*pc)->c_owner == owner )
+       {
+          c = *pc;
+          *pc = c->c_next;
+          freebytes( c, sizeof(t_pidip_pacerclient) );
+          return;
+       }
+    }
+}
+
+t_pidip_pacer *pidip_pacer_follow( t_pidip_pacer *current, t_symbol *name, void *owner, t_pidip_pacer_tick tick )
+{
+  t_pidip_pacer *p = NULL;
+
+    if ( current )
+    {
+       pidip_pacer_unsubscribe( current, owner );
+       pidip_pacer_detach( current );
+    }
+    if ( name != &s_ )
+    {
+       p = pidip_pacer_attach( name );
+       pidip_pacer_subscribe( p, owner, tick );
+    }
+    return p;
+}
+
+int pidip_pacer_rate( t_pidip_pacer *p, int ratenum, int rateden )
+{
+    if ( !p || ( ratenum <= 0 ) || ( rateden <= 0 ) ) return 0;
+    p->p_ratenum = ratenum;
+    p->p_rateden = rateden;
+    return 1;
+}
+
+void pidip_pacer_reset( t_pidip_pacer *p )
+{
+    if ( !p ) return;
+    p->p_frame = -1;
+    p->p_late = 0;
+    p->p_skipped = 0;
+}
+
+int pidip_pacer_frameat( t_pidip_pacer *p, long long elapsed, long long units )
+{
+    if ( elapsed < 0 ) return -1;
+    return (int)( ( elapsed*p->p_ratenum ) / ( units*p->p_rateden ) );
+}
+
+long long pidip_pacer_timeof( t_pidip_pacer *p, int frame, long long units )
+{
+    // rounded up, so that frameat( timeof( frame ) ) is frame
+    return ( (long long)frame*units*p->p_rateden + p->p_ratenum-1 ) / p->p_ratenum;
+}
+
+int pidip_pacer_advance( t_pidip_pacer *p, int frame, int late )
+{
+  t_pidip_pacerclient *c, *next;
+  int skipped;
+
+    if ( !p || ( frame <= p->p_frame ) ) return 0;
+
+    skipped = ( p->p_frame >= 0 ) ? frame-p->p_frame-1 : 0;
+    p->p_frame = frame;
+    p->p_skipped += skipped;
+    if ( late ) p->p_late++;
+
+    for ( c=p->p_clients; c; c=next )
+    {
+       // a client may unsubscribe from its tick
+       next = c->c_next;
+       c->c_tick( c->c_owner, frame, skipped );
+    }
+    return skipped;
+}
+
+long long pidip_pacer_now( void )
+{
+  struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
@@ -0,0 +1,546 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  fused chains of point and neighbourhood operators
+ *  ( see pidip_pipe.h )
+ */
+
+#include "pdp.h"
+#include "pidip_pipe.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define PIPE_WHITE ((255)<<7)
+#define PIPE_EVEN(n) (((n)+1)&~1)
+
+/* lumafilt : blacks out some levels of luminosity */
+
+#define PIPE_MAXLUMA 256
+
+typedef struct _pipe_lumafilt
+{
+  char l_filter[PIPE_MAXLUMA];
+} t_pipe_lumafilt;
+
+static void pipe_lumafilt_init( void *state )
+{
+  t_pipe_lumafilt *s = (t_pipe_lumafilt *)state;
+
+    memset( s->l_filter, 0x0, PIPE_MAXLUMA );
+}
+
+static int pipe_lumafilt_param( void *state, char *param, int argc, t_float *argv )
+{
+  t_pipe_lumafilt *s = (t_pipe_lumafilt *)state;
+  int li, ls, le, onoff;
+
+    if ( !strcmp( param, "filter" ) && ( argc == 2 ) )
+    {
+       ls = le = (int)argv[0];
+       onoff = (int)argv[1];
+    }
+    else if ( !strcmp( param, "mfilter" ) && ( argc == 3 ) )
+    {
+       ls = (int)argv[0];
+       le = (int)argv[1];
+       onoff = (int)argv[2];
+    }
+    else
+    {
+       return 0;
+    }
+    if ( ( ls < 0 ) || ( le >= PIPE_MAXLUMA ) || ( ls > le ) ) return 1;
+    if ( ( onoff != 0 ) && ( onoff != 1 ) ) return 1;
+    for ( li=ls; li<=le; li++ ) s->l_filter[li] = onoff;
+    return 1;
+}
+
+static int pipe_lumafilt_filtered( t_pipe_lumafilt *s, short int y )
+{
+  int luma = y>>7;
+
+    return ( ( luma >= 0 ) && ( luma < PIPE_MAXLUMA ) && s->l_filter[luma] );
+}
+
+static void pipe_lumafilt_run( void *state, t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 )
+{
+  t_pipe_lumafilt *s = (t_pipe_lumafilt *)state;
+  short int *piY, *piU, *piV, *poY, *poU, *poV;
+  int px, py;
+
+    for ( py=y0; py<y1; py++ )
+    {
+       piY = PIDIP_STRIP_Y( in, py );
+       poY = PIDIP_STRIP_Y( out, py );
+       for ( px=0; px<width; px++ )
+       {
+          poY[px] = pipe_lumafilt_filtered( s, piY[px] ) ? 0 : piY[px];
+       }
+       if ( py&1 ) continue;
+
+       // each chrominance sample goes with the luminance of its first pixel
+       piU = PIDIP_STRIP_U( in, py );
+       piV = PIDIP_STRIP_V( in, py );
+       poU = PIDIP_STRIP_U( out, py );
+       poV = PIDIP_STRIP_V( out, py );
+       for ( px=0; px<(width>>1); px++ )
+       {
+          if ( pipe_lumafilt_filtered( s, piY[px<<1] ) )
+          {
+             poU[px] = 0;
+             poV[px] = 0;
+          }
+          else
+          {
+             poU[px] = piU[px];
+             poV[px] = piV[px];
+          }
+       }
+    }
+}
+
+/* binary : white where the color is close to a ( y, u, v ) setting, black elsewhere */
+
+typedef struct _pipe_binary
+{
+  int b_colorY;               // components compared, -1 if not
+  int b_colorU;
+  int b_colorV;
+  int b_tolerance;
+} t_pipe_binary;
+
+static void pipe_binary_init( void *state )
+{
+  t_pipe_binary *s = (t_pipe_binary *)state;
+
+    s->b_colorY = 200;
+    s->b_colorU = -1;
+    s->b_colorV = -1;
+    s->b_tolerance = 55;
+}
+
+static int pipe_binary_param( void *state, char *param, int argc, t_float *argv )
+{
+  t_pipe_binary *s = (t_pipe_binary *)state;
+
+    if ( argc != 1 ) return 0;
+    if ( !strcmp( param, "Y" ) )
+    {
+       if ( argv[0] <= 255. ) s->b_colorY = (int)argv[0];
+    }
+    else if ( !strcmp( param, "U" ) )
+    {
+       if ( argv[0] <= 255. ) s->b_colorU = (int)argv[0];
+    }
+    else if ( !strcmp( param, "V" ) )
+    {
+       if ( argv[0] <= 255. ) s->b_colorV = (int)argv[0];
+    }
+    else if ( !strcmp( param, "tolerance" ) )
+    {
+       if ( argv[0] >= 0. ) s->b_tolerance = (int)argv[0];
+    }
+    else
+    {
+       return 0;
+    }
+    return 1;
+}
+
+static void pipe_binary_run( void *state, t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 )
+{
+  t_pipe_binary *s = (t_pipe_binary *)state;
+  short int *piY, *piU, *piV, *poY;
+  int px, py, diff;
+
+    for ( py=y0; py<y1; py++ )
+    {
+       piY = PIDIP_STRIP_Y( in, py );
+       piU = PIDIP_STRIP_U( in, py&~1 );
+       piV = PIDIP_STRIP_V( in, py&~1 );
+       poY = PIDIP_STRIP_Y( out, py );
+       for ( px=0; px<width; px++ )
+       {
+          diff = 0;
+          if ( s->b_colorY >= 0 ) diff = abs( (piY[px]>>7) - s->b_colorY );
+          if ( s->b_colorV >= 0 ) diff += abs( (piV[px>>1]>>8) + 128 - s->b_colorV );
+          if ( s->b_colorU >= 0 ) diff += abs( (piU[px>>1]>>8) + 128 - s->b_colorU );
+          poY[px] = ( diff <= s->b_tolerance ) ? PIPE_WHITE : 0;
+       }
+       if ( py&1 ) continue;
+       memset( PIDIP_STRIP_U( out, py ), 0x0, (width>>1)*sizeof(short int) );
+       memset( PIDIP_STRIP_V( out, py ), 0x0, (width>>1)*sizeof(short int) );
+    }
+}
+
+/* erode and dilate : morphology on a binary luminance with a WxH square */
+
+typedef struct _pipe_morph
+{
+  int m_kernelw;
+  int m_kernelh;
+} t_pipe_morph;
+
+static void pipe_morph_init( void *state )
+{
+  t_pipe_morph *s = (t_pipe_morph *)state;
+
+    s->m_kernelw = 3;
+    s->m_kernelh = 3;
+}
+
+static int pipe_morph_param( void *state, char *param, int argc, t_float *argv )
+{
+  t_pipe_morph *s = (t_pipe_morph *)state;
+
+    if ( argc != 1 ) return 0;
+    if ( !strcmp( param, "kernelw" ) )
+    {
+       if ( ( argv[0] >= 0. ) && ( (int)argv[0]/2 <= PIDIP_PIPE_MAXREACH ) ) s->m_kernelw = (int)argv[0];
+    }
+    else if ( !strcmp( param, "kernelh" ) )
+    {
+       if ( ( argv[0] >= 0. ) && ( (int)argv[0]/2 <= PIDIP_PIPE_MAXREACH ) ) s->m_kernelh = (int)argv[0];
+    }
+    else
+    {
+       return 0;
+    }
+    return 1;
+}
+
+static void pipe_morph_reach( void *state, int *rx, int *ry )
+{
+  t_pipe_morph *s = (t_pipe_morph *)state;
+
+    *rx = s->m_kernelw/2;
+    *ry = s->m_kernelh/2;
+}
+
+static void pipe_chroma_copy( t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 )
+{
+  int py;
+
+    for ( py=(y0+1)&~1; py<y1; py+=2 )
+    {
+       memcpy( PIDIP_STRIP_U( out, py ), PIDIP_STRIP_U( in, py ), (width>>1)*sizeof(short int) );
+       memcpy( PIDIP_STRIP_V( out, py ), PIDIP_STRIP_V( in, py ), (width>>1)*sizeof(short int) );
+    }
+}
+
+// a rectangle is the product of a row and a column, so the windows are looked at in two passes :
+// the work rows count the white samples around each sample of a row, from y0-ky to y1+ky,
+// then the samples of a column of 2*ky+1 work rows are combined.
+// same results as pdp_erode and pdp_dilate with one pass, the apron replicates the border
+static void pipe_morph_rows( t_pidip_strip *in, int width, int kx, int y0, int y1 )
+{
+  short int *piY, *pwY;
+  int px, py, ix, count;
+
+    for ( py=y0; py<y1; py++ )
+    {
+       piY = PIDIP_STRIP_Y( in, py );
+       pwY = PIDIP_STRIP_W( in, py );
+       count = 0;
+       for ( ix=-kx; ix<kx; ix++ ) count += ( piY[ix] == PIPE_WHITE );
+       for ( px=0; px<width; px++ )
+       {
+          count += ( piY[px+kx] == PIPE_WHITE );
+          pwY[px] = count;
+          count -= ( piY[px-kx] == PIPE_WHITE );
+       }
+    }
+}
+
+static void pipe_erode_run( void *state, t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 )
+{
+  t_pipe_morph *s = (t_pipe_morph *)state;
+  short int *piY, *poY, *pwY;
+  int px, py, iy, kx = s->m_kernelw/2, ky = s->m_kernelh/2;
+
+    // a sample stays if its whole window is white
+    pipe_morph_rows( in, width, kx, y0-ky, y1+ky );
+    for ( py=y0; py<y1; py++ )
+    {
+       piY = PIDIP_STRIP_Y( in, py );
+       poY = PIDIP_STRIP_Y( out, py );
+       memcpy( poY, piY, width*sizeof(short int) );
+       for ( iy=-ky; iy<=ky; iy++ )
+       {
+          pwY = PIDIP_STRIP_W( in, py+iy );
+          for ( px=0; px<width; px++ )
+          {
+             poY[px] = ( pwY[px] == 2*kx+1 ) ? poY[px] : 0;
+          }
+       }
+    }
+    pipe_chroma_copy( in, out, width, y0, y1 );
+}
+
+static void pipe_dilate_run( void *state, t_pidip_strip *in, t_pidip_strip *out, int width, int y0, int y1 )
+{
+  t_pipe_morph *s = (t_pipe_morph *)state;
+  short int *piY, *poY, *pwY;
+  int px, py, iy, kx = s->m_kernelw/2, ky = s->m_kernelh/2;
+
+    // a black sample gets white if its window has a white one
+    pipe_morph_rows( in, width, kx, y0-ky, y1+ky );
+    for ( py=y0; py<y1; py++ )
+    {
+       piY = PIDIP_STRIP_Y( in, py );
+       poY = PIDIP_STRIP_Y( out, py );
+       memcpy( poY, piY, width*sizeof(short int) );
+       for ( iy=-ky; iy<=ky; iy++ )
+       {
+          pwY = PIDIP_STRIP_W( in, py+iy );
+          for ( px=0; px<width; px++ )
+          {
+             poY[px] = ( ( poY[px] == 0 ) && pwY[px] ) ? PIPE_WHITE : poY[px];
+          }
+       }
+    }
+    pipe_chroma_copy( in, out, width, y0, y1 );
+}
+
+static t_pidip_pipeop pidip_pipe_ops[] =
+{
+  { "lumafilt", sizeof(t_pipe_lumafilt), pipe_lumafilt_init, pipe_lumafilt_param, NULL, pipe_lumafilt_run },
+  { "binary", sizeof(t_pipe_binary), pipe_binary_init, pipe_binary_param, NULL, pipe_binary_run },
+  { "erode", sizeof(t_pipe_morph), pipe_morph_init, pipe_morph_param, pipe_morph_reach, pipe_erode_run },
+  { "dilate", sizeof(t_pipe_morph), pipe_morph_init, pipe_morph_param, pipe_morph_reach, pipe_dilate_run },
+  { NULL, 0, NULL, NULL, NULL, NULL }
+};
+
+/* the pipe */
+
+void pidip_pipe_init( t_pidip_pipe *pipe )
+{
+  int si;
+
+    pipe->p_nbstages = 0;
+    pipe->p_band = PIDIP_PIPE_BAND;
+    pipe->p_width = 0;
+    pipe->p_height = 0;
+    pipe->p_dirty = 1;
+    for ( si=0; si<2; si++ )
+    {
+       pidip_plane_init( &pipe->p_strips[si].s_y );
+       pidip_plane_init( &pipe->p_strips[si].s_v );
+       pidip_plane_init( &pipe->p_strips[si].s_u );
+       pipe->p_strips[si].s_work = &pipe->p_work;
+       pipe->p_strips[si].s_base = 0;
+    }
+    pidip_plane_init( &pipe->p_work );
+}
+
+void pidip_pipe_free( t_pidip_pipe *pipe )
+{
+  int si;
+
+    for ( si=0; si<pipe->p_nbstages; si++ )
+    {
+       freebytes( pipe->p_states[si], pipe->p_ops[si]->o_size );
+    }
+    for ( si=0; si<2; si++ )
+    {
+       pidip_plane_free( &pipe->p_strips[si].s_y );
+       pidip_plane_free( &pipe->p_strips[si].s_v );
+       pidip_plane_free( &pipe->p_strips[si].s_u );
+    }
+    pidip_plane_free( &pipe->p_work );
+    pipe->p_nbstages = 0;
+}
+
+t_pidip_pipeop *pidip_pipe_op( char *name )
+{
+  t_pidip_pipeop *op;
+
+    for ( op=pidip_pipe_ops; op->o_name; op++ )
+    {
+       if ( !strcmp( op->o_name, name ) ) return op;
+    }
+    return NULL;
+}
+
+int pidip_pipe_add( t_pidip_pipe *pipe, char *name )
+{
+  t_pidip_pipeop *op = pidip_pipe_op( name );
+  void *state;
+
+    if ( !op || ( pipe->p_nbstages >= PIDIP_PIPE_MAXSTAGES ) ) return 0;
+    if ( !( state = getbytes( op->o_size ) ) ) return 0;
+    op->o_init( state );
+    pipe->p_ops[pipe->p_nbstages] = op;
+    pipe->p_states[pipe->p_nbstages] = state;
+    pipe->p_nbstages++;
+    pipe->p_dirty = 1;
+    return 1;
+}
+
+int pidip_pipe_param( t_pidip_pipe *pipe, char *name, char *param, int argc, t_float *argv )
+{
+  int si, taken = 0;
+
+    for ( si=0; si<pipe->p_nbstages; si++ )
+    {
+       if ( strcmp( pipe->p_ops[si]->o_name, name ) ) continue;
+       taken += pipe->p_ops[si]->o_param( pipe->p_states[si], param, argc, argv );
+    }
+    if ( taken ) pipe->p_dirty = 1;
+    return taken;
+}
+
+void pidip_pipe_band( t_pidip_pipe *pipe, int band )
+{
+    if ( band < 2 ) return;
+    pipe->p_band = PIPE_EVEN( band );
+    pipe->p_dirty = 1;
+}
+
+static void pidip_pipe_reach( t_pidip_pipe *pipe, int si, int *rx, int *ry )
+{
+    *rx = *ry = 0;
+    if ( pipe->p_ops[si]->o_reach ) pipe->p_ops[si]->o_reach( pipe->p_states[si], rx, ry );
+}
+
+// halos and strips for a frame of width x height
+static int pidip_pipe_prepare( t_pidip_pipe *pipe, int width, int height )
+{
+  int si, rx, ry, apron = 1, rows;
+
+    if ( !pipe->p_dirty && ( width == pipe->p_width ) && ( height == pipe->p_height ) ) return 1;
+
+    // the halo of a stage holds the rows reached by itself and all the following ones
+    pipe->p_halo[pipe->p_nbstages] = 0;
+    for ( si=pipe->p_nbstages-1; si>=0; si-- )
+    {
+       pidip_pipe_reach( pipe, si, &rx, &ry );
+       if ( rx > apron ) apron = rx;
+       if ( ry > apron ) apron = ry;
+       pipe->p_halo[si] = pipe->p_halo[si+1] + PIPE_EVEN( ry );
+    }
+
+    rows = pipe->p_band + 2*pipe->p_halo[0];
+    for ( si=0; si<2; si++ )
+    {
+       if ( !pidip_plane_alloc( &pipe->p_strips[si].s_y, width, rows, apron ) ||
+            !pidip_plane_alloc( &pipe->p_strips[si].s_v, width>>1, rows>>1, 1 ) ||
+            !pidip_plane_alloc( &pipe->p_strips[si].s_u, width>>1, rows>>1, 1 ) )
+       {
+          pipe->p_width = 0;
+          return 0;
+       }
+    }
+    if ( !pidip_plane_alloc( &pipe->p_work, width, rows, apron ) )
+    {
+       pipe->p_width = 0;
+       return 0;
+    }
+    pipe->p_width = width;
+    pipe->p_height = height;
+    pipe->p_dirty = 0;
+    return 1;
+}
+
+// copies the border of the luminance rows y0 <= y < y1 in the apron of a strip,
+// with rows above and below when they are the first or the last ones of the frame
+static void pidip_pipe_replicate( t_pidip_strip *strip, int rx, int ry, int y0, int y1, int width, int height )
+{
+  short int *row;
+  int px, py;
+
+    for ( py=y0; py<y1; py++ )
+    {
+       row = PIDIP_STRIP_Y( strip, py );
+       for ( px=1; px<=rx; px++ )
+       {
+          row[-px] = row[0];
+          row[width-1+px] = row[width-1];
+       }
+    }
+    for ( py=1; py<=ry; py++ )
+    {
+       if ( y0 == 0 )
+       {
+          memcpy( PIDIP_STRIP_Y( strip, -py )-rx, PIDIP_STRIP_Y( strip, 0 )-rx, (width+2*rx)*sizeof(short int) );
+       }
+       if ( y1 == height )
+       {
+          memcpy( PIDIP_STRIP_Y( strip, height-1+py )-rx, PIDIP_STRIP_Y( strip, height-1 )-rx, (width+2*rx)*sizeof(short int) );
+       }
+    }
+}
+
+void pidip_pipe_yv12( t_pidip_pipe *pipe, short int *src, short int *dst, int width, int height )
+{
+  t_pidip_strip *in, *out, *tmp;
+  int r0, r1, y0, y1, py, si, rx, ry;
+  int cw = width>>1;
+  short int *srcV = PIDIP_YV12_V( src, width, height ), *srcU = PIDIP_YV12_U( src, width, height );
+  short int *dstV = PIDIP_YV12_V( dst, width, height ), *dstU = PIDIP_YV12_U( dst, width, height );
+
+    if ( !pipe->p_nbstages || !pidip_pipe_prepare( pipe, width, height ) )
+    {
+       memcpy( dst, src, ( width*height + ( (width*height)>>1 ) )*sizeof(short int) );
+       return;
+    }
+
+    for ( r0=0; r0<height; r0=r1 )
+    {
+       r1 = ( r0+pipe->p_band < height ) ? r0+pipe->p_band : height;
+
+       // load the band with its halo
+       in = &pipe->p_strips[0];
+       out = &pipe->p_strips[1];
+       y0 = ( r0-pipe->p_halo[0] > 0 ) ? r0-pipe->p_halo[0] : 0;
+       y1 = ( r1+pipe->p_halo[0] < height ) ? r1+pipe->p_halo[0] : height;
+       in->s_base = out->s_base = y0;
+       for ( py=y0; py<y1; py++ )
+       {
+          memcpy( PIDIP_STRIP_Y( in, py ), src+py*width, width*sizeof(short int) );
+       }
+       for ( py=y0; py<y1; py+=2 )
+       {
+          memcpy( PIDIP_STRIP_V( in, py ), srcV+(py>>1)*cw, cw*sizeof(short int) );
+          memcpy( PIDIP_STRIP_U( in, py ), srcU+(py>>1)*cw, cw*sizeof(short int) );
+       }
+
+       // each stage leaves out the rows only reached by itself
+       for ( si=0; si<pipe->p_nbstages; si++ )
+       {
+          pidip_pipe_reach( pipe, si, &rx, &ry );
+          if ( rx || ry ) pidip_pipe_replicate( in, rx, ry, y0, y1, width, height );
+          y0 = ( r0-pipe->p_halo[si+1] > 0 ) ? r0-pipe->p_halo[si+1] : 0;
+          y1 = ( r1+pipe->p_halo[si+1] < height ) ? r1+pipe->p_halo[si+1] : height;
+          pipe->p_ops[si]->o_run( pipe->p_states[si], in, out, width, y0, y1 );
+          tmp = in; in = out; out = tmp;
+       }
+
+       for ( py=r0; py<r1; py++ )
+       {
+          memcpy( dst+py*width, PIDIP_STRIP_Y( in, py ), width*sizeof(short int) );
+       }
+       for ( py=r0; py<r1; py+=2 )
+       {
+          memcpy( dstV+(py>>1)*cw, PIDIP_STRIP_V( in, py ), cw*sizeof(short int) );
+          memcpy( dstU+(py>>1)*cw, PIDIP_STRIP_U( in, py ), cw*sizeof(short int) );
+       }
+    }
+}
@@ -0,0 +1,158 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  planes with aligned rows and a border apron
+ *  ( see pidip_plane.h )
+ */
+
+#include "pdp.h"
+#include "pidip_pool.h"
+#include "pidip_plane.h"
+
+#define PIDIP_PLANE_ALIGNS (PIDIP_PLANE_ALIGN/sizeof(short int))   // alignment in samples
+
+static int pidip_plane_round( int n )
+{
+    return ( n + PIDIP_PLANE_ALIGNS - 1 ) & ~( PIDIP_PLANE_ALIGNS - 1 );
+}
+
+void pidip_plane_init( t_pidip_plane *plane )
+{
+    plane->p_width = 0;
+    plane->p_height = 0;
+    plane->p_apron = 0;
+    plane->p_stride = 0;
+    plane->p_data = NULL;
+    plane->p_buffer = NULL;
+    plane->p_allocated = 0;
+}
+
+void pidip_plane_free( t_pidip_plane *plane )
+{
+    pidip_pool_put( plane->p_buffer );
+    pidip_plane_init( plane );
+}
+
+int pidip_plane_alloc( t_pidip_plane *plane, int width, int height, int apron )
+{
+  int left, stride, size;
+  unsigned long base;
+
+    if ( ( width <= 0 ) || ( height <= 0 ) || ( apron < 0 ) ) return 0;
+
+    // the left apron is rounded, so that the first sample of each row is aligned
+    left = pidip_plane_round( apron );
+    stride = pidip_plane_round( left + width + apron );
+    size = ( stride * ( height + 2*apron ) ) * sizeof(short int) + PIDIP_PLANE_ALIGN;
+
+    if ( size > plane->p_allocated )
+    {
+       pidip_pool_put( plane->p_buffer );
+       plane->p_buffer = pidip_pool_get( size );
+       if ( !plane->p_buffer )
+       {
+          post( "pidip_plane : cannot allocate a plane of %dx%d", width, height );
+          plane->p_allocated = 0;
+          plane->p_data = NULL;
+          return 0;
+       }
+       plane->p_allocated = size;
+    }
+
+    base = ( (unsigned long)plane->p_buffer + PIDIP_PLANE_ALIGN - 1 ) & ~(unsigned long)( PIDIP_PLANE_ALIGN - 1 );
+    plane->p_width = width;
+    plane->p_height = height;
+    plane->p_apron = apron;
+    plane->p_stride = stride;
+    plane->p_data = (short int *)base + apron*stride + left;
+    return 1;
+}
+
+void pidip_plane_import( t_pidip_plane *plane, short int *src, int stride )
+{
+  int py;
+
+    if ( !plane->p_data ) return;
+    for ( py=0; py<plane->p_height; py++ )
+    {
+       memcpy( PIDIP_PLANE_ROW( plane, py ), src+py*stride, plane->p_width*sizeof(short int) );
+    }
+    pidip_plane_replicate( plane );
+}
+
+void pidip_plane_export( t_pidip_plane *plane, short int *dst, int stride )
+{
+  int py;
+
+    if ( !plane->p_data ) return;
+    for ( py=0; py<plane->p_height; py++ )
+    {
+       memcpy( dst+py*stride, PIDIP_PLANE_ROW( plane, py ), plane->p_width*sizeof(short int) );
+    }
+}
+
+void pidip_plane_replicate( t_pidip_plane *plane )
+{
+  int px, py, a = plane->p_apron, w = plane->p_width, h = plane->p_height;
+  short int *row;
+
+    if ( !plane->p_data || !a ) return;
+
+    // left and right, then whole rows above and below with their corners
+    for ( py=0; py<h; py++ )
+    {
+       row = PIDIP_PLANE_ROW( plane, py );
+       for ( px=1; px<=a; px++ )
+       {
+          row[-px] = row[0];
+          row[w-1+px] = row[w-1];
+       }
+    }
+    for ( py=1; py<=a; py++ )
+    {
+       memcpy( PIDIP_PLANE_ROW( plane, -py )-a, PIDIP_PLANE_ROW( plane, 0 )-a, (w+2*a)*sizeof(short int) );
+       memcpy( PIDIP_PLANE_ROW( plane, h-1+py )-a, PIDIP_PLANE_ROW( plane, h-1 )-a, (w+2*a)*sizeof(short int) );
+    }
+}
+
+void pidip_plane_border( t_pidip_plane *plane, short int value )
+{
+  int px, py, a = plane->p_apron, w = plane->p_width, h = plane->p_height;
+  short int *row;
+
+    if ( !plane->p_data || !a ) return;
+
+    for ( py=-a; py<h+a; py++ )
+    {
+       row = PIDIP_PLANE_ROW( plane, py );
+       if ( ( py < 0 ) || ( py >= h ) )
+       {
+          for ( px=-a; px<w+a; px++ ) row[px] = value;
+       }
+       else
+       {
+          for ( px=1; px<=a; px++ )
+          {
+             row[-px] = value;
+             row[w-1+px] = value;
+          }
+       }
+    }
+}
@@ -0,0 +1,223 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  pool of scratch buffers with size classes
+ *  ( see pidip_pool.h )
+ */
+
+#include "pdp.h"
+#include "pidip_pool.h"
+#include <pthread.h>
+
+#define POOL_MINSHIFT 8           // smallest class : 256 bytes
+#define POOL_NBCLASSES 46         // up to 3<<29 bytes
+#define POOL_MAGIC 0x706f6f6c      // buffer held by an effect
+#define POOL_RESIDENT 0x72657364   // buffer waiting in a list
+
+/* kept in the PIDIP_POOL_ALIGN bytes before each buffer */
+typedef struct _pool_header
+{
+  void *h_block;                  // allocated block
+  struct _pool_header *h_next;    // next resident buffer of the class
+  int h_class;
+  int h_magic;
+} t_pool_header;
+
+#define POOL_HEADER(buffer) ((t_pool_header *)((char *)(buffer)-PIDIP_POOL_ALIGN))
+
+static pthread_mutex_t pidip_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static t_pool_header *pidip_pool_lists[POOL_NBCLASSES];
+static t_pidip_pool_stats pidip_pool_counters = { 0, 0, 0, 0, 0, 0, PIDIP_POOL_LIMIT };
+
+static unsigned long pidip_pool_classsize( int c )
+{
+    if ( c&1 ) return 3UL<<( (c>>1)+POOL_MINSHIFT-1 );
+    return 1UL<<( (c>>1)+POOL_MINSHIFT );
+}
+
+static int pidip_pool_class( int size )
+{
+  int c = 0;
+
+    while ( ( c < POOL_NBCLASSES ) && ( pidip_pool_classsize( c ) < (unsigned long)size ) ) c++;
+    return c;
+}
+
+static void pidip_pool_release( t_pool_header *h )
+{
+    h->h_magic = 0;
+    freebytes( h->h_block, pidip_pool_classsize( h->h_class )+2*PIDIP_POOL_ALIGN );
+}
+
+void *pidip_pool_get( int size )
+{
+  int c;
+  t_pool_header *h;
+  void *block;
+  char *buffer;
+
+    if ( size <= 0 ) return NULL;
+    if ( ( c = pidip_pool_class( size ) ) >= POOL_NBCLASSES )
+    {
+       post( "pidip_pool : cannot allocate %d bytes", size );
+       return NULL;
+    }
+
+    pthread_mutex_lock( &pidip_pool_mutex );
+    if ( ( h = pidip_pool_lists[c] ) )
+    {
+       pidip_pool_lists[c] = h->h_next;
+       pidip_pool_counters.s_resident -= pidip_pool_classsize( c );
+       pidip_pool_counters.s_hits++;
+       h->h_magic = POOL_MAGIC;
+    }
+    else
+    {
+       pidip_pool_counters.s_misses++;
+    }
+    pidip_pool_counters.s_used += pidip_pool_classsize( c );
+    if ( pidip_pool_counters.s_used > pidip_pool_counters.s_peak )
+    {
+       pidip_pool_counters.s_peak = pidip_pool_counters.s_used;
+    }
+    pthread_mutex_unlock( &pidip_pool_mutex );
+
+    if ( h )
+    {
+       h->h_next = NULL;
+       buffer = (char *)h+PIDIP_POOL_ALIGN;
+       memset( buffer, 0x0, size );
+       return buffer;
+    }
+
+    // getbytes clears the block, the buffer starts aligned after room for the header
+    if ( !( block = getbytes( pidip_pool_classsize( c )+2*PIDIP_POOL_ALIGN ) ) )
+    {
+       post( "pidip_pool : cannot allocate %d bytes", size );
+       pthread_mutex_lock( &pidip_pool_mutex );
+       pidip_pool_counters.s_used -= pidip_pool_classsize( c );
+       pthread_mutex_unlock( &pidip_pool_mutex );
+       return NULL;
+    }
+    buffer = (char *)( ( (unsigned long)block + 2*PIDIP_POOL_ALIGN - 1 ) & ~(unsigned long)( PIDIP_POOL_ALIGN - 1 ) );
+    h = POOL_HEADER( buffer );
+    h->h_block = block;
+    h->h_next = NULL;
+    h->h_class = c;
+    h->h_magic = POOL_MAGIC;
+    return buffer;
+}
+
+void pidip_pool_put( void *buffer )
+{
+  t_pool_header *h;
+  unsigned long size;
+
+    if ( !buffer ) return;
+    h = POOL_HEADER( buffer );
+    if ( h->h_magic == POOL_RESIDENT )
+    {
+       post( "pidip_pool : error : %p given back twice", buffer );
+       return;
+    }
+    if ( h->h_magic != POOL_MAGIC )
+    {
+       post( "pidip_pool : error : %p was not taken from the pool", buffer );
+       return;
+    }
+    size = pidip_pool_classsize( h->h_class );
+
+    pthread_mutex_lock( &pidip_pool_mutex );
+    pidip_pool_counters.s_used -= size;
+    if ( pidip_pool_counters.s_resident + size <= pidip_pool_counters.s_limit )
+    {
+       h->h_magic = POOL_RESIDENT;
+       h->h_next = pidip_pool_lists[h->h_class];
+       pidip_pool_lists[h->h_class] = h;
+       pidip_pool_counters.s_resident += size;
+       h = NULL;
+    }
+    else
+    {
+       pidip_pool_counters.s_released++;
+    }
+    pthread_mutex_unlock( &pidip_pool_mutex );
+
+    if ( h ) pidip_pool_release( h );
+}
+
+void *pidip_pool_resize( void *buffer, int size )
+{
+    if ( buffer && ( size > 0 ) && ( POOL_HEADER( buffer )->h_magic == POOL_MAGIC )
+         && ( POOL_HEADER( buffer )->h_class == pidip_pool_class( size ) ) )
+    {
+       memset( buffer, 0x0, size );
+       return buffer;
+    }
+    pidip_pool_put( buffer );
+    return pidip_pool_get( size );
+}
+
+// frees resident buffers, largest classes first, until 'bytes' are left
+static void pidip_pool_shrink( unsigned long bytes )
+{
+  t_pool_header *h, *released = NULL;
+  int c;
+
+    pthread_mutex_lock( &pidip_pool_mutex );
+    for ( c=POOL_NBCLASSES-1; ( c>=0 ) && ( pidip_pool_counters.s_resident > bytes ); c-- )
+    {
+       while ( ( h = pidip_pool_lists[c] ) && ( pidip_pool_counters.s_resident > bytes ) )
+       {
+          pidip_pool_lists[c] = h->h_next;
+          pidip_pool_counters.s_resident -= pidip_pool_classsize( c );
+          pidip_pool_counters.s_released++;
+          h->h_next = released;
+          released = h;
+       }
+    }
+    pthread_mutex_unlock( &pidip_pool_mutex );
+
+    while ( ( h = released ) )
+    {
+       released = h->h_next;
+       pidip_pool_release( h );
+    }
+}
+
+void pidip_pool_trim( void )
+{
+    pidip_pool_shrink( 0 );
+}
+
+void pidip_pool_limit( unsigned long bytes )
+{
+    pthread_mutex_lock( &pidip_pool_mutex );
+    pidip_pool_counters.s_limit = bytes;
+    pthread_mutex_unlock( &pidip_pool_mutex );
+    pidip_pool_shrink( bytes );
+}
+
+void pidip_pool_stats( t_pidip_pool_stats *stats )
+{
+    pthread_mutex_lock( &pidip_pool_mutex );
+    *stats = pidip_pool_counters;
+    pthread_mutex_unlock( &pidip_pool_mutex );
+}
@@ -0,0 +1,189 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  processing time and drops of each object
+ *  ( see pidip_profile.h )
+ */
+
+#include <time.h>
+#include "pdp.h"
+#include "pidip_profile.h"
+
+static t_pidip_profile *pidip_profile_list = NULL;
+static int pidip_profile_nbinstances = 0;
+static double pidip_profile_start = 0.;
+
+static double pidip_profile_now( clockid_t clock )
+{
+  struct timespec ts;
+
+    clock_gettime( clock, &ts );
+    return ts.tv_sec*1000000. + ts.tv_nsec/1000.;
+}
+
+static t_pidip_profile *pidip_profile_find( void *owner, int create )
+{
+  t_pidip_profile *p;
+
+    for ( p=pidip_profile_list; p; p=p->p_next )
+    {
+       if ( p->p_owner == owner ) return p;
+    }
+    if ( !create ) return NULL;
+
+    p = (t_pidip_profile *) getbytes( sizeof(t_pidip_profile) );
+    if ( !p ) return NULL;
+    memset( p, 0x0, sizeof(t_pidip_profile) );
+    p->p_owner = owner;
+    p->p_instance = pidip_profile_nbinstances++;
+    if ( !pidip_profile_list ) pidip_profile_start = pidip_profile_now( CLOCK_MONOTONIC );
+    p->p_next = pidip_profile_list;
+    pidip_profile_list = p;
+    return p;
+}
+
+/* runs in the process thread */
+static void pidip_profile_process( t_pidip_profile_job *job )
+{
+  t_pidip_profile *p = job->j_profile;
+  double start, cpu, wait;
+
+    if ( p->p_reseen != p->p_reset )
+    {
+       p->p_nbprocessed = 0;
+       p->p_wall = p->p_wallmax = 0.;
+       p->p_cpu = 0.;
+       p->p_wait = p->p_waitmax = 0.;
+       p->p_reseen = p->p_reset;
+    }
+
+    start = pidip_profile_now( CLOCK_MONOTONIC );
+    cpu = pidip_profile_now( CLOCK_THREAD_CPUTIME_ID );
+    wait = start - job->j_queued;
+
+    job->j_process( p->p_owner );
+
+    cpu = pidip_profile_now( CLOCK_THREAD_CPUTIME_ID ) - cpu;
+    start = pidip_profile_now( CLOCK_MONOTONIC ) - start;
+    p->p_wall += start;
+    if ( start > p->p_wallmax ) p->p_wallmax = start;
+    p->p_cpu += cpu;
+    p->p_wait += wait;
+    if ( wait > p->p_waitmax ) p->p_waitmax = wait;
+    p->p_nbprocessed++;
+}
+
+/* runs in the pd thread */
+static void pidip_profile_callback( t_pidip_profile_job *job )
+{
+    job->j_callback( job->j_profile->p_owner );
+}
+
+void pidip_queue_add( void *owner, void *process, void *callback, int *queue_id )
+{
+  t_pidip_profile *p = pidip_profile_find( owner, 1 );
+  t_pidip_profile_job *job;
+
+    if ( !p )
+    {
+       pdp_queue_add( owner, process, callback, queue_id );
+       return;
+    }
+    // the slots are reused in turn, older jobs are done by then
+    job = &p->p_jobs[p->p_nextjob++%PIDIP_PROFILE_JOBS];
+    job->j_profile = p;
+    job->j_process = (void (*)(void *))process;
+    job->j_callback = (void (*)(void *))callback;
+    job->j_queued = pidip_profile_now( CLOCK_MONOTONIC );
+    p->p_nbqueued++;
+    pdp_queue_add( job, pidip_profile_process, pidip_profile_callback, queue_id );
+}
+
+void pidip_process_inline( void *owner, void *process )
+{
+  t_pidip_profile *p = pidip_profile_find( owner, 1 );
+  t_pidip_profile_job job;
+
+    if ( !p )
+    {
+       ((void (*)(void *))process)( owner );
+       return;
+    }
+    job.j_profile = p;
+    job.j_process = (void (*)(void *))process;
+    job.j_callback = NULL;
+    job.j_queued = pidip_profile_now( CLOCK_MONOTONIC );
+    p->p_nbqueued++;
+    pidip_profile_process( &job );
+}
+
+int pidip_convert_ro_or_drop( void *owner, int *dst, int src, t_pdp_symbol *type )
+{
+  t_pidip_profile *p;
+  int dropped = pdp_packet_convert_ro_or_drop( dst, src, type );
+
+    if ( dropped && ( p = pidip_profile_find( owner, 1 ) ) ) p->p_nbdropped++;
+    return dropped;
+}
+
+void pidip_queue_release( void *owner, int queue_id )
+{
+  t_pidip_profile *p, **pp;
+
+    pdp_queue_finish( queue_id );
+    for ( pp=&pidip_profile_list; ( p = *pp ); pp=&p->p_next )
+    {
+       if ( p->p_owner == owner )
+       {
+          *pp = p->p_next;
+          freebytes( p, sizeof(t_pidip_profile) );
+          return;
+       }
+    }
+}
+
+t_pidip_profile *pidip_profile_first( void )
+{
+    return pidip_profile_list;
+}
+
+char *pidip_profile_name( t_pidip_profile *p )
+{
+    return (char *)class_getname( *(t_pd *)p->p_owner );
+}
+
+void pidip_profile_reset( void )
+{
+  t_pidip_profile *p;
+
+    for ( p=pidip_profile_list; p; p=p->p_next )
+    {
+       p->p_nbqueued = 0;
+       p->p_nbdropped = 0;
+       p->p_reset++;
+    }
+    pidip_profile_start = pidip_profile_now( CLOCK_MONOTONIC );
+}
+
+double pidip_profile_elapsed( void )
+{
+    return pidip_profile_now( CLOCK_MONOTONIC ) - pidip_profile_start;
+}
@@ -0,0 +1,339 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  precomputed coordinate maps and their cache
+ *  ( see pidip_remap.h )
+ */
+
+#include "pdp.h"
+#include "pidip_remap.h"
+
+void pidip_remap_init( t_pidip_remap *map )
+{
+    map->m_width = 0;
+    map->m_height = 0;
+    map->m_interpolate = PIDIP_REMAP_NEAREST;
+    map->m_x0 = map->m_y0 = map->m_x1 = map->m_y1 = 0;
+    map->m_allocated = 0;
+    map->m_offset = NULL;
+    map->m_frac = NULL;
+    map->m_coffset = NULL;
+    map->m_cfrac = NULL;
+    map->m_nbkeys = -1;
+    map->m_used = 0;
+}
+
+void pidip_remap_free( t_pidip_remap *map )
+{
+  int size = map->m_allocated;
+
+    if ( map->m_offset ) freebytes( map->m_offset, size*sizeof(int) );
+    if ( map->m_frac ) freebytes( map->m_frac, size*sizeof(unsigned short) );
+    if ( map->m_coffset ) freebytes( map->m_coffset, (size>>2)*sizeof(int) );
+    if ( map->m_cfrac ) freebytes( map->m_cfrac, (size>>2)*sizeof(unsigned short) );
+    pidip_remap_init( map );
+}
+
+static int pidip_remap_allocate( t_pidip_remap *map, int width, int height )
+{
+  int size = width*height;
+
+    if ( size > map->m_allocated )
+    {
+       pidip_remap_free( map );
+       map->m_offset = (int *) getbytes( size*sizeof(int) );
+       map->m_frac = (unsigned short *) getbytes( size*sizeof(unsigned short) );
+       map->m_coffset = (int *) getbytes( (size>>2)*sizeof(int) );
+       map->m_cfrac = (unsigned short *) getbytes( (size>>2)*sizeof(unsigned short) );
+       map->m_allocated = size;
+       if ( !map->m_offset || !map->m_frac || !map->m_coffset || !map->m_cfrac )
+       {
+          post( "pidip_remap : cannot allocate map" );
+          pidip_remap_free( map );
+          return 0;
+       }
+    }
+    map->m_width = width;
+    map->m_height = height;
+    pidip_remap_region( map, 0, 0, width, height );
+    return 1;
+}
+
+void pidip_remap_region( t_pidip_remap *map, int x0, int y0, int x1, int y1 )
+{
+    // even bounds, so that chrominance cells are fully inside or outside
+    x0 &= ~1; y0 &= ~1;
+    x1 = (x1+1)&~1; y1 = (y1+1)&~1;
+    if ( x0 < 0 ) x0 = 0;
+    if ( y0 < 0 ) y0 = 0;
+    if ( x1 > map->m_width ) x1 = map->m_width;
+    if ( y1 > map->m_height ) y1 = map->m_height;
+    if ( x1 < x0 ) x1 = x0;
+    if ( y1 < y0 ) y1 = y0;
+    map->m_x0 = x0;
+    map->m_y0 = y0;
+    map->m_x1 = x1;
+    map->m_y1 = y1;
+}
+
+/* clamp a source position to a plane, keeping the 2x2 block
+   read by the bilinear sampling inside the plane */
+static void pidip_remap_locate( int interpolate, int sx, int sy, int width, int height,
+                                int *offset, unsigned short *frac )
+{
+  int ix, iy, fx, fy;
+
+    if ( sx < 0 ) sx = 0;
+    if ( sy < 0 ) sy = 0;
+    if ( sx > (width-1)*PIDIP_REMAP_ONE ) sx = (width-1)*PIDIP_REMAP_ONE;
+    if ( sy > (height-1)*PIDIP_REMAP_ONE ) sy = (height-1)*PIDIP_REMAP_ONE;
+
+    if ( interpolate == PIDIP_REMAP_BILINEAR )
+    {
+       ix = sx/PIDIP_REMAP_ONE; fx = sx%PIDIP_REMAP_ONE;
+       iy = sy/PIDIP_REMAP_ONE; fy = sy%PIDIP_REMAP_ONE;
+       if ( ix > width-2 ) { ix = width-2; fx = PIDIP_REMAP_ONE; }
+       if ( iy > height-2 ) { iy = height-2; fy = PIDIP_REMAP_ONE; }
+       if ( ix < 0 ) { ix = 0; fx = 0; }
+       if ( iy < 0 ) { iy = 0; fy = 0; }
+    }
+    else
+    {
+       ix = sx/PIDIP_REMAP_ONE; fx = 0;
+       iy = sy/PIDIP_REMAP_ONE; fy = 0;
+    }
+    *offset = iy*width+ix;
+    *frac = fx | (fy<<8);
+}
+
+void pidip_remap_point( t_pidip_remap *map, int px, int py, int sx, int sy )
+{
+  int i;
+
+    if ( ( px < map->m_x0 ) || ( px >= map->m_x1 ) ||
+         ( py < map->m_y0 ) || ( py >= map->m_y1 ) ) return;
+
+    i = py*map->m_width+px;
+    pidip_remap_locate( map->m_interpolate, sx, sy, map->m_width, map->m_height,
+                        &map->m_offset[i], &map->m_frac[i] );
+
+    // the top left pixel of a 2x2 block gives the chrominance,
+    // nearest sampling truncates so that mirrored maps stay exact
+    if ( !( (px|py)&1 ) )
+    {
+       i = (py>>1)*(map->m_width>>1)+(px>>1);
+       pidip_remap_locate( map->m_interpolate, sx>>1, sy>>1, map->m_width>>1, map->m_height>>1,
+                           &map->m_coffset[i], &map->m_cfrac[i] );
+    }
+}
+
+static inline short int pidip_remap_bilinear( short int *s, int o, int f, int width )
+{
+  int fx = f&0xff, fy = f>>8;
+  int top, bottom;
+
+    top = s[o]*(PIDIP_REMAP_ONE-fx) + s[o+1]*fx;
+    bottom = s[o+width]*(PIDIP_REMAP_ONE-fx) + s[o+width+1]*fx;
+    return ( top*(PIDIP_REMAP_ONE-fy) + bottom*fy ) >> 8;
+}
+
+void pidip_remap_apply( t_pidip_remap *map, short int *src, short int *dst )
+{
+  int width = map->m_width, height = map->m_height;
+  int cwidth = width>>1;
+  int vsize = width*height;
+  int x0 = map->m_x0, x1 = map->m_x1;
+  int cx0 = x0>>1, cx1 = x1>>1;
+  int px, py, row, crow;
+  int *offset, *coffset;
+  unsigned short *frac, *cfrac;
+  short int *sY = src, *sV = src+vsize, *sU = src+vsize+(vsize>>2);
+  short int *dY = dst, *dV = dst+vsize, *dU = dst+vsize+(vsize>>2);
+
+    for ( py=0; py<height; py++ )
+    {
+       row = py*width;
+       crow = (py>>1)*cwidth;
+
+       if ( ( py < map->m_y0 ) || ( py >= map->m_y1 ) )
+       {
+          memcpy( dY+row, sY+row, width*sizeof(short int) );
+          if ( !(py&1) )
+          {
+             memcpy( dV+crow, sV+crow, cwidth*sizeof(short int) );
+             memcpy( dU+crow, sU+crow, cwidth*sizeof(short int) );
+          }
+          continue;
+       }
+
+       // outside of the region on this row
+       memcpy( dY+row, sY+row, x0*sizeof(short int) );
+       memcpy( dY+row+x1, sY+row+x1, (width-x1)*sizeof(short int) );
+
+       offset = map->m_offset+row;
+       frac = map->m_frac+row;
+       if ( map->m_interpolate == PIDIP_REMAP_BILINEAR )
+       {
+          for ( px=x0; px<x1; px++ )
+          {
+             dY[row+px] = pidip_remap_bilinear( sY, offset[px], frac[px], width );
+          }
+       }
+       else
+       {
+          for ( px=x0; px<x1; px++ )
+          {
+             dY[row+px] = sY[offset[px]];
+          }
+       }
+
+       if ( py&1 ) continue;
+
+       // both chrominance planes share the same cells
+       memcpy( dV+crow, sV+crow, cx0*sizeof(short int) );
+       memcpy( dV+crow+cx1, sV+crow+cx1, (cwidth-cx1)*sizeof(short int) );
+       memcpy( dU+crow, sU+crow, cx0*sizeof(short int) );
+       memcpy( dU+crow+cx1, sU+crow+cx1, (cwidth-cx1)*sizeof(short int) );
+
+       coffset = map->m_coffset+crow;
+       cfrac = map->m_cfrac+crow;
+       if ( map->m_interpolate == PIDIP_REMAP_BILINEAR )
+       {
+          for ( px=cx0; px<cx1; px++ )
+          {
+             dV[crow+px] = pidip_remap_bilinear( sV, coffset[px], cfrac[px], cwidth );
+             dU[crow+px] = pidip_remap_bilinear( sU, coffset[px], cfrac[px], cwidth );
+          }
+       }
+       else
+       {
+          for ( px=cx0; px<cx1; px++ )
+          {
+             dV[crow+px] = sV[coffset[px]];
+             dU[crow+px] = sU[coffset[px]];
+          }
+       }
+    }
+}
+
+void pidip_remap_pixel_bilinear( short int *src, short int *dst, int width, int height,
+                                 int px, int py, int sx, int sy )
+{
+  int o, i, cwidth = width>>1, vsize = width*height;
+  unsigned short f;
+
+    pidip_remap_locate( PIDIP_REMAP_BILINEAR, sx, sy, width, height, &o, &f );
+    dst[py*width+px] = pidip_remap_bilinear( src, o, f, width );
+
+    if ( (px|py)&1 ) return;
+    pidip_remap_locate( PIDIP_REMAP_BILINEAR, sx>>1, sy>>1, cwidth, height>>1, &o, &f );
+    i = vsize+(py>>1)*cwidth+(px>>1);
+    src += vsize;
+    dst[i] = pidip_remap_bilinear( src, o, f, cwidth );
+    dst[i+(vsize>>2)] = pidip_remap_bilinear( src+(vsize>>2), o, f, cwidth );
+}
+
+void pidip_remapcache_init( t_pidip_remapcache *cache, int nbmaps )
+{
+  int i;
+
+    if ( nbmaps < 1 ) nbmaps = 1;
+    cache->c_nbmaps = nbmaps;
+    cache->c_clock = 0;
+    cache->c_nblast = -1;
+    cache->c_maps = (t_pidip_remap *) getbytes( nbmaps*sizeof(t_pidip_remap) );
+    for ( i=0; i<nbmaps; i++ ) pidip_remap_init( &cache->c_maps[i] );
+}
+
+void pidip_remapcache_free( t_pidip_remapcache *cache )
+{
+  int i;
+
+    if ( !cache->c_maps ) return;
+    for ( i=0; i<cache->c_nbmaps; i++ ) pidip_remap_free( &cache->c_maps[i] );
+    freebytes( cache->c_maps, cache->c_nbmaps*sizeof(t_pidip_remap) );
+    cache->c_maps = NULL;
+    cache->c_nbmaps = 0;
+}
+
+t_pidip_remap *pidip_remapcache_get( t_pidip_remapcache *cache, int width, int height,
+                                     int interpolate, int *key, int nbkeys, int *build )
+{
+  int i;
+  t_pidip_remap *map, *oldest = NULL;
+
+    *build = 0;
+    if ( !cache->c_maps ) return NULL;
+    if ( nbkeys > PIDIP_REMAP_KEYSIZE ) nbkeys = PIDIP_REMAP_KEYSIZE;
+    cache->c_clock++;
+
+    for ( i=0; i<cache->c_nbmaps; i++ )
+    {
+       map = &cache->c_maps[i];
+       if ( ( map->m_width == width ) && ( map->m_height == height ) &&
+            ( map->m_interpolate == interpolate ) && ( map->m_nbkeys == nbkeys ) &&
+            !memcmp( map->m_key, key, nbkeys*sizeof(int) ) )
+       {
+          map->m_used = cache->c_clock;
+          return map;
+       }
+       if ( !oldest || ( map->m_used < oldest->m_used ) ) oldest = map;
+    }
+
+    // the least recently used map is rebuilt
+    map = oldest;
+    map->m_nbkeys = -1;
+    if ( !pidip_remap_allocate( map, width, height ) ) return NULL;
+    map->m_interpolate = interpolate;
+    map->m_nbkeys = nbkeys;
+    memcpy( map->m_key, key, nbkeys*sizeof(int) );
+    map->m_used = cache->c_clock;
+    *build = 1;
+    return map;
+}
+
+t_pidip_remap *pidip_remapcache_steady( t_pidip_remapcache *cache, int width, int height,
+                                        int interpolate, int *key, int nbkeys, int *build )
+{
+  int i, changed;
+  t_pidip_remap *map;
+
+    *build = 0;
+    if ( nbkeys > PIDIP_REMAP_KEYSIZE ) nbkeys = PIDIP_REMAP_KEYSIZE;
+    changed = ( cache->c_nblast != nbkeys ) || memcmp( cache->c_lastkey, key, nbkeys*sizeof(int) );
+    cache->c_nblast = nbkeys;
+    memcpy( cache->c_lastkey, key, nbkeys*sizeof(int) );
+    if ( !changed ) return pidip_remapcache_get( cache, width, height, interpolate, key, nbkeys, build );
+
+    // animated parameters : a map that is already there is still used,
+    // but building one for a single frame costs more than remapping directly
+    for ( i=0; i<cache->c_nbmaps; i++ )
+    {
+       map = &cache->c_maps[i];
+       if ( ( map->m_width == width ) && ( map->m_height == height ) &&
+            ( map->m_interpolate == interpolate ) && ( map->m_nbkeys == nbkeys ) &&
+            !memcmp( map->m_key, key, nbkeys*sizeof(int) ) )
+       {
+          map->m_used = ++cache->c_clock;
+          return map;
+       }
+    }
+    return NULL;
+}
@@ -0,0 +1,136 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  regions of interest passed along with packets
+ *  ( see pidip_roi.h )
+ */
+
+#include "pdp.h"
+#include "pidip_roi.h"
+
+typedef struct _pidip_roipass
+{
+  int p_packet;
+  t_pidip_roi p_roi;
+} t_pidip_roipass;
+
+/* packets being passed with a region, the innermost pass last */
+static t_pidip_roipass pidip_roi_passes[PIDIP_ROI_MAXPASSES];
+static int pidip_roi_nbpasses = 0;
+
+void pidip_roi_set( t_pidip_roi *roi, int x0, int y0, int x1, int y1, int width, int height )
+{
+  int t;
+
+    if ( x0 > x1 ) { t = x0; x0 = x1; x1 = t; }
+    if ( y0 > y1 ) { t = y0; y0 = y1; y1 = t; }
+    if ( x0 < 0 ) x0 = 0;
+    if ( y0 < 0 ) y0 = 0;
+    if ( x1 > width ) x1 = width;
+    if ( y1 > height ) y1 = height;
+
+    // whole chrominance cells
+    x0 &= ~1; y0 &= ~1;
+    x1 = ( x1 + 1 ) & ~1; y1 = ( y1 + 1 ) & ~1;
+    if ( x1 > width ) x1 = width & ~1;
+    if ( y1 > height ) y1 = height & ~1;
+
+    roi->r_stride = width;
+    if ( ( x1 <= x0 ) || ( y1 <= y0 ) )
+    {
+       // nothing left, keep an empty rectangle rather than the whole frame
+       roi->r_x = x0; roi->r_y = y0;
+       roi->r_width = 0; roi->r_height = -1;
+       return;
+    }
+    roi->r_x = x0;
+    roi->r_y = y0;
+    roi->r_width = x1 - x0;
+    roi->r_height = y1 - y0;
+}
+
+void pidip_roi_clear( t_pidip_roi *roi )
+{
+    roi->r_x = roi->r_y = 0;
+    roi->r_width = roi->r_height = 0;
+    roi->r_stride = 0;
+}
+
+int pidip_roi_whole( t_pidip_roi *roi )
+{
+    return ( ( roi->r_width == 0 ) && ( roi->r_height == 0 ) );
+}
+
+void pidip_roi_pass( t_outlet *outlet, int *packet, t_pidip_roi *roi )
+{
+    if ( !roi || pidip_roi_whole( roi ) || ( *packet == -1 ) )
+    {
+       pdp_packet_pass_if_valid( outlet, packet );
+       return;
+    }
+    if ( pidip_roi_nbpasses >= PIDIP_ROI_MAXPASSES )
+    {
+       post( "pidip_roi : too many nested passes, region lost" );
+       pdp_packet_pass_if_valid( outlet, packet );
+       return;
+    }
+
+    pidip_roi_passes[pidip_roi_nbpasses].p_packet = *packet;
+    pidip_roi_passes[pidip_roi_nbpasses].p_roi = *roi;
+    pidip_roi_nbpasses++;
+    pdp_packet_pass_if_valid( outlet, packet );
+    pidip_roi_nbpasses--;
+}
+
+int pidip_roi_get( int packet, t_pidip_roi *roi )
+{
+  int i;
+
+    for ( i=pidip_roi_nbpasses-1; i>=0; i-- )
+    {
+       if ( pidip_roi_passes[i].p_packet == packet )
+       {
+          *roi = pidip_roi_passes[i].p_roi;
+          return 1;
+       }
+    }
+    pidip_roi_clear( roi );
+    return 0;
+}
+
+int pidip_roi_clip( t_pidip_roi *roi, int width, int height, int *x0, int *y0, int *x1, int *y1 )
+{
+  int rx0 = 0, ry0 = 0, rx1 = width, ry1 = height;
+
+    // a region of a frame of another size does not apply
+    if ( !pidip_roi_whole( roi ) && ( roi->r_stride == width ) )
+    {
+       rx0 = roi->r_x;
+       ry0 = roi->r_y;
+       rx1 = roi->r_x + roi->r_width;
+       ry1 = roi->r_y + roi->r_height;
+    }
+    if ( *x0 < rx0 ) *x0 = rx0;
+    if ( *y0 < ry0 ) *y0 = ry0;
+    if ( *x1 > rx1 ) *x1 = rx1;
+    if ( *y1 > ry1 ) *y1 = ry1;
+
+    return ( ( *x0 < *x1 ) && ( *y0 < *y1 ) );
+}
@@ -0,0 +1,348 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  frame sources with a prefetching thread and a cache of decoded frames
+ *  ( see pidip_source.h )
+ */
+
+#include "pdp.h"
+#include "pidip_source.h"
+
+static t_pidip_source_backend *pidip_source_backends[PIDIP_SOURCE_MAXBACKENDS];
+static int pidip_source_nbbackends = -1;
+
+static void pidip_source_builtins( void )
+{
+    if ( pidip_source_nbbackends >= 0 ) return;
+    pidip_source_nbbackends = 0;
+    pidip_source_register( &pidip_source_clip );
+    pidip_source_register( &pidip_source_quicktime );
+}
+
+void pidip_source_register( t_pidip_source_backend *backend )
+{
+  int i;
+
+    pidip_source_builtins();
+    for ( i=0; i<pidip_source_nbbackends; i++ )
+    {
+       if ( pidip_source_backends[i] == backend ) return;
+    }
+    if ( pidip_source_nbbackends >= PIDIP_SOURCE_MAXBACKENDS )
+    {
+       post( "pidip_source : too many backends : %s ignored", backend->b_name );
+       return;
+    }
+    pidip_source_backends[pidip_source_nbbackends++] = backend;
+}
+
+void pidip_source_init( t_pidip_source *src )
+{
+    src->s_backend = NULL;
+    src->s_handle = NULL;
+    src->s_cache = NULL;
+    src->s_cachesize = 0;
+    src->s_loop = 0;
+    src->s_running = 0;
+    pthread_mutex_init( &src->s_mutex, NULL );
+    pthread_mutex_init( &src->s_decoder, NULL );
+    pthread_cond_init( &src->s_cond, NULL );
+}
+
+void pidip_source_free( t_pidip_source *src )
+{
+    pidip_source_close( src );
+    pthread_mutex_destroy( &src->s_mutex );
+    pthread_mutex_destroy( &src->s_decoder );
+    pthread_cond_destroy( &src->s_cond );
+}
+
+/* the functions below are called with s_mutex locked */
+
+static t_pidip_sourceframe *pidip_source_find( t_pidip_source *src, int frame )
+{
+  int i;
+
+    for ( i=0; i<src->s_cachesize; i++ )
+    {
+       if ( src->s_cache[i].f_frame == frame ) return &src->s_cache[i];
+    }
+    return NULL;
+}
+
+/* the n-th frame after the current one in the play direction, -1 past the ends */
+static int pidip_source_ahead( t_pidip_source *src, int n )
+{
+  int frame = src->s_current + n*src->s_direction;
+  int nbframes = src->s_info.i_nbframes;
+
+    if ( src->s_loop ) return ( ( frame % nbframes ) + nbframes ) % nbframes;
+    if ( ( frame < 0 ) || ( frame >= nbframes ) ) return -1;
+    return frame;
+}
+
+static int pidip_source_inwindow( t_pidip_source *src, int frame )
+{
+  int i;
+
+    for ( i=0; i<=src->s_prefetch; i++ )
+    {
+       if ( pidip_source_ahead( src, i ) == frame ) return 1;
+    }
+    return 0;
+}
+
+/* an empty frame or the least recently used one out of the prefetch window */
+static t_pidip_sourceframe *pidip_source_victim( t_pidip_source *src )
+{
+  int i;
+  t_pidip_sourceframe *f, *victim = NULL;
+
+    for ( i=0; i<src->s_cachesize; i++ )
+    {
+       f = &src->s_cache[i];
+       if ( f->f_busy ) continue;
+       if ( f->f_frame < 0 ) return f;
+       if ( pidip_source_inwindow( src, f->f_frame ) ) continue;
+       if ( !victim || ( f->f_used < victim->f_used ) ) victim = f;
+    }
+    return victim;
+}
+
+/* the cache is unlocked while the backend decodes */
+static int pidip_source_decode( t_pidip_source *src, t_pidip_sourceframe *f, int frame )
+{
+  int ok;
+
+    if ( !f->f_data && !( f->f_data = (short int *) getbytes( src->s_framesize ) ) )
+    {
+       post( "pidip_source : cannot allocate frame" );
+       return 0;
+    }
+    f->f_frame = frame;
+    f->f_busy = 1;
+    pthread_mutex_unlock( &src->s_mutex );
+
+    pthread_mutex_lock( &src->s_decoder );
+    ok = src->s_backend->b_decode( src->s_handle, frame, f->f_data );
+    pthread_mutex_unlock( &src->s_decoder );
+
+    pthread_mutex_lock( &src->s_mutex );
+    f->f_busy = 0;
+    f->f_used = ++src->s_clock;
+    if ( !ok ) f->f_frame = -1;
+    pthread_cond_broadcast( &src->s_cond );
+    return ok;
+}
+
+static void *pidip_source_prefetcher( void *tdata )
+{
+  t_pidip_source *src = (t_pidip_source *) tdata;
+  t_pidip_sourceframe *f;
+  int i, frame, failed = -1;
+
+    pthread_mutex_lock( &src->s_mutex );
+    while ( src->s_running )
+    {
+       frame = -1;
+       for ( i=1; i<=src->s_prefetch; i++ )
+       {
+          frame = pidip_source_ahead( src, i );
+          if ( ( frame < 0 ) || ( frame == failed ) ) { frame = -1; break; }
+          if ( !pidip_source_find( src, frame ) ) break;
+          frame = -1;
+       }
+       if ( ( frame < 0 ) || !( f = pidip_source_victim( src ) ) )
+       {
+          pthread_cond_wait( &src->s_cond, &src->s_mutex );
+          failed = -1;
+          continue;
+       }
+       if ( !pidip_source_decode( src, f, frame ) ) failed = frame;
+    }
+    pthread_mutex_unlock( &src->s_mutex );
+
+    return NULL;
+}
+
+int pidip_source_open( t_pidip_source *src, char *filename, int cachesize, int prefetch )
+{
+  int i, nbframes;
+
+    pidip_source_close( src );
+    pidip_source_builtins();
+
+    for ( i=0; i<pidip_source_nbbackends; i++ )
+    {
+       if ( ( src->s_handle = pidip_source_backends[i]->b_open( filename, &src->s_info ) ) ) break;
+    }
+    if ( !src->s_handle )
+    {
+       post( "pidip_source : cannot open %s", filename );
+       return 0;
+    }
+    src->s_backend = pidip_source_backends[i];
+    nbframes = src->s_info.i_nbframes;
+    if ( nbframes <= 0 )
+    {
+       post( "pidip_source : %s has no frames", filename );
+       src->s_backend->b_close( src->s_handle );
+       src->s_backend = NULL;
+       src->s_handle = NULL;
+       return 0;
+    }
+
+    // the prefetch window and two frames being decoded must fit in the cache
+    if ( prefetch >= nbframes ) prefetch = nbframes-1;
+    if ( prefetch < 0 ) prefetch = 0;
+    if ( ( cachesize <= 0 ) || ( cachesize > nbframes ) ) cachesize = nbframes;
+    if ( cachesize < prefetch+3 ) cachesize = ( prefetch+3 < nbframes ) ? prefetch+3 : nbframes;
+
+    src->s_framesize = ( src->s_info.i_width*src->s_info.i_height*3/2 )*sizeof(short int);
+    src->s_cache = (t_pidip_sourceframe *) getbytes( cachesize*sizeof(t_pidip_sourceframe) );
+    for ( i=0; i<cachesize; i++ )
+    {
+       src->s_cache[i].f_frame = -1;
+       src->s_cache[i].f_busy = 0;
+       src->s_cache[i].f_used = 0;
+       src->s_cache[i].f_data = NULL;
+    }
+    src->s_cachesize = cachesize;
+    src->s_prefetch = prefetch;
+    src->s_clock = 0;
+    src->s_current = 0;
+    src->s_direction = 1;
+
+    src->s_running = 1;
+    if ( pthread_create( &src->s_thread, NULL, pidip_source_prefetcher, src ) != 0 )
+    {
+       post( "pidip_source : could not launch prefetch thread" );
+       src->s_running = 0;
+    }
+
+    post( "pidip_source : %s : %s : %dx%d : %d frames at %.2f fps",
+          src->s_backend->b_name, filename, src->s_info.i_width, src->s_info.i_height,
+          nbframes, src->s_info.i_framerate );
+    return 1;
+}
+
+void pidip_source_close( t_pidip_source *src )
+{
+  int i;
+  void *dummy;
+
+    if ( !src->s_backend ) return;
+
+    if ( src->s_running )
+    {
+       pthread_mutex_lock( &src->s_mutex );
+       src->s_running = 0;
+       pthread_cond_broadcast( &src->s_cond );
+       pthread_mutex_unlock( &src->s_mutex );
+       pthread_join( src->s_thread, &dummy );
+    }
+
+    src->s_backend->b_close( src->s_handle );
+    for ( i=0; i<src->s_cachesize; i++ )
+    {
+       if ( src->s_cache[i].f_data ) freebytes( src->s_cache[i].f_data, src->s_framesize );
+    }
+    if ( src->s_cache ) freebytes( src->s_cache, src->s_cachesize*sizeof(t_pidip_sourceframe) );
+    src->s_cache = NULL;
+    src->s_cachesize = 0;
+    src->s_backend = NULL;
+    src->s_handle = NULL;
+}
+
+int pidip_source_opened( t_pidip_source *src )
+{
+    return ( src->s_backend != NULL );
+}
+
+void pidip_source_loop( t_pidip_source *src, int loop )
+{
+    pthread_mutex_lock( &src->s_mutex );
+    src->s_loop = loop;
+    pthread_cond_broadcast( &src->s_cond );
+    pthread_mutex_unlock( &src->s_mutex );
+}
+
+int pidip_source_frame( t_pidip_source *src, int frame, short int *data )
+{
+  t_pidip_sourceframe *f;
+  int last;
+
+    if ( !src->s_backend ) return 0;
+
+    last = src->s_info.i_nbframes-1;
+    if ( frame > last ) frame = last;
+    if ( frame < 0 ) frame = 0;
+
+    pthread_mutex_lock( &src->s_mutex );
+
+    // the play direction, a loop going on in the same direction
+    if ( src->s_loop && ( src->s_current == last ) && ( frame == 0 ) && ( last > 0 ) )
+       src->s_direction = 1;
+    else if ( src->s_loop && ( src->s_current == 0 ) && ( frame == last ) && ( last > 0 ) )
+       src->s_direction = -1;
+    else if ( frame != src->s_current )
+       src->s_direction = ( frame > src->s_current ) ? 1 : -1;
+    src->s_current = frame;
+    pthread_cond_broadcast( &src->s_cond );
+
+    while ( 1 )
+    {
+       if ( ( f = pidip_source_find( src, frame ) ) )
+       {
+          if ( !f->f_busy ) break;
+          // the prefetcher is on it
+          pthread_cond_wait( &src->s_cond, &src->s_mutex );
+          continue;
+       }
+       if ( !( f = pidip_source_victim( src ) ) )
+       {
+          pthread_cond_wait( &src->s_cond, &src->s_mutex );
+          continue;
+       }
+       if ( !pidip_source_decode( src, f, frame ) )
+       {
+          pthread_mutex_unlock( &src->s_mutex );
+          post( "pidip_source : could not decode frame %d", frame );
+          return 0;
+       }
+    }
+
+    memcpy( data, f->f_data, src->s_framesize );
+    f->f_used = ++src->s_clock;
+    pthread_mutex_unlock( &src->s_mutex );
+    return 1;
+}
+
+double pidip_source_time( t_pidip_source *src, int frame )
+{
+    if ( src->s_info.i_framerate <= 0 ) return 0.;
+    return 1000.*frame/src->s_info.i_framerate;
+}
+
+double pidip_source_duration( t_pidip_source *src )
+{
+    return pidip_source_time( src, src->s_info.i_nbframes );
+}
@@ -0,0 +1,121 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/*  frame source backend for quicktime files
+ *  ( see pidip_source.h )
+ */
+
+#include "pdp.h"
+#include "pdp_llconv.h"
+#include "pidip_config.h"
+#include "pidip_source.h"
+#ifdef QUICKTIME_NEWER
+#include <lqt/lqt.h>
+#include <lqt/colormodels.h>
+#else
+#include <quicktime/lqt.h>
+#include <quicktime/colormodels.h>
+#endif
+
+typedef struct _pidip_source_qt
+{
+  quicktime_t *q_qt;
+  int q_width;
+  int q_height;
+  int q_next;                   // frame the decoder is on
+  unsigned char *q_frame;
+  unsigned char *q_rows[3];
+} t_pidip_source_qt;
+
+static void *pidip_source_qt_open( char *filename, t_pidip_source_info *info )
+{
+  t_pidip_source_qt *q;
+  quicktime_t *qt;
+  int size;
+
+    if ( !quicktime_check_sig( filename ) ) return NULL;
+    if ( !( qt = quicktime_open( filename, 1, 0 ) ) ) return NULL;
+
+    if ( !quicktime_has_video( qt ) )
+    {
+       post( "pidip_source : %s : no video stream", filename );
+       quicktime_close( qt );
+       return NULL;
+    }
+    if ( !quicktime_supported_video( qt, 0 ) )
+    {
+       post( "pidip_source : %s : unsupported video codec", filename );
+       quicktime_close( qt );
+       return NULL;
+    }
+
+    q = (t_pidip_source_qt *) getbytes( sizeof(t_pidip_source_qt) );
+    q->q_qt = qt;
+    q->q_width = quicktime_video_width( qt, 0 );
+    q->q_height = quicktime_video_height( qt, 0 );
+    q->q_next = 0;
+    size = q->q_width*q->q_height;
+    q->q_frame = (unsigned char *) getbytes( size+(size>>1) );
+    q->q_rows[0] = &q->q_frame[0];
+    q->q_rows[2] = &q->q_frame[size];
+    q->q_rows[1] = &q->q_frame[size+(size>>2)];
+    quicktime_set_cmodel( qt, BC_YUV420P );
+
+    info->i_width = q->q_width;
+    info->i_height = q->q_height;
+    info->i_nbframes = quicktime_video_length( qt, 0 );
+    info->i_framerate = quicktime_frame_rate( qt, 0 );
+    return q;
+}
+
+static int pidip_source_qt_decode( void *handle, int frame, short int *data )
+{
+  t_pidip_source_qt *q = (t_pidip_source_qt *) handle;
+
+    // only seek when the frame is not the next one
+    if ( frame != q->q_next ) quicktime_set_video_position( q->q_qt, frame, 0 );
+    if ( lqt_decode_video( q->q_qt, q->q_rows, 0 ) < 0 )
+    {
+       q->q_next = -1;
+       return 0;
+    }
+    q->q_next = frame+1;
+    pdp_llconv( q->q_frame, RIF_YVU__P411_U8, data, RIF_YVU__P411_S16, q->q_width, q->q_height );
+    return 1;
+}
+
+static void pidip_source_qt_close( void *handle )
+{
+  t_pidip_source_qt *q = (t_pidip_source_qt *) handle;
+  int size = q->q_width*q->q_height;
+
+    quicktime_close( q->q_qt );
+    freebytes( q->q_frame, size+(size>>1) );
+    freebytes( q, sizeof(t_pidip_source_qt) );
+}
+
+t_pidip_source_backend pidip_source_quicktime =
+{
+  "quicktime",
+  pidip_source_qt_open,
+  pidip_source_qt_decode,
+  pidip_source_qt_close
+};
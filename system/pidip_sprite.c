@@ -0,0 +1,320 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  YUV+alpha sprites and the text sprite cache
+ *  ( see pidip_sprite.h )
+ */
+
+#include "pdp.h"
+#include "yuv.h"
+#include "pidip_sprite.h"
+#include <Imlib2.h>  // imlib2 is required
+
+void pidip_sprite_init( t_pidip_sprite *sprite )
+{
+    sprite->s_width = 0;
+    sprite->s_height = 0;
+    sprite->s_xoff = 0;
+    sprite->s_yoff = 0;
+    sprite->s_allocated = 0;
+    sprite->s_alpha = NULL;
+    sprite->s_data = NULL;
+}
+
+void pidip_sprite_free( t_pidip_sprite *sprite )
+{
+    if ( sprite->s_alpha ) freebytes( sprite->s_alpha, sprite->s_allocated );
+    if ( sprite->s_data ) freebytes( sprite->s_data, 3*sprite->s_allocated*sizeof(short int) );
+    pidip_sprite_init( sprite );
+}
+
+static int pidip_sprite_allocate( t_pidip_sprite *sprite, int size )
+{
+    if ( size > sprite->s_allocated )
+    {
+       pidip_sprite_free( sprite );
+       sprite->s_alpha = (unsigned char *) getbytes( size );
+       sprite->s_data = (short int *) getbytes( 3*size*sizeof(short int) );
+       if ( !sprite->s_alpha || !sprite->s_data )
+       {
+          post( "pidip_sprite : cannot allocate sprite" );
+          pidip_sprite_free( sprite );
+          return 0;
+       }
+       sprite->s_allocated = size;
+    }
+    return 1;
+}
+
+int pidip_sprite_solid( t_pidip_sprite *sprite, int x, int y, int width, int height, int r, int g, int b )
+{
+  int i, size, rgb;
+  short int sy, sv, su;
+
+    sprite->s_width = 0;
+    sprite->s_height = 0;
+    if ( ( width <= 0 ) || ( height <= 0 ) ) return 0;
+
+    size = width*height;
+    if ( !pidip_sprite_allocate( sprite, size ) ) return 0;
+    sprite->s_width = width;
+    sprite->s_height = height;
+    sprite->s_xoff = x;
+    sprite->s_yoff = y;
+
+    rgb = ( (r&0xff)<<16 ) + ( (g&0xff)<<8 ) + (b&0xff);
+    sy = yuv_RGBtoY( rgb )<<7;
+    sv = ( yuv_RGBtoV( rgb )-128 )<<8;
+    su = ( yuv_RGBtoU( rgb )-128 )<<8;
+    memset( sprite->s_alpha, 0x0, size );
+    for ( i=0; i<size; i++ )
+    {
+       sprite->s_data[i] = sy;
+       sprite->s_data[size+i] = sv;
+       sprite->s_data[2*size+i] = su;
+    }
+    return 1;
+}
+
+void pidip_sprite_from_argb( t_pidip_sprite *sprite, unsigned int *argb, int width, int height,
+                             int xorigin, int yorigin )
+{
+  int px, py, x0, y0, x1, y1, size;
+  unsigned int pixel;
+  unsigned char *palpha;
+  short int *pY, *pV, *pU;
+
+    // bounding box of the drawing
+    x0 = width; y0 = height; x1 = -1; y1 = -1;
+    for ( py=0; py<height; py++ )
+    {
+       for ( px=0; px<width; px++ )
+       {
+          if ( argb[py*width+px]>>24 )
+          {
+             if ( px < x0 ) x0 = px;
+             if ( px > x1 ) x1 = px;
+             if ( py < y0 ) y0 = py;
+             if ( py > y1 ) y1 = py;
+          }
+       }
+    }
+
+    sprite->s_width = 0;
+    sprite->s_height = 0;
+    if ( x1 < 0 ) return;
+
+    size = (x1-x0+1)*(y1-y0+1);
+    if ( !pidip_sprite_allocate( sprite, size ) ) return;
+    sprite->s_width = x1-x0+1;
+    sprite->s_height = y1-y0+1;
+    sprite->s_xoff = x0-xorigin;
+    sprite->s_yoff = y0-yorigin;
+
+    palpha = sprite->s_alpha;
+    pY = sprite->s_data;
+    pV = sprite->s_data+size;
+    pU = sprite->s_data+2*size;
+    for ( py=y0; py<=y1; py++ )
+    {
+       for ( px=x0; px<=x1; px++ )
+       {
+          pixel = argb[py*width+px];
+          *(palpha++) = pixel>>24;
+          *(pY++) = yuv_RGBtoY( pixel )<<7;
+          *(pV++) = ( yuv_RGBtoV( pixel )-128 )<<8;
+          *(pU++) = ( yuv_RGBtoU( pixel )-128 )<<8;
+       }
+    }
+}
+
+void pidip_sprite_blend( t_pidip_sprite *sprite, short int *frame, int fwidth, int fheight,
+                         int x, int y, int alpha )
+{
+  int sx, sy, sx0, sy0, sx1, sy1, cx, cy, dx, dy;
+  int a, asum, vsum, usum, cindex, sindex;
+  int fsize = fwidth*fheight;
+  int ssize = sprite->s_width*sprite->s_height;
+  unsigned char *salpha;
+  short int *sY, *sV, *sU, *pY, *pV, *pU;
+
+    if ( ( sprite->s_width <= 0 ) || ( alpha <= 0 ) ) return;
+    if ( alpha > 256 ) alpha = 256;
+
+    x += sprite->s_xoff;
+    y += sprite->s_yoff;
+
+    // clip the sprite to the frame
+    sx0 = ( x < 0 ) ? -x : 0;
+    sy0 = ( y < 0 ) ? -y : 0;
+    sx1 = ( x+sprite->s_width > fwidth ) ? fwidth-x : sprite->s_width;
+    sy1 = ( y+sprite->s_height > fheight ) ? fheight-y : sprite->s_height;
+    if ( ( sx0 >= sx1 ) || ( sy0 >= sy1 ) ) return;
+
+    // luminance, one pass over the covered rows
+    for ( sy=sy0; sy<sy1; sy++ )
+    {
+       salpha = sprite->s_alpha+sy*sprite->s_width;
+       sY = sprite->s_data+sy*sprite->s_width;
+       pY = frame+(y+sy)*fwidth+x;
+       for ( sx=sx0; sx<sx1; sx++ )
+       {
+          a = ( salpha[sx]*alpha )>>8;
+          pY[sx] += ( ( sY[sx]-pY[sx] )*a )>>8;
+       }
+    }
+
+    // chrominance, each frame sample gets the coverage of its 2x2 block
+    pV = frame+fsize;
+    pU = frame+fsize+(fsize>>2);
+    for ( cy=(y+sy0)>>1; cy<=(y+sy1-1)>>1; cy++ )
+    {
+       for ( cx=(x+sx0)>>1; cx<=(x+sx1-1)>>1; cx++ )
+       {
+          asum = vsum = usum = 0;
+          for ( dy=0; dy<2; dy++ )
+          {
+             sy = (cy<<1)+dy-y;
+             if ( ( sy < sy0 ) || ( sy >= sy1 ) ) continue;
+             for ( dx=0; dx<2; dx++ )
+             {
+                sx = (cx<<1)+dx-x;
+                if ( ( sx < sx0 ) || ( sx >= sx1 ) ) continue;
+                sindex = sy*sprite->s_width+sx;
+                a = sprite->s_alpha[sindex];
+                asum += a;
+                vsum += a*sprite->s_data[ssize+sindex];
+                usum += a*sprite->s_data[2*ssize+sindex];
+             }
+          }
+          if ( asum == 0 ) continue;
+          cindex = cy*(fwidth>>1)+cx;
+          a = ( asum*alpha )>>8;
+          pV[cindex] += ( ( vsum/asum-pV[cindex] )*a )>>10;
+          pU[cindex] += ( ( usum/asum-pU[cindex] )*a )>>10;
+       }
+    }
+}
+
+void pidip_textcache_init( t_pidip_textcache *cache )
+{
+    cache->c_sprites = NULL;
+}
+
+static void pidip_textcache_render( t_pidip_textsprite *t )
+{
+  Imlib_Image image;
+  int width, height;
+
+    imlib_context_set_font( (Imlib_Font)t->t_font );
+    imlib_context_set_direction( IMLIB_TEXT_TO_ANGLE );
+    imlib_context_set_angle( t->t_angle );
+    imlib_get_text_size( t->t_text, &t->t_width, &t->t_height );
+
+    // a margin of one pixel for the rounding of rotated texts
+    width = t->t_width+2;
+    height = t->t_height+2;
+    image = imlib_create_image( width, height );
+    if ( image == NULL )
+    {
+       post( "pidip_sprite : could not allocate text image" );
+       t->t_sprite.s_width = 0;
+       return;
+    }
+    imlib_context_set_image( image );
+    imlib_image_set_has_alpha( 1 );
+    imlib_image_clear();
+    imlib_context_set_color( t->t_r, t->t_g, t->t_b, 255 );
+    imlib_text_draw( 1, 1, t->t_text );
+
+    pidip_sprite_from_argb( &t->t_sprite, (unsigned int *)imlib_image_get_data_for_reading_only(),
+                            width, height, 1, 1 );
+    imlib_free_image();
+}
+
+t_pidip_textsprite *pidip_textcache_get( t_pidip_textcache *cache, char *text, void *font,
+                                         int r, int g, int b, t_float angle )
+{
+  t_pidip_textsprite *t;
+
+    for ( t=cache->c_sprites; t; t=t->t_next )
+    {
+       if ( ( t->t_font == font ) && ( t->t_r == r ) && ( t->t_g == g ) && ( t->t_b == b ) &&
+            ( t->t_angle == angle ) && !strcmp( t->t_text, text ) )
+       {
+          t->t_used = 1;
+          return t;
+       }
+    }
+
+    t = (t_pidip_textsprite *) getbytes( sizeof(t_pidip_textsprite) );
+    t->t_text = (char *) getbytes( strlen(text)+1 );
+    strcpy( t->t_text, text );
+    t->t_font = font;
+    t->t_r = r;
+    t->t_g = g;
+    t->t_b = b;
+    t->t_angle = angle;
+    t->t_used = 1;
+    pidip_sprite_init( &t->t_sprite );
+    pidip_textcache_render( t );
+    t->t_next = cache->c_sprites;
+    cache->c_sprites = t;
+
+    return t;
+}
+
+static void pidip_textcache_release( t_pidip_textsprite *t )
+{
+    pidip_sprite_free( &t->t_sprite );
+    freebytes( t->t_text, strlen(t->t_text)+1 );
+    freebytes( t, sizeof(t_pidip_textsprite) );
+}
+
+void pidip_textcache_collect( t_pidip_textcache *cache )
+{
+  t_pidip_textsprite **pt, *t;
+
+    pt = &cache->c_sprites;
+    while ( (t = *pt) )
+    {
+       if ( t->t_used )
+       {
+          t->t_used = 0;
+          pt = &t->t_next;
+       }
+       else
+       {
+          *pt = t->t_next;
+          pidip_textcache_release( t );
+       }
+    }
+}
+
+void pidip_textcache_flush( t_pidip_textcache *cache )
+{
+  t_pidip_textsprite *t;
+
+    while ( (t = cache->c_sprites) )
+    {
+       cache->c_sprites = t->t_next;
+       pidip_textcache_release( t );
+    }
+}
@@ -0,0 +1,266 @@
+/*
+ *   PiDiP module.
+ *   Copyright (c) by Yves Degoyon (ydegoyon@free.fr)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*  histograms and grid statistics of frames
+ *  ( see pidip_stats.h )
+ */
+
+#include "pdp.h"
+#include "pidip_stats.h"
+
+void pidip_stats_init( t_pidip_stats *st )
+{
+    st->s_cols = 0;
+    st->s_rows = 0;
+    st->s_allocated = 0;
+    st->s_cells = NULL;
+    st->s_colcell = NULL;
+    st->s_colwidth = 0;
+    memset( st->s_histo, 0x0, sizeof(st->s_histo) );
+    memset( st->s_count, 0x0, sizeof(st->s_count) );
+}
+
+void pidip_stats_free( t_pidip_stats *st )
+{
+    if ( st->s_cells ) freebytes( st->s_cells, PIDIP_STATS_CHANNELS*st->s_allocated*sizeof(t_pidip_cellstats) );
+    if ( st->s_colcell ) freebytes( st->s_colcell, st->s_colwidth*sizeof(int) );
+    pidip_stats_init( st );
+}
+
+int pidip_stats_grid( t_pidip_stats *st, int cols, int rows )
+{
+    if ( ( cols <= 0 ) || ( rows <= 0 ) )
+    {
+       st->s_cols = st->s_rows = 0;
+       return 1;
+    }
+    if ( cols*rows > PIDIP_STATS_MAXCELLS ) return 0;
+
+    if ( cols*rows > st->s_allocated )
+    {
+       if ( st->s_cells ) freebytes( st->s_cells, PIDIP_STATS_CHANNELS*st->s_allocated*sizeof(t_pidip_cellstats) );
+       st->s_cells = (t_pidip_cellstats *) getbytes( PIDIP_STATS_CHANNELS*cols*rows*sizeof(t_pidip_cellstats) );
+       if ( !st->s_cells )
+       {
+          st->s_allocated = 0;
+          st->s_cols = st->s_rows = 0;
+          return 0;
+       }
+       st->s_allocated = cols*rows;
+    }
+    st->s_cols = cols;
+    st->s_rows = rows;
+    return 1;
+}
+
+/* clear the results and prepare the cell of each column */
+static void pidip_stats_start( t_pidip_stats *st, int width )
+{
+  int ch, i;
+
+    memset( st->s_histo, 0x0, sizeof(st->s_histo) );
+    memset( st->s_count, 0x0, sizeof(st->s_count) );
+    if ( !st->s_cols ) return;
+
+    if ( width > st->s_colwidth )
+    {
+       if ( st->s_colcell ) freebytes( st->s_colcell, st->s_colwidth*sizeof(int) );
+       st->s_colcell = (int *) getbytes( width*sizeof(int) );
+       st->s_colwidth = width;
+    }
+    for ( i=0; i<width; i++ ) st->s_colcell[i] = (i*st->s_cols)/width;
+
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ )
+    {
+       for ( i=0; i<st->s_cols*st->s_rows; i++ )
+       {
+          t_pidip_cellstats *c = &st->s_cells[ch*st->s_allocated+i];
+          c->c_count = c->c_sum = 0;
+          c->c_sum2 = 0;
+          c->c_min = 255;
+          c->c_max = 0;
+       }
+    }
+}
+
+static inline int pidip_stats_clip( int v )
+{
+    if ( v < 0 ) return 0;
+    if ( v > 255 ) return 255;
+    return v;
+}
+
+static inline void pidip_stats_addcell( t_pidip_cellstats *c, int v )
+{
+    c->c_count++;
+    c->c_sum += v;
+    c->c_sum2 += v*v;
+    if ( v < c->c_min ) c->c_min = v;
+    if ( v > c->c_max ) c->c_max = v;
+}
+
+/* one plane of a YV12 frame, 'shift' and 'bias' bring samples to 0..255,
+   'step' is the ratio between the frame and the plane resolutions */
+static void pidip_stats_plane( t_pidip_stats *st, int ch, short int *plane, int width, int height,
+                               int shift, int bias, int step )
+{
+  int px, py, v;
+  unsigned int *histo = st->s_histo[ch];
+  t_pidip_cellstats *cells, *rowcells;
+
+    if ( !st->s_cols )
+    {
+       for ( px=0; px<width*height; px++ )
+       {
+          histo[pidip_stats_clip( (plane[px]>>shift)+bias )]++;
+       }
+    }
+    else
+    {
+       cells = st->s_cells+ch*st->s_allocated;
+       for ( py=0; py<height; py++ )
+       {
+          rowcells = cells + ((py*st->s_rows)/height)*st->s_cols;
+          for ( px=0; px<width; px++ )
+          {
+             v = pidip_stats_clip( (plane[py*width+px]>>shift)+bias );
+             histo[v]++;
+             pidip_stats_addcell( &rowcells[st->s_colcell[px*step]], v );
+          }
+       }
+    }
+    st->s_count[ch] = width*height;
+}
+
+void pidip_stats_yv12( t_pidip_stats *st, short int *data, int width, int height )
+{
+  int vsize = width*height;
+
+    pidip_stats_start( st, width );
+    pidip_stats_plane( st, 0, data, width, height, 7, 0, 1 );
+    pidip_stats_plane( st, 1, data+vsize+(vsize>>2), width>>1, height>>1, 8, 128, 2 );
+    pidip_stats_plane( st, 2, data+vsize, width>>1, height>>1, 8, 128, 2 );
+}
+
+void pidip_stats_rgb( t_pidip_stats *st, unsigned char *data, int width, int height )
+{
+  int px, py, ch;
+  t_pidip_cellstats *rowcells;
+
+    pidip_stats_start( st, width );
+    if ( !st->s_cols )
+    {
+       for ( px=0; px<width*height; px++ )
+       {
+          st->s_histo[0][data[0]]++;
+          st->s_histo[1][data[1]]++;
+          st->s_histo[2][data[2]]++;
+          data+=3;
+       }
+    }
+    else
+    {
+       for ( py=0; py<height; py++ )
+       {
+          for ( px=0; px<width; px++ )
+          {
+             for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ )
+             {
+                rowcells = st->s_cells + ch*st->s_allocated + ((py*st->s_rows)/height)*st->s_cols;
+                st->s_histo[ch][data[ch]]++;
+                pidip_stats_addcell( &rowcells[st->s_colcell[px]], data[ch] );
+             }
+             data+=3;
+          }
+       }
+    }
+    for ( ch=0; ch<PIDIP_STATS_CHANNELS; ch++ ) st->s_count[ch] = width*height;
+}
+
+int pidip_stats_min( t_pidip_stats *st, int channel )
+{
+  int v;
+
+    for ( v=0; v<256; v++ )
+    {
+       if ( st->s_histo[channel][v] ) return v;
+    }
+    return 0;
+}
+
+int pidip_stats_max( t_pidip_stats *st, int channel )
+{
+  int v;
+
+    for ( v=255; v>=0; v-- )
+    {
+       if ( st->s_histo[channel][v] ) return v;
+    }
+    return 0;
+}
+
+t_float pidip_stats_mean( t_pidip_stats *st, int channel )
+{
+  int v;
+  unsigned long long sum = 0;
+
+    if ( !st->s_count[channel] ) return 0.;
+    for ( v=0; v<256; v++ ) sum += (unsigned long long)v*st->s_histo[channel][v];
+    return (t_float)((double)sum/st->s_count[channel]);
+}
+
+t_float pidip_stats_variance( t_pidip_stats *st, int channel )
+{
+  int v;
+  unsigned long long sum = 0, sum2 = 0;
+  double mean;
+
+    if ( !st->s_count[channel] ) return 0.;
+    for ( v=0; v<256; v++ )
+    {
+       sum += (unsigned long long)v*st->s_histo[channel][v];
+       sum2 += (unsigned long long)v*v*st->s_histo[channel][v];
+    }
+    mean = (double)sum/st->s_count[channel];
+    return (t_float)((double)sum2/st->s_count[channel] - mean*mean);
+}
+
+int pidip_stats_percentile( t_pidip_stats *st, int channel, t_float percent )
+{
+  int v;
+  unsigned int count = 0, limit;
+
+    if ( percent < 0 ) percent = 0;
+    if ( percent > 100 ) percent = 100;
+    limit = (unsigned int)( st->s_count[channel]*(double)percent/100. );
+    if ( ( limit >= st->s_count[channel] ) && ( limit > 0 ) ) limit = st->s_count[channel]-1;
+    for ( v=0; v<256; v++ )
+    {
+       count += st->s_histo[channel][v];
+       if ( count > limit ) return v;
+    }
+    return 255;
+}
+
+t_pidip_cellstats *pidip_stats_cell( t_pidip_stats *st, int channel, int cell )
+{
+    if ( ( cell < 0 ) || ( cell >= st->s_cols*st->s_rows ) ) return NULL;
+    return &st->s_cells[channel*st->s_allocated+cell];
+}
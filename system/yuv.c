@@ -200,6 +200,45 @@ void yuv_Y122BGR( short int* packet, unsigned int *rgb, int width, int height )
 
 }
 
+/* a whole YV12 frame to RGB, the chrominance terms are computed
+ * once for each 2x2 block and shared by its four pixels */
+static inline unsigned char yuv_clip( int c )
+{
+    if ( c>255 ) return 255;
+    if ( c<0 ) return 0;
+    return c;
+}
+
+void yuv_YV12toRGB( short int* packet, unsigned int *rgb, int width, int height )
+{
+  int X, Y, i, y, u, v, r, g, b;
+  int vsize = width*height;
+  short int *pY, *pV, *pU;
+  unsigned int *prgb;
+
+  if ( yuvinit == -1 ) { yuv_init(); }
+  for ( Y=0; Y<height; Y++ )
+  {
+     pY = packet+Y*width;
+     pV = packet+vsize+(Y>>1)*(width>>1);
+     pU = packet+vsize+(vsize>>2)+(Y>>1)*(width>>1);
+     prgb = rgb+Y*width;
+     for ( X=0; X<width; X+=2 )
+     {
+        v = yuv_clip( (*pV++>>8)+128 );
+        u = yuv_clip( (*pU++>>8)+128 );
+        r = VtoR[v];
+        g = UtoG[u] + VtoG[v];
+        b = UtoB[u];
+        for ( i=X; ( i<X+2 ) && ( i<width ); i++ )
+        {
+           y = YtoRGB[yuv_clip( *pY++>>7 )];
+           *prgb++ = (yuv_clip(y+r)<<16) + (yuv_clip(y+g)<<8) + yuv_clip(y+b);
+        }
+     }
+  }
+}
+
 
 void yuv_RGB2Y12( unsigned int *rgb, short int* packet, int width, int height )
 {